@@ -0,0 +1,282 @@
+/**
+ * array.cpp - this file implements a value that's a whole array of ints or
+ *             doubles. The array isn't copied into LKit - the caller binds
+ *             it to their own buffer, and it's just a pointer and a size -
+ *             so a series of ten thousand prices is one value, and not ten
+ *             thousand of them. The reductions in array_functions.h then
+ *             work on the buffer in tight loops. As a single value, an
+ *             array is undefined.
+ */
+
+//	System Headers
+#include <sstream>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "array.h"
+#include "variable.h"
+
+//	Forward Declarations
+
+//	Private Constants
+
+//	Private Datatypes
+
+//	Private Data Constants
+
+
+
+/**
+ * Make it easy to reference the spinlock and it's scoped lock. They
+ * are both in the lkit::util namespace, and it's just going to make
+ * the code a little cleaner.
+ */
+using lkit::util::spinlock;
+
+namespace lkit {
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This is the default constructor that assumes NOTHING - it just
+ * makes an empty array that can be bound to a buffer later.
+ */
+array::array() :
+	value(),
+	_elem(eUnknown),
+	_data(NULL),
+	_size(0)
+{
+}
+
+
+/**
+ * These constructors bind the array to the caller's buffer of
+ * 'aSize' elements. The buffer isn't copied, so it has to be
+ * there for as long as the array is bound to it.
+ */
+array::array( const int *aData, size_t aSize ) :
+	value(),
+	_elem(eInt),
+	_data(aData),
+	_size(aSize)
+{
+}
+
+
+array::array( const double *aData, size_t aSize ) :
+	value(),
+	_elem(eDouble),
+	_data(aData),
+	_size(aSize)
+{
+}
+
+
+/**
+ * This is the standard copy constructor that needs to be in every
+ * class to make sure that we control how many copies we have
+ * floating around in the system. The copy is bound to the same
+ * buffer.
+ */
+array::array( const array & anOther ) :
+	value(),
+	_elem(eUnknown),
+	_data(NULL),
+	_size(0)
+{
+	// let the '=' operator do the heavy lifting...
+	*this = anOther;
+}
+
+
+/**
+ * This is the standard clone method that we'll have for all
+ * classes so that it's possible to clone the value without
+ * having to worry about memory management, etc.
+ */
+value *array::clone() const
+{
+	return new array(*this);
+}
+
+
+/**
+ * This is the standard destructor and needs to be virtual to make
+ * sure that if we subclass off this, the right destructor will be
+ * called.
+ */
+array::~array()
+{
+	// the buffer is the caller's, so there's nothing to do
+}
+
+
+/**
+ * When we process the result of an equality we need to make sure
+ * that we do this right by always having an equals operator on
+ * all classes.
+ */
+array & array::operator=( const array & anOther )
+{
+	if (this != & anOther) {
+		view	v = anOther.getView();
+		{
+			spinlock::scoped_lock	lock(mutex());
+			_elem = v.type;
+			_data = v.data;
+			_size = v.size;
+		}
+		markDependentsDirty();
+	}
+	return *this;
+}
+
+
+/*******************************************************************
+ *
+ *                        Accessor Methods
+ *
+ *******************************************************************/
+/**
+ * These methods bind the array to the caller's buffer of 'aSize'
+ * elements - replacing whatever it was bound to - and let all the
+ * values that depend on it know that it's changed.
+ */
+void array::bind( const int *aData, size_t aSize )
+{
+	{
+		spinlock::scoped_lock	lock(mutex());
+		_elem = eInt;
+		_data = aData;
+		_size = aSize;
+	}
+	markDependentsDirty();
+}
+
+
+void array::bind( const double *aData, size_t aSize )
+{
+	{
+		spinlock::scoped_lock	lock(mutex());
+		_elem = eDouble;
+		_data = aData;
+		_size = aSize;
+	}
+	markDependentsDirty();
+}
+
+
+/**
+ * The buffer belongs to the caller, so we can't know when it's
+ * contents change. When they do, this method lets all the values
+ * that depend on the array know, so that their cached results are
+ * calculated again.
+ */
+void array::touch()
+{
+	markDependentsDirty();
+}
+
+
+/**
+ * This method returns the buffer the array is bound to - the type
+ * is eUnknown if it's not bound at all.
+ */
+array::view array::getView() const
+{
+	view	retval;
+	spinlock::scoped_lock	lock(mutex());
+	retval.type = _elem;
+	retval.data = _data;
+	retval.size = _size;
+	return retval;
+}
+
+
+/**
+ * This method returns the array for the value - if it is one, or
+ * if it's a variable that has one as it's value. Otherwise, it
+ * returns NULL. This is how the reductions find their arrays, as
+ * the parser hands them the variables.
+ */
+array *array::getArray( value *aValue )
+{
+	array	*retval = NULL;
+	if (aValue != NULL) {
+		if (aValue->isArray()) {
+			retval = (array *)aValue;
+		} else if (aValue->isVariable()) {
+			value	*e = ((variable *)aValue)->getExpr();
+			if ((e != NULL) && e->isArray()) {
+				retval = (array *)e;
+			}
+		}
+	}
+	return retval;
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * Because C++ doesn't have a nice 'instanceof' operator, we
+ * need to have an efficient way to know what this particular
+ * instance is REALLY. Since we can have the base class and a
+ * few subclasses, it is necessary to put the tests in this,
+ * the base class, and then just overwrite them in the subclasses.
+ */
+bool array::isArray() const
+{
+	return true;
+}
+
+
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string array::toString() const
+{
+	spinlock::scoped_lock	lock(mutex());
+	return toString_nl();
+}
+
+
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ *
+ * The "_nl" is for no-lock, and this is used by subclasses to
+ * get the representation of this instance variable without the
+ * locking that we'll get with the public interface.
+ */
+std::string array::toString_nl() const
+{
+	std::ostringstream	msg;
+	switch (_elem) {
+		case eInt:
+			msg << "(int[" << _size << "])";
+			break;
+		case eDouble:
+			msg << "(double[" << _size << "])";
+			break;
+		default:
+			msg << "(unknown[])";
+			break;
+	}
+	return msg.str();
+}
+}		// end of namespace lkit
@@ -0,0 +1,175 @@
+/**
+ * array.h - this file defines a value that's a whole array of ints or
+ *           doubles. The array isn't copied into LKit - the caller binds
+ *           it to their own buffer, and it's just a pointer and a size -
+ *           so a series of ten thousand prices is one value, and not ten
+ *           thousand of them. The reductions in array_functions.h then
+ *           work on the buffer in tight loops. As a single value, an
+ *           array is undefined.
+ */
+#ifndef __LKIT_ARRAY_H
+#define __LKIT_ARRAY_H
+
+//	System Headers
+#include <stddef.h>
+#include <string>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "value.h"
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+/**
+ * Main class definition
+ */
+namespace lkit {
+class array :
+	public value
+{
+	public:
+		/**
+		 * This is the buffer the array is bound to - the type of the
+		 * elements, where they are, and how many there are. It's handed
+		 * out all at once, so that it's all from the same binding.
+		 */
+		struct view {
+			value::value_type	type;
+			const void			*data;
+			size_t				size;
+		};
+
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This is the default constructor that assumes NOTHING - it just
+		 * makes an empty array that can be bound to a buffer later.
+		 */
+		array();
+		/**
+		 * These constructors bind the array to the caller's buffer of
+		 * 'aSize' elements. The buffer isn't copied, so it has to be
+		 * there for as long as the array is bound to it.
+		 */
+		array( const int *aData, size_t aSize );
+		array( const double *aData, size_t aSize );
+		/**
+		 * This is the standard copy constructor that needs to be in every
+		 * class to make sure that we control how many copies we have
+		 * floating around in the system. The copy is bound to the same
+		 * buffer.
+		 */
+		array( const array & anOther );
+		/**
+		 * This is the standard clone method that we'll have for all
+		 * classes so that it's possible to clone the value without
+		 * having to worry about memory management, etc.
+		 */
+		virtual value *clone() const;
+		/**
+		 * This is the standard destructor and needs to be virtual to make
+		 * sure that if we subclass off this, the right destructor will be
+		 * called.
+		 */
+		virtual ~array();
+
+		/**
+		 * When we process the result of an equality we need to make sure
+		 * that we do this right by always having an equals operator on
+		 * all classes.
+		 */
+		array & operator=( const array & anOther );
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * These methods bind the array to the caller's buffer of 'aSize'
+		 * elements - replacing whatever it was bound to - and let all the
+		 * values that depend on it know that it's changed.
+		 */
+		void bind( const int *aData, size_t aSize );
+		void bind( const double *aData, size_t aSize );
+		/**
+		 * The buffer belongs to the caller, so we can't know when it's
+		 * contents change. When they do, this method lets all the values
+		 * that depend on the array know, so that their cached results are
+		 * calculated again.
+		 */
+		void touch();
+		/**
+		 * This method returns the buffer the array is bound to - the type
+		 * is eUnknown if it's not bound at all.
+		 */
+		view getView() const;
+
+		/**
+		 * This method returns the array for the value - if it is one, or
+		 * if it's a variable that has one as it's value. Otherwise, it
+		 * returns NULL. This is how the reductions find their arrays, as
+		 * the parser hands them the variables.
+		 */
+		static array *getArray( value *aValue );
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * Because C++ doesn't have a nice 'instanceof' operator, we
+		 * need to have an efficient way to know what this particular
+		 * instance is REALLY. Since we can have the base class and a
+		 * few subclasses, it is necessary to put the tests in this,
+		 * the base class, and then just overwrite them in the subclasses.
+		 */
+		virtual bool isArray() const;
+
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 *
+		 * The "_nl" is for no-lock, and this is used by subclasses to
+		 * get the representation of this instance variable without the
+		 * locking that we'll get with the public interface.
+		 */
+		virtual std::string toString_nl() const;
+
+	private:
+		/**
+		 * This is the caller's buffer we're bound to - the type of the
+		 * elements, and where they are - and how many there are.
+		 */
+		value::value_type		_elem;
+		const void				*_data;
+		size_t					_size;
+};
+}		// end of namespace lkit
+
+#endif		// __LKIT_ARRAY_H
@@ -0,0 +1,196 @@
+/**
+ * array_functions.cpp - this file implements the reductions of arrays for
+ *                       the function table. Each one takes the arrays that
+ *                       are it's arguments - or the variables that have them
+ *                       as their values - and reduces all their elements into
+ *                       one value in a tight loop over the caller's buffer.
+ *                       Anything that's not an array is skipped, just as the
+ *                       undefined values are by the base functions.
+ */
+
+//	System Headers
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "array_functions.h"
+#include "array.h"
+#include "kernels.h"
+
+//	Forward Declarations
+
+//	Private Constants
+
+//	Private Datatypes
+
+//	Private Data Constants
+
+
+namespace lkit {
+namespace func {
+/**
+ * This returns the sum, min or max of the elements of the one array
+ * in it's own type - undefined for the min or max of an empty one.
+ */
+static value reduceView( reduce::reduce_type aType, const array::view & aView )
+{
+	value		retval;
+	bool		dbl = (aView.type == value::eDouble);
+	switch (aType) {
+		case reduce::eSum:
+		case reduce::eMean:
+			if (dbl) {
+				retval = kernels::sum((const double *)aView.data, aView.size);
+			} else {
+				retval = kernels::sum((const int *)aView.data, aView.size);
+			}
+			break;
+		case reduce::eMin:
+			if (aView.size == 0) {
+				break;
+			}
+			if (dbl) {
+				retval = kernels::min((const double *)aView.data, aView.size);
+			} else {
+				retval = kernels::min((const int *)aView.data, aView.size);
+			}
+			break;
+		case reduce::eMax:
+			if (aView.size == 0) {
+				break;
+			}
+			if (dbl) {
+				retval = kernels::max((const double *)aView.data, aView.size);
+			} else {
+				retval = kernels::max((const int *)aView.data, aView.size);
+			}
+			break;
+		default:
+			break;
+	}
+	return retval;
+}
+
+
+/**
+ * reduce() - this function does all the reductions of the arrays based
+ *            on the constructor argument. The default is 'sum'. The sum
+ *            of more than one array is the same as adding up the sums of
+ *            each - so the first array's type is the type of the answer -
+ *            and the mean is of all their elements together. The min and
+ *            max take the type of the array the answer came from, and an
+ *            empty array has no min or max. The dot product is of the
+ *            first two arrays, and they have to be the same size.
+ */
+/*******************************************************************
+ *
+ *                       Evaluation Methods
+ *
+ *******************************************************************/
+/**
+ * This is the main evaluation point for the function. It takes a
+ * vector of values and returns a value - simple. How it does this
+ * is entirely up to the developer of that function.
+ */
+value reduce::eval( std::vector<value *> & anArg )
+{
+	value		ans;
+	// get the buffers of all the arrays - skipping everything else
+	std::vector<array::view>	views;
+	for (size_t i = 0; i < anArg.size(); ++i) {
+		array	*a = array::getArray(anArg[i]);
+		if (a != NULL) {
+			array::view		v = a->getView();
+			if ((v.type == value::eInt) || (v.type == value::eDouble)) {
+				views.push_back(v);
+			}
+		}
+	}
+
+	if (_type == eDot) {
+		// the first two have to line up, element for element
+		if ((views.size() >= 2) && (views[0].size == views[1].size)) {
+			const array::view	& a = views[0];
+			const array::view	& b = views[1];
+			if (a.type == value::eDouble) {
+				if (b.type == value::eDouble) {
+					ans = kernels::dot((const double *)a.data, (const double *)b.data, a.size);
+				} else {
+					ans = kernels::dot((const double *)a.data, (const int *)b.data, a.size);
+				}
+			} else {
+				if (b.type == value::eDouble) {
+					ans = kernels::dot((const int *)a.data, (const double *)b.data, a.size);
+				} else {
+					ans = kernels::dot((const int *)a.data, (const int *)b.data, a.size);
+				}
+			}
+		}
+	} else if (_type == eMean) {
+		// the mean is of all the elements, so it's always a double
+		double	total = 0.0;
+		size_t	cnt = 0;
+		for (size_t i = 0; i < views.size(); ++i) {
+			total += reduceView(eSum, views[i]).evalAsDouble();
+			cnt += views[i].size;
+		}
+		if (cnt > 0) {
+			ans = total / cnt;
+		}
+	} else {
+		// combine the answers for each array as the base functions would
+		for (size_t i = 0; i < views.size(); ++i) {
+			value	v = reduceView(_type, views[i]);
+			if (v.isUndefined()) {
+				continue;
+			}
+			if (ans.isUndefined()) {
+				ans = v;
+			} else if (_type == eSum) {
+				ans += v;
+			} else if ((_type == eMin) ? (v < ans) : (v > ans)) {
+				ans = v;
+			}
+		}
+	}
+	return ans;
+}
+
+
+/**
+ * This is the evaluation point used by the expressions. The arrays
+ * aren't evaluated at all - their buffers are read right where
+ * they are - so there isn't any need for the scratch buffer, and
+ * it's just the eval() above - or a subclass's own, if it has one.
+ */
+value reduce::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return eval(anArg);
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string reduce::toString() const
+{
+	switch (_type) {
+		case eSum :		return "<.vsum.>"; break;
+		case eMean :	return "<.vmean.>"; break;
+		case eMin :		return "<.vmin.>"; break;
+		case eMax :		return "<.vmax.>"; break;
+		case eDot :		return "<.dot.>"; break;
+	}
+	return "<.vsum.>";
+}
+}		// end of namespace func
+}		// end of namespace lkit
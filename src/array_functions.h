@@ -0,0 +1,136 @@
+/**
+ * array_functions.h - this file defines the reductions of arrays for the
+ *                     function table. Each one takes the arrays that are
+ *                     it's arguments - or the variables that have them as
+ *                     their values - and reduces all their elements into
+ *                     one value in a tight loop over the caller's buffer.
+ *                     Anything that's not an array is skipped, just as the
+ *                     undefined values are by the base functions.
+ */
+#ifndef __LKIT_ARRAY_FUNCTIONS_H
+#define __LKIT_ARRAY_FUNCTIONS_H
+
+//	System Headers
+#include <vector>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "function.h"
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+namespace lkit {
+namespace func {
+
+/**
+ * reduce() - this function does all the reductions of the arrays based
+ *            on the constructor argument. The default is 'sum'. The sum
+ *            of more than one array is the same as adding up the sums of
+ *            each - so the first array's type is the type of the answer -
+ *            and the mean is of all their elements together. The min and
+ *            max take the type of the array the answer came from, and an
+ *            empty array has no min or max. The dot product is of the
+ *            first two arrays, and they have to be the same size.
+ */
+class reduce :
+	public function
+{
+	public:
+		/**
+		 * These are the different types of reductions that this function
+		 * can perform. The default, no-arg constructor is eSum, but the
+		 * caller can create any one they desire.
+		 */
+		enum reduce_type {
+			eSum = 0,
+			eMean,
+			eMin,
+			eMax,
+			eDot
+		};
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This function has no state, so these are all very simple to
+		 * stub out here in the header.
+		 */
+		reduce() : _type(eSum) { };
+		reduce( reduce_type aType ) : _type(aType) { };
+		reduce( const reduce & anOther ) : _type(anOther._type) { };
+		virtual function *clone() const { return new reduce(*this); }
+		virtual ~reduce() { };
+		reduce & operator=( const reduce & anOther )
+		{
+			_type = anOther._type;
+			return *this;
+		};
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arrays, and
+		 * they tell their dependents when they change, so it's safe to
+		 * cache - as long as the caller touch()-es an array when it has
+		 * changed the contents of it's buffer.
+		 */
+		virtual bool isPure() const { return true; }
+		/**
+		 * This method returns the type of reduction this instance is
+		 * doing - set in the constructor.
+		 */
+		reduce_type getType() const { return _type; }
+
+		/*******************************************************************
+		 *
+		 *                       Evaluation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This is the main evaluation point for the function. It takes a
+		 * vector of values and returns a value - simple. How it does this
+		 * is entirely up to the developer of that function.
+		 */
+		virtual value eval( std::vector<value *> & anArg );
+		/**
+		 * This is the evaluation point used by the expressions. The arrays
+		 * aren't evaluated at all - their buffers are read right where
+		 * they are - so there isn't any need for the scratch buffer, and
+		 * it's just the eval() above - or a subclass's own, if it has one.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+	private:
+		// this is the type of reduction this instance is doing
+		reduce_type			_type;
+};
+}		// end of namespace func
+}		// end of namespace lkit
+
+#endif		// __LKIT_ARRAY_FUNCTIONS_H
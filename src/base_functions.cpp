@@ -6,6 +6,7 @@
  */
 
 //	System Headers
+#include <typeinfo>
 
 //	Third-Party Headers
 
@@ -23,12 +24,64 @@
 
 namespace lkit {
 namespace func {
+/**
+ * The updates need to know where the first argument is - as it sets the
+ * type of the answer - and if the values are numbers, as those are the
+ * only ones we know how to take out of an answer, and put back in.
+ */
+static size_t firstArg( const std::vector<value *> & anArg )
+{
+	size_t		pos = 0;
+	while ((pos < anArg.size()) && (anArg[pos] == NULL)) {
+		++pos;
+	}
+	return pos;
+}
+
+
+/**
+ * For the sum, the answer starts out undefined when the first argument
+ * is, and it takes on the type of the first one that IS defined. The
+ * updates get the last values seen, so this finds that argument.
+ */
+static size_t firstDefined( const std::vector<value *> & anArg )
+{
+	size_t		pos = 0;
+	while ((pos < anArg.size()) &&
+		   ((anArg[pos] == NULL) || anArg[pos]->isUndefined())) {
+		++pos;
+	}
+	return pos;
+}
+
+
+static bool isNumber( const value & aValue )
+{
+	return (aValue.isInteger() || aValue.isDouble());
+}
+
 
 /**
  * max() - this function simply takes the largest value in the argument
  *         list and returns it. The comparisons are all done on the
  *         values themselves.
  */
+/*******************************************************************
+ *
+ *                        Accessor Methods
+ *
+ *******************************************************************/
+/**
+ * When one argument changes, the answer can be updated from
+ * the old one - but only for this class, as a subclass may well
+ * be doing something different in it's eval().
+ */
+bool max::canUpdate() const
+{
+	return (typeid(*this) == typeid(max));
+}
+
+
 /*******************************************************************
  *
  *                       Evaluation Methods
@@ -40,9 +93,39 @@ namespace func {
  * is entirely up to the developer of that function.
  */
 value max::eval( std::vector<value *> & anArg )
+{
+	std::vector<value>	scratch;
+	return calc(anArg, scratch);
+}
+
+
+/**
+ * This is the evaluation point used by the expressions. Each of the
+ * arguments is evaluated exactly ONCE into the scratch buffer, and
+ * then everything is done on those values. The buffer is owned by
+ * the caller, and reused from call to call.
+ * A subclass that only has it's own eval() of the arguments gets
+ * that called instead, as it's only this one the expressions use.
+ */
+value max::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return (typeid(*this) == typeid(max) ? calc(anArg, aScratch) : eval(anArg));
+}
+
+
+/**
+ * This is where the function is really evaluated - each of the
+ * arguments exactly ONCE into the scratch buffer - for both of the
+ * eval() methods.
+ */
+value max::calc( std::vector<value *> & anArg, std::vector<value> & aScratch )
 {
 	// get the number of arguments to check
 	size_t		sz = anArg.size();
+	// make sure we have a place to evaluate each argument
+	if (aScratch.size() < sz) {
+		aScratch.resize(sz);
+	}
 	/**
 	 * Get the initial value as the first, defined, arg - if we
 	 * have ANY - we just have to find it.
@@ -54,15 +137,16 @@ value max::eval( std::vector<value *> & anArg )
 	}
 	// if we have something, then get it, and process the rest
 	if (pos < sz) {
-		ans = anArg[pos++]->eval();
+		anArg[pos++]->eval(ans);
 		// run through all the rest, comparing as we go
-		value	*v = NULL;
 		while (pos < sz) {
-			// get the pointer to the next argument in the list
-			v = anArg[pos];
+			// evaluate the next argument ONCE, and use that value
+			value	& v = aScratch[pos];
 			// simply look for the largest one that's not undefined
-			if ((v != NULL) && !v->eval().isUndefined()) {
-				ans = (*v > ans ? *v : ans);
+			if ((anArg[pos] != NULL) && !anArg[pos]->eval(v).isUndefined()) {
+				if (v > ans) {
+					ans = v;
+				}
 			}
 			++pos;
 		}
@@ -71,6 +155,33 @@ value max::eval( std::vector<value *> & anArg )
 }
 
 
+/**
+ * This method updates the maximum for the one argument changing.
+ * If the new value is larger, it's the answer. If it's smaller,
+ * and the old one wasn't the answer, nothing changes. Otherwise -
+ * and for the first argument - we have to look at them all.
+ */
+bool max::update( value & anAnswer, const std::vector<value *> & anArg,
+				  size_t aPos, const value & anOld, const value & aNew )
+{
+	bool		ok = (isNumber(anAnswer) && (aPos != firstArg(anArg)) &&
+					  (anOld.isUndefined() || isNumber(anOld)) &&
+					  (aNew.isUndefined() || isNumber(aNew)));
+	if (ok) {
+		if (!aNew.isUndefined() && (aNew > anAnswer)) {
+			anAnswer = aNew;
+		} else if (!anOld.isUndefined() && !(anOld < anAnswer)) {
+			// the old value might have been the answer
+			ok = false;
+		} else if (!aNew.isUndefined() && !(aNew < anAnswer)) {
+			// a tie could change which one is the answer
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+
 /*******************************************************************
  *
  *                         Utility Methods
@@ -98,6 +209,22 @@ std::string max::toString() const
  *         list and returns it. The comparisons are all done on the
  *         values themselves.
  */
+/*******************************************************************
+ *
+ *                        Accessor Methods
+ *
+ *******************************************************************/
+/**
+ * When one argument changes, the answer can be updated from
+ * the old one - but only for this class, as a subclass may well
+ * be doing something different in it's eval().
+ */
+bool min::canUpdate() const
+{
+	return (typeid(*this) == typeid(min));
+}
+
+
 /*******************************************************************
  *
  *                       Evaluation Methods
@@ -109,9 +236,39 @@ std::string max::toString() const
  * is entirely up to the developer of that function.
  */
 value min::eval( std::vector<value *> & anArg )
+{
+	std::vector<value>	scratch;
+	return calc(anArg, scratch);
+}
+
+
+/**
+ * This is the evaluation point used by the expressions. Each of the
+ * arguments is evaluated exactly ONCE into the scratch buffer, and
+ * then everything is done on those values. The buffer is owned by
+ * the caller, and reused from call to call.
+ * A subclass that only has it's own eval() of the arguments gets
+ * that called instead, as it's only this one the expressions use.
+ */
+value min::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return (typeid(*this) == typeid(min) ? calc(anArg, aScratch) : eval(anArg));
+}
+
+
+/**
+ * This is where the function is really evaluated - each of the
+ * arguments exactly ONCE into the scratch buffer - for both of the
+ * eval() methods.
+ */
+value min::calc( std::vector<value *> & anArg, std::vector<value> & aScratch )
 {
 	// get the number of arguments to check
 	size_t		sz = anArg.size();
+	// make sure we have a place to evaluate each argument
+	if (aScratch.size() < sz) {
+		aScratch.resize(sz);
+	}
 	/**
 	 * Get the initial value as the first, defined, arg - if we
 	 * have ANY - we just have to find it.
@@ -123,15 +280,16 @@ value min::eval( std::vector<value *> & anArg )
 	}
 	// if we have something, then get it, and process the rest
 	if (pos < sz) {
-		ans = anArg[pos++]->eval();
+		anArg[pos++]->eval(ans);
 		// run through all the rest, comparing as we go
-		value	*v = NULL;
 		while (pos < sz) {
-			// get the pointer to the next argument in the list
-			v = anArg[pos];
+			// evaluate the next argument ONCE, and use that value
+			value	& v = aScratch[pos];
 			// simply look for the smallest one that's not undefined
-			if ((v != NULL) && !v->eval().isUndefined()) {
-				ans = (*v < ans ? *v : ans);
+			if ((anArg[pos] != NULL) && !anArg[pos]->eval(v).isUndefined()) {
+				if (v < ans) {
+					ans = v;
+				}
 			}
 			++pos;
 		}
@@ -140,6 +298,33 @@ value min::eval( std::vector<value *> & anArg )
 }
 
 
+/**
+ * This method updates the minimum for the one argument changing.
+ * If the new value is smaller, it's the answer. If it's larger,
+ * and the old one wasn't the answer, nothing changes. Otherwise -
+ * and for the first argument - we have to look at them all.
+ */
+bool min::update( value & anAnswer, const std::vector<value *> & anArg,
+				  size_t aPos, const value & anOld, const value & aNew )
+{
+	bool		ok = (isNumber(anAnswer) && (aPos != firstArg(anArg)) &&
+					  (anOld.isUndefined() || isNumber(anOld)) &&
+					  (aNew.isUndefined() || isNumber(aNew)));
+	if (ok) {
+		if (!aNew.isUndefined() && (aNew < anAnswer)) {
+			anAnswer = aNew;
+		} else if (!anOld.isUndefined() && !(anOld > anAnswer)) {
+			// the old value might have been the answer
+			ok = false;
+		} else if (!aNew.isUndefined() && !(aNew > anAnswer)) {
+			// a tie could change which one is the answer
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+
 /*******************************************************************
  *
  *                         Utility Methods
@@ -167,6 +352,22 @@ std::string min::toString() const
  *         and returns it. The operations are all done on the
  *         values themselves.
  */
+/*******************************************************************
+ *
+ *                        Accessor Methods
+ *
+ *******************************************************************/
+/**
+ * When one argument changes, the answer can be updated from
+ * the old one - but only for this class, as a subclass may well
+ * be doing something different in it's eval().
+ */
+bool sum::canUpdate() const
+{
+	return (typeid(*this) == typeid(sum));
+}
+
+
 /*******************************************************************
  *
  *                       Evaluation Methods
@@ -178,9 +379,39 @@ std::string min::toString() const
  * is entirely up to the developer of that function.
  */
 value sum::eval( std::vector<value *> & anArg )
+{
+	std::vector<value>	scratch;
+	return calc(anArg, scratch);
+}
+
+
+/**
+ * This is the evaluation point used by the expressions. Each of the
+ * arguments is evaluated exactly ONCE into the scratch buffer, and
+ * then everything is done on those values. The buffer is owned by
+ * the caller, and reused from call to call.
+ * A subclass that only has it's own eval() of the arguments gets
+ * that called instead, as it's only this one the expressions use.
+ */
+value sum::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return (typeid(*this) == typeid(sum) ? calc(anArg, aScratch) : eval(anArg));
+}
+
+
+/**
+ * This is where the function is really evaluated - each of the
+ * arguments exactly ONCE into the scratch buffer - for both of the
+ * eval() methods.
+ */
+value sum::calc( std::vector<value *> & anArg, std::vector<value> & aScratch )
 {
 	// get the number of arguments to check
 	size_t		sz = anArg.size();
+	// make sure we have a place to evaluate each argument
+	if (aScratch.size() < sz) {
+		aScratch.resize(sz);
+	}
 	/**
 	 * Get the initial value as the first, defined, arg - if we
 	 * have ANY - we just have to find it.
@@ -192,15 +423,14 @@ value sum::eval( std::vector<value *> & anArg )
 	}
 	// if we have something, then get it, and process the rest
 	if (pos < sz) {
-		ans = anArg[pos++]->eval();
+		anArg[pos++]->eval(ans);
 		// run through all the rest, comparing as we go
-		value	*v = NULL;
 		while (pos < sz) {
-			// get the pointer to the next argument in the list
-			v = anArg[pos];
+			// evaluate the next argument ONCE, and use that value
+			value	& v = aScratch[pos];
 			// simply sum up all the valid values as best we can...
-			if ((v != NULL) && !v->eval().isUndefined()) {
-				ans += *v;
+			if ((anArg[pos] != NULL) && !anArg[pos]->eval(v).isUndefined()) {
+				ans += v;
 			}
 			++pos;
 		}
@@ -209,6 +439,38 @@ value sum::eval( std::vector<value *> & anArg )
 }
 
 
+/**
+ * This method updates the sum for the one argument changing by
+ * taking out the old value, and putting in the new one. The first
+ * defined argument sets the type of the answer, so it can only
+ * change to a value of the same type, and none of the undefined
+ * ones ahead of it can become defined.
+ */
+bool sum::update( value & anAnswer, const std::vector<value *> & anArg,
+				  size_t aPos, const value & anOld, const value & aNew )
+{
+	bool		ok = isNumber(anAnswer);
+	if (ok && (aPos <= firstDefined(anArg))) {
+		// an undefined one ahead of it would take over the type
+		ok = (isNumber(anOld) && isNumber(aNew) &&
+			  (anOld.isDouble() == aNew.isDouble()));
+	} else if (ok) {
+		// undefined values are skipped in the sum, so they can come and go
+		ok = ((anOld.isUndefined() || isNumber(anOld)) &&
+			  (aNew.isUndefined() || isNumber(aNew)));
+	}
+	if (ok) {
+		if (!anOld.isUndefined()) {
+			anAnswer -= anOld;
+		}
+		if (!aNew.isUndefined()) {
+			anAnswer += aNew;
+		}
+	}
+	return ok;
+}
+
+
 /*******************************************************************
  *
  *                         Utility Methods
@@ -247,9 +509,39 @@ std::string sum::toString() const
  * is entirely up to the developer of that function.
  */
 value diff::eval( std::vector<value *> & anArg )
+{
+	std::vector<value>	scratch;
+	return calc(anArg, scratch);
+}
+
+
+/**
+ * This is the evaluation point used by the expressions. Each of the
+ * arguments is evaluated exactly ONCE into the scratch buffer, and
+ * then everything is done on those values. The buffer is owned by
+ * the caller, and reused from call to call.
+ * A subclass that only has it's own eval() of the arguments gets
+ * that called instead, as it's only this one the expressions use.
+ */
+value diff::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return (typeid(*this) == typeid(diff) ? calc(anArg, aScratch) : eval(anArg));
+}
+
+
+/**
+ * This is where the function is really evaluated - each of the
+ * arguments exactly ONCE into the scratch buffer - for both of the
+ * eval() methods.
+ */
+value diff::calc( std::vector<value *> & anArg, std::vector<value> & aScratch )
 {
 	// get the number of arguments to check
 	size_t		sz = anArg.size();
+	// make sure we have a place to evaluate each argument
+	if (aScratch.size() < sz) {
+		aScratch.resize(sz);
+	}
 	/**
 	 * Get the initial value as the first, defined, arg - if we
 	 * have ANY - we just have to find it.
@@ -261,20 +553,19 @@ value diff::eval( std::vector<value *> & anArg )
 	}
 	// if we have something, then get it, and process the rest
 	if (pos < sz) {
-		ans = anArg[pos++]->eval();
+		anArg[pos++]->eval(ans);
 		// check for unary minus
 		if (pos >= sz) {
 			// unary minus - just negate what we have
 			ans *= -1;
 		} else {
 			// run through all the rest, comparing as we go
-			value	*v = NULL;
 			while (pos < sz) {
-				// get the pointer to the next argument in the list
-				v = anArg[pos];
+				// evaluate the next argument ONCE, and use that value
+				value	& v = aScratch[pos];
 				// simply difference all the valid values as best we can...
-				if ((v != NULL) && !v->eval().isUndefined()) {
-					ans -= *v;
+				if ((anArg[pos] != NULL) && !anArg[pos]->eval(v).isUndefined()) {
+					ans -= v;
 				}
 				++pos;
 			}
@@ -311,6 +602,22 @@ std::string diff::toString() const
  *          and returns it. The operations are all done on the
  *          values themselves.
  */
+/*******************************************************************
+ *
+ *                        Accessor Methods
+ *
+ *******************************************************************/
+/**
+ * When one argument changes, the answer can be updated from
+ * the old one - but only for this class, as a subclass may well
+ * be doing something different in it's eval().
+ */
+bool prod::canUpdate() const
+{
+	return (typeid(*this) == typeid(prod));
+}
+
+
 /*******************************************************************
  *
  *                       Evaluation Methods
@@ -322,9 +629,39 @@ std::string diff::toString() const
  * is entirely up to the developer of that function.
  */
 value prod::eval( std::vector<value *> & anArg )
+{
+	std::vector<value>	scratch;
+	return calc(anArg, scratch);
+}
+
+
+/**
+ * This is the evaluation point used by the expressions. Each of the
+ * arguments is evaluated exactly ONCE into the scratch buffer, and
+ * then everything is done on those values. The buffer is owned by
+ * the caller, and reused from call to call.
+ * A subclass that only has it's own eval() of the arguments gets
+ * that called instead, as it's only this one the expressions use.
+ */
+value prod::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return (typeid(*this) == typeid(prod) ? calc(anArg, aScratch) : eval(anArg));
+}
+
+
+/**
+ * This is where the function is really evaluated - each of the
+ * arguments exactly ONCE into the scratch buffer - for both of the
+ * eval() methods.
+ */
+value prod::calc( std::vector<value *> & anArg, std::vector<value> & aScratch )
 {
 	// get the number of arguments to check
 	size_t		sz = anArg.size();
+	// make sure we have a place to evaluate each argument
+	if (aScratch.size() < sz) {
+		aScratch.resize(sz);
+	}
 	/**
 	 * Get the initial value as the first, defined, arg - if we
 	 * have ANY - we just have to find it.
@@ -336,15 +673,14 @@ value prod::eval( std::vector<value *> & anArg )
 	}
 	// if we have something, then get it, and process the rest
 	if (pos < sz) {
-		ans = anArg[pos++]->eval();
+		anArg[pos++]->eval(ans);
 		// run through all the rest, comparing as we go
-		value	*v = NULL;
 		while (pos < sz) {
-			// get the pointer to the next argument in the list
-			v = anArg[pos];
+			// evaluate the next argument ONCE, and use that value
+			value	& v = aScratch[pos];
 			// simply multiply all the valid values as best we can...
-			if ((v != NULL) && !v->eval().isUndefined()) {
-				ans *= *v;
+			if ((anArg[pos] != NULL) && !anArg[pos]->eval(v).isUndefined()) {
+				ans *= v;
 			}
 			++pos;
 		}
@@ -353,6 +689,48 @@ value prod::eval( std::vector<value *> & anArg )
 }
 
 
+/**
+ * This method updates the product for the one argument changing
+ * by dividing out the old value, and multiplying in the new one.
+ * That can't be done when the old value is zero, and for an int
+ * answer, everything has to be an int that divides evenly.
+ */
+bool prod::update( value & anAnswer, const std::vector<value *> & anArg,
+				   size_t aPos, const value & anOld, const value & aNew )
+{
+	bool		ok = isNumber(anAnswer);
+	if (ok && (aPos == firstArg(anArg))) {
+		ok = (isNumber(anOld) && isNumber(aNew) &&
+			  (anOld.isDouble() == aNew.isDouble()));
+	} else if (ok) {
+		// undefined values are skipped in the product, so they can come and go
+		ok = ((anOld.isUndefined() || isNumber(anOld)) &&
+			  (aNew.isUndefined() || isNumber(aNew)));
+	}
+	if (ok && !anOld.isUndefined()) {
+		value	old(anOld);
+		if (anAnswer.isInteger()) {
+			ok = (old.isInteger() && (aNew.isUndefined() || aNew.isInteger()) &&
+				  (old.evalAsInt() != 0) &&
+				  ((anAnswer.evalAsInt() % old.evalAsInt()) == 0));
+		} else {
+			ok = (old.evalAsDouble() != 0.0);
+		}
+	} else if (ok && anAnswer.isInteger()) {
+		ok = (aNew.isUndefined() || aNew.isInteger());
+	}
+	if (ok) {
+		if (!anOld.isUndefined()) {
+			anAnswer /= anOld;
+		}
+		if (!aNew.isUndefined()) {
+			anAnswer *= aNew;
+		}
+	}
+	return ok;
+}
+
+
 /*******************************************************************
  *
  *                         Utility Methods
@@ -391,9 +769,39 @@ std::string prod::toString() const
  * is entirely up to the developer of that function.
  */
 value quot::eval( std::vector<value *> & anArg )
+{
+	std::vector<value>	scratch;
+	return calc(anArg, scratch);
+}
+
+
+/**
+ * This is the evaluation point used by the expressions. Each of the
+ * arguments is evaluated exactly ONCE into the scratch buffer, and
+ * then everything is done on those values. The buffer is owned by
+ * the caller, and reused from call to call.
+ * A subclass that only has it's own eval() of the arguments gets
+ * that called instead, as it's only this one the expressions use.
+ */
+value quot::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return (typeid(*this) == typeid(quot) ? calc(anArg, aScratch) : eval(anArg));
+}
+
+
+/**
+ * This is where the function is really evaluated - each of the
+ * arguments exactly ONCE into the scratch buffer - for both of the
+ * eval() methods.
+ */
+value quot::calc( std::vector<value *> & anArg, std::vector<value> & aScratch )
 {
 	// get the number of arguments to check
 	size_t		sz = anArg.size();
+	// make sure we have a place to evaluate each argument
+	if (aScratch.size() < sz) {
+		aScratch.resize(sz);
+	}
 	/**
 	 * Get the initial value as the first, defined, arg - if we
 	 * have ANY - we just have to find it.
@@ -405,15 +813,14 @@ value quot::eval( std::vector<value *> & anArg )
 	}
 	// if we have something, then get it, and process the rest
 	if (pos < sz) {
-		ans = anArg[pos++]->eval();
+		anArg[pos++]->eval(ans);
 		// run through all the rest, comparing as we go
-		value	*v = NULL;
 		while (pos < sz) {
-			// get the pointer to the next argument in the list
-			v = anArg[pos];
+			// evaluate the next argument ONCE, and use that value
+			value	& v = aScratch[pos];
 			// simply divide all the valid values as best we can...
-			if ((v != NULL) && !v->eval().isUndefined()) {
-				ans /= *v;
+			if ((anArg[pos] != NULL) && !anArg[pos]->eval(v).isUndefined()) {
+				ans /= v;
 			}
 			++pos;
 		}
@@ -461,9 +868,39 @@ std::string quot::toString() const
  * is entirely up to the developer of that function.
  */
 value comp::eval( std::vector<value *> & anArg )
+{
+	std::vector<value>	scratch;
+	return calc(anArg, scratch);
+}
+
+
+/**
+ * This is the evaluation point used by the expressions. Each of the
+ * arguments is evaluated exactly ONCE into the scratch buffer, and
+ * then everything is done on those values. The buffer is owned by
+ * the caller, and reused from call to call.
+ * A subclass that only has it's own eval() of the arguments gets
+ * that called instead, as it's only this one the expressions use.
+ */
+value comp::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return (typeid(*this) == typeid(comp) ? calc(anArg, aScratch) : eval(anArg));
+}
+
+
+/**
+ * This is where the function is really evaluated - each of the
+ * arguments exactly ONCE into the scratch buffer - for both of the
+ * eval() methods.
+ */
+value comp::calc( std::vector<value *> & anArg, std::vector<value> & aScratch )
 {
 	// get the number of arguments to check
 	size_t		sz = anArg.size();
+	// make sure we have a place to evaluate each argument
+	if (aScratch.size() < sz) {
+		aScratch.resize(sz);
+	}
 	/**
 	 * Get the initial value as the first, defined, arg - if we
 	 * have ANY - we just have to find it.
@@ -478,60 +915,59 @@ value comp::eval( std::vector<value *> & anArg )
 	if (pos < sz) {
 		value	first = anArg[pos++]->eval();
 		// run through all the rest, comparing as we go
-		value	*v = NULL;
 		bool	keepGoing = true;
 		while (keepGoing && (pos < sz)) {
-			// get the pointer to the next argument in the list
-			v = anArg[pos];
+			// evaluate the next argument ONCE, and use that value
+			value	& v = aScratch[pos];
 			// simply check all the valid values as best we can...
-			if ((v != NULL) && !v->eval().isUndefined()) {
+			if ((anArg[pos] != NULL) && !anArg[pos]->eval(v).isUndefined()) {
 				// make sure we count the valid values
 				++cnt;
 				// based on what we are, check for show stopper
 				switch (_type) {
 					case eEquals :
-						if (first != *v) {
+						if (first != v) {
 							comp = false;
 							keepGoing = false;
 						}
 						break;
 					case eNotEquals :
-						if (first == *v) {
+						if (first == v) {
 							comp = false;
 							keepGoing = false;
 						}
 						break;
 					case eLessThan :
-						if (first < *v) {
+						if (first < v) {
 							// compare against this value now
-							first = *v;
+							first = v;
 						} else {
 							comp = false;
 							keepGoing = false;
 						}
 						break;
 					case eGreaterThan :
-						if (first > *v) {
+						if (first > v) {
 							// compare against this value now
-							first = *v;
+							first = v;
 						} else {
 							comp = false;
 							keepGoing = false;
 						}
 						break;
 					case eLessOrEqual :
-						if (first <= *v) {
+						if (first <= v) {
 							// compare against this value now
-							first = *v;
+							first = v;
 						} else {
 							comp = false;
 							keepGoing = false;
 						}
 						break;
 					case eGreaterOrEqual :
-						if (first >= *v) {
+						if (first >= v) {
 							// compare against this value now
-							first = *v;
+							first = v;
 						} else {
 							comp = false;
 							keepGoing = false;
@@ -598,23 +1034,51 @@ std::string comp::toString() const
  * is entirely up to the developer of that function.
  */
 value bin::eval( std::vector<value *> & anArg )
+{
+	std::vector<value>	scratch;
+	return calc(anArg, scratch);
+}
+
+
+/**
+ * This is the evaluation point used by the expressions. Each of the
+ * arguments is evaluated exactly ONCE into the scratch buffer, and
+ * then everything is done on those values. The buffer is owned by
+ * the caller, and reused from call to call.
+ * A subclass that only has it's own eval() of the arguments gets
+ * that called instead, as it's only this one the expressions use.
+ */
+value bin::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return (typeid(*this) == typeid(bin) ? calc(anArg, aScratch) : eval(anArg));
+}
+
+
+/**
+ * This is where the function is really evaluated - each of the
+ * arguments exactly ONCE into the scratch buffer - for both of the
+ * eval() methods.
+ */
+value bin::calc( std::vector<value *> & anArg, std::vector<value> & aScratch )
 {
 	// get the number of arguments to check
 	size_t		sz = anArg.size();
+	// make sure we have a place to evaluate each argument
+	if (aScratch.size() < sz) {
+		aScratch.resize(sz);
+	}
 	size_t		pos = 0;
-	// assume the test is true, and check it
-	bool		test = true;
+	// 'and' is true until we find a false, and 'or' false until a true
+	bool		test = (_type != eOr);
 	size_t		cnt = 0;
 	if (pos < sz) {
 		// run through all the values, checking as we go
-		value	*v = NULL;
-		value	val;
 		bool	keepGoing = true;
 		while (keepGoing && (pos < sz)) {
-			// get the pointer to the next argument in the list
-			v = anArg[pos];
+			// evaluate the next argument ONCE, and use that value
+			value	& val = aScratch[pos];
 			// simply check all the valid values as best we can...
-			if ((v != NULL) && !(val = v->eval()).isUndefined()) {
+			if ((anArg[pos] != NULL) && !anArg[pos]->eval(val).isUndefined()) {
 				// make sure we count the valid values
 				++cnt;
 				// based on what we are, check for show stopper
@@ -671,5 +1135,109 @@ std::string bin::toString() const
 	}
 	return "<.and.>";
 }
+
+
+
+
+
+
+
+/**
+ * cond() - this function takes pairs of arguments - a test and a value -
+ *          and returns the value of the first pair whose test is true.
+ *          If there's an odd argument left at the end, it's the value
+ *          when none of the tests are true - otherwise that's undefined.
+ *          Only the tests up to the one that's true, and it's value, are
+ *          evaluated, so '(if test then else)' is just the one pair.
+ */
+/*******************************************************************
+ *
+ *                       Evaluation Methods
+ *
+ *******************************************************************/
+/**
+ * This is the main evaluation point for the function. It takes a
+ * vector of values and returns a value - simple. How it does this
+ * is entirely up to the developer of that function.
+ */
+value cond::eval( std::vector<value *> & anArg )
+{
+	std::vector<value>	scratch;
+	return calc(anArg, scratch);
+}
+
+
+/**
+ * This is the evaluation point used by the expressions. Only the
+ * tests up to the first one that's true, and it's value, are ever
+ * evaluated - the rest of the arguments are left alone - so there
+ * isn't any need for the scratch buffer.
+ * A subclass that only has it's own eval() of the arguments gets
+ * that called instead, as it's only this one the expressions use.
+ */
+value cond::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return (typeid(*this) == typeid(cond) ? calc(anArg, aScratch) : eval(anArg));
+}
+
+
+/**
+ * This is where the function is really evaluated - each of the
+ * arguments exactly ONCE into the scratch buffer - for both of the
+ * eval() methods.
+ */
+value cond::calc( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	value		ans;
+	size_t		sz = anArg.size();
+	size_t		pos = 0;
+	bool		keepGoing = true;
+	while (keepGoing) {
+		// find the next test - skipping the NULLs as the others do
+		while ((pos < sz) && (anArg[pos] == NULL)) {
+			++pos;
+		}
+		if (pos >= sz) {
+			break;
+		}
+		value	*test = anArg[pos++];
+		// ...and the value that goes with it
+		while ((pos < sz) && (anArg[pos] == NULL)) {
+			++pos;
+		}
+		if (pos >= sz) {
+			// there's no value, so this is the one for 'none of the above'
+			test->eval(ans);
+			keepGoing = false;
+		} else {
+			value	*val = anArg[pos++];
+			// an undefined test isn't true - so on to the next pair
+			value	t = test->eval();
+			if (!t.isUndefined() && t.evalAsBool()) {
+				val->eval(ans);
+				keepGoing = false;
+			}
+		}
+	}
+	return ans;
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string cond::toString() const
+{
+	return "<.cond.>";
+}
 }		// end of namespace func
 }		// end of namespace lkit
@@ -50,6 +50,23 @@ class max :
 		virtual ~max() { };
 		max & operator=( const max & anOther ) { return *this; };
 
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+		/**
+		 * When one argument changes, the answer can be updated from
+		 * the old one - but only for this class, as a subclass may well
+		 * be doing something different in it's eval().
+		 */
+		virtual bool canUpdate() const;
+
 		/*******************************************************************
 		 *
 		 *                       Evaluation Methods
@@ -61,6 +78,23 @@ class max :
 		 * is entirely up to the developer of that function.
 		 */
 		virtual value eval( std::vector<value *> & anArg );
+		/**
+		 * This is the evaluation point used by the expressions. Each of the
+		 * arguments is evaluated exactly ONCE into the scratch buffer, and
+		 * then everything is done on those values. The buffer is owned by
+		 * the caller, and reused from call to call.
+		 * A subclass that only has it's own eval() of the arguments gets
+		 * that called instead, as it's only this one the expressions use.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
+		/**
+		 * This method updates the maximum for the one argument changing.
+		 * If the new value is larger, it's the answer. If it's smaller,
+		 * and the old one wasn't the answer, nothing changes. Otherwise -
+		 * and for the first argument - we have to look at them all.
+		 */
+		virtual bool update( value & anAnswer, const std::vector<value *> & anArg,
+							 size_t aPos, const value & anOld, const value & aNew );
 
 		/*******************************************************************
 		 *
@@ -75,6 +109,14 @@ class max :
 		 * this guy.
 		 */
 		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * This is where the function is really evaluated - each of the
+		 * arguments exactly ONCE into the scratch buffer - for both of the
+		 * eval() methods.
+		 */
+		value calc( std::vector<value *> & anArg, std::vector<value> & aScratch );
 };
 
 
@@ -103,6 +145,23 @@ class min :
 		virtual ~min() { };
 		min & operator=( const min & anOther ) { return *this; };
 
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+		/**
+		 * When one argument changes, the answer can be updated from
+		 * the old one - but only for this class, as a subclass may well
+		 * be doing something different in it's eval().
+		 */
+		virtual bool canUpdate() const;
+
 		/*******************************************************************
 		 *
 		 *                       Evaluation Methods
@@ -114,6 +173,23 @@ class min :
 		 * is entirely up to the developer of that function.
 		 */
 		virtual value eval( std::vector<value *> & anArg );
+		/**
+		 * This is the evaluation point used by the expressions. Each of the
+		 * arguments is evaluated exactly ONCE into the scratch buffer, and
+		 * then everything is done on those values. The buffer is owned by
+		 * the caller, and reused from call to call.
+		 * A subclass that only has it's own eval() of the arguments gets
+		 * that called instead, as it's only this one the expressions use.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
+		/**
+		 * This method updates the minimum for the one argument changing.
+		 * If the new value is smaller, it's the answer. If it's larger,
+		 * and the old one wasn't the answer, nothing changes. Otherwise -
+		 * and for the first argument - we have to look at them all.
+		 */
+		virtual bool update( value & anAnswer, const std::vector<value *> & anArg,
+							 size_t aPos, const value & anOld, const value & aNew );
 
 		/*******************************************************************
 		 *
@@ -128,6 +204,14 @@ class min :
 		 * this guy.
 		 */
 		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * This is where the function is really evaluated - each of the
+		 * arguments exactly ONCE into the scratch buffer - for both of the
+		 * eval() methods.
+		 */
+		value calc( std::vector<value *> & anArg, std::vector<value> & aScratch );
 };
 
 
@@ -156,6 +240,23 @@ class sum :
 		virtual ~sum() { };
 		sum & operator=( const sum & anOther ) { return *this; };
 
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+		/**
+		 * When one argument changes, the answer can be updated from
+		 * the old one - but only for this class, as a subclass may well
+		 * be doing something different in it's eval().
+		 */
+		virtual bool canUpdate() const;
+
 		/*******************************************************************
 		 *
 		 *                       Evaluation Methods
@@ -167,6 +268,24 @@ class sum :
 		 * is entirely up to the developer of that function.
 		 */
 		virtual value eval( std::vector<value *> & anArg );
+		/**
+		 * This is the evaluation point used by the expressions. Each of the
+		 * arguments is evaluated exactly ONCE into the scratch buffer, and
+		 * then everything is done on those values. The buffer is owned by
+		 * the caller, and reused from call to call.
+		 * A subclass that only has it's own eval() of the arguments gets
+		 * that called instead, as it's only this one the expressions use.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
+		/**
+		 * This method updates the sum for the one argument changing by
+		 * taking out the old value, and putting in the new one. The first
+		 * defined argument sets the type of the answer, so it can only
+		 * change to a value of the same type, and none of the undefined
+		 * ones ahead of it can become defined.
+		 */
+		virtual bool update( value & anAnswer, const std::vector<value *> & anArg,
+							 size_t aPos, const value & anOld, const value & aNew );
 
 		/*******************************************************************
 		 *
@@ -181,6 +300,14 @@ class sum :
 		 * this guy.
 		 */
 		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * This is where the function is really evaluated - each of the
+		 * arguments exactly ONCE into the scratch buffer - for both of the
+		 * eval() methods.
+		 */
+		value calc( std::vector<value *> & anArg, std::vector<value> & aScratch );
 };
 
 
@@ -209,6 +336,17 @@ class diff :
 		virtual ~diff() { };
 		diff & operator=( const diff & anOther ) { return *this; };
 
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+
 		/*******************************************************************
 		 *
 		 *                       Evaluation Methods
@@ -220,6 +358,15 @@ class diff :
 		 * is entirely up to the developer of that function.
 		 */
 		virtual value eval( std::vector<value *> & anArg );
+		/**
+		 * This is the evaluation point used by the expressions. Each of the
+		 * arguments is evaluated exactly ONCE into the scratch buffer, and
+		 * then everything is done on those values. The buffer is owned by
+		 * the caller, and reused from call to call.
+		 * A subclass that only has it's own eval() of the arguments gets
+		 * that called instead, as it's only this one the expressions use.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
 
 		/*******************************************************************
 		 *
@@ -234,6 +381,14 @@ class diff :
 		 * this guy.
 		 */
 		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * This is where the function is really evaluated - each of the
+		 * arguments exactly ONCE into the scratch buffer - for both of the
+		 * eval() methods.
+		 */
+		value calc( std::vector<value *> & anArg, std::vector<value> & aScratch );
 };
 
 
@@ -262,6 +417,23 @@ class prod :
 		virtual ~prod() { };
 		prod & operator=( const prod & anOther ) { return *this; };
 
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+		/**
+		 * When one argument changes, the answer can be updated from
+		 * the old one - but only for this class, as a subclass may well
+		 * be doing something different in it's eval().
+		 */
+		virtual bool canUpdate() const;
+
 		/*******************************************************************
 		 *
 		 *                       Evaluation Methods
@@ -273,6 +445,23 @@ class prod :
 		 * is entirely up to the developer of that function.
 		 */
 		virtual value eval( std::vector<value *> & anArg );
+		/**
+		 * This is the evaluation point used by the expressions. Each of the
+		 * arguments is evaluated exactly ONCE into the scratch buffer, and
+		 * then everything is done on those values. The buffer is owned by
+		 * the caller, and reused from call to call.
+		 * A subclass that only has it's own eval() of the arguments gets
+		 * that called instead, as it's only this one the expressions use.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
+		/**
+		 * This method updates the product for the one argument changing
+		 * by dividing out the old value, and multiplying in the new one.
+		 * That can't be done when the old value is zero, and for an int
+		 * answer, everything has to be an int that divides evenly.
+		 */
+		virtual bool update( value & anAnswer, const std::vector<value *> & anArg,
+							 size_t aPos, const value & anOld, const value & aNew );
 
 		/*******************************************************************
 		 *
@@ -287,6 +476,14 @@ class prod :
 		 * this guy.
 		 */
 		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * This is where the function is really evaluated - each of the
+		 * arguments exactly ONCE into the scratch buffer - for both of the
+		 * eval() methods.
+		 */
+		value calc( std::vector<value *> & anArg, std::vector<value> & aScratch );
 };
 
 
@@ -315,6 +512,17 @@ class quot :
 		virtual ~quot() { };
 		quot & operator=( const quot & anOther ) { return *this; };
 
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+
 		/*******************************************************************
 		 *
 		 *                       Evaluation Methods
@@ -326,6 +534,15 @@ class quot :
 		 * is entirely up to the developer of that function.
 		 */
 		virtual value eval( std::vector<value *> & anArg );
+		/**
+		 * This is the evaluation point used by the expressions. Each of the
+		 * arguments is evaluated exactly ONCE into the scratch buffer, and
+		 * then everything is done on those values. The buffer is owned by
+		 * the caller, and reused from call to call.
+		 * A subclass that only has it's own eval() of the arguments gets
+		 * that called instead, as it's only this one the expressions use.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
 
 		/*******************************************************************
 		 *
@@ -340,6 +557,14 @@ class quot :
 		 * this guy.
 		 */
 		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * This is where the function is really evaluated - each of the
+		 * arguments exactly ONCE into the scratch buffer - for both of the
+		 * eval() methods.
+		 */
+		value calc( std::vector<value *> & anArg, std::vector<value> & aScratch );
 };
 
 
@@ -387,6 +612,22 @@ class comp :
 			return *this;
 		};
 
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+		/**
+		 * This method returns the type of comparison this instance is
+		 * doing - set in the constructor.
+		 */
+		comp_type getType() const { return _type; }
+
 		/*******************************************************************
 		 *
 		 *                       Evaluation Methods
@@ -398,6 +639,15 @@ class comp :
 		 * is entirely up to the developer of that function.
 		 */
 		virtual value eval( std::vector<value *> & anArg );
+		/**
+		 * This is the evaluation point used by the expressions. Each of the
+		 * arguments is evaluated exactly ONCE into the scratch buffer, and
+		 * then everything is done on those values. The buffer is owned by
+		 * the caller, and reused from call to call.
+		 * A subclass that only has it's own eval() of the arguments gets
+		 * that called instead, as it's only this one the expressions use.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
 
 		/*******************************************************************
 		 *
@@ -412,6 +662,14 @@ class comp :
 		 * this guy.
 		 */
 		virtual std::string toString() const;
+	protected:
+		/**
+		 * This is where the function is really evaluated - each of the
+		 * arguments exactly ONCE into the scratch buffer - for both of the
+		 * eval() methods.
+		 */
+		value calc( std::vector<value *> & anArg, std::vector<value> & aScratch );
+
 	private:
 		// this is the type of comparison this instance is doing
 		comp_type		_type;
@@ -459,6 +717,22 @@ class bin :
 			return *this;
 		};
 
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+		/**
+		 * This method returns the type of operation this instance is
+		 * doing - set in the constructor.
+		 */
+		bin_type getType() const { return _type; }
+
 		/*******************************************************************
 		 *
 		 *                       Evaluation Methods
@@ -470,6 +744,15 @@ class bin :
 		 * is entirely up to the developer of that function.
 		 */
 		virtual value eval( std::vector<value *> & anArg );
+		/**
+		 * This is the evaluation point used by the expressions. Each of the
+		 * arguments is evaluated exactly ONCE into the scratch buffer, and
+		 * then everything is done on those values. The buffer is owned by
+		 * the caller, and reused from call to call.
+		 * A subclass that only has it's own eval() of the arguments gets
+		 * that called instead, as it's only this one the expressions use.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
 
 		/*******************************************************************
 		 *
@@ -484,10 +767,102 @@ class bin :
 		 * this guy.
 		 */
 		virtual std::string toString() const;
+	protected:
+		/**
+		 * This is where the function is really evaluated - each of the
+		 * arguments exactly ONCE into the scratch buffer - for both of the
+		 * eval() methods.
+		 */
+		value calc( std::vector<value *> & anArg, std::vector<value> & aScratch );
+
 	private:
 		// this is the type of operation this instance is doing
 		bin_type			_type;
 };
+
+
+
+/**
+ * cond() - this function takes pairs of arguments - a test and a value -
+ *          and returns the value of the first pair whose test is true.
+ *          If there's an odd argument left at the end, it's the value
+ *          when none of the tests are true - otherwise that's undefined.
+ *          Only the tests up to the one that's true, and it's value, are
+ *          evaluated, so '(if test then else)' is just the one pair.
+ */
+class cond :
+	public function
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This function has no state, so these are all very simple to
+		 * stub out here in the header.
+		 */
+		cond() { };
+		cond( const cond & anOther ) { };
+		virtual function *clone() const { return new cond(*this); }
+		virtual ~cond() { };
+		cond & operator=( const cond & anOther ) { return *this; };
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+
+		/*******************************************************************
+		 *
+		 *                       Evaluation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This is the main evaluation point for the function. It takes a
+		 * vector of values and returns a value - simple. How it does this
+		 * is entirely up to the developer of that function.
+		 */
+		virtual value eval( std::vector<value *> & anArg );
+		/**
+		 * This is the evaluation point used by the expressions. Only the
+		 * tests up to the first one that's true, and it's value, are ever
+		 * evaluated - the rest of the arguments are left alone - so there
+		 * isn't any need for the scratch buffer.
+		 * A subclass that only has it's own eval() of the arguments gets
+		 * that called instead, as it's only this one the expressions use.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * This is where the function is really evaluated - each of the
+		 * arguments exactly ONCE into the scratch buffer - for both of the
+		 * eval() methods.
+		 */
+		value calc( std::vector<value *> & anArg, std::vector<value> & aScratch );
+};
 }		// end of namespace func
 }		// end of namespace lkit
 
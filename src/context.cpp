@@ -0,0 +1,296 @@
+/**
+ * context.cpp - this file implements the execution context for a compiled
+ *               program. The program is just the instructions, and it's
+ *               never changed when it's run with a context, so it can be
+ *               shared by as many threads as we like. Everything that does
+ *               change - the stack, the lanes, the values of the variables
+ *               for this thread - is in the context, and each thread has
+ *               it's own, so that there's nothing to lock.
+ */
+
+//	System Headers
+#include <sstream>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "context.h"
+#include "program.h"
+
+//	Forward Declarations
+
+//	Private Constants
+
+//	Private Datatypes
+
+//	Private Data Constants
+
+
+
+/**
+ * Make it easy to reference the spinlock and it's scoped lock. They
+ * are both in the lkit::util namespace, and it's just going to make
+ * the code a little cleaner.
+ */
+using lkit::util::spinlock;
+
+namespace lkit {
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This is the default constructor that assumes NOTHING - it just
+ * makes an empty context that will be made ready for the first
+ * program that's run on it.
+ */
+context::context() :
+	_program(NULL),
+	_generation(0),
+	_live(false),
+	_consts(),
+	_vars(),
+	_bound(),
+	_stack(),
+	_stride(0),
+	_scratch(),
+	_kinds(),
+	_dbls(),
+	_ints(),
+	_mask(),
+	_call_vals(),
+	_call_args(),
+	_call_scratch()
+{
+}
+
+
+/**
+ * This constructor makes a context that's ready to run the
+ * provided program - so that the slots of the variables can be
+ * set before it's run the first time.
+ */
+context::context( const program & aProgram ) :
+	_program(NULL),
+	_generation(0),
+	_live(false),
+	_consts(),
+	_vars(),
+	_bound(),
+	_stack(),
+	_stride(0),
+	_scratch(),
+	_kinds(),
+	_dbls(),
+	_ints(),
+	_mask(),
+	_call_vals(),
+	_call_args(),
+	_call_scratch()
+{
+	prepare(aProgram);
+}
+
+
+/**
+ * This is the standard copy constructor that needs to be in every
+ * class to make sure that we control how many copies we have
+ * floating around in the system.
+ */
+context::context( const context & anOther ) :
+	_program(NULL),
+	_generation(0),
+	_live(false),
+	_consts(),
+	_vars(),
+	_bound(),
+	_stack(),
+	_stride(0),
+	_scratch(),
+	_kinds(),
+	_dbls(),
+	_ints(),
+	_mask(),
+	_call_vals(),
+	_call_args(),
+	_call_scratch()
+{
+	// let the '=' operator do the heavy lifting...
+	*this = anOther;
+}
+
+
+/**
+ * This is the standard destructor and needs to be virtual to make
+ * sure that if we subclass off this, the right destructor will be
+ * called.
+ */
+context::~context()
+{
+	// the program isn't ours, so there's nothing to do
+}
+
+
+/**
+ * When we process the result of an equality we need to make sure
+ * that we do this right by always having an equals operator on
+ * all classes.
+ */
+context & context::operator=( const context & anOther )
+{
+	if (this != & anOther) {
+		_program = anOther._program;
+		_generation = anOther._generation;
+		_live = anOther._live;
+		_consts = anOther._consts;
+		_vars = anOther._vars;
+		_bound = anOther._bound;
+		// we just need the bindings - the stack is set up when we run
+		_stride = 0;
+		_stack.clear();
+	}
+	return *this;
+}
+
+
+/*******************************************************************
+ *
+ *                        Accessor Methods
+ *
+ *******************************************************************/
+/**
+ * This method gets the context ready to run the provided program.
+ * The constants of the program are copied in, so that we never
+ * have to look at the shared values, and all the variables are
+ * unbound. This is done automatically when a context is run with
+ * a program it's not ready for.
+ */
+void context::prepare( const program & aProgram )
+{
+	spinlock::scoped_lock	lock(aProgram._mutex);
+	aProgram.prepare_nl(*this, false);
+}
+
+
+/**
+ * This method returns the number of variable slots in this
+ * context - which is the number of different variables used by
+ * the program it was prepared for.
+ */
+size_t context::getSlotCount() const
+{
+	return _vars.size();
+}
+
+
+/**
+ * This method binds the slot to the provided value, so that when
+ * the program is run with this context, the variable in that slot
+ * has this value - regardless of what the shared variable has.
+ * If the slot isn't in this context, 'false' is returned.
+ */
+bool context::set( size_t aSlot, const value & aValue )
+{
+	bool		error = false;
+	if (aSlot >= _vars.size()) {
+		error = true;
+	} else {
+		_vars[aSlot] = aValue.getDatum();
+		_bound[aSlot] = true;
+	}
+	return !error;
+}
+
+
+/**
+ * This method returns the value bound to the slot. If the slot
+ * isn't bound, or isn't in this context, the value is undefined.
+ */
+value context::get( size_t aSlot ) const
+{
+	value		retval;
+	if (isBound(aSlot)) {
+		retval = _vars[aSlot];
+	}
+	return retval;
+}
+
+
+/**
+ * This method returns 'true' if the slot is bound to a value for
+ * this context.
+ */
+bool context::isBound( size_t aSlot ) const
+{
+	return ((aSlot < _bound.size()) && _bound[aSlot]);
+}
+
+
+/**
+ * These methods remove the binding for a slot - or all of them -
+ * so that the program goes back to using the shared variables
+ * for them. That's a lock on the variable each time, so it's not
+ * what we want a thread to do for anything it can set.
+ */
+void context::unbind( size_t aSlot )
+{
+	if (aSlot < _bound.size()) {
+		_bound[aSlot] = false;
+		_vars[aSlot] = value().getDatum();
+	}
+}
+
+
+void context::unbindAll()
+{
+	datum		undef = value().getDatum();
+	for (size_t i = 0; i < _bound.size(); ++i) {
+		_bound[i] = false;
+		_vars[i] = undef;
+	}
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string context::toString() const
+{
+	std::ostringstream	msg;
+	msg << "[context slots=(";
+	for (size_t i = 0; i < _vars.size(); ++i) {
+		if (i > 0) {
+			msg << ", ";
+		}
+		if (_bound[i]) {
+			msg << value(_vars[i]).toString();
+		} else {
+			msg << "-";
+		}
+	}
+	msg << ")]";
+	return msg.str();
+}
+}		// end of namespace lkit
+
+
+/**
+ * For debugging purposes, let's make it easy for the user to stream
+ * out this value. It basically is just the toString() method of the
+ * context streamed out.
+ */
+std::ostream & operator<<( std::ostream & aStream, const lkit::context & aValue )
+{
+	aStream << aValue.toString();
+	return aStream;
+}
@@ -0,0 +1,207 @@
+/**
+ * context.h - this file defines the execution context for a compiled
+ *             program. The program is just the instructions, and it's
+ *             never changed when it's run with a context, so it can be
+ *             shared by as many threads as we like. Everything that does
+ *             change - the stack, the lanes, the values of the variables
+ *             for this thread - is in the context, and each thread has
+ *             it's own, so that there's nothing to lock.
+ */
+#ifndef __LKIT_CONTEXT_H
+#define __LKIT_CONTEXT_H
+
+//	System Headers
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "value.h"
+
+//	Forward Declarations
+/**
+ * The context is made for a program, and the program is the one that
+ * runs on it, so we need a forward reference to it.
+ */
+namespace lkit {
+class program;
+}	// end of namespace lkit
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+/**
+ * Main class definition
+ */
+namespace lkit {
+class context
+{
+	friend class program;
+
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This is the default constructor that assumes NOTHING - it just
+		 * makes an empty context that will be made ready for the first
+		 * program that's run on it.
+		 */
+		context();
+		/**
+		 * This constructor makes a context that's ready to run the
+		 * provided program - so that the slots of the variables can be
+		 * set before it's run the first time.
+		 */
+		context( const program & aProgram );
+		/**
+		 * This is the standard copy constructor that needs to be in every
+		 * class to make sure that we control how many copies we have
+		 * floating around in the system.
+		 */
+		context( const context & anOther );
+		/**
+		 * This is the standard destructor and needs to be virtual to make
+		 * sure that if we subclass off this, the right destructor will be
+		 * called.
+		 */
+		virtual ~context();
+
+		/**
+		 * When we process the result of an equality we need to make sure
+		 * that we do this right by always having an equals operator on
+		 * all classes.
+		 */
+		context & operator=( const context & anOther );
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method gets the context ready to run the provided program.
+		 * The constants of the program are copied in, so that we never
+		 * have to look at the shared values, and all the variables are
+		 * unbound. This is done automatically when a context is run with
+		 * a program it's not ready for.
+		 */
+		virtual void prepare( const program & aProgram );
+		/**
+		 * This method returns the number of variable slots in this
+		 * context - which is the number of different variables used by
+		 * the program it was prepared for.
+		 */
+		virtual size_t getSlotCount() const;
+		/**
+		 * This method binds the slot to the provided value, so that when
+		 * the program is run with this context, the variable in that slot
+		 * has this value - regardless of what the shared variable has.
+		 * If the slot isn't in this context, 'false' is returned.
+		 */
+		virtual bool set( size_t aSlot, const value & aValue );
+		/**
+		 * This method returns the value bound to the slot. If the slot
+		 * isn't bound, or isn't in this context, the value is undefined.
+		 */
+		virtual value get( size_t aSlot ) const;
+		/**
+		 * This method returns 'true' if the slot is bound to a value for
+		 * this context.
+		 */
+		virtual bool isBound( size_t aSlot ) const;
+		/**
+		 * These methods remove the binding for a slot - or all of them -
+		 * so that the program goes back to using the shared variables
+		 * for them. That's a lock on the variable each time, so it's not
+		 * what we want a thread to do for anything it can set.
+		 */
+		virtual void unbind( size_t aSlot );
+		virtual void unbindAll();
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+
+	private:
+		/**
+		 * This is the program the context was prepared for, and the
+		 * generation of it, so that we know when it's been re-compiled
+		 * and we need to be prepared again. A live context reads the
+		 * constants from the program, and doesn't have copies.
+		 */
+		const program				*_program;
+		uint32_t					_generation;
+		bool						_live;
+		/**
+		 * These are the copies of the constants of the program, and the
+		 * values of the variables for this context - by slot - along with
+		 * a flag for each that says if it's been bound. They are just the
+		 * plain data, so they're packed tight, and pushing one is a copy
+		 * of sixteen bytes - not a lock and a virtual call.
+		 */
+		std::vector<datum>			_consts;
+		std::vector<datum>			_vars;
+		std::vector<bool>			_bound;
+		/**
+		 * This is the stack that the program works on - just the plain
+		 * data, like the constants and variables. Each slot holds the
+		 * data for 'stride' rows, one after the other, so that a block
+		 * of rows can be done at once. It's sized before we start, so it
+		 * never grows while we're running, and the pointers into it stay
+		 * valid. The operators work through the one scratch value so
+		 * they act just as they do on values.
+		 */
+		std::vector<datum>			_stack;
+		size_t						_stride;
+		value						_scratch;
+		/**
+		 * These are the lanes for the slots of the stack when we're
+		 * running a batch. The type of each slot says which lane it's
+		 * in - the doubles, or the ints (and bools), and if it's unknown
+		 * then the slot is just the values on the stack. The mask is the
+		 * scratch space for the logical kernels.
+		 */
+		std::vector<value::value_type>	_kinds;
+		std::vector<double>			_dbls;
+		std::vector<int>			_ints;
+		std::vector<int>			_mask;
+		/**
+		 * When we call a function that's not a built-in, it needs values
+		 * for it's arguments, a list of pointers to them, and a scratch
+		 * buffer, so we hold onto them here so they're not re-created on
+		 * every call. This is the only place the stack becomes values.
+		 */
+		std::vector<value>			_call_vals;
+		std::vector<value *>		_call_args;
+		std::vector<value>			_call_scratch;
+};
+}		// end of namespace lkit
+
+/**
+ * For debugging purposes, let's make it easy for the user to stream
+ * out this value. It basically is just the toString() method of the
+ * context streamed out.
+ */
+std::ostream & operator<<( std::ostream & aStream, const lkit::context & aValue );
+
+#endif		// __LKIT_CONTEXT_H
@@ -18,10 +18,20 @@
 //	Other Headers
 #include "expression.h"
 #include "function.h"
+#include "util/footprint.h"
+#include "util/timer.h"
 
 //	Forward Declarations
 
 //	Private Constants
+/**
+ * An expression only keeps track of the arguments that change if it has
+ * at least this many of them - below that, it's just as fast to do them
+ * all. And after this many updates, we do them all anyway, to keep the
+ * rounding of the doubles from creeping in.
+ */
+static const size_t		__min_delta_args = 8;
+static const uint32_t	__max_deltas = 256;
 
 //	Private Datatypes
 
@@ -31,10 +41,10 @@
 
 /**
  * Make it easy to reference the spinlock and it's scoped lock. They
- * are both in the boost::detail namespace, and it's just going to make
+ * are both in the lkit::util namespace, and it's just going to make
  * the code a little cleaner.
  */
-using namespace boost::detail;
+using lkit::util::spinlock;
 
 namespace lkit {
 /*******************************************************************
@@ -51,7 +61,21 @@ expression::expression() :
 	value(),
 	_name(),
 	_fcn(NULL),
-	_args()
+	_fast(NULL),
+	_args(),
+	_scratch(),
+	_delta(NULL),
+	_dirty(true),
+	_volatile(false),
+	_delta_mutex()
+#ifdef LKIT_PROFILE
+	,
+	_calls(0),
+	_recalcs(0),
+	_nsec(0),
+	_span_begin(0),
+	_span_end(0)
+#endif
 {
 }
 
@@ -66,14 +90,30 @@ expression::expression( function *aFcn, std::vector<value *> & anArgs ) :
 	value(),
 	_name(),
 	_fcn(aFcn),
-	_args()
+	_fast(NULL),
+	_args(),
+	_scratch(),
+	_delta(NULL),
+	_dirty(true),
+	_volatile(false),
+	_delta_mutex()
+#ifdef LKIT_PROFILE
+	,
+	_calls(0),
+	_recalcs(0),
+	_nsec(0),
+	_span_begin(0),
+	_span_end(0)
+#endif
 {
 	// add each argument to the list
 	BOOST_FOREACH( value *v, anArgs ) {
 		if (v != NULL) {
 			_args.push_back(v);
+			v->addDependent(this);
 		}
 	}
+	checkVolatile_nl();
 }
 
 
@@ -91,27 +131,48 @@ expression::expression( function *aFcn, value *anArg1, value *anArg2,
 	value(),
 	_name(),
 	_fcn(aFcn),
-	_args()
+	_fast(NULL),
+	_args(),
+	_scratch(),
+	_delta(NULL),
+	_dirty(true),
+	_volatile(false),
+	_delta_mutex()
+#ifdef LKIT_PROFILE
+	,
+	_calls(0),
+	_recalcs(0),
+	_nsec(0),
+	_span_begin(0),
+	_span_end(0)
+#endif
 {
 	// add all the args that we have...
 	if (anArg1 != NULL) {
 		_args.push_back(anArg1);
+		anArg1->addDependent(this);
 	}
 	if (anArg2 != NULL) {
 		_args.push_back(anArg2);
+		anArg2->addDependent(this);
 	}
 	if (anArg3 != NULL) {
 		_args.push_back(anArg3);
+		anArg3->addDependent(this);
 	}
 	if (anArg4 != NULL) {
 		_args.push_back(anArg4);
+		anArg4->addDependent(this);
 	}
 	if (anArg5 != NULL) {
 		_args.push_back(anArg5);
+		anArg5->addDependent(this);
 	}
 	if (anArg6 != NULL) {
 		_args.push_back(anArg6);
+		anArg6->addDependent(this);
 	}
+	checkVolatile_nl();
 }
 
 
@@ -124,7 +185,21 @@ expression::expression( const expression & anOther ) :
 	value(anOther),
 	_name(),
 	_fcn(NULL),
-	_args()
+	_fast(NULL),
+	_args(),
+	_scratch(),
+	_delta(NULL),
+	_dirty(true),
+	_volatile(false),
+	_delta_mutex()
+#ifdef LKIT_PROFILE
+	,
+	_calls(0),
+	_recalcs(0),
+	_nsec(0),
+	_span_begin(0),
+	_span_end(0)
+#endif
 {
 	// let the '=' operator do the heavy lifting...
 	*this = anOther;
@@ -151,6 +226,11 @@ expression::~expression()
 {
 	// just clear out the arguments...
 	clearArgs();
+	// ...and anything we were tracking them with
+	if (_delta != NULL) {
+		delete _delta;
+		_delta = NULL;
+	}
 }
 
 
@@ -162,12 +242,18 @@ expression::~expression()
 expression & expression::operator=( const expression & anOther )
 {
 	if (this != & anOther) {
-		// first, let the super do it's thing...
-		value::operator=(anOther);
 		// ...now I can do my stuff
 		_name = anOther._name;
 		_fcn = anOther._fcn;
-		_args = anOther._args;
+		setArgs(anOther._args);
+		_fast = anOther._fast;
+#ifdef LKIT_PROFILE
+		// the counts are for this one, but it's from the same source
+		_span_begin = anOther._span_begin;
+		_span_end = anOther._span_end;
+#endif
+		// finally, let the super do it's thing - and tell our dependents
+		value::operator=(anOther);
 	}
 	return *this;
 }
@@ -214,6 +300,9 @@ void expression::setFunction( function *aFunction )
 {
 	spinlock::scoped_lock	lock(mutex());
 	_fcn = aFunction;
+	_fast = NULL;
+	checkVolatile_nl();
+	markDirty();
 }
 
 
@@ -229,6 +318,30 @@ function *expression::getFunction()
 }
 
 
+/**
+ * These methods set, and return, the function that's used in the
+ * place of the one above when this expression is evaluated - one
+ * that gives exactly the same answers, but just for the arguments
+ * there are now, so it can skip all the work of the general case.
+ * The parser sets this when it compiles the source, and it's
+ * dropped whenever the function or the arguments change. Like the
+ * function, it's just a reference, and it's not managed here.
+ */
+void expression::setFastPath( function *aFunction )
+{
+	spinlock::scoped_lock	lock(mutex());
+	_fast = aFunction;
+	markDirty();
+}
+
+
+function *expression::getFastPath()
+{
+	spinlock::scoped_lock	lock(mutex());
+	return _fast;
+}
+
+
 /**
  * This method sets the vector of ALL arguments for this expression
  * to the provided set. This will REPLACE the existing argument list
@@ -239,7 +352,21 @@ function *expression::getFunction()
 void expression::setArgs( const std::vector<value *> & anArgs )
 {
 	spinlock::scoped_lock	lock(mutex());
+	// register with the new args before dropping the old ones
+	BOOST_FOREACH( value *v, anArgs ) {
+		if (v != NULL) {
+			v->addDependent(this);
+		}
+	}
+	BOOST_FOREACH( value *v, _args ) {
+		if (v != NULL) {
+			v->removeDependent(this);
+		}
+	}
 	_args = anArgs;
+	_fast = NULL;
+	checkVolatile_nl();
+	markDirty();
 }
 
 
@@ -274,6 +401,10 @@ bool expression::addToArgs( value *anArg )
 	} else {
 		spinlock::scoped_lock	lock(mutex());
 		_args.push_back(anArg);
+		anArg->addDependent(this);
+		_fast = NULL;
+		checkVolatile_nl();
+		markDirty();
 	}
 	return !error;
 }
@@ -300,8 +431,12 @@ bool expression::addToArgs( const std::vector<value *> & anArgs )
 			error = true;
 		} else {
 			_args.push_back(v);
+			v->addDependent(this);
 		}
 	}
+	_fast = NULL;
+	checkVolatile_nl();
+	markDirty();
 	return !error;
 }
 
@@ -322,10 +457,15 @@ bool expression::removeFromArgs( const value *anArg )
 		for (std::vector<value *>::iterator it = _args.begin(); it != _args.end(); ++it) {
 			if (*it == anArg) {
 				_args.erase(it);
+				((value *)anArg)->removeDependent(this);
 				removed = true;
 				break;
 			}
 		}
+		if (removed) {
+			_fast = NULL;
+			markDirty();
+		}
 	}
 	return removed;
 }
@@ -344,7 +484,14 @@ bool expression::removeFromArgs( const value *anArg )
 void expression::clearArgs()
 {
 	spinlock::scoped_lock	lock(mutex());
+	BOOST_FOREACH( value *v, _args ) {
+		if (v != NULL) {
+			v->removeDependent(this);
+		}
+	}
 	_args.clear();
+	_fast = NULL;
+	markDirty();
 }
 
 
@@ -366,6 +513,150 @@ bool expression::isExpression() const
 }
 
 
+/**
+ * This method returns 'true' if the cached result of this
+ * expression is out of date - because one of the arguments has
+ * changed, or the function or arguments have been replaced -
+ * and the next evaluation will have to call the function again.
+ */
+bool expression::isDirty() const
+{
+	return (_dirty || _volatile);
+}
+
+
+/**
+ * This method returns 'true' if this expression can't cache
+ * it's result because the function isn't pure, or one of the
+ * arguments is itself volatile. These are recalculated on
+ * every evaluation.
+ */
+bool expression::isVolatile() const
+{
+	return _volatile;
+}
+
+
+/**
+ * When LKit is built with LKIT_PROFILE, each expression counts the
+ * number of times it's evaluated, the number of those that actually
+ * called the function - and weren't just the cached answer - and
+ * the total nsec spent doing it, including all the arguments. Without
+ * it, there's nothing to count, and these all return 0.
+ */
+uint64_t expression::getCallCount() const
+{
+	uint64_t	retval = 0;
+#ifdef LKIT_PROFILE
+	spinlock::scoped_lock	lock(mutex());
+	retval = _calls;
+#endif
+	return retval;
+}
+
+
+uint64_t expression::getRecalcCount() const
+{
+	uint64_t	retval = 0;
+#ifdef LKIT_PROFILE
+	spinlock::scoped_lock	lock(mutex());
+	retval = _recalcs;
+#endif
+	return retval;
+}
+
+
+uint64_t expression::getNSec() const
+{
+	uint64_t	retval = 0;
+#ifdef LKIT_PROFILE
+	spinlock::scoped_lock	lock(mutex());
+	retval = _nsec;
+#endif
+	return retval;
+}
+
+
+void expression::resetProfile()
+{
+#ifdef LKIT_PROFILE
+	spinlock::scoped_lock	lock(mutex());
+	_calls = 0;
+	_recalcs = 0;
+	_nsec = 0;
+#endif
+}
+
+
+/**
+ * These methods set, and get, the span of the source - from the
+ * opening '(' to just past the closing ')' - that this
+ * expression was parsed from, so that the numbers can be matched up
+ * back to the source. They're only kept when profiling.
+ */
+void expression::setSpan( uint32_t aBegin, uint32_t anEnd )
+{
+#ifdef LKIT_PROFILE
+	spinlock::scoped_lock	lock(mutex());
+	_span_begin = aBegin;
+	_span_end = anEnd;
+#endif
+}
+
+
+uint32_t expression::getSpanBegin() const
+{
+	uint32_t	retval = 0;
+#ifdef LKIT_PROFILE
+	spinlock::scoped_lock	lock(mutex());
+	retval = _span_begin;
+#endif
+	return retval;
+}
+
+
+uint32_t expression::getSpanEnd() const
+{
+	uint32_t	retval = 0;
+#ifdef LKIT_PROFILE
+	spinlock::scoped_lock	lock(mutex());
+	retval = _span_end;
+#endif
+	return retval;
+}
+
+
+/**
+ * This method adds all that this expression holds on the heap -
+ * the name, the arguments, and the lists it uses to evaluate and
+ * track them - to the tally, along with what the value does.
+ */
+void expression::addFootprint( util::footprint & aTally ) const
+{
+	{
+		typedef boost::unordered_map<const value *, std::vector<uint32_t> >	where_map_t;
+		spinlock::scoped_lock	lock(mutex());
+		aTally.addString(_name);
+		aTally.addList(_args);
+		aTally.addList(_scratch);
+		// the tracker is only made, or let go, with this lock held
+		if (_delta != NULL) {
+			aTally.addBlock(sizeof(tracker));
+			aTally.addList(_delta->seen);
+			aTally.addList(_delta->seen_ptrs);
+			aTally.addMap(_delta->where);
+			for (where_map_t::const_iterator it = _delta->where.begin(); it != _delta->where.end(); ++it) {
+				aTally.addList(it->second);
+			}
+			spinlock::scoped_lock	dlock(_delta_mutex);
+			aTally.addList(_delta->changed);
+			aTally.addList(_delta->applying);
+		}
+	}
+	value::addFootprint(aTally);
+}
+
+
 /**
  * There are a lot of times that a human-readable version of
  * this instance will come in handy. This is that method. It's
@@ -478,49 +769,299 @@ bool expression::operator!=( const value & anOther ) const
  */
 value expression::eval_nl()
 {
-	if (_fcn != NULL) {
-		set_nl(_fcn->eval(_args));
-	}
+	recalc_nl();
 	return value(*this);
 }
 
 
+void expression::eval_nl( value & aResult )
+{
+	recalc_nl();
+	// the base would call eval_nl() again, so just copy it into theirs
+	copyTo_nl(aResult);
+}
+
+
 bool expression::evalAsBool_nl()
 {
-	if (_fcn != NULL) {
-		set_nl(_fcn->eval(_args));
-	}
+	recalc_nl();
 	return value::evalAsBool_nl();
 }
 
 
 int expression::evalAsInt_nl()
 {
-	if (_fcn != NULL) {
-		set_nl(_fcn->eval(_args));
-	}
+	recalc_nl();
 	return value::evalAsInt_nl();
 }
 
 
 double expression::evalAsDouble_nl()
 {
-	if (_fcn != NULL) {
-		set_nl(_fcn->eval(_args));
-	}
+	recalc_nl();
 	return value::evalAsDouble_nl();
 }
 
 
 uint64_t expression::evalAsTime_nl()
 {
-	if (_fcn != NULL) {
-		set_nl(_fcn->eval(_args));
-	}
+	recalc_nl();
 	return value::evalAsTime_nl();
 }
 
 
+/**
+ * This method calls the function on the arguments, and caches the
+ * result in this instance - but ONLY if the cached value is stale.
+ * If none of the arguments have changed since the last time, then
+ * there's no need to do the work again. The "_nl" means "no lock".
+ */
+void expression::recalc_nl()
+{
+#ifdef LKIT_PROFILE
+	++_calls;
+	uint64_t	start = 0;
+#endif
+	if ((_fcn != NULL) && (_dirty || _volatile)) {
+#ifdef LKIT_PROFILE
+		++_recalcs;
+		start = util::timer::nsecStamp();
+#endif
+		/**
+		 * Clear the flag BEFORE we call the function so that if one
+		 * of the arguments changes while we're in the middle of this,
+		 * we'll be marked dirty again and pick it up next time. The
+		 * list of changed arguments is taken at the same time, so that
+		 * anything after this is on the next list.
+		 */
+		bool	full = true;
+		{
+			spinlock::scoped_lock	lock(_delta_mutex);
+			_dirty = false;
+			if (_delta != NULL) {
+				full = (_delta->full || _delta->changed.empty());
+				_delta->full = false;
+				_delta->applying.clear();
+				_delta->applying.swap(_delta->changed);
+			}
+		}
+		if (full || _volatile || !evalDelta_nl(_delta->applying)) {
+			evalAll_nl();
+		}
+#ifdef LKIT_PROFILE
+		_nsec += util::timer::nsecStamp() - start;
+#endif
+	}
+}
+
+
+/**
+ * These methods do the work of calling the function. The first
+ * evaluates it on all the arguments - and if the function can do
+ * updates, it keeps the values of the arguments it used. The
+ * second uses those to update the cached result for just the
+ * arguments that have changed, and returns 'false' if that can't
+ * be done, and everything has to be evaluated. The "_nl" means
+ * the caller has to handle the locking.
+ */
+void expression::evalAll_nl()
+{
+	size_t	sz = _args.size();
+	bool	track = (!_volatile && (sz >= __min_delta_args) && _fcn->canUpdate());
+	/**
+	 * The tracker is made when we start tracking, and let go when we
+	 * stop. The changes are noted under the delta lock, so that's what
+	 * it's swapped under - everything else is done with the caller's.
+	 */
+	tracker		*old = NULL;
+	if (track && (_delta == NULL)) {
+		tracker		*d = new tracker();
+		spinlock::scoped_lock	lock(_delta_mutex);
+		_delta = d;
+	} else if (!track && (_delta != NULL)) {
+		spinlock::scoped_lock	lock(_delta_mutex);
+		old = _delta;
+		_delta = NULL;
+	}
+	if (old != NULL) {
+		delete old;
+	}
+	if (_delta != NULL) {
+		spinlock::scoped_lock	lock(_delta_mutex);
+		_delta->limit = sz / 4;
+	}
+	if (!track) {
+		set_nl((_fast != NULL ? _fast : _fcn)->eval(_args, _scratch));
+	} else {
+		/**
+		 * Evaluate each argument once, and keep the value, and then the
+		 * function works on those - so what it used is exactly what we
+		 * have to take out of the answer when one of them changes.
+		 */
+		tracker		& d = *_delta;
+		d.seen.resize(sz);
+		d.seen_ptrs.resize(sz);
+		for (size_t i = 0; i < sz; ++i) {
+			if (_args[i] == NULL) {
+				d.seen[i].clear();
+				d.seen_ptrs[i] = NULL;
+			} else {
+				_args[i]->eval(d.seen[i]);
+				d.seen_ptrs[i] = &d.seen[i];
+			}
+		}
+		// ...and if the arguments have changed, find where each one is
+		if (!d.mapped) {
+			d.where.clear();
+			for (size_t i = 0; i < sz; ++i) {
+				if (_args[i] != NULL) {
+					d.where[_args[i]].push_back((uint32_t)i);
+				}
+			}
+			d.mapped = true;
+		}
+		d.deltas = 0;
+		set_nl(_fcn->eval(d.seen_ptrs, _scratch));
+	}
+}
+
+
+bool expression::evalDelta_nl( const std::vector<const value *> & aChanged )
+{
+	tracker		& d = *_delta;
+	bool		ok = (d.mapped && (d.seen.size() == _args.size()) &&
+					  (d.deltas < __max_deltas));
+	// the answer we have now is what we're going to update
+	value		ans = value::eval_nl();
+	BOOST_FOREACH( const value *src, aChanged ) {
+		if (!ok) {
+			break;
+		}
+		boost::unordered_map<const value *, std::vector<uint32_t> >::iterator	it = d.where.find(src);
+		if (it == d.where.end()) {
+			ok = false;
+			break;
+		}
+		// an argument can be in the list more than once
+		BOOST_FOREACH( uint32_t i, it->second ) {
+			value	v = _args[i]->eval();
+			if ((v.isUndefined() && d.seen[i].isUndefined()) || (v == d.seen[i])) {
+				continue;
+			}
+			if (!_fcn->update(ans, d.seen_ptrs, i, d.seen[i], v)) {
+				ok = false;
+				break;
+			}
+			d.seen[i] = v;
+		}
+	}
+	if (ok) {
+		++d.deltas;
+		set_nl(ans);
+	}
+	return ok;
+}
+
+
+/**
+ * This method looks at the function and the arguments and sets
+ * the volatile flag if we can't rely on the cached value. This
+ * needs to be called whenever the function changes, or arguments
+ * are added. Removing arguments can't make us any more volatile,
+ * and the function may already be gone when the parser is tearing
+ * things down, so we don't call it then. The "_nl" means the
+ * caller has to handle the locking.
+ */
+void expression::checkVolatile_nl()
+{
+	_volatile = ((_fcn != NULL) && !_fcn->isPure());
+	for (size_t i = 0; !_volatile && (i < _args.size()); ++i) {
+		_volatile = ((_args[i] != NULL) && _args[i]->isVolatile());
+	}
+}
+
+
+/**
+ * This method is called when one of the arguments of this
+ * expression has changed. We need to mark our cached result as
+ * stale, and if it wasn't already, pass that along to everyone
+ * that depends on us.
+ */
+void expression::markDirty()
+{
+	bool	first = false;
+	{
+		spinlock::scoped_lock	lock(_delta_mutex);
+		first = !_dirty;
+		_dirty = true;
+		// we can't know what changed, so it all has to be done
+		if (_delta != NULL) {
+			_delta->full = true;
+			_delta->mapped = false;
+		}
+	}
+	if (first) {
+		markDependentsDirty();
+	}
+}
+
+
+/**
+ * This method is called when the argument 'aSource' of this
+ * expression has changed. It's just like the above, but if the
+ * function can update it's answer, we note which argument it was,
+ * so that we only have to look at it the next time.
+ */
+void expression::markDirty( const value *aSource )
+{
+	bool	first = false;
+	{
+		spinlock::scoped_lock	lock(_delta_mutex);
+		first = !_dirty;
+		_dirty = true;
+		if ((_delta != NULL) && !_delta->full) {
+			// the same argument changing over and over is only noted once
+			std::vector<const value *>	& chg = _delta->changed;
+			if (!chg.empty() && (chg.back() == aSource)) {
+				// ...already have it
+			} else if (chg.size() < _delta->limit) {
+				chg.push_back(aSource);
+			} else {
+				_delta->full = true;
+			}
+		}
+	}
+	if (first) {
+		markDependentsDirty();
+	}
+}
+
+
+/**
+ * This method is called when one of the arguments to this
+ * expression is being destroyed, and we need to remove all
+ * references to it from our argument list.
+ */
+void expression::dropDependency( const value *aValue )
+{
+	spinlock::scoped_lock	lock(mutex());
+	bool	removed = false;
+	std::vector<value *>::iterator	it = _args.begin();
+	while (it != _args.end()) {
+		if (*it == aValue) {
+			it = _args.erase(it);
+			removed = true;
+		} else {
+			++it;
+		}
+	}
+	if (removed) {
+		_fast = NULL;
+		markDirty();
+	}
+}
+
+
 /*******************************************************************
  *
  *                      Subclass Utility Methods
@@ -16,9 +16,11 @@
 #include <vector>
 
 //	Third-Party Headers
+#include <boost/unordered_map.hpp>
 
 //	Other Headers
 #include "value.h"
+#include "util/spinlock.h"
 
 //	Forward Declarations
 /**
@@ -134,6 +136,17 @@ class expression :
 		 * want to check on that.
 		 */
 		virtual function *getFunction();
+		/**
+		 * These methods set, and return, the function that's used in the
+		 * place of the one above when this expression is evaluated - one
+		 * that gives exactly the same answers, but just for the arguments
+		 * there are now, so it can skip all the work of the general case.
+		 * The parser sets this when it compiles the source, and it's
+		 * dropped whenever the function or the arguments change. Like the
+		 * function, it's just a reference, and it's not managed here.
+		 */
+		virtual void setFastPath( function *aFunction );
+		virtual function *getFastPath();
 
 		/**
 		 * This method sets the vector of ALL arguments for this expression
@@ -207,6 +220,49 @@ class expression :
 		 */
 		virtual bool isExpression() const;
 
+		/**
+		 * This method returns 'true' if the cached result of this
+		 * expression is out of date - because one of the arguments has
+		 * changed, or the function or arguments have been replaced -
+		 * and the next evaluation will have to call the function again.
+		 */
+		virtual bool isDirty() const;
+		/**
+		 * This method returns 'true' if this expression can't cache
+		 * it's result because the function isn't pure, or one of the
+		 * arguments is itself volatile. These are recalculated on
+		 * every evaluation.
+		 */
+		virtual bool isVolatile() const;
+
+		/**
+		 * When LKit is built with LKIT_PROFILE, each expression counts the
+		 * number of times it's evaluated, the number of those that actually
+		 * called the function - and weren't just the cached answer - and
+		 * the total nsec spent doing it, including all the arguments. Without
+		 * it, there's nothing to count, and these all return 0.
+		 */
+		uint64_t getCallCount() const;
+		uint64_t getRecalcCount() const;
+		uint64_t getNSec() const;
+		void resetProfile();
+		/**
+		 * These methods set, and get, the span of the source - from the
+		 * opening '(' to just past the closing ')' - that this
+		 * expression was parsed from, so that the numbers can be matched up
+		 * back to the source. They're only kept when profiling.
+		 */
+		void setSpan( uint32_t aBegin, uint32_t anEnd );
+		uint32_t getSpanBegin() const;
+		uint32_t getSpanEnd() const;
+
+		/**
+		 * This method adds all that this expression holds on the heap -
+		 * the name, the arguments, and the lists it uses to evaluate and
+		 * track them - to the tally, along with what the value does.
+		 */
+		virtual void addFootprint( util::footprint & aTally ) const;
+
 		/**
 		 * There are a lot of times that a human-readable version of
 		 * this instance will come in handy. This is that method. It's
@@ -270,11 +326,62 @@ class expression :
 		 * these values. That means the caller has to do it.
 		 */
 		virtual value eval_nl();
+		virtual void eval_nl( value & aResult );
 		virtual bool evalAsBool_nl();
 		virtual int evalAsInt_nl();
 		virtual double evalAsDouble_nl();
 		virtual uint64_t evalAsTime_nl();
 
+		/**
+		 * This method calls the function on the arguments, and caches the
+		 * result in this instance - but ONLY if the cached value is stale.
+		 * If none of the arguments have changed since the last time, then
+		 * there's no need to do the work again. The "_nl" means "no lock".
+		 */
+		void recalc_nl();
+		/**
+		 * This method looks at the function and the arguments and sets
+		 * the volatile flag if we can't rely on the cached value. This
+		 * needs to be called whenever the function changes, or arguments
+		 * are added. Removing arguments can't make us any more volatile,
+		 * and the function may already be gone when the parser is tearing
+		 * things down, so we don't call it then. The "_nl" means the
+		 * caller has to handle the locking.
+		 */
+		void checkVolatile_nl();
+		/**
+		 * These methods do the work of calling the function. The first
+		 * evaluates it on all the arguments - and if the function can do
+		 * updates, it keeps the values of the arguments it used. The
+		 * second uses those to update the cached result for just the
+		 * arguments that have changed, and returns 'false' if that can't
+		 * be done, and everything has to be evaluated. The "_nl" means
+		 * the caller has to handle the locking.
+		 */
+		void evalAll_nl();
+		bool evalDelta_nl( const std::vector<const value *> & aChanged );
+
+		/**
+		 * This method is called when one of the arguments of this
+		 * expression has changed. We need to mark our cached result as
+		 * stale, and if it wasn't already, pass that along to everyone
+		 * that depends on us.
+		 */
+		virtual void markDirty();
+		/**
+		 * This method is called when the argument 'aSource' of this
+		 * expression has changed. It's just like the above, but if the
+		 * function can update it's answer, we note which argument it was,
+		 * so that we only have to look at it the next time.
+		 */
+		virtual void markDirty( const value *aSource );
+		/**
+		 * This method is called when one of the arguments to this
+		 * expression is being destroyed, and we need to remove all
+		 * references to it from our argument list.
+		 */
+		virtual void dropDependency( const value *aValue );
+
 		/*******************************************************************
 		 *
 		 *                      Subclass Utility Methods
@@ -310,6 +417,12 @@ class expression :
 		 * on this guy.
 		 */
 		function				*_fcn;
+		/**
+		 * This is the function that's used in the place of the one above
+		 * for the arguments there are now - or NULL if there isn't one.
+		 * It gives the same answers, and is just faster about it.
+		 */
+		function				*_fast;
 		/**
 		 * These are all the arguments that the user has supplied for this
 		 * expression. Each evaluation will see the function given this list
@@ -320,6 +433,90 @@ class expression :
 		 * not managed.
 		 */
 		std::vector<value *>	_args;
+		/**
+		 * This is the scratch buffer that we hand to the function on each
+		 * evaluation so that it has a place to evaluate each argument once.
+		 * It's kept here so that it's reused, and not re-created on every
+		 * call to the function.
+		 */
+		std::vector<value>		_scratch;
+		/**
+		 * When the function can update it's answer for one argument that
+		 * changes, and we have enough arguments to make that worth doing,
+		 * we're 'tracking' them. Then the values of the arguments that were
+		 * last used are kept - along with pointers to them for the function -
+		 * and where each argument is in the list, so that when one of them
+		 * tells us it's changed, we know what to update.
+		 *
+		 * Then there are the arguments that have changed since the last
+		 * evaluation - and the list we're working on - along with the
+		 * most we'll keep before we just say everything has to be done.
+		 * 'full' is set when the list isn't enough - the function or the
+		 * arguments themselves have changed, or there were too many.
+		 * And the number of updates since everything was evaluated, as
+		 * doubles pick up rounding with each update, so every so often we
+		 * do them all to keep the answer the same as it would have been.
+		 */
+		struct tracker {
+			tracker() :
+				seen(),
+				seen_ptrs(),
+				where(),
+				mapped(false),
+				changed(),
+				applying(),
+				limit(0),
+				full(false),
+				deltas(0)
+			{ }
+			std::vector<value>			seen;
+			std::vector<value *>		seen_ptrs;
+			boost::unordered_map<const value *, std::vector<uint32_t> >	where;
+			bool						mapped;
+			std::vector<const value *>	changed;
+			std::vector<const value *>	applying;
+			size_t						limit;
+			bool						full;
+			uint32_t					deltas;
+		};
+		/**
+		 * Most expressions are just a couple of arguments, and never
+		 * track them, so the tracker is only made when we start to, and
+		 * it's NULL the rest of the time - and when we stop.
+		 */
+		tracker					*_delta;
+		/**
+		 * This is 'true' when the value cached in this expression is no
+		 * longer valid, and the function needs to be called on the args
+		 * the next time we're evaluated. Every argument has us registered
+		 * as a dependent so that they can set this when they change.
+		 */
+		bool					_dirty;
+		/**
+		 * This is 'true' when the function isn't pure, or one of the
+		 * arguments is volatile, and so the cached value can't be used
+		 * and we have to call the function on every evaluation.
+		 */
+		bool					_volatile;
+		/**
+		 * The changes come up from the arguments while we might be in
+		 * the middle of an evaluation, so the dirty flag, and the list of
+		 * changes in the tracker, have their own lock - so the two don't
+		 * fight.
+		 */
+		mutable util::spinlock	_delta_mutex;
+#ifdef LKIT_PROFILE
+		/**
+		 * These are the counts, and time, of the evaluations, and the span
+		 * of the source this came from - only when we're profiling, so
+		 * that there's nothing at all when we're not.
+		 */
+		uint64_t				_calls;
+		uint64_t				_recalcs;
+		uint64_t				_nsec;
+		uint32_t				_span_begin;
+		uint32_t				_span_end;
+#endif
 };
 }		// end of namespace lkit
 
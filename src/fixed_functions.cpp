@@ -0,0 +1,218 @@
+/**
+ * fixed_functions.cpp - this file implements the functions of a fixed arity
+ *                       that the parser puts in for the general ones of the
+ *                       base functions in the common cases - a sum or
+ *                       comparison of just two values, or the 'not' of one.
+ *                       Each operation is a little struct for the templates
+ *                       in the header, and there's just one of each of the
+ *                       functions, shared by every expression using it.
+ */
+
+//	System Headers
+#include <typeinfo>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "fixed_functions.h"
+#include "base_functions.h"
+
+//	Forward Declarations
+
+//	Private Constants
+
+//	Private Datatypes
+
+//	Private Data Constants
+
+
+namespace lkit {
+namespace func {
+/**
+ * These are the operations for the arith() function - each one on two
+ * ints, or two doubles, or the general case of two values, where the
+ * second is applied to the first just as the base functions do it.
+ */
+struct add {
+	static int apply( int a, int b ) { return a + b; }
+	static double apply( double a, double b ) { return a + b; }
+	static void apply( value & a, const value & b ) { a += b; }
+	static const char *name() { return "<.add2.>"; }
+};
+
+
+struct subtract {
+	static int apply( int a, int b ) { return a - b; }
+	static double apply( double a, double b ) { return a - b; }
+	static void apply( value & a, const value & b ) { a -= b; }
+	static const char *name() { return "<.sub2.>"; }
+};
+
+
+struct multiply {
+	static int apply( int a, int b ) { return a * b; }
+	static double apply( double a, double b ) { return a * b; }
+	static void apply( value & a, const value & b ) { a *= b; }
+	static const char *name() { return "<.mul2.>"; }
+};
+
+
+/**
+ * These are the tests for the relate() function. They are written just
+ * the way the value operators are - so '<=' is "not '>'" - so that the
+ * answers are the same as the comparison functions give, even for the
+ * NaNs.
+ */
+struct eq {
+	template <class T> static bool test( const T & a, const T & b ) { return (a == b); }
+	static const char *name() { return "<.eq2.>"; }
+};
+
+
+struct ne {
+	template <class T> static bool test( const T & a, const T & b ) { return !(a == b); }
+	static const char *name() { return "<.ne2.>"; }
+};
+
+
+struct lt {
+	template <class T> static bool test( const T & a, const T & b ) { return (a < b); }
+	static const char *name() { return "<.lt2.>"; }
+};
+
+
+struct gt {
+	template <class T> static bool test( const T & a, const T & b ) { return (a > b); }
+	static const char *name() { return "<.gt2.>"; }
+};
+
+
+struct le {
+	template <class T> static bool test( const T & a, const T & b ) { return !(a > b); }
+	static const char *name() { return "<.le2.>"; }
+};
+
+
+struct ge {
+	template <class T> static bool test( const T & a, const T & b ) { return !(a < b); }
+	static const char *name() { return "<.ge2.>"; }
+};
+
+
+/**
+ * These are the one instance of each of the fixed functions. None of them
+ * have any state, so they can be used by any number of expressions, on
+ * any number of threads, all at once.
+ */
+static arith<add>			__add;
+static arith<subtract>		__sub;
+static arith<multiply>		__mul;
+static relate<eq>			__eq;
+static relate<ne>			__ne;
+static relate<lt>			__lt;
+static relate<gt>			__gt;
+static relate<le>			__le;
+static relate<ge>			__ge;
+static logic<false>			__and;
+static logic<true>			__or;
+static negate				__not;
+
+
+/**
+ * negate() - this function is the unary 'not' of the one value - which is
+ *            undefined if the value is.
+ */
+/*******************************************************************
+ *
+ *                       Evaluation Methods
+ *
+ *******************************************************************/
+/**
+ * These are the evaluation points for the function. There has to
+ * be exactly one argument, and it can't be NULL.
+ */
+value negate::eval( std::vector<value *> & anArg )
+{
+	value	ans;
+	value	a = anArg[0]->eval();
+	datum	x = a.getDatum();
+	if (x.type == value::eBool) {
+		ans = !x.boolValue;
+	} else if (x.type != value::eUnknown) {
+		ans = !a.evalAsBool();
+	}
+	return ans;
+}
+
+
+value negate::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return negate::eval(anArg);
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string negate::toString() const
+{
+	return "<.not1.>";
+}
+
+
+/**
+ * This function returns the fixed function that gives the same answers
+ * as 'aFunction' on the arguments 'anArgs' - if there is one - and NULL
+ * if there isn't. Only the base functions themselves are done - not any
+ * subclasses of them - and only when none of the arguments are NULL. The
+ * functions returned are shared, and have no state, so they belong to no
+ * one, and are never to be deleted.
+ */
+function *findFixed( function *aFunction, const std::vector<value *> & anArgs )
+{
+	function	*ans = NULL;
+	bool		whole = (aFunction != NULL);
+	for (size_t i = 0; whole && (i < anArgs.size()); ++i) {
+		whole = (anArgs[i] != NULL);
+	}
+	if (whole && (anArgs.size() == 2)) {
+		const std::type_info	& t = typeid(*aFunction);
+		if (t == typeid(sum)) {
+			ans = &__add;
+		} else if (t == typeid(diff)) {
+			ans = &__sub;
+		} else if (t == typeid(prod)) {
+			ans = &__mul;
+		} else if (t == typeid(comp)) {
+			switch (((comp *)aFunction)->getType()) {
+				case comp::eEquals :			ans = &__eq; break;
+				case comp::eNotEquals :			ans = &__ne; break;
+				case comp::eLessThan :			ans = &__lt; break;
+				case comp::eGreaterThan :		ans = &__gt; break;
+				case comp::eLessOrEqual :		ans = &__le; break;
+				case comp::eGreaterOrEqual :	ans = &__ge; break;
+			}
+		} else if (t == typeid(bin)) {
+			switch (((bin *)aFunction)->getType()) {
+				case bin::eAnd :	ans = &__and; break;
+				case bin::eOr :		ans = &__or; break;
+				default :			break;
+			}
+		}
+	} else if (whole && (anArgs.size() == 1) && (typeid(*aFunction) == typeid(bin)) &&
+			   (((bin *)aFunction)->getType() == bin::eNot)) {
+		ans = &__not;
+	}
+	return ans;
+}
+}		// end of namespace func
+}		// end of namespace lkit
@@ -0,0 +1,370 @@
+/**
+ * fixed_functions.h - this file defines the functions of a fixed arity that
+ *                     the parser puts in for the general ones of the base
+ *                     functions in the common cases - a sum or comparison
+ *                     of just two values, or the 'not' of one. There's no
+ *                     loop over the arguments, and no checks for NULLs, as
+ *                     the parser only uses them when there are exactly that
+ *                     many, and when the two values are both ints, or both
+ *                     doubles, the work is done right on them. Anything
+ *                     else gets the same answer the general function would
+ *                     give, so they can be used in it's place.
+ */
+#ifndef __LKIT_FIXED_FUNCTIONS_H
+#define __LKIT_FIXED_FUNCTIONS_H
+
+//	System Headers
+#include <vector>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "function.h"
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+namespace lkit {
+namespace func {
+
+/**
+ * arith() - this function does the binary arithmetic of 'OP' - the '+',
+ *           '-' or '*' of two values. 'OP' has a static apply() that works
+ *           on ints, doubles and values alike, and a static name() for the
+ *           toString().
+ */
+template <class OP> class arith :
+	public function
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This function has no state, so these are all very simple to
+		 * stub out here in the header.
+		 */
+		arith() { };
+		arith( const arith & anOther ) { };
+		virtual function *clone() const { return new arith(*this); }
+		virtual ~arith() { };
+		arith & operator=( const arith & anOther ) { return *this; };
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+
+		/*******************************************************************
+		 *
+		 *                       Evaluation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * These are the evaluation points for the function. There have to
+		 * be exactly two arguments, and neither can be NULL. Each one is
+		 * evaluated once, and if they are the same kind of number, that's
+		 * all there is to it. Otherwise, the second is applied to the first
+		 * just as the general function does it - if it's defined.
+		 */
+		virtual value eval( std::vector<value *> & anArg )
+		{
+			value	a = anArg[0]->eval();
+			value	b = anArg[1]->eval();
+			datum	x = a.getDatum();
+			datum	y = b.getDatum();
+			if ((x.type == y.type) && (x.type == value::eDouble)) {
+				a = OP::apply(x.doubleValue, y.doubleValue);
+			} else if ((x.type == y.type) && (x.type == value::eInt)) {
+				a = OP::apply(x.intValue, y.intValue);
+			} else if (y.type != value::eUnknown) {
+				OP::apply(a, b);
+			}
+			return a;
+		}
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+		{
+			return arith::eval(anArg);
+		}
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const { return OP::name(); }
+};
+
+
+
+/**
+ * relate() - this function does the comparison of 'OP' on two values. 'OP'
+ *            has a static test() that works on ints, doubles and values
+ *            alike, and a static name() for the toString().
+ */
+template <class OP> class relate :
+	public function
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This function has no state, so these are all very simple to
+		 * stub out here in the header.
+		 */
+		relate() { };
+		relate( const relate & anOther ) { };
+		virtual function *clone() const { return new relate(*this); }
+		virtual ~relate() { };
+		relate & operator=( const relate & anOther ) { return *this; };
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+
+		/*******************************************************************
+		 *
+		 *                       Evaluation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * These are the evaluation points for the function. There have to
+		 * be exactly two arguments, and neither can be NULL. If the second
+		 * is undefined, so is the answer - just as it is for the general
+		 * comparison - and otherwise it's the test of the two.
+		 */
+		virtual value eval( std::vector<value *> & anArg )
+		{
+			value	ans;
+			value	a = anArg[0]->eval();
+			value	b = anArg[1]->eval();
+			datum	x = a.getDatum();
+			datum	y = b.getDatum();
+			if ((x.type == y.type) && (x.type == value::eDouble)) {
+				ans = OP::test(x.doubleValue, y.doubleValue);
+			} else if ((x.type == y.type) && (x.type == value::eInt)) {
+				ans = OP::test(x.intValue, y.intValue);
+			} else if (y.type != value::eUnknown) {
+				ans = OP::test(a, b);
+			}
+			return ans;
+		}
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+		{
+			return relate::eval(anArg);
+		}
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const { return OP::name(); }
+};
+
+
+
+/**
+ * logic() - this function does the 'and' or 'or' of two values - 'STOP' is
+ *           the value of the first that's the answer without looking at
+ *           the second: 'false' for the 'and', and 'true' for the 'or'.
+ */
+template <bool STOP> class logic :
+	public function
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This function has no state, so these are all very simple to
+		 * stub out here in the header.
+		 */
+		logic() { };
+		logic( const logic & anOther ) { };
+		virtual function *clone() const { return new logic(*this); }
+		virtual ~logic() { };
+		logic & operator=( const logic & anOther ) { return *this; };
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+
+		/*******************************************************************
+		 *
+		 *                       Evaluation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * These are the evaluation points for the function. There have to
+		 * be exactly two arguments, and neither can be NULL. Just as for
+		 * the general function, the undefined values are skipped, and the
+		 * second isn't even evaluated if the first is the answer.
+		 */
+		virtual value eval( std::vector<value *> & anArg )
+		{
+			value	ans;
+			value	a = anArg[0]->eval();
+			datum	x = a.getDatum();
+			bool	done = false;
+			if (x.type != value::eUnknown) {
+				ans = !STOP;
+				if ((x.type == value::eBool ? x.boolValue : a.evalAsBool()) == STOP) {
+					ans = STOP;
+					done = true;
+				}
+			}
+			if (!done) {
+				value	b = anArg[1]->eval();
+				datum	y = b.getDatum();
+				if (y.type != value::eUnknown) {
+					ans = (y.type == value::eBool ? y.boolValue : b.evalAsBool());
+				}
+			}
+			return ans;
+		}
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+		{
+			return logic::eval(anArg);
+		}
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const { return (STOP ? "<.or2.>" : "<.and2.>"); }
+};
+
+
+
+/**
+ * negate() - this function is the unary 'not' of the one value - which is
+ *            undefined if the value is.
+ */
+class negate :
+	public function
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This function has no state, so these are all very simple to
+		 * stub out here in the header.
+		 */
+		negate() { };
+		negate( const negate & anOther ) { };
+		virtual function *clone() const { return new negate(*this); }
+		virtual ~negate() { };
+		negate & operator=( const negate & anOther ) { return *this; };
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * The value of this function depends only on the arguments, so
+		 * it's safe to cache, and to evaluate at compile time.
+		 */
+		virtual bool isPure() const { return true; }
+
+		/*******************************************************************
+		 *
+		 *                       Evaluation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * These are the evaluation points for the function. There has to
+		 * be exactly one argument, and it can't be NULL.
+		 */
+		virtual value eval( std::vector<value *> & anArg );
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+};
+
+
+
+/**
+ * This function returns the fixed function that gives the same answers
+ * as 'aFunction' on the arguments 'anArgs' - if there is one - and NULL
+ * if there isn't. Only the base functions themselves are done - not any
+ * subclasses of them - and only when none of the arguments are NULL. The
+ * functions returned are shared, and have no state, so they belong to no
+ * one, and are never to be deleted.
+ */
+function *findFixed( function *aFunction, const std::vector<value *> & anArgs );
+}		// end of namespace func
+}		// end of namespace lkit
+
+#endif		// __LKIT_FIXED_FUNCTIONS_H
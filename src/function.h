@@ -97,6 +97,32 @@ class function
 		 *                        Accessor Methods
 		 *
 		 *******************************************************************/
+		/**
+		 * This method returns 'true' if the function is "pure" - that is,
+		 * it has no state, and the value it returns depends ONLY on the
+		 * values of the arguments. The parser can then evaluate a pure
+		 * function of constants once, at compile time, and expressions
+		 * can cache the results. The default is 'false' as we can't know
+		 * what a subclass is doing - so it's up to the author to say so.
+		 */
+		virtual bool isPure() const
+		{
+			return false;
+		}
+		/**
+		 * This method returns 'true' if the function can update it's
+		 * answer when just one of the arguments changes - from the old
+		 * answer, and the old and new values of that argument - without
+		 * looking at any of the others. An expression with a lot of
+		 * arguments then only has to do the work for what's changed. The
+		 * default is 'false', and those functions are always evaluated on
+		 * all the arguments.
+		 */
+		virtual bool canUpdate() const
+		{
+			return false;
+		}
+
 
 		/*******************************************************************
 		 *
@@ -109,6 +135,33 @@ class function
 		 * is entirely up to the developer of that function.
 		 */
 		virtual value eval( std::vector<value *> & anArg ) = 0;
+		/**
+		 * This is the evaluation point that the expressions use. It adds
+		 * a scratch buffer of values, owned by the caller and reused from
+		 * call to call, where the function can evaluate each argument
+		 * exactly ONCE and then work on those values - rather than having
+		 * to evaluate an argument to check it, and then again to use it.
+		 * The default just calls the simple form above, so that existing
+		 * functions work as they always have.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+		{
+			return eval(anArg);
+		}
+		/**
+		 * This method updates 'anAnswer' - the value this function gave
+		 * for the arguments - for the argument at 'aPos' changing from
+		 * 'anOld' to 'aNew'. The arguments are as they were, so that the
+		 * function can see where that one is in the list. If the update
+		 * can't be done for these values, 'false' is returned, and the
+		 * caller has to evaluate the function on all the arguments. The
+		 * default can't do any updates at all.
+		 */
+		virtual bool update( value & anAnswer, const std::vector<value *> & anArg,
+							 size_t aPos, const value & anOld, const value & aNew )
+		{
+			return false;
+		}
 
 
 		/*******************************************************************
@@ -0,0 +1,931 @@
+/**
+ * jit.cpp - this file implements the native code for a program. When LKit is
+ *           built with LKIT_JIT defined, the instructions of a program are
+ *           lowered to LLVM IR - with the stack turned into plain registers,
+ *           and the skips into real branches - and compiled, in-process, by
+ *           the one ORC JIT for the process. The types of the values pushed
+ *           are taken when it's built, and checked on every run, so that the
+ *           code is only ever run on what it was built for. Without the
+ *           define, there's no LLVM at all, and nothing is ever compiled.
+ */
+
+//	System Headers
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+#ifdef LKIT_JIT
+#include <llvm-c/Analysis.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+#endif
+
+//	Other Headers
+#include "jit.h"
+#include "base_functions.h"
+#include "util/spinlock.h"
+
+//	Forward Declarations
+
+//	Private Constants
+
+//	Private Datatypes
+
+//	Private Data Constants
+
+
+
+/**
+ * Make it easy to reference the spinlock and it's scoped lock. They
+ * are both in the lkit::util namespace, and it's just going to make
+ * the code a little cleaner.
+ */
+using lkit::util::spinlock;
+
+namespace lkit {
+#ifdef LKIT_JIT
+/**
+ * This is the one JIT for the process - it's made the first time a program
+ * is compiled, and every program's code is added to it, and removed from
+ * it when the program is done with it. If it can't be made, it's not tried
+ * again, and nothing is compiled. The lock protects it all, and the count
+ * gives each program's code a name of it's own.
+ */
+static LLVMOrcLLJITRef	__engine = NULL;
+static bool				__broken = false;
+static uint64_t			__built = 0;
+static spinlock			__engine_mutex;
+
+
+/**
+ * This is the loader that the native code calls for each value it pushes
+ * - the constants are read as they are, and the variables are evaluated -
+ * just as the instructions do it.
+ */
+static void load( value *aValue, int32_t aKind, datum *anOut )
+{
+	*anOut = (aKind == 0 ? aValue->getDatum() : aValue->eval().getDatum());
+}
+
+
+/**
+ * This function returns the JIT for the process, making it if it's not
+ * already been made, or NULL if that can't be done. The caller has to
+ * hold the lock.
+ */
+static LLVMOrcLLJITRef engine_nl()
+{
+	if ((__engine == NULL) && !__broken) {
+		LLVMErrorRef	err = NULL;
+		if (LLVMInitializeNativeTarget() || LLVMInitializeNativeAsmPrinter()) {
+			__broken = true;
+		} else if ((err = LLVMOrcCreateLLJIT(&__engine, NULL)) != NULL) {
+			LLVMConsumeError(err);
+			__engine = NULL;
+			__broken = true;
+		}
+	}
+	return __engine;
+}
+
+
+/**
+ * This is the lowering of the instructions of a program to one function in
+ * an LLVM module. The stack is followed as it would be when the program is
+ * run, but each slot is just the IR value for what would be in it - with
+ * it's type, which is known when the code is built, and a flag that says
+ * if it's defined. Most of the slots are always defined, and only a skip,
+ * or a few of the functions, can leave one that might not be - and it's
+ * only those that ever check for it.
+ */
+class lowering
+{
+	public:
+		/**
+		 * This is what's in a slot of the stack - the type of the value,
+		 * and it's value and the 'i1' that says if it's defined at run
+		 * time - and if it might not be, so that it has to be checked.
+		 */
+		struct slot {
+			value::value_type	type;
+			LLVMValueRef		val;
+			LLVMValueRef		defined;
+			bool				maybe;
+		};
+
+		/**
+		 * The lowering is for the instructions, and the types of all the
+		 * constants and variables they push, by slot, into a new function
+		 * with the provided name in the module.
+		 */
+		lowering( LLVMModuleRef aModule, const std::vector<program::instruction> & aCode,
+				  const std::vector<value::value_type> & aConsts,
+				  const std::vector<value::value_type> & aVars ) :
+			_mod(aModule),
+			_ctx(LLVMGetModuleContext(aModule)),
+			_bld(LLVMCreateBuilderInContext(_ctx)),
+			_code(aCode),
+			_consts(aConsts),
+			_vars(aVars),
+			_fn(NULL),
+			_bail(NULL),
+			_tmp(NULL),
+			_stack()
+		{
+			_i1 = LLVMInt1TypeInContext(_ctx);
+			_i8 = LLVMInt8TypeInContext(_ctx);
+			_i32 = LLVMInt32TypeInContext(_ctx);
+			_i64 = LLVMInt64TypeInContext(_ctx);
+			_f64 = LLVMDoubleTypeInContext(_ctx);
+			_ptr = LLVMPointerType(_i8, 0);
+			_list = LLVMPointerType(_ptr, 0);
+			LLVMTypeRef		args[] = { _ptr, _i32, _ptr };
+			_loader = LLVMFunctionType(LLVMVoidTypeInContext(_ctx), args, 3, 0);
+		}
+
+		~lowering()
+		{
+			LLVMDisposeBuilder(_bld);
+		}
+
+		/**
+		 * This method builds the function, with the provided name, and
+		 * returns 'true' if every instruction could be lowered.
+		 */
+		bool build( const std::string & aName )
+		{
+			bool		error = false;
+			LLVMTypeRef		args[] = { _list, _list, LLVMPointerType(_loader, 0), _ptr };
+			_fn = LLVMAddFunction(_mod, aName.c_str(), LLVMFunctionType(_i32, args, 4, 0));
+			LLVMBasicBlockRef	entry = LLVMAppendBasicBlockInContext(_ctx, _fn, "entry");
+			_bail = LLVMAppendBasicBlockInContext(_ctx, _fn, "bail");
+			LLVMPositionBuilderAtEnd(_bld, _bail);
+			LLVMBuildRet(_bld, LLVMConstInt(_i32, 0, 0));
+			LLVMPositionBuilderAtEnd(_bld, entry);
+			// the datum the loader fills in for each push
+			_tmp = LLVMBuildAlloca(_bld, LLVMArrayType(_i8, sizeof(datum)), "tmp");
+			LLVMSetAlignment(_tmp, 8);
+			if (!range(0, _code.size()) || (_stack.size() != 1)) {
+				error = true;
+			} else {
+				// the answer is undefined if it's not defined
+				const slot	& s = _stack[0];
+				LLVMValueRef	ans = LLVMGetParam(_fn, 3);
+				LLVMValueRef	t = LLVMBuildSelect(_bld, s.defined,
+										LLVMConstInt(_i32, (uint64_t)(int64_t)s.type, 1),
+										LLVMConstInt(_i32, (uint64_t)(int64_t)value::eUnknown, 1), "");
+				LLVMBuildStore(_bld, t, field(ans, offsetof(datum, type), _i32));
+				LLVMValueRef	v = s.val;
+				LLVMTypeRef		vt = raw(s.type);
+				if (s.type == value::eBool) {
+					v = LLVMBuildZExt(_bld, v, _i8, "");
+				}
+				LLVMBuildStore(_bld, v, field(ans, offsetof(datum, intValue), vt));
+				LLVMBuildRet(_bld, LLVMConstInt(_i32, 1, 0));
+			}
+			return !error;
+		}
+
+	private:
+		/**
+		 * This method lowers the instructions from 'aBegin' up to, but not
+		 * including, 'anEnd' - which is the whole program, or the code for
+		 * one expression behind a skip - and returns 'false' if any of them
+		 * can't be done.
+		 */
+		bool range( size_t aBegin, size_t anEnd )
+		{
+			bool		error = false;
+			for (size_t pc = aBegin; !error && (pc < anEnd); ++pc) {
+				const program::instruction	& in = _code[pc];
+				switch (in.op) {
+					case program::ePushValue:
+						error = !push(0, in.count, _consts);
+						break;
+					case program::ePushVariable:
+						error = !push(1, in.count, _vars);
+						break;
+					case program::eSkip:
+						error = !skip(in, pc, anEnd);
+						pc += in.count;
+						break;
+					case program::eStep:
+						error = !step(in);
+						break;
+					default:
+						if ((in.count == 0) || (in.count > _stack.size())) {
+							error = true;
+						} else {
+							std::vector<slot>	args(_stack.end() - in.count, _stack.end());
+							_stack.resize(_stack.size() - in.count);
+							slot	ans;
+							error = !function(in, args, ans);
+							_stack.push_back(ans);
+						}
+						break;
+				}
+			}
+			return !error;
+		}
+
+		/**
+		 * This method pushes the constant, or variable, in slot 'anIndex'
+		 * by calling the loader for it, and checking that it's still the
+		 * type the code is being built for - and if not, giving up.
+		 */
+		bool push( int32_t aKind, uint32_t anIndex, const std::vector<value::value_type> & aTypes )
+		{
+			bool		error = (anIndex >= aTypes.size());
+			if (!error) {
+				slot	s;
+				s.type = aTypes[anIndex];
+				LLVMValueRef	idx = LLVMConstInt(_i64, anIndex, 0);
+				LLVMValueRef	at = LLVMBuildInBoundsGEP2(_bld, _ptr, LLVMGetParam(_fn, aKind), &idx, 1, "");
+				LLVMValueRef	args[] = { LLVMBuildLoad2(_bld, _ptr, at, ""),
+										   LLVMConstInt(_i32, aKind, 0), tmp() };
+				LLVMBuildCall2(_bld, _loader, LLVMGetParam(_fn, 2), args, 3, "");
+				LLVMValueRef	t = LLVMBuildLoad2(_bld, _i32, field(_tmp, offsetof(datum, type), _i32), "");
+				guard(LLVMBuildICmp(_bld, LLVMIntEQ, t, LLVMConstInt(_i32, s.type, 0), ""));
+				s.val = LLVMBuildLoad2(_bld, raw(s.type), field(_tmp, offsetof(datum, intValue), raw(s.type)), "");
+				if (s.type == value::eBool) {
+					s.val = LLVMBuildICmp(_bld, LLVMIntNE, s.val, LLVMConstInt(_i8, 0, 0), "");
+				}
+				s.defined = LLVMConstInt(_i1, 1, 0);
+				s.maybe = false;
+				_stack.push_back(s);
+			}
+			return !error;
+		}
+
+		/**
+		 * This method lowers a skip at 'aPC' - the test of the slot is a
+		 * branch around the code for the next expression, and where the
+		 * two meet, the slot it leaves is either what that code left, or
+		 * undefined, if it was skipped.
+		 */
+		bool skip( const program::instruction & anInst, size_t aPC, size_t anEnd )
+		{
+			bool		error = ((anInst.skip.back == 0) || (anInst.skip.back > _stack.size()) ||
+								 (aPC + 1 + anInst.count > anEnd));
+			if (!error) {
+				const slot	test = _stack[_stack.size() - anInst.skip.back];
+				LLVMValueRef	t = truth(test);
+				LLVMValueRef	cond = NULL;
+				switch (anInst.skip.mode) {
+					case program::eSkipIfFalse:
+						cond = LLVMBuildAnd(_bld, test.defined, LLVMBuildNot(_bld, t, ""), "");
+						break;
+					case program::eSkipIfTrue:
+						cond = LLVMBuildAnd(_bld, test.defined, t, "");
+						break;
+					default:
+						cond = LLVMBuildOr(_bld, LLVMBuildNot(_bld, test.defined, ""),
+										   LLVMBuildNot(_bld, t, ""), "");
+						break;
+				}
+				LLVMBasicBlockRef	run = LLVMAppendBasicBlockInContext(_ctx, _fn, "run");
+				LLVMBasicBlockRef	over = LLVMAppendBasicBlockInContext(_ctx, _fn, "skip");
+				LLVMBasicBlockRef	join = LLVMAppendBasicBlockInContext(_ctx, _fn, "join");
+				LLVMBuildCondBr(_bld, cond, over, run);
+				LLVMPositionBuilderAtEnd(_bld, over);
+				LLVMBuildBr(_bld, join);
+				LLVMPositionBuilderAtEnd(_bld, run);
+				size_t	depth = _stack.size();
+				if (!range(aPC + 1, aPC + 1 + anInst.count) || (_stack.size() != depth + 1)) {
+					error = true;
+				} else {
+					slot	& s = _stack.back();
+					LLVMBasicBlockRef	done = LLVMGetInsertBlock(_bld);
+					LLVMBuildBr(_bld, join);
+					LLVMPositionBuilderAtEnd(_bld, join);
+					LLVMValueRef		vals[] = { s.val, zero(s.type) };
+					LLVMValueRef		defs[] = { s.defined, LLVMConstInt(_i1, 0, 0) };
+					LLVMBasicBlockRef	from[] = { done, over };
+					s.val = LLVMBuildPhi(_bld, LLVMTypeOf(vals[0]), "");
+					LLVMAddIncoming(s.val, vals, from, 2);
+					s.defined = LLVMBuildPhi(_bld, _i1, "");
+					LLVMAddIncoming(s.defined, defs, from, 2);
+					s.maybe = true;
+				}
+			}
+			return !error;
+		}
+
+		/**
+		 * This method lowers one of the built-in functions on it's
+		 * arguments, and puts the answer in 'anAnswer'. Anything that the
+		 * native code can't give the same answer as the instruction for,
+		 * on every run, isn't done, and 'false' is returned.
+		 */
+		bool function( const program::instruction & anInst, const std::vector<slot> & anArgs, slot & anAnswer )
+		{
+			bool		error = false;
+			anAnswer.type = value::eBool;
+			anAnswer.defined = LLVMConstInt(_i1, 1, 0);
+			anAnswer.maybe = false;
+			switch (anInst.op) {
+				case program::eSum:
+				case program::eDiff:
+				case program::eProd:
+				case program::eQuot:
+					error = !arith(anInst, anArgs, anAnswer);
+					break;
+				case program::eMax:
+				case program::eMin:
+					error = !extreme(anInst, anArgs, anAnswer);
+					break;
+				case program::eComp:
+					error = !compare(anInst, anArgs, anAnswer);
+					break;
+				case program::eBin:
+					error = !logic(anInst, anArgs, anAnswer);
+					break;
+				case program::eSelect:
+					error = !select(anInst, anArgs, anAnswer);
+					break;
+				default:
+					// the pushes of trees, and the calls, stay in the instructions
+					error = true;
+					break;
+			}
+			return !error;
+		}
+
+		/**
+		 * The arithmetic is done on ints, or on doubles - where an int
+		 * on the right is converted to a double - just as the value does
+		 * it, and the left type is the type of the answer. An int on the
+		 * left of a double truncates, so that's left to the instructions,
+		 * as is the division by zero, which leaves the answer undefined.
+		 */
+		bool arith( const program::instruction & anInst, const std::vector<slot> & anArgs, slot & anAnswer )
+		{
+			bool		error = !number(anArgs[0].type);
+			if (!error) {
+				anAnswer.type = anArgs[0].type;
+				bool			dbl = (anAnswer.type == value::eDouble);
+				anAnswer.val = need(anArgs[0]);
+				if ((anInst.op == program::eDiff) && (anArgs.size() == 1)) {
+					anAnswer.val = (dbl ? LLVMBuildFMul(_bld, anAnswer.val, LLVMConstReal(_f64, -1.0), "") :
+										  LLVMBuildMul(_bld, anAnswer.val, LLVMConstInt(_i32, (uint64_t)-1, 1), ""));
+				}
+				for (size_t i = 1; !error && (i < anArgs.size()); ++i) {
+					if (!number(anArgs[i].type) || (!dbl && (anArgs[i].type != value::eInt))) {
+						error = true;
+						break;
+					}
+					LLVMValueRef	b = need(anArgs[i]);
+					if (anInst.op == program::eQuot) {
+						guard(anArgs[i].type == value::eDouble ?
+								LLVMBuildFCmp(_bld, LLVMRealUNE, b, LLVMConstReal(_f64, 0.0), "") :
+								LLVMBuildICmp(_bld, LLVMIntNE, b, LLVMConstInt(_i32, 0, 0), ""));
+						if (!dbl) {
+							// ...and the one int division that overflows
+							guard(LLVMBuildOr(_bld,
+									LLVMBuildICmp(_bld, LLVMIntNE, anAnswer.val, LLVMConstInt(_i32, 0x80000000, 0), ""),
+									LLVMBuildICmp(_bld, LLVMIntNE, b, LLVMConstInt(_i32, (uint64_t)-1, 1), ""), ""));
+						}
+					}
+					if (dbl && (anArgs[i].type == value::eInt)) {
+						b = LLVMBuildSIToFP(_bld, b, _f64, "");
+					}
+					LLVMValueRef	a = anAnswer.val;
+					switch (anInst.op) {
+						case program::eSum:
+							anAnswer.val = (dbl ? LLVMBuildFAdd(_bld, a, b, "") : LLVMBuildAdd(_bld, a, b, ""));
+							break;
+						case program::eDiff:
+							anAnswer.val = (dbl ? LLVMBuildFSub(_bld, a, b, "") : LLVMBuildSub(_bld, a, b, ""));
+							break;
+						case program::eProd:
+							anAnswer.val = (dbl ? LLVMBuildFMul(_bld, a, b, "") : LLVMBuildMul(_bld, a, b, ""));
+							break;
+						default:
+							anAnswer.val = (dbl ? LLVMBuildFDiv(_bld, a, b, "") : LLVMBuildSDiv(_bld, a, b, ""));
+							break;
+					}
+				}
+			}
+			return !error;
+		}
+
+		/**
+		 * The max and min are done when all the arguments are ints, or
+		 * all are doubles, and each one replaces the answer if it's the
+		 * bigger, or smaller, of the two - so the NaNs work out the same.
+		 */
+		bool extreme( const program::instruction & anInst, const std::vector<slot> & anArgs, slot & anAnswer )
+		{
+			bool		error = !number(anArgs[0].type);
+			anAnswer.type = anArgs[0].type;
+			anAnswer.val = need(anArgs[0]);
+			bool		dbl = (anAnswer.type == value::eDouble);
+			for (size_t i = 1; !error && (i < anArgs.size()); ++i) {
+				if (anArgs[i].type != anAnswer.type) {
+					error = true;
+				} else {
+					LLVMValueRef	v = need(anArgs[i]);
+					LLVMValueRef	c = NULL;
+					if (anInst.op == program::eMax) {
+						c = (dbl ? LLVMBuildFCmp(_bld, LLVMRealOGT, v, anAnswer.val, "") :
+								   LLVMBuildICmp(_bld, LLVMIntSGT, v, anAnswer.val, ""));
+					} else {
+						c = (dbl ? LLVMBuildFCmp(_bld, LLVMRealOLT, v, anAnswer.val, "") :
+								   LLVMBuildICmp(_bld, LLVMIntSLT, v, anAnswer.val, ""));
+					}
+					anAnswer.val = LLVMBuildSelect(_bld, c, v, anAnswer.val, "");
+				}
+			}
+			return !error;
+		}
+
+		/**
+		 * The comparisons are the 'and' of the tests along the list - of
+		 * the first against each of the rest, for the equality tests, and
+		 * each against the next for the ordered ones, as they move along
+		 * the list. Equality of different types is just false, but the
+		 * ordered tests are only done on the numbers, and an int and a
+		 * double are compared as doubles. A comparison of one value is
+		 * undefined.
+		 */
+		bool compare( const program::instruction & anInst, const std::vector<slot> & anArgs, slot & anAnswer )
+		{
+			bool		error = false;
+			bool		equality = ((anInst.kind == func::comp::eEquals) ||
+									(anInst.kind == func::comp::eNotEquals));
+			anAnswer.val = LLVMConstInt(_i1, 1, 0);
+			if (anArgs.size() == 1) {
+				anAnswer.defined = LLVMConstInt(_i1, 0, 0);
+				anAnswer.maybe = true;
+			}
+			for (size_t i = 1; !error && (i < anArgs.size()); ++i) {
+				const slot	& a = (equality ? anArgs[0] : anArgs[i - 1]);
+				const slot	& b = anArgs[i];
+				LLVMValueRef	c = test(anInst.kind, a, need(a), b, need(b));
+				if (c == NULL) {
+					error = true;
+				} else {
+					anAnswer.val = LLVMBuildAnd(_bld, anAnswer.val, c, "");
+				}
+			}
+			return !error;
+		}
+
+		/**
+		 * This is the one test of a comparison of 'x', of the type of 'a',
+		 * with 'y', of the type of 'b', or NULL if it can't be done.
+		 */
+		LLVMValueRef test( int aKind, const slot & a, LLVMValueRef x, const slot & b, LLVMValueRef y )
+		{
+			LLVMValueRef	c = NULL;
+			if ((aKind == func::comp::eEquals) || (aKind == func::comp::eNotEquals)) {
+				bool	eq = (aKind == func::comp::eEquals);
+				if (a.type != b.type) {
+					c = LLVMConstInt(_i1, (eq ? 0 : 1), 0);
+				} else if (a.type == value::eDouble) {
+					c = LLVMBuildFCmp(_bld, (eq ? LLVMRealOEQ : LLVMRealUNE), x, y, "");
+				} else {
+					c = LLVMBuildICmp(_bld, (eq ? LLVMIntEQ : LLVMIntNE), x, y, "");
+				}
+			} else if (!number(a.type) || !number(b.type)) {
+				// it can't be done here
+			} else if ((a.type == value::eInt) && (b.type == value::eInt)) {
+				switch (aKind) {
+					case func::comp::eLessThan :		c = LLVMBuildICmp(_bld, LLVMIntSLT, x, y, ""); break;
+					case func::comp::eGreaterThan :		c = LLVMBuildICmp(_bld, LLVMIntSGT, x, y, ""); break;
+					case func::comp::eLessOrEqual :		c = LLVMBuildICmp(_bld, LLVMIntSLE, x, y, ""); break;
+					default :							c = LLVMBuildICmp(_bld, LLVMIntSGE, x, y, ""); break;
+				}
+			} else {
+				if (a.type == value::eInt) {
+					x = LLVMBuildSIToFP(_bld, x, _f64, "");
+				}
+				if (b.type == value::eInt) {
+					y = LLVMBuildSIToFP(_bld, y, _f64, "");
+				}
+				// '<=' is "not '>'" and '>=' is "not '<'" - so a NaN passes them
+				switch (aKind) {
+					case func::comp::eLessThan :		c = LLVMBuildFCmp(_bld, LLVMRealOLT, x, y, ""); break;
+					case func::comp::eGreaterThan :		c = LLVMBuildFCmp(_bld, LLVMRealOGT, x, y, ""); break;
+					case func::comp::eLessOrEqual :		c = LLVMBuildFCmp(_bld, LLVMRealULE, x, y, ""); break;
+					default :							c = LLVMBuildFCmp(_bld, LLVMRealUGE, x, y, ""); break;
+				}
+			}
+			return c;
+		}
+
+		/**
+		 * This method lowers a step of a comparison - the argument on the
+		 * top is folded into the answer so far, unless it's undefined, or
+		 * the answer is already false - and then it's what the next one is
+		 * compared against, for the ordered tests.
+		 */
+		bool step( const program::instruction & anInst )
+		{
+			bool		error = ((anInst.count < 2) || (anInst.count > 3) || (anInst.count > _stack.size()));
+			if (!error) {
+				bool	ordered = ((anInst.step.kind != func::comp::eEquals) &&
+								   (anInst.step.kind != func::comp::eNotEquals));
+				slot	v = _stack.back();
+				_stack.pop_back();
+				slot	from = _stack.back();
+				_stack.pop_back();
+				slot	ans;
+				if (anInst.count == 2) {
+					ans.type = value::eBool;
+					ans.val = LLVMConstInt(_i1, 1, 0);
+					ans.defined = LLVMConstInt(_i1, 0, 0);
+					ans.maybe = true;
+				} else {
+					ans = _stack.back();
+					_stack.pop_back();
+				}
+				LLVMValueRef	c = test(anInst.step.kind, from, need(from), v, v.val);
+				if ((c == NULL) || (ans.type != value::eBool)) {
+					error = true;
+				} else {
+					// it's folded in if it's defined, and nothing has failed yet
+					LLVMValueRef	failed = LLVMBuildAnd(_bld, ans.defined, LLVMBuildNot(_bld, ans.val, ""), "");
+					LLVMValueRef	fold = LLVMBuildAnd(_bld, v.defined, LLVMBuildNot(_bld, failed, ""), "");
+					ans.val = LLVMBuildSelect(_bld, fold, c, ans.val, "");
+					ans.defined = LLVMBuildOr(_bld, ans.defined, fold, "");
+					ans.maybe = (ans.maybe && v.maybe);
+					if (ordered) {
+						/**
+						 * It's only skipped once the answer is false, and then
+						 * what's compared against doesn't matter - so if it's
+						 * undefined otherwise, the run is given up on.
+						 */
+						if (v.maybe) {
+							guard(LLVMBuildOr(_bld, v.defined, failed, ""));
+						}
+						from = v;
+						from.defined = LLVMConstInt(_i1, 1, 0);
+						from.maybe = false;
+					}
+					_stack.push_back(ans);
+					if (!anInst.step.last) {
+						_stack.push_back(from);
+					}
+				}
+			}
+			return !error;
+		}
+
+		/**
+		 * The 'and' and 'or' skip the undefined values, and are undefined
+		 * only if they all are, and the 'not' is of it's one argument. Any
+		 * type is fine, as it's just the truth of each that's needed.
+		 */
+		bool logic( const program::instruction & anInst, const std::vector<slot> & anArgs, slot & anAnswer )
+		{
+			bool		error = false;
+			if (anInst.kind == func::bin::eNot) {
+				if (anArgs.size() != 1) {
+					error = true;
+				} else {
+					anAnswer.val = LLVMBuildNot(_bld, truth(anArgs[0]), "");
+					anAnswer.defined = anArgs[0].defined;
+					anAnswer.maybe = anArgs[0].maybe;
+				}
+			} else {
+				bool	isAnd = (anInst.kind == func::bin::eAnd);
+				anAnswer.val = LLVMConstInt(_i1, (isAnd ? 1 : 0), 0);
+				anAnswer.defined = LLVMConstInt(_i1, 0, 0);
+				anAnswer.maybe = true;
+				for (size_t i = 0; i < anArgs.size(); ++i) {
+					const slot	& s = anArgs[i];
+					LLVMValueRef	t = truth(s);
+					if (isAnd) {
+						t = LLVMBuildOr(_bld, LLVMBuildNot(_bld, s.defined, ""), t, "");
+						anAnswer.val = LLVMBuildAnd(_bld, anAnswer.val, t, "");
+					} else {
+						t = LLVMBuildAnd(_bld, s.defined, t, "");
+						anAnswer.val = LLVMBuildOr(_bld, anAnswer.val, t, "");
+					}
+					anAnswer.defined = LLVMBuildOr(_bld, anAnswer.defined, s.defined, "");
+					anAnswer.maybe = (anAnswer.maybe && s.maybe);
+				}
+			}
+			return !error;
+		}
+
+		/**
+		 * The 'if' picks the 'then' if the test is defined and true, and
+		 * the 'else' - or undefined, if there isn't one - if not. The two
+		 * have to be the same type, as the slot has just the one.
+		 */
+		bool select( const program::instruction & anInst, const std::vector<slot> & anArgs, slot & anAnswer )
+		{
+			bool		error = ((anArgs.size() < 2) || (anArgs.size() > 3) ||
+								 ((anArgs.size() == 3) && (anArgs[1].type != anArgs[2].type)));
+			if (!error) {
+				LLVMValueRef	test = LLVMBuildAnd(_bld, anArgs[0].defined, truth(anArgs[0]), "");
+				const slot		& then = anArgs[1];
+				anAnswer.type = then.type;
+				if (anArgs.size() == 3) {
+					anAnswer.val = LLVMBuildSelect(_bld, test, then.val, anArgs[2].val, "");
+					anAnswer.defined = LLVMBuildSelect(_bld, test, then.defined, anArgs[2].defined, "");
+					anAnswer.maybe = (then.maybe || anArgs[2].maybe);
+				} else {
+					anAnswer.val = then.val;
+					anAnswer.defined = LLVMBuildAnd(_bld, test, then.defined, "");
+					anAnswer.maybe = true;
+				}
+			}
+			return !error;
+		}
+
+		/**
+		 * This method returns the 'i1' truth of the slot - just as the
+		 * evalAsBool() of the value would be - so an int or double is true
+		 * if it's not zero - and that includes the NaNs.
+		 */
+		LLVMValueRef truth( const slot & aSlot )
+		{
+			LLVMValueRef	t = aSlot.val;
+			if (aSlot.type == value::eInt) {
+				t = LLVMBuildICmp(_bld, LLVMIntNE, aSlot.val, LLVMConstInt(_i32, 0, 0), "");
+			} else if (aSlot.type == value::eDouble) {
+				t = LLVMBuildFCmp(_bld, LLVMRealUNE, aSlot.val, LLVMConstReal(_f64, 0.0), "");
+			}
+			return t;
+		}
+
+		/**
+		 * This method returns the value of the slot for a function that
+		 * can't take an undefined value - so if it might be undefined,
+		 * and is, the run is given up on.
+		 */
+		LLVMValueRef need( const slot & aSlot )
+		{
+			if (aSlot.maybe) {
+				guard(aSlot.defined);
+			}
+			return aSlot.val;
+		}
+
+		/**
+		 * This method adds a check that gives up on the run if the
+		 * condition isn't true, and carries on with the rest if it is.
+		 */
+		void guard( LLVMValueRef aCondition )
+		{
+			LLVMBasicBlockRef	ok = LLVMAppendBasicBlockInContext(_ctx, _fn, "ok");
+			LLVMBuildCondBr(_bld, aCondition, ok, _bail);
+			LLVMPositionBuilderAtEnd(_bld, ok);
+		}
+
+		/**
+		 * This method returns a pointer of the provided type to the byte
+		 * at 'anOffset' in the datum at 'aBase'.
+		 */
+		LLVMValueRef field( LLVMValueRef aBase, size_t anOffset, LLVMTypeRef aType )
+		{
+			LLVMValueRef	base = LLVMBuildBitCast(_bld, aBase, _ptr, "");
+			LLVMValueRef	idx = LLVMConstInt(_i64, anOffset, 0);
+			LLVMValueRef	at = LLVMBuildInBoundsGEP2(_bld, _i8, base, &idx, 1, "");
+			return LLVMBuildBitCast(_bld, at, LLVMPointerType(aType, 0), "");
+		}
+
+		/**
+		 * These are the little helpers for the types - the temporary datum
+		 * as a plain pointer, the type of the payload of a value in the
+		 * datum, the zero of a slot's type, and if a type is a number.
+		 */
+		LLVMValueRef tmp()
+		{
+			return LLVMBuildBitCast(_bld, _tmp, _ptr, "");
+		}
+
+		LLVMTypeRef raw( value::value_type aType )
+		{
+			return (aType == value::eBool ? _i8 : (aType == value::eInt ? _i32 : _f64));
+		}
+
+		LLVMValueRef zero( value::value_type aType )
+		{
+			return (aType == value::eBool ? LLVMConstInt(_i1, 0, 0) :
+					(aType == value::eInt ? LLVMConstInt(_i32, 0, 0) : LLVMConstReal(_f64, 0.0)));
+		}
+
+		static bool number( value::value_type aType )
+		{
+			return ((aType == value::eInt) || (aType == value::eDouble));
+		}
+
+		// there's no copying a lowering - it owns the builder
+		lowering( const lowering & anOther );
+		lowering & operator=( const lowering & anOther );
+
+		/**
+		 * These are the module, it's context, and the builder for the
+		 * code, and the instructions and types we're working from.
+		 */
+		LLVMModuleRef							_mod;
+		LLVMContextRef							_ctx;
+		LLVMBuilderRef							_bld;
+		const std::vector<program::instruction>	& _code;
+		const std::vector<value::value_type>	& _consts;
+		const std::vector<value::value_type>	& _vars;
+		/**
+		 * These are the function being built, the block that gives up on
+		 * the run, the datum the loader fills in, and the stack of slots.
+		 */
+		LLVMValueRef							_fn;
+		LLVMBasicBlockRef						_bail;
+		LLVMValueRef							_tmp;
+		std::vector<slot>						_stack;
+		// ...and the types we use everywhere
+		LLVMTypeRef								_i1;
+		LLVMTypeRef								_i8;
+		LLVMTypeRef								_i32;
+		LLVMTypeRef								_i64;
+		LLVMTypeRef								_f64;
+		LLVMTypeRef								_ptr;
+		LLVMTypeRef								_list;
+		LLVMTypeRef								_loader;
+};
+
+
+/**
+ * This function returns the type of the datum if it's one the native code
+ * can work with - a bool, int or double - and eUnknown if it's not.
+ */
+static value::value_type typeOf( const datum & aDatum )
+{
+	value::value_type	t = aDatum.type;
+	if ((t != value::eBool) && (t != value::eInt) && (t != value::eDouble)) {
+		t = value::eUnknown;
+	}
+	return t;
+}
+#endif		// LKIT_JIT
+
+
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * The only way to make one is with build(), and as they own the
+ * native code, there's no copying them.
+ */
+jit::jit( native_t aFunction, void *aTracker ) :
+	_fn(aFunction),
+	_tracker(aTracker)
+{
+}
+
+
+/**
+ * This method compiles the instructions of a program - with it's
+ * constants and variables by slot - into native code, and returns
+ * it, or NULL if there's something in the program that can't be
+ * compiled. The values are looked at to get their types, and the
+ * variables are evaluated for it. The caller owns what's returned.
+ */
+jit *jit::build( const std::vector<program::instruction> & aCode,
+				 const std::vector<value *> & aConsts,
+				 const std::vector<value *> & aVars )
+{
+	jit		*retval = NULL;
+#ifdef LKIT_JIT
+	// the code reads the datums as plain bytes, so they have to be what we expect
+	bool	error = aCode.empty() || (sizeof(value::value_type) != sizeof(int32_t)) ||
+					(sizeof(bool) != 1) || (sizeof(int) != sizeof(int32_t));
+	/**
+	 * The types of the constants and variables are what the code is built
+	 * for - and if any of them isn't a simple type, there's no point.
+	 */
+	std::vector<value::value_type>	consts;
+	std::vector<value::value_type>	vars;
+	for (size_t i = 0; !error && (i < aConsts.size()); ++i) {
+		consts.push_back(typeOf(aConsts[i]->getDatum()));
+		error = (consts.back() == value::eUnknown);
+	}
+	for (size_t i = 0; !error && (i < aVars.size()); ++i) {
+		vars.push_back(typeOf(aVars[i]->eval().getDatum()));
+		error = (vars.back() == value::eUnknown);
+	}
+	if (!error) {
+		spinlock::scoped_lock	lock(__engine_mutex);
+		LLVMOrcLLJITRef		engine = engine_nl();
+		if (engine != NULL) {
+			char	name[64];
+			snprintf(name, sizeof(name), "lkit_native_%llu", (unsigned long long)++__built);
+			LLVMOrcThreadSafeContextRef	tsc = LLVMOrcCreateNewThreadSafeContext();
+			LLVMModuleRef	mod = LLVMModuleCreateWithNameInContext(name,
+										LLVMOrcThreadSafeContextGetContext(tsc));
+			LLVMSetDataLayout(mod, LLVMOrcLLJITGetDataLayoutStr(engine));
+			LLVMSetTarget(mod, LLVMOrcLLJITGetTripleString(engine));
+			bool	ok = false;
+			{
+				lowering	low(mod, aCode, consts, vars);
+				ok = low.build(name);
+			}
+			char	*msg = NULL;
+			if (ok && LLVMVerifyModule(mod, LLVMReturnStatusAction, &msg)) {
+				ok = false;
+			}
+			if (msg != NULL) {
+				LLVMDisposeMessage(msg);
+			}
+			if (ok) {
+				// clean up the stack of slots into straight-line code
+				LLVMPassBuilderOptionsRef	opts = LLVMCreatePassBuilderOptions();
+				LLVMErrorRef	err = LLVMRunPasses(mod, "default<O2>", NULL, opts);
+				LLVMDisposePassBuilderOptions(opts);
+				if (err != NULL) {
+					LLVMConsumeError(err);
+				}
+				// the JIT owns the module now, and the tracker lets us remove it
+				LLVMOrcResourceTrackerRef	rt = LLVMOrcJITDylibCreateResourceTracker(
+													LLVMOrcLLJITGetMainJITDylib(engine));
+				LLVMOrcThreadSafeModuleRef	tsm = LLVMOrcCreateNewThreadSafeModule(mod, tsc);
+				LLVMOrcExecutorAddress		addr = 0;
+				if ((err = LLVMOrcLLJITAddLLVMIRModuleWithRT(engine, rt, tsm)) != NULL) {
+					LLVMConsumeError(err);
+				} else if ((err = LLVMOrcLLJITLookup(engine, &addr, name)) != NULL) {
+					LLVMConsumeError(err);
+				}
+				if (addr != 0) {
+					retval = new jit((native_t)(uintptr_t)addr, rt);
+				} else {
+					if ((err = LLVMOrcResourceTrackerRemove(rt)) != NULL) {
+						LLVMConsumeError(err);
+					}
+					LLVMOrcReleaseResourceTracker(rt);
+				}
+			} else {
+				LLVMDisposeModule(mod);
+			}
+			LLVMOrcDisposeThreadSafeContext(tsc);
+		}
+	}
+#endif
+	return retval;
+}
+
+
+/**
+ * This is the standard destructor and it releases the native
+ * code back to the JIT.
+ */
+jit::~jit()
+{
+#ifdef LKIT_JIT
+	if (_tracker != NULL) {
+		spinlock::scoped_lock	lock(__engine_mutex);
+		LLVMOrcResourceTrackerRef	rt = (LLVMOrcResourceTrackerRef)_tracker;
+		LLVMErrorRef	err = LLVMOrcResourceTrackerRemove(rt);
+		if (err != NULL) {
+			LLVMConsumeError(err);
+		}
+		LLVMOrcReleaseResourceTracker(rt);
+		_tracker = NULL;
+	}
+#endif
+}
+
+
+/*******************************************************************
+ *
+ *                       Evaluation Methods
+ *
+ *******************************************************************/
+/**
+ * This method runs the native code on the constants and variables
+ * of the program it was built from, and if it gets an answer, puts
+ * it in 'anAnswer' and returns 'true'. If it has to give up - a
+ * value isn't the type it was when the code was made, or it needs
+ * an undefined value where it can't handle one - it returns 'false'
+ * and the instructions have to be run.
+ */
+bool jit::run( const std::vector<value *> & aConsts,
+			   const std::vector<value *> & aVars, value & anAnswer ) const
+{
+	bool		error = (_fn == NULL);
+#ifdef LKIT_JIT
+	if (!error) {
+		datum	ans;
+		ans.type = value::eUnknown;
+		ans.timeValue = 0;
+		if (_fn((aConsts.empty() ? NULL : &aConsts[0]),
+				(aVars.empty() ? NULL : &aVars[0]), &load, &ans) == 0) {
+			error = true;
+		} else {
+			anAnswer = ans;
+		}
+	}
+#endif
+	return !error;
+}
+}		// end of namespace lkit
@@ -0,0 +1,112 @@
+/**
+ * jit.h - this file defines the native code for a program. When LKit is
+ *         built with LKIT_JIT defined, a program that's run a lot is handed
+ *         to this class, and if it's only made up of the built-in functions
+ *         on bools, ints and doubles, it's lowered to LLVM IR and compiled,
+ *         in-process, to machine code. The types of the values it pushes
+ *         are taken when it's compiled, and checked each time it's run - and
+ *         anything that's not what the code was built for - a value of some
+ *         other type, or a division by zero - gives up on the run, and the
+ *         program's instructions are run as they always are. Without the
+ *         define, nothing can be compiled, and build() always returns NULL.
+ */
+#ifndef __LKIT_JIT_H
+#define __LKIT_JIT_H
+
+//	System Headers
+#include <stdint.h>
+#include <vector>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "program.h"
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+/**
+ * Main class definition
+ */
+namespace lkit {
+class jit
+{
+	public:
+		/**
+		 * This is the function the native code calls to get each value it
+		 * pushes - the datum of a constant, if 'aKind' is 0, or of the
+		 * evaluation of a variable, if it's 1 - just as the instructions
+		 * get them.
+		 */
+		typedef void (*loader_t)( value *aValue, int32_t aKind, datum *anOut );
+		/**
+		 * This is the native code for a program. It takes the constants
+		 * and the variables of the program, by slot, and the loader, and
+		 * puts the answer in 'anAnswer' and returns 1 - or returns 0 if
+		 * it had to give up on the run.
+		 */
+		typedef int32_t (*native_t)( value * const *aConsts, value * const *aVars,
+									 loader_t aLoad, datum *anAnswer );
+
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This method compiles the instructions of a program - with it's
+		 * constants and variables by slot - into native code, and returns
+		 * it, or NULL if there's something in the program that can't be
+		 * compiled. The values are looked at to get their types, and the
+		 * variables are evaluated for it. The caller owns what's returned.
+		 */
+		static jit *build( const std::vector<program::instruction> & aCode,
+						   const std::vector<value *> & aConsts,
+						   const std::vector<value *> & aVars );
+		/**
+		 * This is the standard destructor and it releases the native
+		 * code back to the JIT.
+		 */
+		virtual ~jit();
+
+		/*******************************************************************
+		 *
+		 *                       Evaluation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method runs the native code on the constants and variables
+		 * of the program it was built from, and if it gets an answer, puts
+		 * it in 'anAnswer' and returns 'true'. If it has to give up - a
+		 * value isn't the type it was when the code was made, or it needs
+		 * an undefined value where it can't handle one - it returns 'false'
+		 * and the instructions have to be run.
+		 */
+		bool run( const std::vector<value *> & aConsts,
+				  const std::vector<value *> & aVars, value & anAnswer ) const;
+
+	private:
+		/**
+		 * The only way to make one is with build(), and as they own the
+		 * native code, there's no copying them.
+		 */
+		jit( native_t aFunction, void *aTracker );
+		jit( const jit & anOther );
+		jit & operator=( const jit & anOther );
+
+		/**
+		 * This is the native code for the program, and the handle the JIT
+		 * gave us for it, so that it can all be released when we're done.
+		 */
+		native_t		_fn;
+		void			*_tracker;
+};
+}		// end of namespace lkit
+
+#endif		// __LKIT_JIT_H
@@ -0,0 +1,588 @@
+/**
+ * kernels.cpp - this file implements the vector kernels that the programs
+ *               use when they are working on a block of rows where a slot
+ *               of the stack is all doubles, or all ints. These are simple,
+ *               tight, loops over arrays that the compiler can turn into
+ *               SSE2/AVX2/NEON code, and on x86_64 they are built for
+ *               more than one instruction set, with the right one picked
+ *               at run-time for the CPU we're on.
+ */
+
+//	System Headers
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "kernels.h"
+
+//	Forward Declarations
+
+//	Private Constants
+/**
+ * On x86_64 with GCC on ELF systems, we have the compiler build each
+ * kernel for AVX2 as well as the SSE2 baseline, and the loader picks the
+ * right one for the CPU the first time it's called. Everywhere else, we
+ * get the one version for the baseline of the target - which is NEON
+ * on aarch64.
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && \
+	defined(__ELF__)
+#define LKIT_KERNEL		__attribute__((target_clones("avx2", "default")))
+#else
+#define LKIT_KERNEL
+#endif
+
+//	Private Datatypes
+
+//	Private Data Constants
+
+
+
+namespace lkit {
+/*******************************************************************
+ *
+ *                        Arithmetic Kernels
+ *
+ *******************************************************************/
+/**
+ * These kernels do 'a[i] += b[i]' for 'n' elements, where the
+ * type of 'a' is the type of the answer. For an int answer, the
+ * double is truncated to an int before it's added - just like
+ * lkit::value does it.
+ */
+
+LKIT_KERNEL
+void kernels::add( double *a, const double *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] += b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::add( double *a, const int *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] += b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::add( int *a, const int *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] += b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::add( int *a, const double *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] += (int)b[i];
+	}
+}
+
+
+/**
+ * These kernels do 'a[i] -= b[i]' for 'n' elements, with the
+ * same conversions as the adds.
+ */
+
+LKIT_KERNEL
+void kernels::sub( double *a, const double *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] -= b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::sub( double *a, const int *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] -= b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::sub( int *a, const int *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] -= b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::sub( int *a, const double *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] -= (int)b[i];
+	}
+}
+
+
+/**
+ * These kernels do 'a[i] *= b[i]' for 'n' elements, with the
+ * same conversions as the adds.
+ */
+
+LKIT_KERNEL
+void kernels::mul( double *a, const double *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] *= b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::mul( double *a, const int *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] *= b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::mul( int *a, const int *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] *= b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::mul( int *a, const double *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] *= (int)b[i];
+	}
+}
+
+
+/**
+ * These kernels do 'a[i] /= b[i]' for 'n' elements. The caller
+ * has to make sure that there are no zeros in 'b', as lkit::value
+ * makes the answer undefined for those. For an int answer, the
+ * division by a double is done as a double, and then truncated.
+ */
+
+LKIT_KERNEL
+void kernels::div( double *a, const double *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] /= b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::div( double *a, const int *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] /= b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::div( int *a, const int *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] /= b[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::div( int *a, const double *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] /= b[i];
+	}
+}
+
+
+
+/**
+ * These kernels leave the larger (or smaller) of 'a[i]' and 'b[i]'
+ * in 'a[i]' for 'n' elements of the same type.
+ */
+LKIT_KERNEL
+void kernels::max( double *a, const double *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] = (b[i] > a[i] ? b[i] : a[i]);
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::max( int *a, const int *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] = (b[i] > a[i] ? b[i] : a[i]);
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::min( double *a, const double *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] = (b[i] < a[i] ? b[i] : a[i]);
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::min( int *a, const int *b, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] = (b[i] < a[i] ? b[i] : a[i]);
+	}
+}
+
+
+/**
+ * These kernels negate the 'n' elements in 'a'.
+ */
+LKIT_KERNEL
+void kernels::neg( double *a, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] = -a[i];
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::neg( int *a, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		a[i] = -a[i];
+	}
+}
+
+
+/**
+ * These methods return 'true' if any of the 'n' elements of 'a'
+ * are zero - so that we know if a division can be done in a
+ * kernel.
+ */
+LKIT_KERNEL
+bool kernels::anyZero( const double *a, size_t n )
+{
+	int		zeros = 0;
+	for (size_t i = 0; i < n; ++i) {
+		zeros |= (a[i] == 0.0);
+	}
+	return (zeros != 0);
+}
+
+
+LKIT_KERNEL
+bool kernels::anyZero( const int *a, size_t n )
+{
+	int		zeros = 0;
+	for (size_t i = 0; i < n; ++i) {
+		zeros |= (a[i] == 0);
+	}
+	return (zeros != 0);
+}
+
+
+/*******************************************************************
+ *
+ *                         Logical Kernels
+ *
+ *******************************************************************/
+/**
+ * These kernels clear 'mask[i]' for each of the 'n' elements where
+ * 'a[i] op b[i]' is not true - so that a chain of comparisons can
+ * be built up one pair at a time. The switch is outside the loops
+ * so that each of them is as simple as it can be.
+ */
+LKIT_KERNEL
+void kernels::comp( comp_type op, const double *a, const double *b, int *mask, size_t n )
+{
+	switch (op) {
+		case eEquals:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] == b[i]);
+			}
+			break;
+		case eNotEquals:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] != b[i]);
+			}
+			break;
+		case eLessThan:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] < b[i]);
+			}
+			break;
+		case eGreaterThan:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] > b[i]);
+			}
+			break;
+		case eLessOrEqual:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] <= b[i]);
+			}
+			break;
+		case eGreaterOrEqual:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] >= b[i]);
+			}
+			break;
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::comp( comp_type op, const int *a, const int *b, int *mask, size_t n )
+{
+	switch (op) {
+		case eEquals:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] == b[i]);
+			}
+			break;
+		case eNotEquals:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] != b[i]);
+			}
+			break;
+		case eLessThan:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] < b[i]);
+			}
+			break;
+		case eGreaterThan:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] > b[i]);
+			}
+			break;
+		case eLessOrEqual:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] <= b[i]);
+			}
+			break;
+		case eGreaterOrEqual:
+			for (size_t i = 0; i < n; ++i) {
+				mask[i] &= (a[i] >= b[i]);
+			}
+			break;
+	}
+}
+
+
+/**
+ * These kernels clear 'mask[i]' for each of the 'n' elements where
+ * 'a[i]' is zero - which is the logical 'and' of the values.
+ */
+LKIT_KERNEL
+void kernels::truth( const double *a, int *mask, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		mask[i] &= (a[i] != 0.0);
+	}
+}
+
+
+LKIT_KERNEL
+void kernels::truth( const int *a, int *mask, size_t n )
+{
+	for (size_t i = 0; i < n; ++i) {
+		mask[i] &= (a[i] != 0);
+	}
+}
+
+
+/*******************************************************************
+ *
+ *                        Reduction Kernels
+ *
+ *******************************************************************/
+/**
+ * These kernels return the sum of the 'n' elements of 'a'. The
+ * doubles are added in a few running sums at once - so that the
+ * adds don't all wait on one another - which means they aren't
+ * added strictly left to right, and the last bit may differ from
+ * a simple loop.
+ */
+LKIT_KERNEL
+double kernels::sum( const double *a, size_t n )
+{
+	double	s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+	size_t	i = 0;
+	for (; i + 4 <= n; i += 4) {
+		s0 += a[i];
+		s1 += a[i + 1];
+		s2 += a[i + 2];
+		s3 += a[i + 3];
+	}
+	for (; i < n; ++i) {
+		s0 += a[i];
+	}
+	return ((s0 + s1) + (s2 + s3));
+}
+
+
+LKIT_KERNEL
+int kernels::sum( const int *a, size_t n )
+{
+	int		s = 0;
+	for (size_t i = 0; i < n; ++i) {
+		s += a[i];
+	}
+	return s;
+}
+
+
+/**
+ * These kernels return the largest (or smallest) of the 'n'
+ * elements of 'a' - and there has to be at least one.
+ */
+LKIT_KERNEL
+double kernels::max( const double *a, size_t n )
+{
+	double	m = a[0];
+	for (size_t i = 1; i < n; ++i) {
+		m = (a[i] > m ? a[i] : m);
+	}
+	return m;
+}
+
+
+LKIT_KERNEL
+int kernels::max( const int *a, size_t n )
+{
+	int		m = a[0];
+	for (size_t i = 1; i < n; ++i) {
+		m = (a[i] > m ? a[i] : m);
+	}
+	return m;
+}
+
+
+LKIT_KERNEL
+double kernels::min( const double *a, size_t n )
+{
+	double	m = a[0];
+	for (size_t i = 1; i < n; ++i) {
+		m = (a[i] < m ? a[i] : m);
+	}
+	return m;
+}
+
+
+LKIT_KERNEL
+int kernels::min( const int *a, size_t n )
+{
+	int		m = a[0];
+	for (size_t i = 1; i < n; ++i) {
+		m = (a[i] < m ? a[i] : m);
+	}
+	return m;
+}
+
+
+/**
+ * These kernels return the sum of 'a[i] * b[i]' for the 'n'
+ * elements, where the type of 'a' is the type of the answer, and
+ * 'b' is converted to it just as the multiplies do it.
+ */
+LKIT_KERNEL
+double kernels::dot( const double *a, const double *b, size_t n )
+{
+	double	s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+	size_t	i = 0;
+	for (; i + 4 <= n; i += 4) {
+		s0 += a[i] * b[i];
+		s1 += a[i + 1] * b[i + 1];
+		s2 += a[i + 2] * b[i + 2];
+		s3 += a[i + 3] * b[i + 3];
+	}
+	for (; i < n; ++i) {
+		s0 += a[i] * b[i];
+	}
+	return ((s0 + s1) + (s2 + s3));
+}
+
+
+LKIT_KERNEL
+double kernels::dot( const double *a, const int *b, size_t n )
+{
+	double	s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+	size_t	i = 0;
+	for (; i + 4 <= n; i += 4) {
+		s0 += a[i] * b[i];
+		s1 += a[i + 1] * b[i + 1];
+		s2 += a[i + 2] * b[i + 2];
+		s3 += a[i + 3] * b[i + 3];
+	}
+	for (; i < n; ++i) {
+		s0 += a[i] * b[i];
+	}
+	return ((s0 + s1) + (s2 + s3));
+}
+
+
+LKIT_KERNEL
+int kernels::dot( const int *a, const int *b, size_t n )
+{
+	int		s = 0;
+	for (size_t i = 0; i < n; ++i) {
+		s += a[i] * b[i];
+	}
+	return s;
+}
+
+
+LKIT_KERNEL
+int kernels::dot( const int *a, const double *b, size_t n )
+{
+	int		s = 0;
+	for (size_t i = 0; i < n; ++i) {
+		s += a[i] * (int)b[i];
+	}
+	return s;
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * This method returns the name of the instruction set that the
+ * kernels are using on this CPU - "avx2", "sse2", "neon", or
+ * just "scalar" when the compiler is on it's own.
+ */
+const char *kernels::isa()
+{
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && \
+	defined(__ELF__)
+	return (__builtin_cpu_supports("avx2") ? "avx2" : "sse2");
+#elif defined(__x86_64__) || defined(__SSE2__)
+	return "sse2";
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
+}		// end of namespace lkit
@@ -0,0 +1,181 @@
+/**
+ * kernels.h - this file defines the vector kernels that the programs use
+ *             when they are working on a block of rows where a slot of
+ *             the stack is all doubles, or all ints. These are simple,
+ *             tight, loops over arrays that the compiler can turn into
+ *             SSE2/AVX2/NEON code, and on x86_64 they are built for
+ *             more than one instruction set, with the right one picked
+ *             at run-time for the CPU we're on.
+ *
+ *             The kernels follow the same rules as lkit::value - the
+ *             type of the first argument is the type of the answer, and
+ *             the second argument is converted to it just as the value
+ *             operators do it.
+ */
+#ifndef __LKIT_KERNELS_H
+#define __LKIT_KERNELS_H
+
+//	System Headers
+#include <stddef.h>
+
+//	Third-Party Headers
+
+//	Other Headers
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+namespace lkit {
+/**
+ * This is the main class definition.
+ */
+class kernels
+{
+	public:
+		/**
+		 * These are the comparisons the kernels know how to do, and they
+		 * match up with the types of the comp function.
+		 */
+		enum comp_type {
+			eEquals = 0,
+			eNotEquals,
+			eLessThan,
+			eGreaterThan,
+			eLessOrEqual,
+			eGreaterOrEqual
+		};
+
+		/*******************************************************************
+		 *
+		 *                        Arithmetic Kernels
+		 *
+		 *******************************************************************/
+		/**
+		 * These kernels do 'a[i] += b[i]' for 'n' elements, where the
+		 * type of 'a' is the type of the answer. For an int answer, the
+		 * double is truncated to an int before it's added - just like
+		 * lkit::value does it.
+		 */
+		static void add( double *a, const double *b, size_t n );
+		static void add( double *a, const int *b, size_t n );
+		static void add( int *a, const int *b, size_t n );
+		static void add( int *a, const double *b, size_t n );
+		/**
+		 * These kernels do 'a[i] -= b[i]' for 'n' elements, with the
+		 * same conversions as the adds.
+		 */
+		static void sub( double *a, const double *b, size_t n );
+		static void sub( double *a, const int *b, size_t n );
+		static void sub( int *a, const int *b, size_t n );
+		static void sub( int *a, const double *b, size_t n );
+		/**
+		 * These kernels do 'a[i] *= b[i]' for 'n' elements, with the
+		 * same conversions as the adds.
+		 */
+		static void mul( double *a, const double *b, size_t n );
+		static void mul( double *a, const int *b, size_t n );
+		static void mul( int *a, const int *b, size_t n );
+		static void mul( int *a, const double *b, size_t n );
+		/**
+		 * These kernels do 'a[i] /= b[i]' for 'n' elements. The caller
+		 * has to make sure that there are no zeros in 'b', as lkit::value
+		 * makes the answer undefined for those, and that's not something
+		 * that a kernel can do.
+		 */
+		static void div( double *a, const double *b, size_t n );
+		static void div( double *a, const int *b, size_t n );
+		static void div( int *a, const int *b, size_t n );
+		static void div( int *a, const double *b, size_t n );
+		/**
+		 * These kernels leave the larger (or smaller) of 'a[i]' and 'b[i]'
+		 * in 'a[i]' for 'n' elements of the same type.
+		 */
+		static void max( double *a, const double *b, size_t n );
+		static void max( int *a, const int *b, size_t n );
+		static void min( double *a, const double *b, size_t n );
+		static void min( int *a, const int *b, size_t n );
+		/**
+		 * These kernels negate the 'n' elements in 'a'.
+		 */
+		static void neg( double *a, size_t n );
+		static void neg( int *a, size_t n );
+		/**
+		 * These methods return 'true' if any of the 'n' elements of 'a'
+		 * are zero - so that we know if a division can be done in a
+		 * kernel.
+		 */
+		static bool anyZero( const double *a, size_t n );
+		static bool anyZero( const int *a, size_t n );
+
+		/*******************************************************************
+		 *
+		 *                         Logical Kernels
+		 *
+		 *******************************************************************/
+		/**
+		 * These kernels clear 'mask[i]' for each of the 'n' elements where
+		 * 'a[i] op b[i]' is not true - so that a chain of comparisons can
+		 * be built up one pair at a time.
+		 */
+		static void comp( comp_type op, const double *a, const double *b, int *mask, size_t n );
+		static void comp( comp_type op, const int *a, const int *b, int *mask, size_t n );
+		/**
+		 * These kernels clear 'mask[i]' for each of the 'n' elements where
+		 * 'a[i]' is zero - which is the logical 'and' of the values.
+		 */
+		static void truth( const double *a, int *mask, size_t n );
+		static void truth( const int *a, int *mask, size_t n );
+
+		/*******************************************************************
+		 *
+		 *                        Reduction Kernels
+		 *
+		 *******************************************************************/
+		/**
+		 * These kernels return the sum of the 'n' elements of 'a'. The
+		 * doubles are added in a few running sums at once - so that the
+		 * adds don't all wait on one another - which means they aren't
+		 * added strictly left to right, and the last bit may differ from
+		 * a simple loop.
+		 */
+		static double sum( const double *a, size_t n );
+		static int sum( const int *a, size_t n );
+		/**
+		 * These kernels return the largest (or smallest) of the 'n'
+		 * elements of 'a' - and there has to be at least one.
+		 */
+		static double max( const double *a, size_t n );
+		static int max( const int *a, size_t n );
+		static double min( const double *a, size_t n );
+		static int min( const int *a, size_t n );
+		/**
+		 * These kernels return the sum of 'a[i] * b[i]' for the 'n'
+		 * elements, where the type of 'a' is the type of the answer, and
+		 * 'b' is converted to it just as the multiplies do it.
+		 */
+		static double dot( const double *a, const double *b, size_t n );
+		static double dot( const double *a, const int *b, size_t n );
+		static int dot( const int *a, const int *b, size_t n );
+		static int dot( const int *a, const double *b, size_t n );
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method returns the name of the instruction set that the
+		 * kernels are using on this CPU - "avx2", "sse2", "neon", or
+		 * just "scalar" when the compiler is on it's own.
+		 */
+		static const char *isa();
+};
+}		// end of namespace lkit
+
+#endif		// __LKIT_KERNELS_H
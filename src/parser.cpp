@@ -10,20 +10,41 @@
 
 //	System Headers
 #include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <sstream>
 
 //	Third-Party Headers
+#include <boost/bind/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/unordered_set.hpp>
 
 //	Other Headers
 #include "parser.h"
-#include "base_functions.h"
 #include "expression.h"
+#include "fixed_functions.h"
+#include "program.h"
+#include "util/footprint.h"
+#include "util/pool.h"
 #include "util/timer.h"
 
 //	Forward Declarations
 
 //	Private Constants
+/**
+ * When the source is evaluated on a pool of threads, a sub-expression,
+ * or the definition of a variable, has to be at least this many values
+ * before it's worth running on it's own - anything smaller is left to
+ * whatever uses it.
+ */
+static const size_t	__par_grain = 32;
 
 //	Private Datatypes
 
@@ -33,12 +54,617 @@
 
 /**
  * Make it easy to reference the spinlock and it's scoped lock. They
- * are both in the boost::detail namespace, and it's just going to make
+ * are both in the lkit::util namespace, and it's just going to make
  * the code a little cleaner.
  */
-using namespace boost::detail;
+using lkit::util::spinlock;
 
 namespace lkit {
+/**
+ * The names in the source are looked up in the maps of variables and
+ * functions right out of the source - without making a std::string of
+ * each one - so these hash and compare them just the way the maps do.
+ */
+struct name_hash
+{
+	size_t operator()( const boost::string_ref & aName ) const
+	{
+		return boost::hash_range(aName.begin(), aName.end());
+	}
+};
+
+
+struct name_equal
+{
+	bool operator()( const boost::string_ref & aName, const std::string & aKey ) const
+	{
+		return (aName.compare(boost::string_ref(aKey)) == 0);
+	}
+	bool operator()( const std::string & aKey, const boost::string_ref & aName ) const
+	{
+		return (aName.compare(boost::string_ref(aKey)) == 0);
+	}
+};
+
+
+#ifdef LKIT_PROFILE
+/**
+ * For the profile, we need to find each expression in the trees - once,
+ * even if it's the argument of more than one - and be able to put the
+ * ones with the most time first.
+ */
+static void collectProfile( const expression *anExpr,
+							std::vector<const expression *> & aList,
+							boost::unordered_set<const value *> & aSeen )
+{
+	if ((anExpr != NULL) && aSeen.insert(anExpr).second) {
+		aList.push_back(anExpr);
+		BOOST_FOREACH( const value *v, anExpr->getArgs() ) {
+			if ((v != NULL) && v->isExpression()) {
+				collectProfile((const expression *)v, aList, aSeen);
+			}
+		}
+	}
+}
+
+
+static bool moreTime( const expression *aLeft, const expression *aRight )
+{
+	return (aLeft->getNSec() > aRight->getNSec());
+}
+#endif
+
+
+/**
+ * When the common sub-expressions are shared, the constants, and the
+ * expressions, that are the same are found with these - the hash and
+ * equality of the values themselves, and not their pointers. For the
+ * expressions, that's the function and the arguments, so it's only
+ * right once the arguments have been shared.
+ */
+struct const_hash
+{
+	size_t operator()( const value *aValue ) const
+	{
+		return aValue->hash();
+	}
+};
+
+
+struct const_equal
+{
+	bool operator()( const value *aValue, const value *anOther ) const
+	{
+		// 0.0 and -0.0 are equal, but they don't divide the same
+		return ((*aValue == *anOther) &&
+				(!aValue->isDouble() ||
+				 (signbit(((value *)aValue)->evalAsDouble()) ==
+				  signbit(((value *)anOther)->evalAsDouble()))));
+	}
+};
+
+
+struct expr_hash
+{
+	size_t operator()( const expression *anExpr ) const
+	{
+		return anExpr->hash();
+	}
+};
+
+
+struct expr_equal
+{
+	bool operator()( const expression *anExpr, const expression *anOther ) const
+	{
+		return (*anExpr == *anOther);
+	}
+};
+
+
+/**
+ * This is what we need to keep as we share the common sub-expressions
+ * - the constants and sub-expressions that we own, and can replace,
+ * the one of each that everything the same is replaced with, and what
+ * we've replaced each value with, so each is only done once.
+ */
+struct share_state
+{
+	value_set_t													consts;
+	value_set_t													subs;
+	boost::unordered_set<value *, const_hash, const_equal>		const_table;
+	boost::unordered_set<expression *, expr_hash, expr_equal>	expr_table;
+	value_map_t													shared;
+};
+
+
+static void shareArgs( expression *anExpr, share_state & aState );
+
+/**
+ * This returns the value to use in place of the provided one - the
+ * first of all those that are the same, if it's a constant, or a
+ * sub-expression of a pure function, that we own. The arguments of
+ * an expression - and the definition of a variable - are shared
+ * first, so that the expression can be compared by them.
+ */
+static value *shareValue( value *aValue, share_state & aState )
+{
+	value_map_t::iterator	it = aState.shared.find(aValue);
+	value					*retval = aValue;
+	if (it != aState.shared.end()) {
+		retval = it->second;
+	} else {
+		// mark it first - a variable can refer to itself
+		aState.shared[aValue] = aValue;
+		if (aValue->isVariable()) {
+			value	*def = ((variable *)aValue)->getExpr();
+			if ((def != NULL) && def->isExpression()) {
+				shareArgs((expression *)def, aState);
+			}
+		} else if (aState.consts.find(aValue) != aState.consts.end()) {
+			retval = *aState.const_table.insert(aValue).first;
+		} else if (aValue->isExpression() && (aState.subs.find(aValue) != aState.subs.end())) {
+			expression	*e = (expression *)aValue;
+			shareArgs(e, aState);
+			function	*f = e->getFunction();
+			if ((f != NULL) && f->isPure()) {
+				retval = *aState.expr_table.insert(e).first;
+			}
+		}
+		aState.shared[aValue] = retval;
+	}
+	return retval;
+}
+
+
+/**
+ * This shares each of the arguments of the expression, and puts the
+ * shared ones back in the expression if any have changed.
+ */
+static void shareArgs( expression *anExpr, share_state & aState )
+{
+	bool					changed = false;
+	std::vector<value *>	args = anExpr->getArgs();
+	for (size_t i = 0; i < args.size(); ++i) {
+		value	*v = (args[i] == NULL ? NULL : shareValue(args[i], aState));
+		if (v != args[i]) {
+			args[i] = v;
+			changed = true;
+		}
+	}
+	if (changed) {
+		anExpr->setArgs(args);
+	}
+}
+
+
+/**
+ * The image of a compiled source is a simple run of native-endian
+ * fields - it's meant to be written and read by the same build on
+ * the same kind of machine. These are the magic, version and byte
+ * order at the start of it, so that we know it's one we can read,
+ * and the kinds of nodes in the trees that follow.
+ */
+static const char		__image_magic[] = { 'L', 'K', 'I', 'T' };
+static const uint32_t	__image_version = 1;
+static const uint32_t	__image_order = 0x01020304;
+/**
+ * Every count in the image is checked against what's left of it before
+ * anything is made for that many - each string has it's length, each
+ * root is an ID, each definition a pair of them, and the smallest node,
+ * a variable, is it's kind and the ID of it's name.
+ */
+static const size_t		__image_min_node = sizeof(uint8_t) + sizeof(uint32_t);
+
+enum image_node_t {
+	eImageConst = 0,
+	eImageVariable,
+	eImageExpression,
+};
+
+
+static void putU8( std::string & anImage, uint8_t aValue )
+{
+	anImage.push_back((char)aValue);
+}
+
+
+static void putU32( std::string & anImage, uint32_t aValue )
+{
+	anImage.append((const char *)&aValue, sizeof(aValue));
+}
+
+
+static bool getU8( const char * & aPos, const char *anEnd, uint8_t & aValue )
+{
+	bool	ok = (aPos < anEnd);
+	if (ok) {
+		aValue = (uint8_t)*aPos++;
+	}
+	return ok;
+}
+
+
+static bool getU32( const char * & aPos, const char *anEnd, uint32_t & aValue )
+{
+	bool	ok = ((size_t)(anEnd - aPos) >= sizeof(aValue));
+	if (ok) {
+		memcpy(&aValue, aPos, sizeof(aValue));
+		aPos += sizeof(aValue);
+	}
+	return ok;
+}
+
+
+/**
+ * As the trees are written out, each value gets the ID of the node
+ * it's written as - so a value used in more than one place is only
+ * written once - and each name goes into the table of strings once.
+ * The functions are written by the name they're registered under.
+ */
+struct image_writer
+{
+	image_writer() : node_count(0), string_count(0) { };
+	uint32_t name( const std::string & aName )
+	{
+		boost::unordered_map<std::string, uint32_t>::iterator	it = names.find(aName);
+		if (it == names.end()) {
+			it = names.insert(std::make_pair(aName, string_count++)).first;
+			putU32(strings, (uint32_t)aName.size());
+			strings.append(aName);
+		}
+		return it->second;
+	}
+	std::string										nodes;
+	uint32_t										node_count;
+	std::string										strings;
+	uint32_t										string_count;
+	boost::unordered_map<const value *, uint32_t>	ids;
+	boost::unordered_map<std::string, uint32_t>		names;
+	boost::unordered_map<function *, std::string>	fcns;
+};
+
+
+/**
+ * This writes the constant as a node - the type, and then all eight
+ * bytes of whatever it holds, so they're all the same size.
+ */
+static uint32_t putConst( value & aValue, image_writer & anImage )
+{
+	int8_t		type = value::eBool;
+	uint64_t	bits = 0;
+	if (aValue.isUndefined()) {
+		type = value::eUnknown;
+	} else if (aValue.isInteger()) {
+		type = value::eInt;
+		bits = (uint64_t)(int64_t)aValue.evalAsInt();
+	} else if (aValue.isDouble()) {
+		type = value::eDouble;
+		double	d = aValue.evalAsDouble();
+		memcpy(&bits, &d, sizeof(bits));
+	} else if (aValue.isTime()) {
+		type = value::eTime;
+		bits = aValue.evalAsTime();
+	} else {
+		bits = (aValue.evalAsBool() ? 1 : 0);
+	}
+	putU8(anImage.nodes, eImageConst);
+	putU8(anImage.nodes, (uint8_t)type);
+	anImage.nodes.append((const char *)&bits, sizeof(bits));
+	return anImage.node_count++;
+}
+
+
+/**
+ * This writes the value - and for an expression, all it's arguments
+ * before it - into the image, and puts the ID of it's node in 'anID'.
+ * If there's a function that isn't registered, there's no way to
+ * write it, and 'false' is returned.
+ */
+static bool putNode( value *aValue, image_writer & anImage, uint32_t & anID )
+{
+	bool		error = false;
+	boost::unordered_map<const value *, uint32_t>::iterator	it = anImage.ids.find(aValue);
+	if (aValue == NULL) {
+		error = true;
+	} else if (it != anImage.ids.end()) {
+		anID = it->second;
+	} else if (aValue->isExpression()) {
+		expression	*e = (expression *)aValue;
+		boost::unordered_map<function *, std::string>::iterator	f = anImage.fcns.find(e->getFunction());
+		std::vector<uint32_t>	args;
+		if (f == anImage.fcns.end()) {
+			error = true;
+		}
+		BOOST_FOREACH( value *v, e->getArgs() ) {
+			uint32_t	id = 0;
+			if (error || !putNode(v, anImage, id)) {
+				error = true;
+				break;
+			}
+			args.push_back(id);
+		}
+		if (!error) {
+			putU8(anImage.nodes, eImageExpression);
+			putU32(anImage.nodes, anImage.name(f->second));
+			putU32(anImage.nodes, e->getSpanBegin());
+			putU32(anImage.nodes, e->getSpanEnd());
+			putU32(anImage.nodes, (uint32_t)args.size());
+			BOOST_FOREACH( uint32_t id, args ) {
+				putU32(anImage.nodes, id);
+			}
+			anID = anImage.node_count++;
+		}
+	} else if (aValue->isVariable()) {
+		putU8(anImage.nodes, eImageVariable);
+		putU32(anImage.nodes, anImage.name(((variable *)aValue)->getName()));
+		anID = anImage.node_count++;
+	} else {
+		anID = putConst(*aValue, anImage);
+	}
+	if (!error) {
+		anImage.ids[aValue] = anID;
+	}
+	return !error;
+}
+
+
+/**
+ * This deletes everything in a compiled tree from the compile cache -
+ * the programs, the top-level expressions and the copies of the
+ * variables it sets - and leaves all the lists empty.
+ */
+static void dropTree( expr_list_t & anExpr, prog_list_t & aProgs, std::vector<variable *> & aDefs )
+{
+	BOOST_FOREACH( program *p, aProgs ) {
+		delete p;
+	}
+	aProgs.clear();
+	BOOST_FOREACH( expression *e, anExpr ) {
+		if (e != NULL) {
+			delete e;
+		}
+	}
+	anExpr.clear();
+	BOOST_FOREACH( variable *v, aDefs ) {
+		delete v;
+	}
+	aDefs.clear();
+}
+
+
+/**
+ * When we plan the evaluation of the source on a pool of threads, this
+ * is what we need to know as we walk the trees - the size of each value,
+ * the wave it's ready by, the values that the parser owns, and so can be
+ * held onto, and the ones that are to be run on their own, with their
+ * waves. In bytecode, the programs don't use the cached values of the
+ * sub-expressions, so only the variables are run on their own.
+ */
+struct plan_state {
+	bool										bytecode;
+	boost::unordered_map<const value *, size_t>	sizes;
+	boost::unordered_map<const value *, int>	waves;
+	boost::unordered_set<const value *>			owned;
+	std::vector<std::pair<value *, int> >		tasks;
+};
+
+
+/**
+ * This returns the number of values in the tree for the value - a
+ * sub-expression that's shared is counted each time, as it's just a
+ * guide to how much work it might be.
+ */
+static size_t planSize( value *aValue, plan_state & aState )
+{
+	size_t		sz = 0;
+	if (aValue != NULL) {
+		boost::unordered_map<const value *, size_t>::iterator	it = aState.sizes.find(aValue);
+		if (it != aState.sizes.end()) {
+			sz = it->second;
+		} else {
+			// a variable defined in terms of itself stops here
+			aState.sizes[aValue] = 1;
+			sz = 1;
+			if (aValue->isExpression()) {
+				BOOST_FOREACH( value *v, ((expression *)aValue)->getArgs() ) {
+					sz += planSize(v, aState);
+				}
+			} else if (aValue->isVariable()) {
+				sz += planSize(((variable *)aValue)->getExpr(), aState);
+			}
+			aState.sizes[aValue] = sz;
+		}
+	}
+	return sz;
+}
+
+
+/**
+ * This returns 'true' if the value is one that's worth running on it's
+ * own - it's ours, it's big enough, and it'll keep the answer, so that
+ * whatever uses it doesn't have to do the work again.
+ */
+static bool planAlone( value *aValue, plan_state & aState )
+{
+	bool		alone = false;
+	if ((aValue != NULL) && (aValue->isExpression() || aValue->isVariable()) &&
+		(aState.owned.find(aValue) != aState.owned.end()) && !aValue->isVolatile()) {
+		alone = (planSize(aValue, aState) >= __par_grain);
+	}
+	return alone;
+}
+
+
+/**
+ * This walks the tree for the value, and returns the last wave that any
+ * value under it - or the value itself - that's run on it's own is in,
+ * or -1 if there are none. A value that's run on it's own is in the wave
+ * after the last of the ones it uses. The variables defined by big trees
+ * are run on their own, and if a function has more than one big argument,
+ * they each are. A value that's shared is only looked at the first time.
+ */
+static int planWave( value *aValue, bool aTask, plan_state & aState )
+{
+	int			wave = -1;
+	if (aValue != NULL) {
+		boost::unordered_map<const value *, int>::iterator	it = aState.waves.find(aValue);
+		if (it != aState.waves.end()) {
+			wave = it->second;
+		} else {
+			aState.waves[aValue] = -1;
+			if (aValue->isExpression()) {
+				const std::vector<value *>	& args = ((expression *)aValue)->getArgs();
+				size_t		big = 0;
+				for (size_t i = 0; !aState.bytecode && (i < args.size()); ++i) {
+					if (planAlone(args[i], aState) && !args[i]->isVariable()) {
+						++big;
+					}
+				}
+				BOOST_FOREACH( value *v, args ) {
+					bool	split = ((big > 1) && planAlone(v, aState) && !v->isVariable());
+					wave = std::max(wave, planWave(v, split, aState));
+				}
+			} else if (aValue->isVariable()) {
+				wave = planWave(((variable *)aValue)->getExpr(), false, aState);
+				aTask = planAlone(aValue, aState);
+			}
+			if (aTask) {
+				aState.tasks.push_back(std::make_pair(aValue, ++wave));
+			}
+			aState.waves[aValue] = wave;
+		}
+	}
+	return wave;
+}
+
+
+/**
+ * This is what a subscription uses to know that what it's watching
+ * might have changed - it's a dependent of the variable, or top-level
+ * expression, and when that's marked dirty, so is the watcher. It
+ * doesn't evaluate anything - that waits for the parser's notify(),
+ * so that a lot of changes at once only lead to one evaluation.
+ */
+class watcher :
+	public value
+{
+	public:
+		watcher() :
+			value(),
+			_target(NULL),
+			_pending(false)
+		{
+		}
+
+		virtual ~watcher()
+		{
+			detach();
+		}
+
+		/**
+		 * These methods make the watcher a dependent of the target - and
+		 * no longer one of the last - and note that it needs a look, or
+		 * drop the target altogether.
+		 */
+		void attach( value *aTarget )
+		{
+			detach();
+			{
+				spinlock::scoped_lock	lock(mutex());
+				_target = aTarget;
+				_pending = true;
+			}
+			if (aTarget != NULL) {
+				aTarget->addDependent(this);
+			}
+		}
+
+		void detach()
+		{
+			value		*t = NULL;
+			{
+				spinlock::scoped_lock	lock(mutex());
+				t = _target;
+				_target = NULL;
+			}
+			if (t != NULL) {
+				t->removeDependent(this);
+			}
+		}
+
+		/**
+		 * This method returns what's being watched - NULL if it's gone.
+		 */
+		value *getTarget() const
+		{
+			spinlock::scoped_lock	lock(mutex());
+			return _target;
+		}
+
+		/**
+		 * This method returns 'true' if the target might have changed
+		 * since the last time this was called.
+		 */
+		bool takePending()
+		{
+			spinlock::scoped_lock	lock(mutex());
+			bool	retval = _pending;
+			_pending = false;
+			return retval;
+		}
+
+	protected:
+		/**
+		 * When the target changes, we just note it - there's no one that
+		 * depends on us to tell.
+		 */
+		virtual void markDirty()
+		{
+			spinlock::scoped_lock	lock(mutex());
+			_pending = true;
+		}
+
+		virtual void markDirty( const value *aSource )
+		{
+			markDirty();
+		}
+
+		/**
+		 * When the target is going away, we can't look at it any more.
+		 */
+		virtual void dropDependency( const value *aValue )
+		{
+			spinlock::scoped_lock	lock(mutex());
+			if (_target == aValue) {
+				_target = NULL;
+				_pending = true;
+			}
+		}
+
+	private:
+		// there's no copying a watcher - it's tied to it's target
+		watcher( const watcher & anOther );
+		watcher & operator=( const watcher & anOther );
+
+		value		*_target;
+		bool		_pending;
+};
+
+
+/**
+ * When the parser looks at what it's subscriptions are watching, it
+ * keeps each one that's changed - with the value before and after -
+ * and calls them all once nothing is locked.
+ */
+struct change_note {
+	change_callback_t	callback;
+	int					id;
+	value				was;
+	value				now;
+};
+
+
 /*******************************************************************
  *
  *                     Constructors/Destructor
@@ -53,15 +679,43 @@ namespace lkit {
 parser::parser() :
 	_src(),
 	_src_mutex(),
+	_registry(),
+	_old_regs(),
 	_fcns(),
+	_fcn_table(),
+	_old_fcns(),
 	_fcns_mutex(),
 	_vars(),
+	_var_table(),
+	_old_vars(),
 	_vars_mutex(),
 	_const(),
 	_const_mutex(),
 	_expr(),
 	_subs(),
-	_expr_mutex()
+	_progs(),
+	_bytecode(false),
+	_fast_paths(true),
+	_pool(NULL),
+	_tasks(),
+	_waves(),
+	_answers(),
+	_planned(false),
+	_tree_gen(0),
+	_expr_mutex(),
+	_watches(),
+	_next_watch(0),
+	_watch_mutex(),
+	_cache(),
+	_cache_order(),
+	_cache_size(0),
+	_cache_hits(0),
+	_cache_misses(0),
+	_set_vars(),
+	_defs(),
+	_cols(),
+	_cols_mutex(),
+	_arena()
 {
 	// reset the parser for the star of something neat
 	reset();
@@ -75,15 +729,43 @@ parser::parser() :
 parser::parser( const std::string & aSource ) :
 	_src(aSource),
 	_src_mutex(),
+	_registry(),
+	_old_regs(),
 	_fcns(),
+	_fcn_table(),
+	_old_fcns(),
 	_fcns_mutex(),
 	_vars(),
+	_var_table(),
+	_old_vars(),
 	_vars_mutex(),
 	_const(),
 	_const_mutex(),
 	_expr(),
 	_subs(),
-	_expr_mutex()
+	_progs(),
+	_bytecode(false),
+	_fast_paths(true),
+	_pool(NULL),
+	_tasks(),
+	_waves(),
+	_answers(),
+	_planned(false),
+	_tree_gen(0),
+	_expr_mutex(),
+	_watches(),
+	_next_watch(0),
+	_watch_mutex(),
+	_cache(),
+	_cache_order(),
+	_cache_size(0),
+	_cache_hits(0),
+	_cache_misses(0),
+	_set_vars(),
+	_defs(),
+	_cols(),
+	_cols_mutex(),
+	_arena()
 {
 	// reset the parser for the star of something neat
 	if (reset()) {
@@ -101,15 +783,43 @@ parser::parser( const std::string & aSource ) :
 parser::parser( const parser & anOther ) :
 	_src(),
 	_src_mutex(),
+	_registry(),
+	_old_regs(),
 	_fcns(),
+	_fcn_table(),
+	_old_fcns(),
 	_fcns_mutex(),
 	_vars(),
+	_var_table(),
+	_old_vars(),
 	_vars_mutex(),
 	_const(),
 	_const_mutex(),
 	_expr(),
 	_subs(),
-	_expr_mutex()
+	_progs(),
+	_bytecode(false),
+	_fast_paths(true),
+	_pool(NULL),
+	_tasks(),
+	_waves(),
+	_answers(),
+	_planned(false),
+	_tree_gen(0),
+	_expr_mutex(),
+	_watches(),
+	_next_watch(0),
+	_watch_mutex(),
+	_cache(),
+	_cache_order(),
+	_cache_size(0),
+	_cache_hits(0),
+	_cache_misses(0),
+	_set_vars(),
+	_defs(),
+	_cols(),
+	_cols_mutex(),
+	_arena()
 {
 	// let the '=' operator do the heavy lifting...
 	*this = anOther;
@@ -123,8 +833,12 @@ parser::parser( const parser & anOther ) :
  */
 parser::~parser()
 {
+	// nothing is watching any more
+	clearSubscriptions();
 	// clear out everything we're responsible for
 	clear();
+	// ...and the threads are the last to go
+	useThreads(0);
 }
 
 
@@ -140,6 +854,12 @@ parser & parser::operator=( const parser & anOther )
 		reset();
 		// start with the source for the parser - if there is anything
 		_src = anOther._src;
+		_bytecode = anOther._bytecode;
+		_fast_paths = anOther.usingFastPaths();
+		_cache_size = anOther.getCompileCacheSize();
+		useThreads(anOther.getThreadCount());
+		// ...and the registry of functions is shared, not copied
+		useRegistry(anOther.getRegistry());
 	}
 	return *this;
 }
@@ -158,9 +878,14 @@ parser & parser::operator=( const parser & anOther )
 void parser::setSource( const std::string & aSource )
 {
 	spinlock::scoped_lock		lock(_src_mutex);
+	// hold onto what we have in the cache - if we're using one
+	if (!stashTree(_src)) {
+		// if we have any expressions, then drop them - but save the subs
+		clearExpr(false);
+	}
 	_src = aSource;
-	// if we have any expressions, then drop them - but save the subs
-	clearExpr(false);
+	// ...and if we've seen this source before, there's no compile
+	restoreTree(_src);
 }
 
 
@@ -208,16 +933,22 @@ bool parser::addVariable( const variable & aVariable )
 {
 	bool		error = false;
 
-	spinlock::scoped_lock		lock(_vars_mutex);
-	// see if we already have a variable with this name
+	// most of the time it's there already, and that needs no lock
 	std::string		name = aVariable.getName();
-	variable	*old = _vars[name];
+	variable	*old = _var_table.get(name);
 	if (old != NULL) {
 		// assign the new value to the existing variable
 		*old = aVariable;
 	} else {
-		// place a clone of the variable in the map
-		_vars[name] = (variable *)aVariable.clone();
+		spinlock::scoped_lock		lock(_vars_mutex);
+		// see if someone added it while we were looking
+		if ((old = _vars[name]) != NULL) {
+			*old = aVariable;
+		} else {
+			// place a clone of the variable in the map
+			_vars[name] = (variable *)aVariable.clone();
+			addSlot_nl(name, _vars[name]);
+		}
 	}
 
 	return !error;
@@ -230,18 +961,24 @@ bool parser::addVariable( variable * & aVariable )
 	if (aVariable == NULL) {
 		error = true;
 	} else {
-		spinlock::scoped_lock		lock(_vars_mutex);
-		// see if we already have a variable with this name
+		// most of the time it's there already, and that needs no lock
 		std::string		name = aVariable->getName();
-		variable	*old = _vars[name];
-		if (old != NULL) {
+		variable	*old = _var_table.get(name);
+		if (old == NULL) {
+			spinlock::scoped_lock		lock(_vars_mutex);
+			// see if someone added it while we were looking
+			if ((old = _vars[name]) == NULL) {
+				// place the new variable into the map
+				_vars[name] = aVariable;
+				addSlot_nl(name, aVariable);
+				old = aVariable;
+			}
+		}
+		if (old != aVariable) {
 			// assign the new value to the existing variable
 			*old = *aVariable;
 			delete aVariable;
 			aVariable = old;
-		} else {
-			// place the new variable into the map
-			_vars[name] = aVariable;
 		}
 	}
 	return !error;
@@ -254,19 +991,35 @@ bool parser::addVariable( const std::string & aName, value * & aValue )
 	if (aValue == NULL) {
 		error = true;
 	} else {
-		spinlock::scoped_lock		lock(_vars_mutex);
-		// see if we already have a variable with this name
-		variable	*old = _vars[aName];
-		if (old != NULL) {
+		// most of the time it's there already, and that needs no lock
+		variable	*old = _var_table.get(aName);
+		bool		added = false;
+		if (old == NULL) {
+			spinlock::scoped_lock		lock(_vars_mutex);
+			// see if someone added it while we were looking
+			if ((old = _vars[aName]) == NULL) {
+				// place the new value into the map
+				_vars[aName] = new (_arena) variable(aName, aValue);
+				addSlot_nl(aName, _vars[aName]);
+				added = true;
+			}
+		}
+		if (added) {
+			// the variable has the value now
+		} else if (aValue->isArray()) {
+			// an array can't be copied - so it becomes the variable's value
+			old->set(aValue);
+		} else {
 			// assign the new value to the existing variable
 			*old = *aValue;
 			delete aValue;
 			aValue = old;
-		} else {
-			// place the new value into the map
-			_vars[aName] = new variable(aName, aValue);
 		}
 	}
+	// ...and let anyone watching know what's changed
+	if (!error) {
+		notifyWatchers(false);
+	}
 	return !error;
 }
 
@@ -275,16 +1028,24 @@ bool parser::addVariable( const std::string & aName, const value & aValue )
 {
 	bool		error = false;
 
-	spinlock::scoped_lock		lock(_vars_mutex);
-	// see if we already have a variable with this name
-	variable	*old = _vars[aName];
+	// most of the time it's there already, and that needs no lock
+	variable	*old = _var_table.get(aName);
 	if (old != NULL) {
 		// assign the new value to the existing variable
 		*old = aValue;
 	} else {
-		// place a new variable into the map
-		_vars[aName] = new variable(aName, aValue);
+		spinlock::scoped_lock		lock(_vars_mutex);
+		// see if someone added it while we were looking
+		if ((old = _vars[aName]) != NULL) {
+			*old = aValue;
+		} else {
+			// place a new variable into the map
+			_vars[aName] = new (_arena) variable(aName, aValue);
+			addSlot_nl(aName, _vars[aName]);
+		}
 	}
+	// ...and let anyone watching know what's changed
+	notifyWatchers(false);
 
 	return !error;
 }
@@ -298,15 +1059,8 @@ bool parser::addVariable( const std::string & aName, const value & aValue )
  */
 const value *parser::getVariable( const std::string & aName )
 {
-	value		*retval = NULL;
-	spinlock::scoped_lock		lock(_vars_mutex);
-	// try to find the variable for the provided name
-	var_map_t::iterator	it = _vars.find(aName);
-	if (it != _vars.end()) {
-		retval = it->second;
-	}
-	// return what we might have found
-	return retval;
+	// the table is read without the lock
+	return _var_table.get(aName);
 }
 
 
@@ -320,181 +1074,1509 @@ const value *parser::getVariable( const std::string & aName )
  */
 bool parser::removeVariable( std::string & aName )
 {
-	bool		removed = false;
-	spinlock::scoped_lock		lock(_vars_mutex);
-	// try to find the variable for the provided name
-	var_map_t::iterator	it = _vars.find(aName);
-	if (it != _vars.end()) {
-		if (it->second != NULL) {
-			delete it->second;
+	bool		removed = false;
+	// the cached trees might be using it, so they have to go
+	clearCompileCache();
+	dropPlan();
+	spinlock::scoped_lock		lock(_vars_mutex);
+	// try to find the variable for the provided name
+	var_map_t::iterator	it = _vars.find(aName);
+	if (it != _vars.end()) {
+		if (it->second != NULL) {
+			// ...it can't have a column bound to it any longer
+			spinlock::scoped_lock		lock(_cols_mutex);
+			_cols.erase(it->second);
+			// someone may have just looked it up, so it's kept until the clear
+			_old_vars.push_back(it->second);
+		}
+		// ...and the slot is kept for the name, but it's empty now
+		_var_table.set(_var_table.find(aName), NULL);
+		// NULL or not, we need to remove it from the map
+		_vars.erase(it);
+		removed = true;
+	}
+	return removed;
+}
+
+
+/**
+ * This method simple clears out all the variables in this
+ * parser instance. It's a clean-slate starting point. As the
+ * variables are looked up, and set, without any lock, nothing
+ * else can be using them while this is done.
+ */
+void parser::clearVariables()
+{
+	// the cached trees are using them, so they have to go first
+	clearCompileCache();
+	dropPlan();
+	spinlock::scoped_lock		lock(_vars_mutex);
+	// scan the map and delete everything that's there
+	value		*v = NULL;
+	for (var_map_t::iterator it = _vars.begin(); it != _vars.end(); ++it) {
+		if ((v = it->second) != NULL) {
+			delete v;
+		}
+	}
+	BOOST_FOREACH( variable *old, _old_vars ) {
+		delete old;
+	}
+	// now we can clear out the map as everything is deleted
+	_vars.clear();
+	_old_vars.clear();
+	// ...and the slots are all free to be handed out again
+	_var_table.clear();
+	// ...and none of them can have columns bound to them now
+	clearColumns();
+}
+
+
+/**
+ * This method provides the parser with a series of default
+ * variables for the expressions. These are values most likely
+ * to be used by standard mathematical expressions.
+ */
+void parser::useDefaultVariables()
+{
+	// these are the default variables
+	addVariable("e", 2.71828183);
+	addVariable("pi", 3.14159265);
+}
+
+
+/**
+ * Every variable the parser knows about has a slot - a dense
+ * integer ID handed out as the variable is first seen, which is
+ * most often as the source is compiled. This method returns the
+ * slot of the named variable, or -1 if there's no such variable.
+ * The slot stays with the name until the variables are cleared,
+ * so it can be looked up once, and used for every update.
+ */
+int parser::getVariableSlot( const std::string & aName )
+{
+	int			slot = _var_table.find(aName);
+	// ...it's only a slot for a variable if there's one in it
+	if (_var_table.get(slot) == NULL) {
+		slot = -1;
+	}
+	return slot;
+}
+
+
+/**
+ * This method returns the number of slots that have been handed
+ * out - which is one more than the largest slot.
+ */
+size_t parser::getVariableSlotCount() const
+{
+	return _var_table.size();
+}
+
+
+/**
+ * These methods set the value of the variable in the slot - with
+ * none of the hashing of the name, and looking it up in the map,
+ * that addVariable() has to do. If the slot isn't in use, then
+ * 'false' is returned.
+ */
+bool parser::setVariable( int aSlot, double aValue )
+{
+	bool		error = false;
+	variable	*v = _var_table.get(aSlot);
+	if (v == NULL) {
+		error = true;
+	} else {
+		v->set(aValue);
+	}
+	// ...and let anyone watching know what's changed
+	if (!error) {
+		notifyWatchers(false);
+	}
+	return !error;
+}
+
+
+bool parser::setVariable( int aSlot, int aValue )
+{
+	bool		error = false;
+	variable	*v = _var_table.get(aSlot);
+	if (v == NULL) {
+		error = true;
+	} else {
+		v->set(aValue);
+	}
+	// ...and let anyone watching know what's changed
+	if (!error) {
+		notifyWatchers(false);
+	}
+	return !error;
+}
+
+
+bool parser::setVariable( int aSlot, const value & aValue )
+{
+	bool		error = false;
+	variable	*v = _var_table.get(aSlot);
+	if (v == NULL) {
+		error = true;
+	} else {
+		// this is just what addVariable() does with the value
+		*v = aValue;
+	}
+	// ...and let anyone watching know what's changed
+	if (!error) {
+		notifyWatchers(false);
+	}
+	return !error;
+}
+
+
+/**
+ * This method sets 'aCount' variables at once - the slots, and
+ * their new values, are in the two arrays - so that all the
+ * inputs for a record are set for the cost of one lock. If any
+ * slot isn't in use, the rest are still set, but 'false' is
+ * returned.
+ */
+bool parser::setVariables( const int *aSlots, const double *aValues, size_t aCount )
+{
+	bool		error = false;
+	if ((aCount > 0) && ((aSlots == NULL) || (aValues == NULL))) {
+		error = true;
+	} else {
+		for (size_t i = 0; i < aCount; ++i) {
+			variable	*v = _var_table.get(aSlots[i]);
+			if (v == NULL) {
+				error = true;
+			} else {
+				v->set(aValues[i]);
+			}
+		}
+	}
+	// ...and everyone watching sees all the changes at once
+	notifyWatchers(false);
+	return !error;
+}
+
+
+/**
+ * This method returns the map of known functions for this parser
+ * - those of the registry it uses, with the ones it has of it's
+ * own put over them. The key is the name of the function as it
+ * exists in the source, and the value is the pointer to the
+ * lkit::function that is used. It's a copy, made when it's asked
+ * for, but the functions are the parser's, and the registry's, so
+ * none of them are to be deleted.
+ */
+fcn_map_t parser::getFunctions() const
+{
+	fcn_map_t	ans;
+	spinlock::scoped_lock		lock(_fcns_mutex);
+	if (_registry) {
+		const fcn_map_t		& shared = _registry->getFunctions();
+		for (fcn_map_t::const_iterator it = shared.begin(); it != shared.end(); ++it) {
+			// anything in our table - even removed - is ours to say
+			if (_fcn_table.find(it->first) < 0) {
+				ans.insert(*it);
+			}
+		}
+	}
+	ans.insert(_fcns.begin(), _fcns.end());
+	return ans;
+}
+
+
+/**
+ * This method adds the provided name and function to the list
+ * of functions for this parser. Checks will be made to see if
+ * this name has already been used, and if so, the argument
+ * will replace the existing function in the table. This allows
+ * for custom functionality under the same name in the scripts.
+ *
+ * The memory management of the functions will become the
+ * responsible of the parser, so the caller has to be willing
+ * to relinquish control.
+ */
+bool parser::addFunction( const std::string & aName, function *aFunction )
+{
+	bool		error = false;
+	if (aFunction == NULL) {
+		error = true;
+	} else {
+		spinlock::scoped_lock		lock(_fcns_mutex);
+		// see if we already have a function with this name - ours, or the registry's
+		function	*old = lookUpFunction(aName);
+		if ((old != NULL) && (old != aFunction)) {
+			// the cached trees might be using the old one, so they go too
+			clearCompileCache();
+		}
+		fcn_map_t::iterator	it = _fcns.find(aName);
+		if ((it != _fcns.end()) && (it->second != aFunction)) {
+			// ...and someone may have just looked it up, so it's kept until the clear
+			_old_fcns.push_back(it->second);
+		}
+		// place the new function into the map - over the registry's
+		_fcns[aName] = aFunction;
+		_fcn_table.add(aName, aFunction);
+	}
+	return !error;
+}
+
+
+/**
+ * This method will look to see if the provided function name
+ * is in the list for this parser, and will remove it if so.
+ * If one is removed, this method will return 'true', otherwise,
+ * it will return 'false'.
+ */
+bool parser::removeFunction( const std::string & aName )
+{
+	// the cached trees might be using it, so they have to go
+	clearCompileCache();
+	spinlock::scoped_lock		lock(_fcns_mutex);
+	bool		removed = (lookUpFunction(aName) != NULL);
+	if (removed) {
+		// the name stays in our table with nothing, so it hides the registry's
+		_fcn_table.add(aName, NULL);
+		fcn_map_t::iterator	it = _fcns.find(aName);
+		if (it != _fcns.end()) {
+			// ...and someone may have just looked it up, so it's kept until the clear
+			_old_fcns.push_back(it->second);
+			_fcns.erase(it);
+		}
+	}
+	return removed;
+}
+
+
+/**
+ * This method will remove ALL the known functions from the
+ * table for this parser.
+ */
+void parser::clearFunctions()
+{
+	// the cached trees are using them, so they have to go first
+	clearCompileCache();
+	spinlock::scoped_lock		lock(_fcns_mutex);
+	// scan the map and delete everything that's there
+	function	*f = NULL;
+	for (fcn_map_t::iterator it = _fcns.begin(); it != _fcns.end(); ++it) {
+		if ((f = it->second) != NULL) {
+			delete f;
+		}
+	}
+	BOOST_FOREACH( function *old, _old_fcns ) {
+		delete old;
+	}
+	// now we can clear out the map as everything is deleted
+	_fcns.clear();
+	_old_fcns.clear();
+	_fcn_table.clear();
+	// ...and let go of the registries - the last one out frees them
+	_registry.reset();
+	_old_regs.clear();
+}
+
+
+/**
+ * This method will set up this parser with the DEFAULT functions
+ * for the language. This does not include any user-supplied
+ * functions, but does include the basic functionality of the
+ * language. They are in the one registry of them for the whole
+ * process, so nothing is made, or copied, for the parser.
+ */
+void parser::useDefaultFunctions()
+{
+	useRegistry(registry::getDefaults());
+}
+
+
+/**
+ * These methods set, and return, the registry of functions the
+ * parser uses - shared with all the other parsers using it, and
+ * with the functions of this parser's own put over it. Changing
+ * it, like clearFunctions(), can't be done while anyone else is
+ * using the parser, and the one it replaces is held onto until
+ * then, as the trees might still use it's functions.
+ */
+void parser::useRegistry( const registry::ptr_t & aRegistry )
+{
+	spinlock::scoped_lock		lock(_fcns_mutex);
+	if (_registry != aRegistry) {
+		if (_registry) {
+			// the cached trees might be using the old functions, so they go
+			clearCompileCache();
+			_old_regs.push_back(_registry);
+		}
+		_registry = aRegistry;
+	}
+}
+
+
+registry::ptr_t parser::getRegistry() const
+{
+	spinlock::scoped_lock		lock(_fcns_mutex);
+	return _registry;
+}
+
+
+/**
+ * This method tells the parser to compile each top-level
+ * expression into a flat program of instructions, and use those
+ * for evaluation, rather than walking the language tree. This is
+ * usually a good bit faster for large trees, but it doesn't use
+ * the cached results in the tree - it always does all the work.
+ * The default is to use the language tree.
+ */
+void parser::useBytecode( bool aFlag )
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	_bytecode = aFlag;
+	// if we're not using them, drop any programs we might have
+	if (!_bytecode) {
+		BOOST_FOREACH( program *p, _progs ) {
+			delete p;
+		}
+		_progs.clear();
+	}
+	// ...and what's run on it's own depends on it as well
+	dropPlan_nl();
+}
+
+
+/**
+ * This method returns 'true' if the parser is compiling the
+ * expressions into programs for evaluation.
+ */
+bool parser::usingBytecode() const
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	return _bytecode;
+}
+
+
+/**
+ * This method tells the parser to put a function of a fixed arity
+ * in for the general one wherever it fits when it compiles the
+ * source - a sum or comparison of just two values, or the 'not'
+ * of one - so there's no loop over the arguments, and when they are
+ * both ints, or both doubles, no looking at what kind of values
+ * they are. The answers are the same either way. The default is to
+ * use them, and the change is seen the next time the source is
+ * compiled.
+ */
+void parser::useFastPaths( bool aFlag )
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	_fast_paths = aFlag;
+}
+
+
+/**
+ * This method returns 'true' if the parser is putting the fixed
+ * functions in for the general ones when it compiles the source.
+ */
+bool parser::usingFastPaths() const
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	return _fast_paths;
+}
+
+
+/**
+ * This method tells the parser to evaluate the source on 'aCount'
+ * threads - the caller's, and a pool of the rest. The top-level
+ * expressions are all run at once, and so are the variables the
+ * source sets, and the large sub-expressions that are arguments
+ * of the same function - each one as soon as the ones it uses are
+ * done. They all have to be independent of one another, but for
+ * what they get from the variables, as there's no telling what
+ * order they'll be done in. A count of 0 or 1, the default, is to
+ * evaluate them one after the other, in the order of the source.
+ */
+void parser::useThreads( size_t aCount )
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	dropPlan_nl();
+	if (_pool != NULL) {
+		delete _pool;
+		_pool = NULL;
+	}
+	if (aCount > 1) {
+		_pool = new util::pool(aCount - 1);
+	}
+}
+
+
+/**
+ * This method returns the number of threads that evaluate the
+ * source - 1 if it's done by the caller alone.
+ */
+size_t parser::getThreadCount() const
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	return (_pool == NULL ? 1 : _pool->getThreadCount());
+}
+
+
+/**
+ * These methods bind the named variable to a column of data
+ * for batch evaluation - a contiguous array owned by the caller
+ * that has to stay valid for as long as it's bound, where each
+ * element is the value of the variable for that row. Binding a
+ * variable again replaces the column it had.
+ */
+bool parser::bindColumn( const std::string & aName, const double *aColumn )
+{
+	bool		error = false;
+	if (aColumn == NULL) {
+		error = true;
+	} else {
+		program::column		col = { value::eDouble, aColumn };
+		value				*v = lookUpVariable(aName);
+		spinlock::scoped_lock		lock(_cols_mutex);
+		_cols[v] = col;
+	}
+	return !error;
+}
+
+
+bool parser::bindColumn( const std::string & aName, const int *aColumn )
+{
+	bool		error = false;
+	if (aColumn == NULL) {
+		error = true;
+	} else {
+		program::column		col = { value::eInt, aColumn };
+		value				*v = lookUpVariable(aName);
+		spinlock::scoped_lock		lock(_cols_mutex);
+		_cols[v] = col;
+	}
+	return !error;
+}
+
+
+bool parser::bindColumn( const std::string & aName, const uint64_t *aColumn )
+{
+	bool		error = false;
+	if (aColumn == NULL) {
+		error = true;
+	} else {
+		program::column		col = { value::eTime, aColumn };
+		value				*v = lookUpVariable(aName);
+		spinlock::scoped_lock		lock(_cols_mutex);
+		_cols[v] = col;
+	}
+	return !error;
+}
+
+
+/**
+ * This method drops all the columns that have been bound to the
+ * variables of this parser.
+ */
+void parser::clearColumns()
+{
+	spinlock::scoped_lock		lock(_cols_mutex);
+	_cols.clear();
+}
+
+
+/**
+ * This method tells the parser to keep the compiled language
+ * trees of the last 'aSize' sources it's seen, so that setting
+ * the source back to one of them skips the compile entirely. A
+ * size of zero, the default, turns off the cache and drops all
+ * that's in it.
+ */
+void parser::useCompileCache( size_t aSize )
+{
+	{
+		spinlock::scoped_lock		lock(_expr_mutex);
+		_cache_size = aSize;
+	}
+	// drop whatever doesn't fit any more - or everything if it's off
+	if (aSize == 0) {
+		clearCompileCache();
+	} else {
+		spinlock::scoped_lock		lock(_expr_mutex);
+		while (_cache.size() > _cache_size) {
+			tree_cache_t::iterator	it = _cache.find(_cache_order.back());
+			cached_tree		& t = it->second.first;
+			dropTree(t.expr, t.progs, t.defs);
+			_cache.erase(it);
+			_cache_order.pop_back();
+		}
+	}
+}
+
+
+/**
+ * This method returns the most compiled sources that will be
+ * kept in the cache - zero if it's not being used.
+ */
+size_t parser::getCompileCacheSize() const
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	return _cache_size;
+}
+
+
+/**
+ * These methods return the number of times setting the source
+ * found it in the cache, and the number of times it didn't, so
+ * that the caller can see how well the size is working.
+ */
+uint64_t parser::getCacheHits() const
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	return _cache_hits;
+}
+
+
+uint64_t parser::getCacheMisses() const
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	return _cache_misses;
+}
+
+
+/**
+ * This method drops all the compiled sources in the cache, but
+ * leaves the size, and the counters, as they are.
+ */
+void parser::clearCompileCache()
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	for (tree_cache_t::iterator it = _cache.begin(); it != _cache.end(); ++it) {
+		cached_tree		& t = it->second.first;
+		dropTree(t.expr, t.progs, t.defs);
+	}
+	_cache.clear();
+	_cache_order.clear();
+}
+
+
+/**
+ * This method attempts to compile the source, if there is any, and
+ * it's not already compiled into a language tree, and then evaluates
+ * the final expression, and all sub-expressions and functions to
+ * come up with a final value of the result. Everything is left in
+ * place so that additional evaluations are done as quickly as
+ * possible.
+ */
+value parser::eval()
+{
+	value		v;
+	// make sure it's compiled and ready to go
+	if (compile()) {
+		spinlock::scoped_lock		lock(_expr_mutex);
+		if (_pool != NULL) {
+			// run it all on the threads, and the last one is the answer
+			if (runPlan_nl() && !_answers.empty()) {
+				v = _answers.back();
+			}
+		} else if (_bytecode && !_progs.empty()) {
+			// run each of the compiled programs for the expressions
+			BOOST_FOREACH( program *p, _progs ) {
+				v = p->eval();
+			}
+		} else {
+			// if we have an expression, then eval it for returning
+			BOOST_FOREACH( expression *e, _expr ) {
+				if (e != NULL) {
+					e->eval(v);
+				}
+			}
+		}
+	}
+	return v;
+}
+
+
+/**
+ * This method is just like eval(), but it places the value of
+ * each of the top-level expressions in the results - in the order
+ * of the source - and not just the last one. If the source can't
+ * be compiled, or any of the evaluations throws an exception, this
+ * returns 'false'.
+ */
+bool parser::evalAll( std::vector<value> & aResults )
+{
+	bool		error = false;
+	aResults.clear();
+	// make sure it's compiled and ready to go
+	if (!compile()) {
+		error = true;
+	} else {
+		spinlock::scoped_lock		lock(_expr_mutex);
+		if (_pool != NULL) {
+			error = !runPlan_nl();
+			aResults = _answers;
+		} else {
+			try {
+				if (_bytecode && !_progs.empty()) {
+					BOOST_FOREACH( program *p, _progs ) {
+						aResults.push_back(p->eval());
+					}
+				} else {
+					BOOST_FOREACH( expression *e, _expr ) {
+						if (e != NULL) {
+							aResults.push_back(e->eval());
+						}
+					}
+				}
+			} catch (...) {
+				error = true;
+			}
+		}
+	}
+	return !error;
+}
+
+
+/**
+ * These methods subscribe the callback to the named variable, or
+ * to the top-level expression at 'anIndex' in the source - the
+ * same order as evalAll() - and return the ID of the subscription.
+ * The callback is only called when the value actually changes, and
+ * is given the value before and after. The value when it's made is
+ * where it starts, so nothing is called for that. A variable that
+ * isn't there yet, or an expression past the end of the source, is
+ * undefined until it is - and the subscription to an expression
+ * goes with the source to the expression at that index.
+ */
+int parser::subscribeVariable( const std::string & aName, const change_callback_t & aCallback )
+{
+	subscription	sub;
+	sub.name = aName;
+	sub.index = -1;
+	sub.callback = aCallback;
+	sub.watch = new watcher();
+	sub.gen = 0;
+	// ...find the variable, and start with the value it has now
+	spinlock::scoped_lock		lock(_expr_mutex);
+	spinlock::scoped_lock		wl(_watch_mutex);
+	sub.id = _next_watch++;
+	attach_nl(sub);
+	value	*t = sub.watch->getTarget();
+	if (t != NULL) {
+		sub.watch->takePending();
+		sub.last = t->eval();
+	}
+	_watches.push_back(sub);
+	return sub.id;
+}
+
+
+int parser::subscribeExpr( size_t anIndex, const change_callback_t & aCallback )
+{
+	subscription	sub;
+	sub.index = (int)anIndex;
+	sub.callback = aCallback;
+	sub.watch = new watcher();
+	sub.gen = 0;
+	// the expressions have to be there to watch one of them
+	compile();
+	spinlock::scoped_lock		lock(_expr_mutex);
+	spinlock::scoped_lock		wl(_watch_mutex);
+	sub.id = _next_watch++;
+	attach_nl(sub);
+	value	*t = sub.watch->getTarget();
+	if (t != NULL) {
+		sub.watch->takePending();
+		sub.last = t->eval();
+	}
+	_watches.push_back(sub);
+	return sub.id;
+}
+
+
+/**
+ * These methods drop the subscription with the ID, or all of them,
+ * so that their callbacks won't be called again.
+ */
+bool parser::unsubscribe( int anID )
+{
+	bool		removed = false;
+	spinlock::scoped_lock		lock(_watch_mutex);
+	for (std::vector<subscription>::iterator it = _watches.begin(); it != _watches.end(); ++it) {
+		if (it->id == anID) {
+			delete it->watch;
+			_watches.erase(it);
+			removed = true;
+			break;
+		}
+	}
+	return removed;
+}
+
+
+void parser::clearSubscriptions()
+{
+	spinlock::scoped_lock		lock(_watch_mutex);
+	BOOST_FOREACH( subscription & sub, _watches ) {
+		delete sub.watch;
+	}
+	_watches.clear();
+}
+
+
+/**
+ * This method evaluates all the subscribed variables and expressions
+ * that the changes since the last time might have changed - along
+ * with any that can't be cached - and calls the callbacks of the
+ * ones that did change, and returns how many were called. This is
+ * done for the caller after every change made with addVariable()
+ * or setVariable(), and setVariables() does it just once for all of
+ * them. For changes made right to the values, or to the source, it
+ * needs to be called by the caller - and a new source is compiled
+ * so that it's expressions can be watched. The setters don't compile
+ * it, so until it is, they only look at the variables. The callbacks
+ * are called with nothing locked, and by the thread that made the
+ * change.
+ */
+size_t parser::notify()
+{
+	return notifyWatchers(true);
+}
+
+
+/**
+ * This is the work of notify() - but if it's for one of the changes
+ * made with addVariable() or setVariable(), it doesn't compile a new
+ * source, as that could fail, and the setter would throw. Until it's
+ * compiled, by eval() or the caller's own notify(), the subscriptions
+ * to expressions are left to be looked at then.
+ */
+size_t parser::notifyWatchers( bool aCompile )
+{
+	// most of the time, no one is watching, so get out fast
+	bool		watched = false;
+	{
+		spinlock::scoped_lock		lock(_watch_mutex);
+		watched = !_watches.empty();
+	}
+
+	/**
+	 * Look at each of the subscriptions that might have changed, and
+	 * keep the ones that did - with their old and new values - so that
+	 * the callbacks can be called once nothing is locked.
+	 */
+	std::vector<change_note>	fired;
+	if (watched) {
+		// a new source has to be compiled to see the new expressions
+		if (aCompile) {
+			compile();
+		}
+		spinlock::scoped_lock		lock(_expr_mutex);
+		spinlock::scoped_lock		wl(_watch_mutex);
+		bool	compiled = !_expr.empty();
+		BOOST_FOREACH( subscription & sub, _watches ) {
+			if (!compiled && (sub.index >= 0)) {
+				continue;
+			}
+			attach_nl(sub);
+			value	*t = sub.watch->getTarget();
+			bool	look = sub.watch->takePending();
+			if ((t != NULL) && t->isVolatile()) {
+				look = true;
+			}
+			if (!look) {
+				continue;
+			}
+			value	now;
+			if (t != NULL) {
+				now = t->eval();
+			}
+			if ((now.isUndefined() && sub.last.isUndefined()) || (now == sub.last)) {
+				continue;
+			}
+			change_note		c;
+			c.callback = sub.callback;
+			c.id = sub.id;
+			c.was = sub.last;
+			c.now = now;
+			fired.push_back(c);
+			sub.last = now;
+		}
+	}
+	BOOST_FOREACH( change_note & c, fired ) {
+		c.callback(c.id, c.was, c.now);
+	}
+	return fired.size();
+}
+
+
+/**
+ * This method points the watcher of the subscription at what it's
+ * subscribed to, if it isn't already, and it's there. The caller
+ * has to hold the expression, and subscription, locks.
+ */
+void parser::attach_nl( subscription & aSub )
+{
+	value		*t = aSub.watch->getTarget();
+	if (aSub.index < 0) {
+		// a variable only has to be found if it's never been, or is gone
+		if (t == NULL) {
+			variable	*v = _var_table.get(aSub.name);
+			if (v != NULL) {
+				aSub.watch->attach(v);
+			}
+		}
+	} else if ((t == NULL) || (aSub.gen != _tree_gen)) {
+		// the expression is the one at that index in the current source
+		value	*e = NULL;
+		if ((size_t)aSub.index < _expr.size()) {
+			e = _expr[aSub.index];
+		}
+		if (e != t) {
+			aSub.watch->attach(e);
+		}
+		aSub.gen = _tree_gen;
+	}
+}
+
+
+/**
+ * These methods compile the source, if needed, and then evaluate
+ * it over 'aRows' rows of the bound columns in one call - placing
+ * the value of the final expression for each row in the results.
+ * The expressions are always compiled into programs for this, as
+ * that's what lets us do a block of rows at a time. Variables
+ * that aren't bound keep the one value they have for all rows.
+ */
+bool parser::evalBatch( size_t aRows, std::vector<value> & aResults )
+{
+	bool		error = false;
+	aResults.resize(aRows);
+	// make sure it's compiled and we have programs to run
+	if (!compile()) {
+		error = true;
+	} else {
+		compilePrograms(true);
+	}
+
+	if (!error && (aRows > 0)) {
+		spinlock::scoped_lock		lock(_expr_mutex);
+		spinlock::scoped_lock		cl(_cols_mutex);
+		if (_progs.empty()) {
+			error = true;
+		}
+		// run each of the programs - the last one is what we return
+		BOOST_FOREACH( program *p, _progs ) {
+			if (!p->eval(aRows, _cols, &aResults[0])) {
+				error = true;
+				break;
+			}
+		}
+	}
+	return !error;
+}
+
+
+bool parser::evalBatch( size_t aRows, double *aResults )
+{
+	bool				error = false;
+	std::vector<value>	ans;
+	if ((aResults == NULL) || !evalBatch(aRows, ans)) {
+		error = true;
+	} else {
+		for (size_t r = 0; r < aRows; ++r) {
+			aResults[r] = ans[r].evalAsDouble();
 		}
-		// NULL or not, we need to remove it from the map
-		_vars.erase(it);
-		removed = true;
 	}
-	return removed;
+	return !error;
 }
 
 
 /**
- * This method simple clears out all the variables in this
- * parser instance. It's a clean-slate starting point.
+ * This method compiles the source, if needed, and returns the
+ * program for the final expression - the one whose value eval()
+ * returns - or NULL if there isn't one. The program can then be
+ * run by any number of threads at once, each with it's own
+ * lkit::context, and no locking. It's owned by the parser, and is
+ * only good until the source, variables, or functions change.
  */
-void parser::clearVariables()
+const program *parser::getProgram()
 {
-	spinlock::scoped_lock		lock(_vars_mutex);
-	// scan the map and delete everything that's there
-	value		*v = NULL;
-	for (var_map_t::iterator it = _vars.begin(); it != _vars.end(); ++it) {
-		if ((v = it->second) != NULL) {
-			delete v;
+	const program	*p = NULL;
+	// make sure it's compiled and we have programs to look at
+	if (compile()) {
+		compilePrograms(true);
+		spinlock::scoped_lock		lock(_expr_mutex);
+		if (!_progs.empty()) {
+			p = _progs.back();
 		}
 	}
-	// now we can clear out the map as everything is deleted
-	_vars.clear();
+	return p;
 }
 
 
 /**
- * This method provides the parser with a series of default
- * variables for the expressions. These are values most likely
- * to be used by standard mathematical expressions.
+ * When LKit is built with LKIT_PROFILE, this method returns the
+ * profile of the language tree for the source - one line for each
+ * expression, with the most time first, as comma-separated values:
+ *
+ *   nsec,self_nsec,calls,recalcs,begin,end,"source"
+ *
+ * where 'self_nsec' is the time not spent in the expressions that
+ * are the arguments, and 'begin' and 'end' are the span of the
+ * source it was parsed from. Programs don't use the expressions,
+ * so nothing is counted when using bytecode. Without LKIT_PROFILE
+ * this is just an empty string.
  */
-void parser::useDefaultVariables()
+std::string parser::getProfile() const
 {
-	// these are the default variables
-	addVariable("e", 2.71828183);
-	addVariable("pi", 3.14159265);
+	std::ostringstream	msg;
+#ifdef LKIT_PROFILE
+	spinlock::scoped_lock		lock(_src_mutex);
+	spinlock::scoped_lock		elock(_expr_mutex);
+	// get all the expressions in the trees - just once each
+	std::vector<const expression *>		nodes;
+	boost::unordered_set<const value *>	seen;
+	BOOST_FOREACH( const expression *e, _expr ) {
+		collectProfile(e, nodes, seen);
+	}
+	std::sort(nodes.begin(), nodes.end(), moreTime);
+	// ...and write them out with the most time first
+	msg << "nsec,self_nsec,calls,recalcs,begin,end,source" << std::endl;
+	BOOST_FOREACH( const expression *e, nodes ) {
+		uint64_t	nsec = e->getNSec();
+		uint64_t	inner = 0;
+		BOOST_FOREACH( const value *v, e->getArgs() ) {
+			if ((v != NULL) && v->isExpression()) {
+				inner += ((const expression *)v)->getNSec();
+			}
+		}
+		uint32_t	b = e->getSpanBegin();
+		uint32_t	n = e->getSpanEnd();
+		msg << nsec << "," << (nsec > inner ? nsec - inner : 0) << ","
+			<< e->getCallCount() << "," << e->getRecalcCount() << ","
+			<< b << "," << n << ",\""
+			<< ((b < n) && (n <= _src.size()) ? _src.substr(b, n - b) : std::string())
+			<< "\"" << std::endl;
+	}
+#endif
+	return msg.str();
 }
 
 
 /**
- * This method returns the actual reference to the map of known
- * functions for this parser. Great care should be exercised, as
- * this is the ACTUAL map, and can be modified by other threads
- * so please be careful. The key is the name of the function as
- * it exists in the source, and the value is the pointer to the
- * lkit::function that is used.
+ * This method resets all the counts, and times, in the profile of
+ * the language tree back to 0 - so that we can profile just what
+ * happens after this.
  */
-const fcn_map_t & parser::getFunctions() const
+void parser::resetProfile()
 {
-	return _fcns;
+#ifdef LKIT_PROFILE
+	spinlock::scoped_lock		lock(_expr_mutex);
+	std::vector<const expression *>		nodes;
+	boost::unordered_set<const value *>	seen;
+	BOOST_FOREACH( const expression *e, _expr ) {
+		collectProfile(e, nodes, seen);
+	}
+	BOOST_FOREACH( const expression *e, nodes ) {
+		((expression *)e)->resetProfile();
+	}
+#endif
 }
 
 
 /**
- * This method adds the provided name and function to the list
- * of functions for this parser. Checks will be made to see if
- * this name has already been used, and if so, the argument
- * will replace the existing function in the table. This allows
- * for custom functionality under the same name in the scripts.
+ * This method returns the memory the parser is using, and what
+ * for, as comma-separated values - one line for each kind of thing
+ * it holds, and then the total:
  *
- * The memory management of the functions will become the
- * responsible of the parser, so the caller has to be willing
- * to relinquish control.
+ *   kind,count,bytes,overhead
+ *
+ * 'bytes' is what all those things asked for - themselves, and their
+ * names and lists - and 'overhead' is what the allocators used on
+ * top of that. The 'arena' line is the chunks it has, and what in
+ * them isn't being used, and it's chunks aren't in the total count.
+ * The 'registry' line, after the total, is the functions, and table,
+ * of the registry - shared by all the parsers using it, so it's not
+ * part of the total for this one.
  */
-bool parser::addFunction( const std::string & aName, function *aFunction )
+std::string parser::getMemoryUsage() const
 {
-	bool		error = false;
-	if (aFunction == NULL) {
-		error = true;
-	} else {
+	util::footprint		self;
+	util::footprint		exprs;
+	util::footprint		subs;
+	util::footprint		consts;
+	util::footprint		vars;
+	util::footprint		fcns;
+	util::footprint		cache;
+	util::footprint		tables;
+	util::footprint		shared;
+	// the parser itself is wherever the caller put it
+	self.addObject(sizeof(parser), 0);
+	{
+		spinlock::scoped_lock		lock(_src_mutex);
+		self.addString(_src);
+	}
+	// the trees - the current ones, and those in the cache
+	{
+		spinlock::scoped_lock		lock(_expr_mutex);
+		BOOST_FOREACH( const expression *e, _expr ) {
+			value::addAllocation(e, exprs);
+		}
+		exprs.addList(_expr);
+		BOOST_FOREACH( const expression *e, _subs ) {
+			value::addAllocation(e, subs);
+		}
+		subs.addList(_subs);
+		for (tree_cache_t::const_iterator it = _cache.begin(); it != _cache.end(); ++it) {
+			BOOST_FOREACH( const expression *e, it->second.first.expr ) {
+				value::addAllocation(e, cache);
+			}
+			cache.addList(it->second.first.expr);
+			cache.addString(it->first);
+		}
+		cache.addMap(_cache);
+	}
+	{
+		spinlock::scoped_lock		lock(_const_mutex);
+		BOOST_FOREACH( const value *v, _const ) {
+			value::addAllocation(v, consts);
+		}
+		consts.addList(_const);
+	}
+	// the variables, and functions, with the hashes and tables they're in
+	{
+		spinlock::scoped_lock		lock(_vars_mutex);
+		for (var_map_t::const_iterator it = _vars.begin(); it != _vars.end(); ++it) {
+			value::addAllocation(it->second, vars);
+			vars.addString(it->first);
+		}
+		BOOST_FOREACH( const variable *v, _old_vars ) {
+			value::addAllocation(v, vars);
+		}
+		vars.addMap(_vars);
+		vars.addList(_old_vars);
+		_var_table.addFootprint(tables);
+	}
+	{
 		spinlock::scoped_lock		lock(_fcns_mutex);
-		// see if we already have a function with this name
-		function	*old = _fcns[aName];
-		if (old != NULL) {
-			delete old;
-			old = NULL;
+		boost::unordered_set<const function *>	seen;
+		for (fcn_map_t::const_iterator it = _fcns.begin(); it != _fcns.end(); ++it) {
+			seen.insert(it->second);
+			fcns.addString(it->first);
+		}
+		seen.insert(_old_fcns.begin(), _old_fcns.end());
+		seen.erase((const function *)NULL);
+		for (size_t i = 0; i < seen.size(); ++i) {
+			fcns.addObject(sizeof(function), util::footprint::heapBlock(sizeof(function)) - sizeof(function));
+		}
+		fcns.addMap(_fcns);
+		fcns.addList(_old_fcns);
+		_fcn_table.addFootprint(tables);
+		// the registries are shared, so they're on their own
+		if (_registry) {
+			_registry->addFootprint(shared);
+		}
+		BOOST_FOREACH( const registry::ptr_t & r, _old_regs ) {
+			r->addFootprint(shared);
 		}
-		// place the new function into the map
-		_fcns[aName] = aFunction;
 	}
-	return !error;
+	// ...and whatever's in the arena that isn't being used
+	size_t		reserved = _arena.getBytesReserved();
+	size_t		used = _arena.getBytesInUse();
+	util::footprint		total;
+	total += self;
+	total += exprs;
+	total += subs;
+	total += consts;
+	total += vars;
+	total += fcns;
+	total += cache;
+	total += tables;
+	total.addOverhead(reserved > used ? reserved - used : 0);
+
+	std::ostringstream	msg;
+	msg << "kind,count,bytes,overhead" << std::endl
+		<< "parser," << self.getCount() << "," << self.getBytes() << "," << self.getOverhead() << std::endl
+		<< "expressions," << exprs.getCount() << "," << exprs.getBytes() << "," << exprs.getOverhead() << std::endl
+		<< "subexpressions," << subs.getCount() << "," << subs.getBytes() << "," << subs.getOverhead() << std::endl
+		<< "constants," << consts.getCount() << "," << consts.getBytes() << "," << consts.getOverhead() << std::endl
+		<< "variables," << vars.getCount() << "," << vars.getBytes() << "," << vars.getOverhead() << std::endl
+		<< "functions," << fcns.getCount() << "," << fcns.getBytes() << "," << fcns.getOverhead() << std::endl
+		<< "cache," << cache.getCount() << "," << cache.getBytes() << "," << cache.getOverhead() << std::endl
+		<< "tables," << tables.getCount() << "," << tables.getBytes() << "," << tables.getOverhead() << std::endl
+		<< "arena," << _arena.getChunkCount() << ",0," << (reserved > used ? reserved - used : 0) << std::endl
+		<< "total," << total.getCount() << "," << total.getBytes() << "," << total.getOverhead() << std::endl
+		<< "registry," << shared.getCount() << "," << shared.getBytes() << "," << shared.getOverhead() << std::endl;
+	return msg.str();
 }
 
 
 /**
- * This method will look to see if the provided function name
- * is in the list for this parser, and will remove it if so.
- * If one is removed, this method will return 'true', otherwise,
- * it will return 'false'.
+ * This method compiles the source, if needed, and returns an image
+ * of the compiled language trees - the constants, the variables and
+ * functions they use, by name, the expressions, and the variables
+ * the source sets - with the source itself. Given to setImage() it
+ * rebuilds the same trees without any of the work of the compile. If
+ * there's nothing that can be written, this returns an empty string.
  */
-bool parser::removeFunction( const std::string & aName )
+std::string parser::getImage()
 {
-	spinlock::scoped_lock		lock(_fcns_mutex);
-	// based on how many are erased, return the right flag
-	return (_fcns.erase(aName) > 0);
+	bool			error = !compile();
+	std::string		image;
+	image_writer	w;
+
+	// the functions are written by the names they're registered under
+	if (!error) {
+		fcn_map_t	all = getFunctions();
+		for (fcn_map_t::const_iterator it = all.begin(); it != all.end(); ++it) {
+			if (it->second != NULL) {
+				w.fcns[it->second] = it->first;
+			}
+		}
+	}
+
+	/**
+	 * Each of the top-level expressions is a root of the trees, and
+	 * each variable the source sets is a name and the root of it's
+	 * definition. They all go out as the IDs of their nodes.
+	 */
+	std::string		roots;
+	std::string		defs;
+	std::string		src;
+	if (!error) {
+		spinlock::scoped_lock		lock(_src_mutex);
+		spinlock::scoped_lock		el(_expr_mutex);
+		src = _src;
+		uint32_t	id = 0;
+		BOOST_FOREACH( expression *e, _expr ) {
+			if (!putNode(e, w, id)) {
+				error = true;
+				break;
+			}
+			putU32(roots, id);
+		}
+		BOOST_FOREACH( variable *v, _defs ) {
+			value	*d = (error ? NULL : v->getExpr());
+			if (error) {
+				break;
+			} else if (d == NULL) {
+				// it's been set to a simple value - so that's the definition
+				id = putConst(*v, w);
+			} else if (d->isVariable() || !putNode(d, w, id)) {
+				error = true;
+				break;
+			}
+			putU32(defs, w.name(v->getName()));
+			putU32(defs, id);
+		}
+	}
+
+	// now we can put it all together - header first
+	if (!error) {
+		image.append(__image_magic, sizeof(__image_magic));
+		putU32(image, __image_version);
+		putU32(image, __image_order);
+		putU32(image, (uint32_t)src.size());
+		image.append(src);
+		putU32(image, w.string_count);
+		image.append(w.strings);
+		putU32(image, (uint32_t)(roots.size() / sizeof(uint32_t)));
+		image.append(roots);
+		putU32(image, (uint32_t)(defs.size() / (2 * sizeof(uint32_t))));
+		image.append(defs);
+		putU32(image, w.node_count);
+		image.append(w.nodes);
+	}
+	return image;
 }
 
 
 /**
- * This method will remove ALL the known functions from the
- * table for this parser.
+ * These methods take an image from getImage() - possibly from a
+ * different parser, in a different process - and make it's source
+ * and language trees the current ones, just as if the source had
+ * been set and compiled. The image is only read, and not kept, so
+ * it can be right in a file mapped into memory. The functions and
+ * variables are looked up by name, so the functions have to be
+ * defined before this is called. If the image is malformed, or a
+ * function is missing, 'false' is returned - and the source in it,
+ * if there was one, will be compiled as usual on the next eval().
  */
-void parser::clearFunctions()
+bool parser::setImage( const char *anImage, size_t aSize )
 {
-	spinlock::scoped_lock		lock(_fcns_mutex);
-	// scan the map and delete everything that's there
-	function	*f = NULL;
-	for (fcn_map_t::iterator it = _fcns.begin(); it != _fcns.end(); ++it) {
-		if ((f = it->second) != NULL) {
-			delete f;
+	bool		error = false;
+	const char	*pos = anImage;
+	const char	*end = anImage + aSize;
+	uint32_t	version = 0;
+	uint32_t	order = 0;
+	uint32_t	len = 0;
+	const char	*src = NULL;
+	uint32_t	srcLen = 0;
+
+	// first, make sure it's one of ours, and we can read it
+	if ((anImage == NULL) || (aSize < sizeof(__image_magic)) ||
+		(memcmp(pos, __image_magic, sizeof(__image_magic)) != 0)) {
+		error = true;
+	} else {
+		pos += sizeof(__image_magic);
+	}
+	if (!error && (!getU32(pos, end, version) || (version != __image_version) ||
+				   !getU32(pos, end, order) || (order != __image_order))) {
+		error = true;
+	}
+	if (!error && (!getU32(pos, end, srcLen) || ((size_t)(end - pos) < srcLen))) {
+		error = true;
+	} else if (!error) {
+		src = pos;
+		pos += srcLen;
+	}
+
+	/**
+	 * The names are used right out of the image, and the IDs of the
+	 * roots and definitions are all we need to hold onto.
+	 */
+	uint32_t						cnt = 0;
+	std::vector<boost::string_ref>	names;
+	if (!error && (!getU32(pos, end, cnt) || (cnt > (size_t)(end - pos) / sizeof(uint32_t)))) {
+		error = true;
+	}
+	for (uint32_t i = 0; !error && (i < cnt); ++i) {
+		if (!getU32(pos, end, len) || ((size_t)(end - pos) < len)) {
+			error = true;
+		} else {
+			names.push_back(boost::string_ref(pos, len));
+			pos += len;
 		}
 	}
-	// now we can clear out the map as everything is deleted
-	_fcns.clear();
+	std::vector<uint32_t>	roots;
+	if (!error && (!getU32(pos, end, cnt) || (cnt > (size_t)(end - pos) / sizeof(uint32_t)))) {
+		error = true;
+	}
+	for (uint32_t i = 0; !error && (i < cnt); ++i) {
+		roots.push_back(0);
+		error = !getU32(pos, end, roots.back());
+	}
+	std::vector<std::pair<uint32_t, uint32_t> >	defs;
+	if (!error && (!getU32(pos, end, cnt) || (cnt > (size_t)(end - pos) / (2 * sizeof(uint32_t))))) {
+		error = true;
+	}
+	for (uint32_t i = 0; !error && (i < cnt); ++i) {
+		defs.push_back(std::make_pair(0, 0));
+		error = (!getU32(pos, end, defs.back().first) ||
+				 !getU32(pos, end, defs.back().second) ||
+				 (defs.back().first >= names.size()));
+	}
+	uint32_t	count = 0;
+	if (!error && (!getU32(pos, end, count) || (count > (size_t)(end - pos) / __image_min_node))) {
+		error = true;
+	}
+	// the roots, and the definitions, are owned by the parser and variables
+	std::vector<bool>	owned(error ? 0 : count, false);
+	BOOST_FOREACH( uint32_t id, roots ) {
+		if (error || (id >= count) || owned[id]) {
+			error = true;
+			break;
+		}
+		owned[id] = true;
+	}
+	for (size_t i = 0; !error && (i < defs.size()); ++i) {
+		if ((defs[i].second >= count) || owned[defs[i].second]) {
+			error = true;
+		} else {
+			owned[defs[i].second] = true;
+		}
+	}
+
+	// make sure they don't change the source while we work...
+	spinlock::scoped_lock		lock(_src_mutex);
+	if (src != NULL) {
+		// this is just like setting the source - but without the compile
+		if (!stashTree(_src)) {
+			clearExpr(false);
+		}
+		_src.assign(src, srcLen);
+	}
+
+	/**
+	 * Now we can build the nodes - every argument of an expression is
+	 * before it, so they're all there by the time we get to it. Just
+	 * as in the compile, the constants and sub-expressions go in the
+	 * parser's lists, and the roots are held onto until the end.
+	 */
+	std::vector<value *>	nodes;
+	nodes.reserve(error ? 0 : count);
+	std::vector<value *>	args;
+	for (uint32_t i = 0; !error && (i < count); ++i) {
+		uint8_t		kind = 0;
+		value		*v = NULL;
+		if (!getU8(pos, end, kind)) {
+			error = true;
+		} else if (kind == eImageConst) {
+			uint8_t		type = 0;
+			uint64_t	bits = 0;
+			if (!getU8(pos, end, type) || ((size_t)(end - pos) < sizeof(bits))) {
+				error = true;
+			} else {
+				memcpy(&bits, pos, sizeof(bits));
+				pos += sizeof(bits);
+				double	d = 0.0;
+				switch ((int8_t)type) {
+					case value::eBool:
+						v = new (_arena) value(bits != 0);
+						break;
+					case value::eInt:
+						v = new (_arena) value((int)(int64_t)bits);
+						break;
+					case value::eDouble:
+						memcpy(&d, &bits, sizeof(d));
+						v = new (_arena) value(d);
+						break;
+					case value::eTime:
+						v = new (_arena) value(bits);
+						break;
+					default:
+						v = new (_arena) value();
+						break;
+				}
+				// a definition belongs to it's variable, not the parser
+				if (!owned[i]) {
+					addConst(v);
+				}
+			}
+		} else if (kind == eImageVariable) {
+			if (!getU32(pos, end, len) || (len >= names.size()) || owned[i]) {
+				error = true;
+			} else {
+				v = lookUpVariable(names[len]);
+			}
+		} else if (kind == eImageExpression) {
+			uint32_t	fcn = 0;
+			uint32_t	begin = 0;
+			uint32_t	finish = 0;
+			uint32_t	argc = 0;
+			function	*f = NULL;
+			if (!getU32(pos, end, fcn) || (fcn >= names.size()) ||
+				!getU32(pos, end, begin) || !getU32(pos, end, finish) ||
+				!getU32(pos, end, argc) || ((f = lookUpFunction(names[fcn])) == NULL)) {
+				error = true;
+			}
+			args.clear();
+			for (uint32_t a = 0; !error && (a < argc); ++a) {
+				uint32_t	id = 0;
+				if (!getU32(pos, end, id) || (id >= i) || owned[id]) {
+					error = true;
+				} else {
+					args.push_back(nodes[id]);
+				}
+			}
+			if (!error) {
+				expression	*e = new (_arena) expression();
+				e->setFunction(f);
+				e->addToArgs(args);
+				e->setSpan(begin, finish);
+				if (!owned[i]) {
+					addSubExpr(e);
+				}
+				v = e;
+			}
+		} else {
+			error = true;
+		}
+		nodes.push_back(v);
+	}
+	for (size_t i = 0; !error && (i < roots.size()); ++i) {
+		if (!nodes[roots[i]]->isExpression()) {
+			error = true;
+		}
+	}
+
+	/**
+	 * If it all came through, the variables the source sets are set,
+	 * and the roots become the top-level expressions - otherwise, the
+	 * roots and definitions we made have to go, as nothing else will
+	 * clean them up.
+	 */
+	if (!error) {
+		std::vector<variable *>		vars;
+		for (size_t i = 0; i < defs.size(); ++i) {
+			variable	*v = new (_arena) variable(std::string(names[defs[i].first].data(),
+																names[defs[i].first].size()));
+			v->set(nodes[defs[i].second]);
+			vars.push_back(v);
+		}
+		BOOST_FOREACH( uint32_t id, roots ) {
+			addExpr((expression *)nodes[id]);
+		}
+		// ...the copies for the cache have to have the fast paths as well
+		useFixedFunctions(vars);
+		BOOST_FOREACH( variable *v, vars ) {
+			addVariable(v);
+			spinlock::scoped_lock		el(_expr_mutex);
+			_defs.push_back((variable *)v->clone());
+		}
+		compilePrograms();
+	} else if (!nodes.empty()) {
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			if (owned[i] && (nodes[i] != NULL)) {
+				delete nodes[i];
+			}
+		}
+		clearCompileCache();
+		clearExpr();
+	}
+	return !error;
 }
 
 
-/**
- * This method will set up this parser with the DEFAULT functions
- * for the language. This does not include any user-supplied
- * functions, but does include the basic functionality of the
- * language.
- */
-void parser::useDefaultFunctions()
+bool parser::setImage( const std::string & anImage )
 {
-	// these are the default functions
-	addFunction("max", new func::max());
-	addFunction("min", new func::min());
-	addFunction("+", new func::sum());
-	addFunction("-", new func::diff());
-	addFunction("*", new func::prod());
-	addFunction("/", new func::quot());
-	addFunction("==", new func::comp(func::comp::eEquals));
-	addFunction("!=", new func::comp(func::comp::eNotEquals));
-	addFunction("<", new func::comp(func::comp::eLessThan));
-	addFunction(">", new func::comp(func::comp::eGreaterThan));
-	addFunction("<=", new func::comp(func::comp::eLessOrEqual));
-	addFunction(">=", new func::comp(func::comp::eGreaterOrEqual));
-	addFunction("and", new func::bin(func::bin::eAnd));
-	addFunction("or", new func::bin(func::bin::eOr));
-	addFunction("not", new func::bin(func::bin::eNot));
+	return setImage(anImage.data(), anImage.size());
 }
 
 
 /**
- * This method attempts to compile the source, if there is any, and
- * it's not already compiled into a language tree, and then evaluates
- * the final expression, and all sub-expressions and functions to
- * come up with a final value of the result. Everything is left in
- * place so that additional evaluations are done as quickly as
- * possible.
+ * These methods write the image of the compiled source to a file,
+ * and read it back - the file is mapped into memory, and the image
+ * is read right out of it, so there's no copy of it made first.
  */
-value parser::eval()
+bool parser::saveImage( const std::string & aFile )
 {
-	value		v;
-	// make sure it's compiled and ready to go
-	if (compile()) {
-		spinlock::scoped_lock		lock(_expr_mutex);
-		// if we have an expression, then eval it for returning
-		BOOST_FOREACH( expression *e, _expr ) {
-			if (e != NULL) {
-				v = e->eval();
-			}
+	bool		error = false;
+	std::string	image = getImage();
+	FILE		*fp = NULL;
+	if (image.empty() || ((fp = fopen(aFile.c_str(), "wb")) == NULL)) {
+		error = true;
+	} else {
+		if (fwrite(image.data(), 1, image.size(), fp) != image.size()) {
+			error = true;
+		}
+		if (fclose(fp) != 0) {
+			error = true;
 		}
 	}
-	return v;
+	return !error;
+}
+
+
+bool parser::loadImage( const std::string & aFile )
+{
+	bool		error = false;
+	int			fd = open(aFile.c_str(), O_RDONLY);
+	struct stat	st;
+	void		*map = MAP_FAILED;
+	if ((fd < 0) || (fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+		error = true;
+	} else if ((map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		error = true;
+	} else {
+		error = !setImage((const char *)map, (size_t)st.st_size);
+	}
+	if (map != MAP_FAILED) {
+		munmap(map, st.st_size);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	return !error;
 }
 
 
@@ -514,6 +2596,11 @@ void parser::clear()
 	clearFunctions();
 	clearConsts();
 	clearExpr();
+	/**
+	 * Everything we allocated for the language trees is gone now, so
+	 * all the memory for them can go back to the heap in one shot.
+	 */
+	_arena.release();
 }
 
 
@@ -584,8 +2671,8 @@ size_t parser::hash() const
 		}
 	}
 	{
-		spinlock::scoped_lock	lock(_fcns_mutex);
-		BOOST_FOREACH( fcn_map_t::value_type i, _fcns ) {
+		fcn_map_t	all = getFunctions();
+		BOOST_FOREACH( fcn_map_t::value_type i, all ) {
 			if (i.second != NULL) {
 				boost::hash_combine(ans, i.first);
 				boost::hash_combine(ans, i.second->hash());
@@ -695,16 +2782,17 @@ bool parser::operator==( const parser & anOther ) const
 	// next, let's check the functions...
 	if (keepChecking) {
 		fcn_map_t::const_iterator	it;
-		spinlock::scoped_lock	lock(_fcns_mutex);
+		fcn_map_t					mine = getFunctions();
+		fcn_map_t					theirs = anOther.getFunctions();
 		// check to make sure the number of functions match...
-		if (_fcns.size() != anOther._fcns.size()) {
+		if (mine.size() != theirs.size()) {
 			equals = false;
 			keepChecking = false;
 		} else {
 			// then look up each to make sure it matches
-			BOOST_FOREACH( fcn_map_t::value_type i, _fcns ) {
+			BOOST_FOREACH( fcn_map_t::value_type i, mine ) {
 				// try to find the function in the 'other' guy...
-				if ((it = anOther._fcns.find(i.first)) == anOther._fcns.end()) {
+				if ((it = theirs.find(i.first)) == theirs.end()) {
 					equals = false;
 					keepChecking = false;
 					break;
@@ -763,25 +2851,47 @@ bool parser::operator!=( const parser & anOther ) const
  * a location for one in the map, and it'll be up to the caller to
  * assign a value to that variable before evaluation starts.
  */
-value *parser::lookUpVariable( const std::string & aName )
+value *parser::lookUpVariable( const boost::string_ref & aName )
 {
-	// lock this map up so we can see what's there safely
-	spinlock::scoped_lock		lock(_vars_mutex);
-	// see if we already have a variable with this name
-	variable	*v = _vars[aName];
+	// most of the time it's there already, and that needs no lock
+	variable	*v = _var_table.get(aName);
 	if (v == NULL) {
-		// create it with the right variable name
-		if ((v = new variable(aName)) == NULL) {
-			throw std::runtime_error("[parser::lookUpVariable] unable to create new placeholder variable for provided name");
+		// lock this map up so we can add it safely
+		spinlock::scoped_lock		lock(_vars_mutex);
+		// see if someone added it while we were looking
+		var_map_t::iterator		it = _vars.find(aName, name_hash(), name_equal());
+		if (it != _vars.end()) {
+			v = it->second;
+		}
+		if (v == NULL) {
+			// only a new name is worth the copy into a string
+			std::string		name(aName.data(), aName.size());
+			// create it with the right variable name
+			if ((v = new (_arena) variable(name)) == NULL) {
+				throw std::runtime_error("[parser::lookUpVariable] unable to create new placeholder variable for provided name");
+			}
+			// place the new variable into the map
+			_vars[name] = v;
+			addSlot_nl(name, v);
 		}
-		// place the new variable into the map
-		_vars[aName] = v;
 	}
 	// return what we have now
 	return v;
 }
 
 
+/**
+ * This method gives the variable the slot for it's name - a new
+ * one if the name hasn't been seen before - so that it can be set
+ * by slot. The "_nl" means the caller has to hold the lock on the
+ * variables.
+ */
+void parser::addSlot_nl( const std::string & aName, variable *aVariable )
+{
+	_var_table.add(aName, aVariable);
+}
+
+
 /**
  * This method looks to the map of all functions we know about in
  * this parser instance and will attempt to find the one registered
@@ -790,18 +2900,17 @@ value *parser::lookUpVariable( const std::string & aName )
  * NULL and that should be the sign of an error. Functions have to
  * be defined prior to parsing of the code.
  */
-function *parser::lookUpFunction( const std::string & aName )
+function *parser::lookUpFunction( const boost::string_ref & aName )
 {
-	// lock this map up so we can see what's there safely
-	spinlock::scoped_lock		lock(_fcns_mutex);
-	// see if we have a function with this name
-	function	*f = NULL;
-	fcn_map_t::const_iterator	it = _fcns.find(aName);
-	if (it != _fcns.end()) {
-		f = it->second;
+	function	*ans = NULL;
+	// our own table is read without the lock - and then the registry's
+	int			slot = _fcn_table.find(aName);
+	if (slot >= 0) {
+		ans = _fcn_table.get(slot);
+	} else if (_registry) {
+		ans = _registry->lookUp(aName);
 	}
-	// return what we have now
-	return f;
+	return ans;
 }
 
 
@@ -889,6 +2998,8 @@ bool parser::addExpr( expression *anExpression )
 {
 	spinlock::scoped_lock		lock(_expr_mutex);
 	_expr.push_back(anExpression);
+	dropPlan_nl();
+	++_tree_gen;
 	return true;
 }
 
@@ -931,6 +3042,15 @@ void parser::clearExpr( bool includeSubExpr )
 		_subs.clear();
 	}
 
+	/**
+	 * Any programs compiled from the top-level expressions are now out
+	 * of date as well, so they need to go.
+	 */
+	BOOST_FOREACH( program *p, _progs ) {
+		delete p;
+	}
+	_progs.clear();
+
 	/**
 	 * Next, delete the top-level expressions as they too, need to
 	 * go as we don't want to leak.
@@ -942,6 +3062,15 @@ void parser::clearExpr( bool includeSubExpr )
 	}
 	// now we can clear out the list as everything is deleted
 	_expr.clear();
+	// ...and nothing in the plan, or watched, is there any more
+	dropPlan_nl();
+	++_tree_gen;
+
+	// ...and the copies of the variables it set go with them
+	BOOST_FOREACH( variable *v, _defs ) {
+		delete v;
+	}
+	_defs.clear();
 }
 
 
@@ -958,6 +3087,210 @@ bool parser::isCompiled()
 }
 
 
+/**
+ * This method compiles each of the top-level expressions into a
+ * program, if we're using bytecode - or we're told to - and we
+ * haven't done it already.
+ */
+void parser::compilePrograms( bool aForce )
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	if ((_bytecode || aForce) && _progs.empty()) {
+		BOOST_FOREACH( expression *e, _expr ) {
+			if (e != NULL) {
+				_progs.push_back(new program(e));
+			}
+		}
+		dropPlan_nl();
+	}
+}
+
+
+/**
+ * If we're using the compile cache, this method moves the
+ * compiled trees for the current source into the cache, and
+ * returns 'true'. If not, it returns 'false' and leaves it all
+ * as it is. It's the caller's job to lock the source.
+ */
+bool parser::stashTree( const std::string & aSource )
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	bool		stashed = false;
+	if ((_cache_size > 0) && !_expr.empty() && !aSource.empty()) {
+		// if there's an old one for this source, this replaces it
+		tree_cache_t::iterator	it = _cache.find(aSource);
+		if (it != _cache.end()) {
+			cached_tree		& t = it->second.first;
+			dropTree(t.expr, t.progs, t.defs);
+			_cache_order.erase(it->second.second);
+			_cache.erase(it);
+		}
+		// the newest is at the front of the list
+		_cache_order.push_front(aSource);
+		std::pair<cached_tree, source_list_t::iterator>	& slot = _cache[aSource];
+		slot.first.expr.swap(_expr);
+		slot.first.progs.swap(_progs);
+		slot.first.defs.swap(_defs);
+		slot.second = _cache_order.begin();
+		dropPlan_nl();
+		++_tree_gen;
+		// ...and the oldest goes if there's no room left
+		while (_cache.size() > _cache_size) {
+			tree_cache_t::iterator	old = _cache.find(_cache_order.back());
+			cached_tree		& t = old->second.first;
+			dropTree(t.expr, t.progs, t.defs);
+			_cache.erase(old);
+			_cache_order.pop_back();
+		}
+		stashed = true;
+	}
+	return stashed;
+}
+
+
+/**
+ * If the provided source is in the compile cache, this method
+ * moves it's compiled trees out of the cache and makes them the
+ * current ones - setting the variables it defines just as a
+ * compile would - and returns 'true'. It's the caller's job to
+ * lock the source.
+ */
+bool parser::restoreTree( const std::string & aSource )
+{
+	bool					restored = false;
+	std::vector<variable *>	defs;
+	{
+		spinlock::scoped_lock		lock(_expr_mutex);
+		if ((_cache_size > 0) && !aSource.empty()) {
+			tree_cache_t::iterator	it = _cache.find(aSource);
+			if (it == _cache.end()) {
+				++_cache_misses;
+			} else if (_expr.empty()) {
+				++_cache_hits;
+				cached_tree		& t = it->second.first;
+				_expr.swap(t.expr);
+				_progs.swap(t.progs);
+				_defs.swap(t.defs);
+				dropPlan_nl();
+				++_tree_gen;
+				_cache_order.erase(it->second.second);
+				_cache.erase(it);
+				defs = _defs;
+				restored = true;
+			}
+		}
+	}
+	// a compile would have set these variables, so we have to as well
+	BOOST_FOREACH( variable *v, defs ) {
+		addVariable(*v);
+	}
+	return restored;
+}
+
+
+/**
+ * When we're using threads, these methods build the plan for the
+ * evaluation of the source - the waves of values that can all be
+ * evaluated at once, where each only uses those in the waves before
+ * it - drop it when the trees, or the variables, change, and then
+ * run it, wave by wave, on the pool. The "_nl" means the caller
+ * has to hold the expression lock.
+ */
+void parser::plan_nl()
+{
+	dropPlan_nl();
+	/**
+	 * We can only hold onto the things we own - the sub-expressions
+	 * and the variables - as anything else might be gone by the time
+	 * the plan is run again.
+	 */
+	plan_state		state;
+	state.bytecode = (_bytecode && !_progs.empty());
+	state.owned.insert(_subs.begin(), _subs.end());
+	{
+		spinlock::scoped_lock		lock(_vars_mutex);
+		for (var_map_t::iterator it = _vars.begin(); it != _vars.end(); ++it) {
+			state.owned.insert(it->second);
+		}
+	}
+
+	/**
+	 * Each top-level expression is run on it's own, in the wave after
+	 * the last of what it uses, and it's answer has a place in the list.
+	 */
+	std::vector<int>	waves;
+	size_t				cnt = 0;
+	BOOST_FOREACH( expression *e, _expr ) {
+		if (e != NULL) {
+			plan_task	t = { e, (state.bytecode ? _progs[cnt] : NULL), (int)cnt };
+			_tasks.push_back(t);
+			waves.push_back(planWave(e, false, state) + 1);
+			++cnt;
+		}
+	}
+	for (size_t i = 0; i < state.tasks.size(); ++i) {
+		plan_task	t = { state.tasks[i].first, NULL, -1 };
+		_tasks.push_back(t);
+		waves.push_back(state.tasks[i].second);
+	}
+	_answers.resize(cnt);
+
+	// now that the tasks won't move, each wave can be ready to go
+	for (size_t i = 0; i < _tasks.size(); ++i) {
+		if ((size_t)waves[i] >= _waves.size()) {
+			_waves.resize(waves[i] + 1);
+		}
+		_waves[waves[i]].push_back(boost::bind(&parser::runTask, &_tasks[i], &_answers));
+	}
+	_planned = true;
+}
+
+
+void parser::dropPlan()
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	dropPlan_nl();
+}
+
+
+void parser::dropPlan_nl()
+{
+	_waves.clear();
+	_tasks.clear();
+	_answers.clear();
+	_planned = false;
+}
+
+
+bool parser::runPlan_nl()
+{
+	bool		error = false;
+	if (!_planned) {
+		plan_nl();
+	}
+	for (size_t w = 0; w < _waves.size(); ++w) {
+		if (!_pool->run(_waves[w])) {
+			error = true;
+		}
+	}
+	return !error;
+}
+
+
+/**
+ * This is what the pool runs for each task in the plan - evaluate
+ * the value, or run it's program, and if it's one of the top-level
+ * expressions, put the answer where it goes.
+ */
+void parser::runTask( const plan_task *aTask, std::vector<value> *anAnswers )
+{
+	value	v = (aTask->prog != NULL ? aTask->prog->eval() : aTask->val->eval());
+	if (aTask->slot >= 0) {
+		(*anAnswers)[aTask->slot] = v;
+	}
+}
+
+
 /*******************************************************************
  *
  *                   Compiling/Evaluation Methods
@@ -976,78 +3309,91 @@ bool parser::compile()
 	spinlock::scoped_lock		lock(_src_mutex);
 	// see if we need to compile anything at all
 	if (!isCompiled()) {
-		value		*e = NULL;
-		char		c = '\0';
-		uint32_t	len = _src.length();
-		for (uint32_t pos = 0; pos < len; ++pos) {
-			// skip all white space - it's unimportant
-			if (isspace((c = _src[pos]))) {
+		value				*e = NULL;
+		boost::string_ref	token;
+		util::lexer			lex(_src.data(), _src.data() + _src.length());
+		util::lexer::token_type	type = util::lexer::eEnd;
+		_set_vars.clear();
+		while ((type = lex.next(token)) != util::lexer::eEnd) {
+			// anything outside of an expression is unimportant
+			if (type != util::lexer::eOpen) {
 				continue;
 			}
-			// see if we have another expression to process
-			if (c == '(') {
-				if ((e = parseExpr(_src, pos)) == NULL) {
-					// can't parse it, drop everything and bail
-					error = true;
-					clearExpr();
-					break;
-				} else {
-					/**
-					 * Looks good, so add it to the list - but ONLY
-					 * if it's not a variable definition. Then it's
-					 * already accounted for in the variable list.
-					 */
-					if (e->isExpression()) {
-						addExpr((expression *)e);
-					}
-					// correct for the fact we're on the right spot
-					--pos;
+			// we have another expression to process
+			if ((e = parseExpr(lex)) == NULL) {
+				// can't parse it, drop everything and bail
+				error = true;
+				clearCompileCache();
+				clearExpr();
+				break;
+			} else {
+				/**
+				 * Looks good, so add it to the list - but ONLY
+				 * if it's not a variable definition. Then it's
+				 * already accounted for in the variable list.
+				 */
+				if (e->isExpression()) {
+					addExpr((expression *)e);
 				}
 			}
 		}
+		// collapse all the constant sub-expressions we just built
+		if (!error) {
+			foldConstants();
+			shareCommonSubExprs();
+			useFixedFunctions(_set_vars);
+		}
+		// ...and keep copies of the variables it set for the cache and images
+		if (!error) {
+			spinlock::scoped_lock		lock(_expr_mutex);
+			BOOST_FOREACH( variable *v, _set_vars ) {
+				_defs.push_back((variable *)v->clone());
+			}
+		}
+		_set_vars.clear();
+	}
+	// ...and if we're using bytecode, make sure we have the programs
+	if (!error) {
+		compilePrograms();
 	}
 	return !error;
 }
 
 
 /**
- * This method assumes that the string starting at position
- * 'aPos' is the start of an expression, and will build up
- * the necessary expression and move the position of the
- * 'cursor' as the parsing continues. This will be called
+ * This method assumes that the lexer has just handed out the
+ * '(' that starts an expression, and will build up the
+ * necessary expression from the tokens that follow it - up to,
+ * and including, the matching ')'. This will be called
  * recursively to generate the complete, final expression for
  * the code starting at this point.
  */
-value *parser::parseExpr( const std::string & aSrc, uint32_t & aPos )
+value *parser::parseExpr( util::lexer & aLexer )
 {
 	/**
-	 * See if we start this off right, and of not, then toss
-	 * an error that can be caught. If so, then create an
-	 * expression to build upon.
+	 * Create an expression to build upon - remembering where the
+	 * '(' was, in case we're keeping track of the source of each.
 	 */
 	value		*expr = NULL;
-	if (aSrc[aPos] == '(') {
-		if ((expr = new expression()) == NULL) {
-			throw std::runtime_error("[parser::parseExpr] unable to create expression to place parsed data into!");
-		}
-		// move past the start of the expression: '('
-		++aPos;
-	} else {
-		throw std::runtime_error("[parser::parseExpr] syntax error - no '(' to start expression!");
+#ifdef LKIT_PROFILE
+	uint32_t	begin = aLexer.getTokenOffset();
+#endif
+	if ((expr = new (_arena) expression()) == NULL) {
+		throw std::runtime_error("[parser::parseExpr] unable to create expression to place parsed data into!");
 	}
 
 	/**
-	 * Now we need to get set up to scan the incoming source
-	 * at the current cursor position. We'll need to have
-	 * some sense of a 'token', and if we're in the middle
-	 * of building it. Then it's just a matter of being careful
-	 * to cover all the bases as we go.
+	 * Now it's just a matter of taking the tokens as they come -
+	 * each atom is handled on it's own, and each '(' is another
+	 * expression to parse as an argument, until we get to the ')'
+	 * that ends this one.
 	 */
-	char			c = '\0';
-	std::string		token;
-	bool			in_token = false;
-	while ((aPos < aSrc.length()) && (aSrc[aPos] != ')')) {
-		if ((c = aSrc[aPos]) == '(') {
+	boost::string_ref			token;
+	util::lexer::token_type		type = util::lexer::eEnd;
+	bool						done = false;
+	while (!done && ((type = aLexer.next(token)) != util::lexer::eEnd) &&
+		   (type != util::lexer::eClose)) {
+		if (type == util::lexer::eOpen) {
 			// make sure we have a function already
 			if (((expression *)expr)->getFunction() == NULL) {
 				// no can do - drop what we've created and bail
@@ -1057,8 +3403,14 @@ value *parser::parseExpr( const std::string & aSrc, uint32_t & aPos )
 				}
 				throw std::runtime_error("[parser:parseExpr] an expression can't be the first element in an expression - it must be a function!");
 			}
-			// starting a new expression to parse
-			value	*sub = parseExpr(aSrc, aPos);
+			// starting a new expression to parse - if it fails, ours goes too
+			value	*sub = NULL;
+			try {
+				sub = parseExpr(aLexer);
+			} catch (...) {
+				delete expr;
+				throw;
+			}
 			if (sub != NULL) {
 				if (((expression *)expr)->addToArgs(sub)) {
 					// add as sub-expr ONLY if it's an expression
@@ -1071,68 +3423,48 @@ value *parser::parseExpr( const std::string & aSrc, uint32_t & aPos )
 					sub = NULL;
 				}
 			}
-			// the expression parser left us in the right spot
-			continue;
-		} else if (isspace(c)) {
-			if (in_token) {
-				/**
-				 * Handle the token, and then clear it out for the
-				 * next one. There is a special "function" for the
-				 * setting of a variable - 'set'. We need to look
-				 * for that, and if we have it, we need to drop the
-				 * expression we're building and realize that it's
-				 * a variable, and build that instead.
-				 */
-				if (token == "set") {
-					// delete the existing expression as it's just wrong
-					if (expr != NULL) {
-						delete expr;
-						expr = NULL;
-					}
-					// now try to parse out the variable definition
-					if ((expr = parseVariable(aSrc, aPos)) == NULL) {
-						throw std::runtime_error("[parser::parseExpr] could not parse the variable definition");
-					} else {
-						// add this to the parser's list of vars
-						addVariable((variable * &)expr);
-					}
-					/**
-					 * We thought this was going to be an expression, but
-					 * it turned out to be a variable definition, we have
-					 * parsed that bad boy, and now it's time to leave.
-					 * Make sure we aren't in a token, and bail out.
-					 */
-					in_token = false;
-					break;
-				} else {
-					// simple token processing, with a clear to reset
-					handleToken((expression *)expr, token);
-					token.clear();
-					in_token = false;
-				}
+		} else if ((((expression *)expr)->getFunction() == NULL) && (token == "set")) {
+			/**
+			 * There is a special "function" for the setting of a
+			 * variable - 'set'. If we have it, we need to drop the
+			 * expression we're building and realize that it's a
+			 * variable, and build that instead.
+			 */
+			delete expr;
+			expr = NULL;
+			// now try to parse out the variable definition
+			if ((expr = parseVariable(aLexer)) == NULL) {
+				throw std::runtime_error("[parser::parseExpr] could not parse the variable definition");
+			} else {
+				// add this to the parser's list of vars
+				addVariable((variable * &)expr);
+				// ...and remember that this source sets it
+				_set_vars.push_back((variable *)expr);
 			}
+			/**
+			 * We thought this was going to be an expression, but
+			 * it turned out to be a variable definition, we have
+			 * parsed that bad boy - up to it's ')' - and now it's
+			 * time to leave.
+			 */
+			done = true;
 		} else {
-			// part of the token we're building
-			token.push_back(c);
-			in_token = true;
+			// simple token processing - a bad one drops what we've created
+			try {
+				handleToken((expression *)expr, token);
+			} catch (...) {
+				delete expr;
+				throw;
+			}
 		}
-		// move to the next character and keep processing
-		++aPos;
-	}
-
-	/**
-	 * If we were in the middle of a token when we hit the end
-	 * of the expression, then handle it, but there's no need to
-	 * clear it out, etc. as we're all done.
-	 */
-	if (in_token) {
-		handleToken((expression *)expr, token);
 	}
 
-	// make sure to move past the closing ')'
-	if ((aSrc[aPos] == ')') && (aPos < aSrc.length())) {
-		++aPos;
+#ifdef LKIT_PROFILE
+	// remember where this came from, so the profile can point back to it
+	if ((expr != NULL) && expr->isExpression()) {
+		((expression *)expr)->setSpan(begin, aLexer.getOffset());
 	}
+#endif
 
 	// return whatever expression we have built up to now
 	return expr;
@@ -1140,15 +3472,15 @@ value *parser::parseExpr( const std::string & aSrc, uint32_t & aPos )
 
 
 /**
- * This method assumes that it's pointing into the source
- * string just AFTER the '(set' part of a variable definition.
- * We need to finish parsing the variable name and value -
- * no matter how complex that value might be, and return it
- * as a new variable. The caller will be responsible for
- * deleting the variable when he's done with it or we will
+ * This method assumes that the lexer has just handed out the
+ * 'set' of a variable definition. We need to finish parsing
+ * the variable name and value - no matter how complex that
+ * value might be - up to, and including, the closing ')', and
+ * return it as a new variable. The caller will be responsible
+ * for deleting the variable when he's done with it or we will
  * leak.
  */
-variable *parser::parseVariable( const std::string & aSrc, uint32_t & aPos )
+variable *parser::parseVariable( util::lexer & aLexer )
 {
 	variable	*retval = NULL;
 
@@ -1161,86 +3493,43 @@ variable *parser::parseVariable( const std::string & aSrc, uint32_t & aPos )
 	 * potential expression that is the value, and make a
 	 * variable out of this and return it to the caller.
 	 */
-	char			c = '\0';
-	std::string		token;
-	bool			in_token = false;
-	bool			complete = false;
-	while ((aPos < aSrc.length()) && (aSrc[aPos] != ')')) {
-		if ((c = aSrc[aPos]) == '(') {
+	boost::string_ref			token;
+	util::lexer::token_type		type = util::lexer::eEnd;
+	bool						complete = false;
+	while (((type = aLexer.next(token)) != util::lexer::eEnd) &&
+		   (type != util::lexer::eClose)) {
+		if (type == util::lexer::eOpen) {
 			// make sure we have a variable already
 			if (retval == NULL) {
 				throw std::runtime_error("[parser:parseVariable] an expression can't be the first element after 'set' in a variable definition - it must be a name!");
 			}
 			// starting a new expression to parse as the value
-			complete = retval->set(parseExpr(aSrc, aPos));
-			// the expression parser left us in the right spot
-			continue;
-		} else if (isspace(c)) {
-			if (in_token) {
-				/**
-				 * Handle the token and then clear it out for
-				 * the rest of the parsing. If we have no name
-				 * for the variable, that's first, and we keep
-				 * it - otherwise, we parse out the value and
-				 * we should be done.
-				 */
-				if (retval == NULL) {
-					if ((retval = new variable(token)) == NULL) {
-						// create the error message for the bad creation
-						std::string		msg = "[parser::parseVariable] unable to create variable for the name: ";
-						msg.append(token);
-						// ...and now throw it so it can be delt with
-						throw std::runtime_error(msg);
-					}
-				} else if (!complete) {
-					// flag that we're done - if it succeeds
-					complete = retval->set(parseConst(token));
-				} else {
-					// drop the variable that we created
-					if (retval != NULL) {
-						delete retval;
-						retval = NULL;
-					}
-					// ...and then throw the exception
-					throw std::runtime_error("[parser:parseVariable] a 'set' requires only two things, and you have provided three!");
-				}
-				// now we can clear out the token for next time
-				token.clear();
-				in_token = false;
+			complete = retval->set(parseExpr(aLexer));
+		} else if (retval == NULL) {
+			/**
+			 * If we have no name for the variable, that's first,
+			 * and we keep it - otherwise, we parse out the value
+			 * and we should be done.
+			 */
+			if ((retval = new (_arena) variable(std::string(token.data(), token.size()))) == NULL) {
+				// create the error message for the bad creation
+				std::string		msg = "[parser::parseVariable] unable to create variable for the name: ";
+				msg.append(token.data(), token.size());
+				// ...and now throw it so it can be delt with
+				throw std::runtime_error(msg);
 			}
-		} else {
-			// part of the token we're building
-			token.push_back(c);
-			in_token = true;
-		}
-		// move to the next character and keep processing
-		++aPos;
-	}
-
-	/**
-	 * If we were in the middle of a token when we hit the end
-	 * of the variable, then handle it, but there's no need to
-	 * clear it out, etc. as we're all done.
-	 */
-	if (in_token) {
-		if (!complete) {
-			retval->set(parseConst(token));
+		} else if (!complete) {
+			// flag that we're done - if it succeeds
+			complete = retval->set(parseConst(token));
 		} else {
 			// drop the variable that we created
-			if (retval != NULL) {
-				delete retval;
-				retval = NULL;
-			}
+			delete retval;
+			retval = NULL;
 			// ...and then throw the exception
 			throw std::runtime_error("[parser:parseVariable] a 'set' requires only two things, and you have provided three!");
 		}
 	}
 
-	// make sure to move past the closing ')'
-	if ((aSrc[aPos] == ')') && (aPos < aSrc.length())) {
-		++aPos;
-	}
-
 	// return whatever variable we have built up to now
 	return retval;
 }
@@ -1255,7 +3544,7 @@ variable *parser::parseVariable( const std::string & aSrc, uint32_t & aPos )
  * what's necessary to place the value/variable/etc. into
  * the expression properly;
  */
-bool parser::handleToken( expression *anExpr, const std::string & aToken )
+bool parser::handleToken( expression *anExpr, const boost::string_ref & aToken )
 {
 	bool		error = false;
 	bool		handled = false;
@@ -1280,7 +3569,7 @@ bool parser::handleToken( expression *anExpr, const std::string & aToken )
 				error = true;
 				// create the error message for the missing function
 				std::string		msg = "[parser::handleToken] there is no function for the name: ";
-				msg.append(aToken);
+				msg.append(aToken.data(), aToken.size());
 				// ...and now throw it so it can be delt with
 				throw std::runtime_error(msg);
 			} else {
@@ -1322,7 +3611,7 @@ bool parser::handleToken( expression *anExpr, const std::string & aToken )
 			error = true;
 			// create the error message for the missing variable
 			std::string		msg = "[parser::handleToken] unable to find/create variable: ";
-			msg.append(aToken);
+			msg.append(aToken.data(), aToken.size());
 			// ...and now throw it so it can be delt with
 			throw std::runtime_error(msg);
 		} else {
@@ -1344,10 +3633,9 @@ bool parser::handleToken( expression *anExpr, const std::string & aToken )
  * will return NULL, but if not-NULL, it is the responsibility
  * of the caller to delete the returned value or we will leak.
  */
-value *parser::parseConst( const std::string & aToken )
+value *parser::parseConst( const boost::string_ref & aToken )
 {
 	value		*retval = NULL;
-	bool		handled = false;
 
 	/**
 	 * Our constants look like one of the following patterns:
@@ -1355,67 +3643,339 @@ value *parser::parseConst( const std::string & aToken )
 	 * +/- 1 2 3 - simple integers all matching isdigit()
 	 * ... plus '.' and 'e'/'E' - doubles
 	 * 'YYYY-MM-DD' or 'YYYY-MM-DD HH:MM:SS.ssss' - timestamps
+	 *
+	 * and they're all parsed right out of the token - there's no
+	 * need to copy it anywhere first.
 	 */
-	size_t		len = aToken.length();
-	if ((aToken[0] == '\'') && (aToken[len - 1] == '\'')) {
+	size_t		len = aToken.size();
+	if (len == 0) {
+		// nothing here to parse - so it's not a constant
+	} else if ((len > 1) && (aToken[0] == '\'') && (aToken[len - 1] == '\'')) {
 		// likely a data by our format
-		retval = new value(util::timer::parseTimestamp(aToken.substr(1, len - 2)));
+		retval = new (_arena) value(util::timer::parseTimestamp(aToken.data() + 1, len - 2));
 		if (retval == NULL) {
 			// create the error message for the malformed timestamp
 			std::string		msg = "[parser::parseConst] unable to parse timestamp value: ";
-			msg.append(aToken);
+			msg.append(aToken.data(), len);
 			// ...and now throw it so it can be delt with
 			throw std::runtime_error(msg);
-		} else {
-			// ...and indicate that this token has been handled
-			handled = true;
 		}
-	} else if (aToken.find_first_not_of("+-0123456789.eE") == std::string::npos) {
+	} else if (aToken.find_first_not_of("+-0123456789.eE") == boost::string_ref::npos) {
 		// it's a number of some kind - find out which kind
-		if (aToken.find_first_of(".eE") == std::string::npos) {
+		if (aToken.find_first_of(".eE") == boost::string_ref::npos) {
 			// it's an integer
-			retval = new value(atoi(aToken.c_str()));
+			retval = new (_arena) value(parseInt(aToken));
 			if (retval == NULL) {
 				// create the error message for the malformed integer
 				std::string		msg = "[parser::parseConst] unable to parse int value: ";
-				msg.append(aToken);
+				msg.append(aToken.data(), len);
 				// ...and now throw it so it can be delt with
 				throw std::runtime_error(msg);
-			} else {
-				// ...and indicate that this token has been handled
-				handled = true;
 			}
 		} else {
 			// it's a double
-			retval = new value(atof(aToken.c_str()));
+			retval = new (_arena) value(parseDouble(aToken));
 			if (retval == NULL) {
 				// create the error message for the malformed double
 				std::string		msg = "[parser::parseConst] unable to parse double value: ";
-				msg.append(aToken);
+				msg.append(aToken.data(), len);
 				// ...and now throw it so it can be delt with
 				throw std::runtime_error(msg);
-			} else {
-				// ...and indicate that this token has been handled
-				handled = true;
 			}
 		}
 	} else if ((aToken == "true") || (aToken == "false")) {
 		// it's a boolean
-		retval = new value(aToken[0] == 't');
+		retval = new (_arena) value(aToken[0] == 't');
 		if (retval == NULL) {
 			// create the error message for the malformed boolean
 			std::string		msg = "[parser::parseConst] unable to parse bool value: ";
-			msg.append(aToken);
+			msg.append(aToken.data(), len);
 			// ...and now throw it so it can be delt with
 			throw std::runtime_error(msg);
+		}
+	}
+
+	return retval;
+}
+
+
+/**
+ * This method parses the leading integer out of the token just
+ * as atoi() would - an optional sign, and then the digits up to
+ * the first thing that isn't one - but right out of the token,
+ * as it's not a NUL-terminated string of it's own.
+ */
+int parser::parseInt( const boost::string_ref & aToken )
+{
+	int			retval = 0;
+	bool		neg = false;
+	size_t		i = 0;
+	size_t		len = aToken.size();
+	if ((len > 0) && ((aToken[0] == '-') || (aToken[0] == '+'))) {
+		neg = (aToken[0] == '-');
+		++i;
+	}
+	for (; (i < len) && (aToken[i] >= '0') && (aToken[i] <= '9'); ++i) {
+		retval = retval * 10 + (aToken[i] - '0');
+	}
+	return (neg ? -retval : retval);
+}
+
+
+/**
+ * This method parses the leading double out of the token just
+ * as atof() would. Getting the last bit right is not something
+ * to do by hand, so we let strtod() do it - but on a copy of
+ * the token on the stack, as it's not NUL-terminated, and the
+ * next thing in the source could look like more of the number.
+ */
+double parser::parseDouble( const boost::string_ref & aToken )
+{
+	double		retval = 0.0;
+	char		buff[64];
+	if (aToken.size() < sizeof(buff)) {
+		memcpy(buff, aToken.data(), aToken.size());
+		buff[aToken.size()] = '\0';
+		retval = strtod(buff, NULL);
+	} else {
+		// nothing this long is sensible - but it's still a number
+		retval = strtod(std::string(aToken.data(), aToken.size()).c_str(), NULL);
+	}
+	return retval;
+}
+
+/**
+ * This method is called at the end of compile() and looks for
+ * every sub-expression that is a pure function of nothing but
+ * constants. Each one of these will always evaluate to the same
+ * thing, so we evaluate it once, replace it in the tree with a
+ * new constant, and delete the sub-expression. This is done all
+ * the way up the tree, so that '(+ (* 2 3) 4)' ends up being
+ * a single function call on constants.
+ */
+void parser::foldConstants()
+{
+	/**
+	 * We can only fold the things that we own - the constants that
+	 * were parsed from the source, and the sub-expressions we built
+	 * from them. A caller's value might change, even if it's not a
+	 * variable, so we can't assume anything about those.
+	 */
+	value_set_t		consts;
+	{
+		spinlock::scoped_lock		lock(_const_mutex);
+		consts.insert(_const.begin(), _const.end());
+	}
+	value_set_t		subs;
+	expr_list_t		top;
+	{
+		spinlock::scoped_lock		lock(_expr_mutex);
+		subs.insert(_subs.begin(), _subs.end());
+		top = _expr;
+	}
+
+	/**
+	 * The top-level expressions have to stay expressions, as that's
+	 * what we evaluate, but everything under them can be folded.
+	 */
+	value_map_t		folded;
+	BOOST_FOREACH( expression *e, top ) {
+		foldArgs(e, consts, subs, folded);
+	}
+
+	/**
+	 * Now that nothing refers to the folded sub-expressions, we
+	 * can drop them from the list and delete them.
+	 */
+	spinlock::scoped_lock		lock(_expr_mutex);
+	expr_list_t		keep;
+	BOOST_FOREACH( expression *e, _subs ) {
+		value_map_t::iterator	it = folded.find(e);
+		if ((it == folded.end()) || (it->second == e)) {
+			keep.push_back(e);
 		} else {
-			// ...and indicate that this token has been handled
-			handled = true;
+			delete e;
 		}
 	}
+	_subs.swap(keep);
+}
+
+
+/**
+ * This method is called at the end of compile(), after the
+ * constants are folded, and finds every sub-expression of a pure
+ * function that's the same as another - the same function on the
+ * same arguments - and has them all share the first one. That way,
+ * the same '(/ x y)' in a dozen places is only calculated once for
+ * each evaluation. The constants that are the same are shared as
+ * well, so that the expressions on them can be.
+ */
+void parser::shareCommonSubExprs()
+{
+	/**
+	 * Just as with the folding, we can only share the things that
+	 * we own - the constants and sub-expressions from the source.
+	 */
+	share_state		state;
+	{
+		spinlock::scoped_lock		lock(_const_mutex);
+		state.consts.insert(_const.begin(), _const.end());
+	}
+	expr_list_t		top;
+	{
+		spinlock::scoped_lock		lock(_expr_mutex);
+		state.subs.insert(_subs.begin(), _subs.end());
+		top = _expr;
+	}
+	std::vector<variable *>		defs = _set_vars;
+
+	/**
+	 * The top-level expressions, and the definitions of the variables
+	 * the source sets, have others that own them, so they have to stay
+	 * as they are - but everything under them can be shared.
+	 */
+	BOOST_FOREACH( expression *e, top ) {
+		shareArgs(e, state);
+	}
+	BOOST_FOREACH( variable *v, defs ) {
+		shareValue(v, state);
+	}
+
+	/**
+	 * Now that nothing refers to the ones that were replaced, we can
+	 * drop them from the lists and delete them.
+	 */
+	{
+		spinlock::scoped_lock		lock(_expr_mutex);
+		expr_list_t		keep;
+		BOOST_FOREACH( expression *e, _subs ) {
+			value_map_t::iterator	it = state.shared.find(e);
+			if ((it == state.shared.end()) || (it->second == e)) {
+				keep.push_back(e);
+			} else {
+				delete e;
+			}
+		}
+		_subs.swap(keep);
+	}
+	spinlock::scoped_lock		lock(_const_mutex);
+	var_list_t		keep;
+	BOOST_FOREACH( value *c, _const ) {
+		value_map_t::iterator	it = state.shared.find(c);
+		if ((it == state.shared.end()) || (it->second == c)) {
+			keep.push_back(c);
+		} else {
+			delete c;
+		}
+	}
+	_const.swap(keep);
+}
 
+
+/**
+ * This method is called at the very end of compile(), after the
+ * sub-expressions are shared, and if we're using the fast paths,
+ * gives every expression in the tree - and the definitions of the
+ * variables 'aDefs' that the source sets - the fixed function that
+ * fits the function and arguments it has, if there is one.
+ */
+void parser::useFixedFunctions( const std::vector<variable *> & aDefs )
+{
+	spinlock::scoped_lock		lock(_expr_mutex);
+	if (_fast_paths) {
+		BOOST_FOREACH( expression *e, _expr ) {
+			e->setFastPath(func::findFixed(e->getFunction(), e->getArgs()));
+		}
+		BOOST_FOREACH( expression *e, _subs ) {
+			e->setFastPath(func::findFixed(e->getFunction(), e->getArgs()));
+		}
+		BOOST_FOREACH( variable *v, aDefs ) {
+			value	*d = v->getExpr();
+			if ((d != NULL) && d->isExpression()) {
+				expression	*e = (expression *)d;
+				e->setFastPath(func::findFixed(e->getFunction(), e->getArgs()));
+			}
+		}
+	}
+}
+
+
+/**
+ * This method looks at the provided value and, if it's a
+ * sub-expression that can be folded into a constant, returns
+ * the new constant to use in it's place. If not, it returns
+ * the value itself. Variables are never replaced, but if they
+ * are defined by a constant expression, they will simply take
+ * on that value. The map remembers what we've already looked
+ * at so that shared values are only done once.
+ */
+value *parser::fold( value *aValue, value_set_t & aConsts,
+					 const value_set_t & aSubs, value_map_t & aFolded )
+{
+	// if we've already seen this guy, then we know the answer
+	value_map_t::iterator	it = aFolded.find(aValue);
+	if (it != aFolded.end()) {
+		return it->second;
+	}
+
+	value	*retval = aValue;
+	if (aValue->isVariable()) {
+		// mark it first - a variable can refer to itself
+		aFolded[aValue] = aValue;
+		/**
+		 * A variable isn't a constant - the caller can always set it
+		 * to something else - but if it's defined by a constant
+		 * expression, then it might as well just hold the value.
+		 */
+		value	*def = ((variable *)aValue)->getExpr();
+		if ((def != NULL) && def->isExpression() &&
+			foldArgs((expression *)def, aConsts, aSubs, aFolded)) {
+			*((variable *)aValue) = def->eval();
+		}
+	} else if (aValue->isExpression() && (aSubs.find(aValue) != aSubs.end())) {
+		// mark it first so shared sub-expressions are done once
+		aFolded[aValue] = aValue;
+		if (foldArgs((expression *)aValue, aConsts, aSubs, aFolded)) {
+			value	*c = new (_arena) value(aValue->eval());
+			addConst(c);
+			aConsts.insert(c);
+			aFolded[aValue] = c;
+			retval = c;
+		}
+	}
 	return retval;
 }
+
+
+/**
+ * This method folds all the arguments of the provided expression,
+ * replacing them in the expression as needed, and then returns
+ * 'true' if the expression is now a pure function of nothing
+ * but constants - and can therefore be folded itself.
+ */
+bool parser::foldArgs( expression *anExpr, value_set_t & aConsts,
+					   const value_set_t & aSubs, value_map_t & aFolded )
+{
+	bool					allConst = true;
+	bool					changed = false;
+	std::vector<value *>	args = anExpr->getArgs();
+	for (size_t i = 0; i < args.size(); ++i) {
+		value	*v = fold(args[i], aConsts, aSubs, aFolded);
+		if (v != args[i]) {
+			args[i] = v;
+			changed = true;
+		}
+		if (aConsts.find(v) == aConsts.end()) {
+			allConst = false;
+		}
+	}
+	// put the folded arguments back into the expression
+	if (changed) {
+		anExpr->setArgs(args);
+	}
+	function	*f = anExpr->getFunction();
+	return (allConst && (f != NULL) && f->isPure());
+}
 }		// end of namespace lkit
 
 
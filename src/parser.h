@@ -12,16 +12,24 @@
 
 //	System Headers
 #include <stdint.h>
+#include <list>
 #include <ostream>
 #include <string>
 
 //	Third-Party Headers
+#include <boost/function.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/unordered_map.hpp>
-#include <boost/smart_ptr/detail/spinlock.hpp>
+#include <boost/utility/string_ref.hpp>
 
 //	Other Headers
 #include "variable.h"
+#include "program.h"
+#include "registry.h"
+#include "util/spinlock.h"
+#include "util/arena.h"
+#include "util/lexer.h"
+#include "util/table.h"
 
 //	Forward Declarations
 /**
@@ -32,6 +40,10 @@
 namespace lkit {
 class function;
 class expression;
+class watcher;
+namespace util {
+class pool;
+}	// end of namespace util
 }	// end of namespace lkit
 
 //	Public Constants
@@ -53,6 +65,11 @@ typedef std::vector<lkit::value *> var_list_t;
  * to this list, destroying everything when we're all done.
  */
 typedef std::vector<lkit::expression *> expr_list_t;
+/**
+ * When we compile the expressions to programs, we'll need to have a list
+ * of them as well - one for each top-level expression, in the same order.
+ */
+typedef std::vector<lkit::program *> prog_list_t;
 /**
  * We are going to have a series of variables in the parsed source and
  * we need to maintain them in a reasonable container, so we're going to
@@ -61,12 +78,18 @@ typedef std::vector<lkit::expression *> expr_list_t;
  */
 typedef boost::unordered_map<std::string, lkit::variable *> var_map_t;
 /**
- * We are going to have a map of the function names to the actual pointers
- * to the lkit::function instances, and rather than clutter up the code
- * with all the syntax, it makes sense to create a nice, simple typedef
- * here so that we can use it in the code and keep things cleaner.
+ * When we're optimizing the language tree we need to quickly know if
+ * a value is one of the parser's constants, or if it's been replaced,
+ * and these simple boost containers of pointers do the trick.
  */
-typedef boost::unordered_map<std::string, lkit::function *> fcn_map_t;
+typedef boost::unordered_set<lkit::value *> value_set_t;
+typedef boost::unordered_map<lkit::value *, lkit::value *> value_map_t;
+/**
+ * When a caller subscribes to a variable, or a top-level expression, of
+ * the parser, this is what's called when it's value changes - with the
+ * ID of the subscription, and the value before and after the change.
+ */
+typedef boost::function<void (int anID, const lkit::value & anOld, const lkit::value & aNew)> change_callback_t;
 
 //	Public Data Constants
 
@@ -154,7 +177,9 @@ class parser
 		 *
 		 * The variable and value pointers will be memory managed by
 		 * the parser from this point on, so the caller must give
-		 * over control to the parser for these arguments.
+		 * over control to the parser for these arguments. An array
+		 * is never copied - it becomes the value of the variable, so
+		 * the caller can bind it to new data later on.
 		 */
 		virtual bool addVariable( const variable & aVariable );
 		virtual bool addVariable( variable * & aVariable );
@@ -178,7 +203,9 @@ class parser
 		virtual bool removeVariable( std::string & aName );
 		/**
 		 * This method simple clears out all the variables in this
-		 * parser instance. It's a clean-slate starting point.
+		 * parser instance. It's a clean-slate starting point. As the
+		 * variables are looked up, and set, without any lock, nothing
+		 * else can be using them while this is done.
 		 */
 		virtual void clearVariables();
 		/**
@@ -187,16 +214,48 @@ class parser
 		 * to be used by standard mathematical expressions.
 		 */
 		virtual void useDefaultVariables();
+		/**
+		 * Every variable the parser knows about has a slot - a dense
+		 * integer ID handed out as the variable is first seen, which is
+		 * most often as the source is compiled. This method returns the
+		 * slot of the named variable, or -1 if there's no such variable.
+		 * The slot stays with the name until the variables are cleared,
+		 * so it can be looked up once, and used for every update.
+		 */
+		virtual int getVariableSlot( const std::string & aName );
+		/**
+		 * This method returns the number of slots that have been handed
+		 * out - which is one more than the largest slot.
+		 */
+		virtual size_t getVariableSlotCount() const;
+		/**
+		 * These methods set the value of the variable in the slot - with
+		 * none of the hashing of the name, and looking it up in the map,
+		 * that addVariable() has to do. If the slot isn't in use, then
+		 * 'false' is returned.
+		 */
+		virtual bool setVariable( int aSlot, double aValue );
+		virtual bool setVariable( int aSlot, int aValue );
+		virtual bool setVariable( int aSlot, const value & aValue );
+		/**
+		 * This method sets 'aCount' variables at once - the slots, and
+		 * their new values, are in the two arrays - so that all the
+		 * inputs for a record are set, and then everyone watching is
+		 * told just once. If any slot isn't in use, the rest are still
+		 * set, but 'false' is returned.
+		 */
+		virtual bool setVariables( const int *aSlots, const double *aValues, size_t aCount );
 
 		/**
-		 * This method returns the actual reference to the map of known
-		 * functions for this parser. Great care should be exercised, as
-		 * this is the ACTUAL map, and can be modified by other threads
-		 * so please be careful. The key is the name of the function as
-		 * it exists in the source, and the value is the pointer to the
-		 * lkit::function that is used.
+		 * This method returns the map of known functions for this parser
+		 * - those of the registry it uses, with the ones it has of it's
+		 * own put over them. The key is the name of the function as it
+		 * exists in the source, and the value is the pointer to the
+		 * lkit::function that is used. It's a copy, made when it's asked
+		 * for, but the functions are the parser's, and the registry's, so
+		 * none of them are to be deleted.
 		 */
-		virtual const fcn_map_t & getFunctions() const;
+		virtual fcn_map_t getFunctions() const;
 		/**
 		 * This method adds the provided name and function to the list
 		 * of functions for this parser. Checks will be made to see if
@@ -204,6 +263,9 @@ class parser
 		 * will replace the existing function in the table. This allows
 		 * for custom functionality under the same name in the scripts.
 		 *
+		 * The function is only this parser's - it's put over the one in
+		 * the registry, which is shared, and never changed.
+		 *
 		 * The memory management of the functions will become the
 		 * responsible of the parser, so the caller has to be willing
 		 * to relinquish control.
@@ -213,21 +275,127 @@ class parser
 		 * This method will look to see if the provided function name
 		 * is in the list for this parser, and will remove it if so.
 		 * If one is removed, this method will return 'true', otherwise,
-		 * it will return 'false'.
+		 * it will return 'false'. A function of the registry is just
+		 * hidden from this parser - the registry isn't changed.
 		 */
 		virtual bool removeFunction( const std::string & aName );
 		/**
 		 * This method will remove ALL the known functions from the
-		 * table for this parser.
+		 * table for this parser - it's own, and the registry it uses.
+		 * Like clearVariables(), it can't be done while anyone else is
+		 * using the parser.
 		 */
 		virtual void clearFunctions();
 		/**
 		 * This method will set up this parser with the DEFAULT functions
 		 * for the language. This does not include any user-supplied
 		 * functions, but does include the basic functionality of the
-		 * language.
+		 * language. They are in the one registry of them for the whole
+		 * process, so nothing is made, or copied, for the parser.
 		 */
 		virtual void useDefaultFunctions();
+		/**
+		 * These methods set, and return, the registry of functions the
+		 * parser uses - shared with all the other parsers using it, and
+		 * with the functions of this parser's own put over it. Changing
+		 * it, like clearFunctions(), can't be done while anyone else is
+		 * using the parser, and the one it replaces is held onto until
+		 * then, as the trees might still use it's functions.
+		 */
+		virtual void useRegistry( const registry::ptr_t & aRegistry );
+		virtual registry::ptr_t getRegistry() const;
+
+		/**
+		 * This method tells the parser to compile each top-level
+		 * expression into a flat program of instructions, and use those
+		 * for evaluation, rather than walking the language tree. This is
+		 * usually a good bit faster for large trees, but it doesn't use
+		 * the cached results in the tree - it always does all the work.
+		 * The default is to use the language tree.
+		 */
+		virtual void useBytecode( bool aFlag = true );
+		/**
+		 * This method returns 'true' if the parser is compiling the
+		 * expressions into programs for evaluation.
+		 */
+		virtual bool usingBytecode() const;
+
+		/**
+		 * This method tells the parser to put a function of a fixed arity
+		 * in for the general one wherever it fits when it compiles the
+		 * source - a sum or comparison of just two values, or the 'not'
+		 * of one - so there's no loop over the arguments, and when they are
+		 * both ints, or both doubles, no looking at what kind of values
+		 * they are. The answers are the same either way. The default is to
+		 * use them, and the change is seen the next time the source is
+		 * compiled.
+		 */
+		virtual void useFastPaths( bool aFlag = true );
+		/**
+		 * This method returns 'true' if the parser is putting the fixed
+		 * functions in for the general ones when it compiles the source.
+		 */
+		virtual bool usingFastPaths() const;
+
+		/**
+		 * This method tells the parser to evaluate the source on 'aCount'
+		 * threads - the caller's, and a pool of the rest. The top-level
+		 * expressions are all run at once, and so are the variables the
+		 * source sets, and the large sub-expressions that are arguments
+		 * of the same function - each one as soon as the ones it uses are
+		 * done. They all have to be independent of one another, but for
+		 * what they get from the variables, as there's no telling what
+		 * order they'll be done in. A count of 0 or 1, the default, is to
+		 * evaluate them one after the other, in the order of the source.
+		 */
+		virtual void useThreads( size_t aCount );
+		/**
+		 * This method returns the number of threads that evaluate the
+		 * source - 1 if it's done by the caller alone.
+		 */
+		virtual size_t getThreadCount() const;
+
+		/**
+		 * These methods bind the named variable to a column of data
+		 * for batch evaluation - a contiguous array owned by the caller
+		 * that has to stay valid for as long as it's bound, where each
+		 * element is the value of the variable for that row. Binding a
+		 * variable again replaces the column it had.
+		 */
+		virtual bool bindColumn( const std::string & aName, const double *aColumn );
+		virtual bool bindColumn( const std::string & aName, const int *aColumn );
+		virtual bool bindColumn( const std::string & aName, const uint64_t *aColumn );
+		/**
+		 * This method drops all the columns that have been bound to the
+		 * variables of this parser.
+		 */
+		virtual void clearColumns();
+
+		/**
+		 * This method tells the parser to keep the compiled language
+		 * trees of the last 'aSize' sources it's seen, so that setting
+		 * the source back to one of them skips the compile entirely. A
+		 * size of zero, the default, turns off the cache and drops all
+		 * that's in it.
+		 */
+		virtual void useCompileCache( size_t aSize );
+		/**
+		 * This method returns the most compiled sources that will be
+		 * kept in the cache - zero if it's not being used.
+		 */
+		virtual size_t getCompileCacheSize() const;
+		/**
+		 * These methods return the number of times setting the source
+		 * found it in the cache, and the number of times it didn't, so
+		 * that the caller can see how well the size is working.
+		 */
+		virtual uint64_t getCacheHits() const;
+		virtual uint64_t getCacheMisses() const;
+		/**
+		 * This method drops all the compiled sources in the cache, but
+		 * leaves the size, and the counters, as they are.
+		 */
+		virtual void clearCompileCache();
 
 		/**
 		 * This method attempts to compile the source, if there is any, and
@@ -238,6 +406,143 @@ class parser
 		 * possible.
 		 */
 		virtual value eval();
+		/**
+		 * This method is just like eval(), but it places the value of
+		 * each of the top-level expressions in the results - in the order
+		 * of the source - and not just the last one. If the source can't
+		 * be compiled, or any of the evaluations throws an exception, this
+		 * returns 'false'.
+		 */
+		virtual bool evalAll( std::vector<value> & aResults );
+
+		/**
+		 * These methods subscribe the callback to the named variable, or
+		 * to the top-level expression at 'anIndex' in the source - the
+		 * same order as evalAll() - and return the ID of the subscription.
+		 * The callback is only called when the value actually changes, and
+		 * is given the value before and after. The value when it's made is
+		 * where it starts, so nothing is called for that. A variable that
+		 * isn't there yet, or an expression past the end of the source, is
+		 * undefined until it is - and the subscription to an expression
+		 * goes with the source to the expression at that index.
+		 */
+		virtual int subscribeVariable( const std::string & aName, const change_callback_t & aCallback );
+		virtual int subscribeExpr( size_t anIndex, const change_callback_t & aCallback );
+		/**
+		 * These methods drop the subscription with the ID, or all of them,
+		 * so that their callbacks won't be called again.
+		 */
+		virtual bool unsubscribe( int anID );
+		virtual void clearSubscriptions();
+		/**
+		 * This method evaluates all the subscribed variables and expressions
+		 * that the changes since the last time might have changed - along
+		 * with any that can't be cached - and calls the callbacks of the
+		 * ones that did change, and returns how many were called. This is
+		 * done for the caller after every change made with addVariable()
+		 * or setVariable(), and setVariables() does it just once for all of
+		 * them. For changes made right to the values, or to the source, it
+		 * needs to be called by the caller - and a new source is compiled
+		 * so that it's expressions can be watched. The setters don't compile
+		 * it, so until it is, they only look at the variables. The callbacks
+		 * are called with nothing locked, and by the thread that made the
+		 * change.
+		 */
+		virtual size_t notify();
+		/**
+		 * These methods compile the source, if needed, and then evaluate
+		 * it over 'aRows' rows of the bound columns in one call - placing
+		 * the value of the final expression for each row in the results.
+		 * The expressions are always compiled into programs for this, as
+		 * that's what lets us do a block of rows at a time. Variables
+		 * that aren't bound keep the one value they have for all rows.
+		 */
+		virtual bool evalBatch( size_t aRows, std::vector<value> & aResults );
+		virtual bool evalBatch( size_t aRows, double *aResults );
+		/**
+		 * This method compiles the source, if needed, and returns the
+		 * program for the final expression - the one whose value eval()
+		 * returns - or NULL if there isn't one. The program can then be
+		 * run by any number of threads at once, each with it's own
+		 * lkit::context, and no locking. It's owned by the parser, and is
+		 * only good until the source, variables, or functions change.
+		 */
+		virtual const program *getProgram();
+		/**
+		 * When LKit is built with LKIT_PROFILE, this method returns the
+		 * profile of the language tree for the source - one line for each
+		 * expression, with the most time first, as comma-separated values:
+		 *
+		 *   nsec,self_nsec,calls,recalcs,begin,end,"source"
+		 *
+		 * where 'self_nsec' is the time not spent in the expressions that
+		 * are the arguments, and 'begin' and 'end' are the span of the
+		 * source it was parsed from. Programs don't use the expressions,
+		 * so nothing is counted when using bytecode. Without LKIT_PROFILE
+		 * this is just an empty string.
+		 */
+		virtual std::string getProfile() const;
+		/**
+		 * This method resets all the counts, and times, in the profile of
+		 * the language tree back to 0 - so that we can profile just what
+		 * happens after this.
+		 */
+		virtual void resetProfile();
+		/**
+		 * This method returns the memory the parser is using, and what
+		 * for, as comma-separated values - one line for each kind of thing
+		 * it holds, and then the total:
+		 *
+		 *   kind,count,bytes,overhead
+		 *
+		 * The kinds are the 'parser' itself and it's source, the top-level
+		 * 'expressions', the 'subexpressions', the 'constants', the
+		 * 'variables' and the 'functions' - with the hashes they're kept
+		 * in - the top-level expressions in the compile 'cache', and the
+		 * 'tables' the names are looked up in. 'bytes' is what all those
+		 * things asked for - themselves, and their names and lists - and
+		 * 'overhead' is what the allocators used on top of that: the
+		 * header on each value, the rounding of the arena, or the heap,
+		 * and the buckets and links of the hashes. The 'arena' line is
+		 * the chunks it has, and what in them isn't being used, and it's
+		 * chunks aren't in the total count. The 'registry' line, after the
+		 * total, is the registry of functions - shared by all the parsers
+		 * using it, so it's not part of the total for this one - and the
+		 * 'functions' are just this parser's own. The heap is taken to be
+		 * like glibc's, and a function is taken to be just the size of the
+		 * base class, as what the subclasses hold can't be known.
+		 */
+		virtual std::string getMemoryUsage() const;
+
+		/**
+		 * This method compiles the source, if needed, and returns an image
+		 * of the compiled language trees - the constants, the variables and
+		 * functions they use, by name, the expressions, and the variables
+		 * the source sets - with the source itself. Given to setImage() it
+		 * rebuilds the same trees without any of the work of the compile. If
+		 * there's nothing that can be written, this returns an empty string.
+		 */
+		virtual std::string getImage();
+		/**
+		 * These methods take an image from getImage() - possibly from a
+		 * different parser, in a different process - and make it's source
+		 * and language trees the current ones, just as if the source had
+		 * been set and compiled. The image is only read, and not kept, so
+		 * it can be right in a file mapped into memory. The functions and
+		 * variables are looked up by name, so the functions have to be
+		 * defined before this is called. If the image is malformed, or a
+		 * function is missing, 'false' is returned - and the source in it,
+		 * if there was one, will be compiled as usual on the next eval().
+		 */
+		virtual bool setImage( const char *anImage, size_t aSize );
+		virtual bool setImage( const std::string & anImage );
+		/**
+		 * These methods write the image of the compiled source to a file,
+		 * and read it back - the file is mapped into memory, and the image
+		 * is read right out of it, so there's no copy of it made first.
+		 */
+		virtual bool saveImage( const std::string & aFile );
+		virtual bool loadImage( const std::string & aFile );
 
 		/**
 		 * This method will clear out EVERYTHING for the parser and have
@@ -304,7 +609,14 @@ class parser
 		 * a location for one in the map, and it'll be up to the caller to
 		 * assign a value to that variable before evaluation starts.
 		 */
-		value *lookUpVariable( const std::string & aName );
+		value *lookUpVariable( const boost::string_ref & aName );
+		/**
+		 * This method gives the variable the slot for it's name - a new
+		 * one if the name hasn't been seen before - so that it can be set
+		 * by slot, and found without the lock. The "_nl" means the caller
+		 * has to hold the lock on the variables.
+		 */
+		void addSlot_nl( const std::string & aName, variable *aVariable );
 
 		/**
 		 * This method looks to the map of all functions we know about in
@@ -314,7 +626,7 @@ class parser
 		 * NULL and that should be the sign of an error. Functions have to
 		 * be defined prior to parsing of the code.
 		 */
-		function *lookUpFunction( const std::string & aName );
+		function *lookUpFunction( const boost::string_ref & aName );
 
 		/**
 		 * This method returns the actual reference to the map of known
@@ -385,6 +697,39 @@ class parser
 		 * the source into a language tree.
 		 */
 		virtual bool isCompiled();
+		/**
+		 * This method compiles each of the top-level expressions into a
+		 * program, if we're using bytecode - or we're told to - and we
+		 * haven't done it already.
+		 */
+		virtual void compilePrograms( bool aForce = false );
+		/**
+		 * If we're using the compile cache, this method moves the
+		 * compiled trees for the current source into the cache, and
+		 * returns 'true'. If not, it returns 'false' and leaves it all
+		 * as it is. It's the caller's job to lock the source.
+		 */
+		virtual bool stashTree( const std::string & aSource );
+		/**
+		 * If the provided source is in the compile cache, this method
+		 * moves it's compiled trees out of the cache and makes them the
+		 * current ones - setting the variables it defines just as a
+		 * compile would - and returns 'true'. It's the caller's job to
+		 * lock the source.
+		 */
+		virtual bool restoreTree( const std::string & aSource );
+		/**
+		 * When we're using threads, these methods build the plan for the
+		 * evaluation of the source - the waves of values that can all be
+		 * evaluated at once, where each only uses those in the waves before
+		 * it - drop it when the trees, or the variables, change, and then
+		 * run it, wave by wave, on the pool. The "_nl" means the caller
+		 * has to hold the expression lock.
+		 */
+		virtual void plan_nl();
+		virtual void dropPlan();
+		virtual void dropPlan_nl();
+		virtual bool runPlan_nl();
 
 		/*******************************************************************
 		 *
@@ -399,24 +744,24 @@ class parser
 		 */
 		virtual bool compile();
 		/**
-		 * This method assumes that the string starting at position
-		 * 'aPos' is the start of an expression, and will build up
-		 * the necessary expression and move the position of the
-		 * 'cursor' as the parsing continues. This will be called
+		 * This method assumes that the lexer has just handed out the
+		 * '(' that starts an expression, and will build up the
+		 * necessary expression from the tokens that follow it - up to,
+		 * and including, the matching ')'. This will be called
 		 * recursively to generate the complete, final expression for
 		 * the code starting at this point.
 		 */
-		virtual value *parseExpr( const std::string & aSrc, uint32_t & aPos );
+		virtual value *parseExpr( util::lexer & aLexer );
 		/**
-		 * This method assumes that it's pointing into the source
-		 * string just AFTER the '(set' part of a variable definition.
-		 * We need to finish parsing the variable name and value -
-		 * no matter how complex that value might be, and return it
-		 * as a new variable. The caller will be responsible for
-		 * deleting the variable when he's done with it or we will
+		 * This method assumes that the lexer has just handed out the
+		 * 'set' of a variable definition. We need to finish parsing
+		 * the variable name and value - no matter how complex that
+		 * value might be - up to, and including, the closing ')', and
+		 * return it as a new variable. The caller will be responsible
+		 * for deleting the variable when he's done with it or we will
 		 * leak.
 		 */
-		virtual variable *parseVariable( const std::string & aSrc, uint32_t & aPos );
+		virtual variable *parseVariable( util::lexer & aLexer );
 		/**
 		 * This method takes a parsed string (token) from the source
 		 * and depending on the state of the current expression we're
@@ -426,7 +771,7 @@ class parser
 		 * what's necessary to place the value/variable/etc. into
 		 * the expression properly;
 		 */
-		virtual bool handleToken( expression *anExpr, const std::string & aToken );
+		virtual bool handleToken( expression *anExpr, const boost::string_ref & aToken );
 		/**
 		 * This method looks at the provided string and attempts to
 		 * parse out a constant from it and return it as a new value
@@ -434,7 +779,62 @@ class parser
 		 * will return NULL, but if not-NULL, it is the responsibility
 		 * of the caller to delete the returned value or we will leak.
 		 */
-		virtual value *parseConst( const std::string & aToken );
+		virtual value *parseConst( const boost::string_ref & aToken );
+		/**
+		 * These methods parse the leading int, or double, out of the
+		 * token just as atoi() and atof() would - but right out of the
+		 * token, as it's not a NUL-terminated string of it's own.
+		 */
+		static int parseInt( const boost::string_ref & aToken );
+		static double parseDouble( const boost::string_ref & aToken );
+
+		/**
+		 * This method is called at the end of compile() and looks for
+		 * every sub-expression that is a pure function of nothing but
+		 * constants. Each one of these will always evaluate to the same
+		 * thing, so we evaluate it once, replace it in the tree with a
+		 * new constant, and delete the sub-expression. This is done all
+		 * the way up the tree, so that '(+ (* 2 3) 4)' ends up being
+		 * a single function call on constants.
+		 */
+		virtual void foldConstants();
+		/**
+		 * This method is called at the end of compile(), after the
+		 * constants are folded, and finds every sub-expression of a pure
+		 * function that's the same as another - the same function on the
+		 * same arguments - and has them all share the first one. That way,
+		 * the same '(/ x y)' in a dozen places is only calculated once for
+		 * each evaluation. The constants that are the same are shared as
+		 * well, so that the expressions on them can be.
+		 */
+		virtual void shareCommonSubExprs();
+		/**
+		 * This method is called at the very end of compile(), after the
+		 * sub-expressions are shared, and if we're using the fast paths,
+		 * gives every expression in the tree - and the definitions of the
+		 * variables 'aDefs' that the source sets - the fixed function that
+		 * fits the function and arguments it has, if there is one.
+		 */
+		virtual void useFixedFunctions( const std::vector<variable *> & aDefs );
+		/**
+		 * This method looks at the provided value and, if it's a
+		 * sub-expression that can be folded into a constant, returns
+		 * the new constant to use in it's place. If not, it returns
+		 * the value itself. Variables are never replaced, but if they
+		 * are defined by a constant expression, they will simply take
+		 * on that value. The map remembers what we've already looked
+		 * at so that shared values are only done once.
+		 */
+		virtual value *fold( value *aValue, value_set_t & aConsts,
+							 const value_set_t & aSubs, value_map_t & aFolded );
+		/**
+		 * This method folds all the arguments of the provided expression,
+		 * replacing them in the expression as needed, and then returns
+		 * 'true' if the expression is now a pure function of nothing
+		 * but constants - and can therefore be folded itself.
+		 */
+		virtual bool foldArgs( expression *anExpr, value_set_t & aConsts,
+							   const value_set_t & aSubs, value_map_t & aFolded );
 
 	private:
 		/**
@@ -445,16 +845,34 @@ class parser
 		 */
 		std::string						_src;
 		// ...and a simple spinlock to control access to it
-		mutable boost::detail::spinlock	_src_mutex;
+		mutable util::spinlock			_src_mutex;
 		/**
-		 * These are all the functions that this parser knows about - keyed
-		 * by their name. The value is a pointer to the function, but since
-		 * we are NOT doing memory management of these functions, we can
-		 * easily replace them without worrying about leaking.
+		 * This is the registry of functions - shared, and never changed -
+		 * that this parser uses, and the ones it's used before, that the
+		 * trees might still be using, until the functions are cleared.
+		 */
+		registry::ptr_t					_registry;
+		std::vector<registry::ptr_t>	_old_regs;
+		/**
+		 * These are the functions that this parser has of it's own - keyed
+		 * by their name - that are put over those of the registry. The
+		 * value is a pointer to the function, and they are all deleted
+		 * when the functions are cleared.
 		 */
 		fcn_map_t						_fcns;
-		// ...and a simple spinlock to control access to it
-		mutable boost::detail::spinlock	_fcns_mutex;
+		/**
+		 * This is the table the parser's own functions are looked up in
+		 * as the source is compiled - without the lock - before looking
+		 * in the registry. A name that's there with no function is one
+		 * that's been removed, and it hides the registry's as well. The
+		 * functions that have been replaced, or removed, are kept until
+		 * the functions are cleared, as one that was just looked up might
+		 * still be in use.
+		 */
+		util::table<function>			_fcn_table;
+		std::vector<function *>			_old_fcns;
+		// ...and a simple spinlock for the ones changing them
+		mutable util::spinlock			_fcns_mutex;
 		/**
 		 * These are all the variables that this parser knows about - keyed
 		 * on the name of the variable, which might also be in the variable,
@@ -463,8 +881,19 @@ class parser
 		 * the magic possible.
 		 */
 		var_map_t						_vars;
-		// ...and a simple spinlock to control access to it
-		mutable boost::detail::spinlock	_vars_mutex;
+		/**
+		 * This is the table of the variables by name, and by slot, that's
+		 * read without the lock - so finding a variable, and setting the
+		 * ones that are already there, never waits on anyone. A slot whose
+		 * variable has been removed is NULL until a variable of that name
+		 * is added again, and the removed variables are kept until they
+		 * are all cleared, as one that was just looked up might still be
+		 * getting set.
+		 */
+		util::table<variable>			_var_table;
+		std::vector<variable *>			_old_vars;
+		// ...and a simple spinlock for the ones adding, or removing, them
+		mutable util::spinlock			_vars_mutex;
 		/**
 		 * These are all the constants that we'll parse out of the source
 		 * code and need a place to hold them as they are referenced in
@@ -473,7 +902,7 @@ class parser
 		 */
 		var_list_t						_const;
 		// ...and a simple spinlock to control access to it
-		mutable boost::detail::spinlock	_const_mutex;
+		mutable util::spinlock			_const_mutex;
 		/**
 		 * These are all the expressions and sub-expressions that this
 		 * parser knows about - in two simple lists. These are created
@@ -483,8 +912,127 @@ class parser
 		 */
 		expr_list_t						_expr;
 		expr_list_t						_subs;
+		/**
+		 * If we're using bytecode, these are the compiled programs for
+		 * each of the top-level expressions, and they are protected by
+		 * the same lock as the expressions.
+		 */
+		prog_list_t						_progs;
+		bool							_bytecode;
+		/**
+		 * This is 'true' if the fixed functions are to be put in for the
+		 * general ones when the source is compiled. It's protected by the
+		 * same lock as the expressions.
+		 */
+		bool							_fast_paths;
+		/**
+		 * If we're using threads, this is the pool, and the plan for the
+		 * evaluation of the source on it - each value to evaluate, the
+		 * program to run in it's place, and where it's answer goes if it's
+		 * a top-level expression - and the waves of them, all ready to be
+		 * given to the pool. These are protected by the same lock as the
+		 * expressions.
+		 */
+		struct plan_task {
+			value		*val;
+			program		*prog;
+			int			slot;
+		};
+		/**
+		 * This is what the pool runs for each task in the plan - evaluate
+		 * the value, or run it's program, and if it's one of the top-level
+		 * expressions, put the answer where it goes.
+		 */
+		static void runTask( const plan_task *aTask, std::vector<value> *anAnswers );
+		util::pool										*_pool;
+		std::vector<plan_task>							_tasks;
+		std::vector<std::vector<boost::function<void ()> > >	_waves;
+		std::vector<value>								_answers;
+		bool											_planned;
+		/**
+		 * Every time the top-level expressions are replaced, this count is
+		 * bumped, so that the subscriptions to them know to look again. It's
+		 * protected by the same lock as the expressions.
+		 */
+		uint64_t						_tree_gen;
+		// ...and a simple spinlock to control access to it
+		mutable util::spinlock			_expr_mutex;
+		/**
+		 * These are the subscriptions to the variables and expressions -
+		 * the name of the variable, or the index of the expression, the
+		 * callback, the watcher that's a dependent of what it's watching,
+		 * the generation of the trees it's watching, and the last value
+		 * that the callback was given.
+		 */
+		struct subscription {
+			int						id;
+			std::string				name;
+			int						index;
+			change_callback_t		callback;
+			watcher					*watch;
+			uint64_t				gen;
+			value					last;
+		};
+		/**
+		 * This method points the watcher of the subscription at what it's
+		 * subscribed to, if it isn't already, and it's there. The caller
+		 * has to hold the expression, and subscription, locks.
+		 */
+		virtual void attach_nl( subscription & aSub );
+		/**
+		 * This is the work of notify() - but if it's for one of the changes
+		 * made with addVariable() or setVariable(), it doesn't compile a new
+		 * source, as that could fail, and the setter would throw. Until it's
+		 * compiled, by eval() or the caller's own notify(), the subscriptions
+		 * to expressions are left to be looked at then.
+		 */
+		virtual size_t notifyWatchers( bool aCompile );
+		std::vector<subscription>		_watches;
+		int								_next_watch;
+		// ...and a simple spinlock to control access to them
+		mutable util::spinlock			_watch_mutex;
+		/**
+		 * This is what we keep in the compile cache for each source -
+		 * the top-level expressions, any programs built from them, and
+		 * copies of the variables it sets, so that we can set them again
+		 * when it comes back out of the cache. The cache is kept in the
+		 * order the sources were last used, so the oldest can go when
+		 * it's full - and all of it is protected by the expression lock.
+		 */
+		struct cached_tree {
+			expr_list_t					expr;
+			prog_list_t					progs;
+			std::vector<variable *>		defs;
+		};
+		typedef std::list<std::string> source_list_t;
+		typedef boost::unordered_map<std::string, std::pair<cached_tree, source_list_t::iterator> > tree_cache_t;
+		tree_cache_t					_cache;
+		source_list_t					_cache_order;
+		size_t							_cache_size;
+		uint64_t						_cache_hits;
+		uint64_t						_cache_misses;
+		/**
+		 * As we compile, these are the variables that the source sets,
+		 * and when it's done, these are the copies of them that will go
+		 * into the cache, or an image, with the expressions.
+		 */
+		std::vector<variable *>			_set_vars;
+		std::vector<variable *>			_defs;
+		/**
+		 * These are the columns of data bound to the variables for batch
+		 * evaluation. The data is owned by the caller, we just hold onto
+		 * where it is.
+		 */
+		program::column_map_t			_cols;
 		// ...and a simple spinlock to control access to it
-		mutable boost::detail::spinlock	_expr_mutex;
+		mutable util::spinlock			_cols_mutex;
+		/**
+		 * All the values, variables and expressions that we create from
+		 * the source come from this arena, so that the nodes of a tree
+		 * are close together in memory, and it can all be released at
+		 * once when the parser is cleared. It has it's own lock.
+		 */
+		util::arena						_arena;
 };
 }		// end of namespace lkit
 
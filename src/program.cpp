@@ -0,0 +1,1603 @@
+/**
+ * program.cpp - this file implements a compiled, flattened, form of a language
+ *               tree. The tree of expressions is walked once, and turned
+ *               into a simple list of instructions that are then run by a
+ *               tight loop over a stack of values. The built-in functions
+ *               have their own instructions, and everything else is just a
+ *               call to the function on the values on the stack.
+ */
+
+//	System Headers
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <typeinfo>
+
+//	Third-Party Headers
+#include <boost/foreach.hpp>
+
+//	Other Headers
+#include "program.h"
+#include "array.h"
+#include "kernels.h"
+#include "base_functions.h"
+#include "expression.h"
+#include "jit.h"
+#include "variable.h"
+
+//	Forward Declarations
+
+//	Private Constants
+/**
+ * When running a batch, we do this many rows at a time. It's big enough
+ * to make the dispatch of each instruction insignificant, and small
+ * enough that the stack stays in the cache.
+ */
+static const size_t	__block = 256;
+/**
+ * When LKit is built with LKIT_JIT, a program is compiled to native code
+ * after it's been run this many times with the instructions - and the
+ * native code is dropped after it's given up on this many runs in a row.
+ * A program is only built a few times, so one that keeps changing types
+ * isn't compiled over and over.
+ */
+#ifdef LKIT_JIT
+static const uint32_t	__jit_threshold = 100;
+static const uint32_t	__jit_builds = 3;
+#endif
+
+//	Private Datatypes
+
+//	Private Data Constants
+
+
+
+/**
+ * Make it easy to reference the spinlock and it's scoped lock. They
+ * are both in the lkit::util namespace, and it's just going to make
+ * the code a little cleaner.
+ */
+using lkit::util::spinlock;
+
+namespace lkit {
+/**
+ * This takes the op code of an arithmetic instruction, and runs the
+ * kernel for it on the two lanes. The overloads of the kernels take
+ * care of the types, and which is converted to what.
+ */
+template <class A, class B> static void arith( program::op_code anOp, A *a, const B *b, size_t n )
+{
+	switch (anOp) {
+		case program::eSum:
+			kernels::add(a, b, n);
+			break;
+		case program::eDiff:
+			kernels::sub(a, b, n);
+			break;
+		case program::eProd:
+			kernels::mul(a, b, n);
+			break;
+		case program::eQuot:
+			kernels::div(a, b, n);
+			break;
+		default:
+			break;
+	}
+}
+
+
+template <class A> static void arith( program::op_code anOp, A *a, const A *b, size_t n )
+{
+	switch (anOp) {
+		case program::eSum:
+			kernels::add(a, b, n);
+			break;
+		case program::eDiff:
+			kernels::sub(a, b, n);
+			break;
+		case program::eProd:
+			kernels::mul(a, b, n);
+			break;
+		case program::eQuot:
+			kernels::div(a, b, n);
+			break;
+		case program::eMax:
+			kernels::max(a, b, n);
+			break;
+		case program::eMin:
+			kernels::min(a, b, n);
+			break;
+		default:
+			break;
+	}
+}
+
+
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This is the default constructor that assumes NOTHING - it just
+ * makes an empty program ready to have an expression compiled
+ * into it.
+ */
+program::program() :
+	_code(),
+	_consts(),
+	_vars(),
+	_depth(0),
+	_generation(0),
+	_ctx(),
+	_native(NULL),
+	_hits(0),
+	_bails(0),
+	_builds(0),
+	_mutex()
+{
+}
+
+
+/**
+ * This constructor takes the root of a language tree and compiles
+ * it into this program. If that can't be done, then an exception
+ * will be thrown.
+ */
+program::program( value *aRoot ) :
+	_code(),
+	_consts(),
+	_vars(),
+	_depth(0),
+	_generation(0),
+	_ctx(),
+	_native(NULL),
+	_hits(0),
+	_bails(0),
+	_builds(0),
+	_mutex()
+{
+	if (!compile(aRoot)) {
+		throw std::runtime_error("[program::program] unable to compile the provided language tree!");
+	}
+}
+
+
+/**
+ * This is the standard copy constructor that needs to be in every
+ * class to make sure that we control how many copies we have
+ * floating around in the system.
+ */
+program::program( const program & anOther ) :
+	_code(),
+	_consts(),
+	_vars(),
+	_depth(0),
+	_generation(0),
+	_ctx(),
+	_native(NULL),
+	_hits(0),
+	_bails(0),
+	_builds(0),
+	_mutex()
+{
+	// let the '=' operator do the heavy lifting...
+	*this = anOther;
+}
+
+
+/**
+ * This is the standard destructor and needs to be virtual to make
+ * sure that if we subclass off this, the right destructor will be
+ * called.
+ */
+program::~program()
+{
+	// the values and functions aren't ours, but the native code is
+	dropNative_nl();
+}
+
+
+/**
+ * When we process the result of an equality we need to make sure
+ * that we do this right by always having an equals operator on
+ * all classes.
+ */
+program & program::operator=( const program & anOther )
+{
+	if (this != & anOther) {
+		spinlock::scoped_lock	lock(_mutex);
+		spinlock::scoped_lock	otherLock(anOther._mutex);
+		_code = anOther._code;
+		_consts = anOther._consts;
+		_vars = anOther._vars;
+		_depth = anOther._depth;
+		dropNative_nl();
+		// any context that was ready for what we had isn't now
+		++_generation;
+	}
+	return *this;
+}
+
+
+/*******************************************************************
+ *
+ *                        Accessor Methods
+ *
+ *******************************************************************/
+/**
+ * This method takes the root of a language tree and walks it,
+ * building up the list of instructions that will calculate the
+ * same value as evaluating the tree. This replaces anything that
+ * was in the program. The values and functions in the tree are
+ * only referenced, so they have to outlive this program.
+ */
+bool program::compile( value *aRoot )
+{
+	bool		error = false;
+	if (aRoot == NULL) {
+		error = true;
+	} else {
+		spinlock::scoped_lock	lock(_mutex);
+		_code.clear();
+		_consts.clear();
+		_vars.clear();
+		_depth = 0;
+		dropNative_nl();
+		emit_nl(aRoot, 0);
+		/**
+		 * Give each different constant, and variable, a slot in the order
+		 * they are first pushed - so that the contexts can hold their
+		 * values in simple arrays.
+		 */
+		boost::unordered_map<value *, uint32_t>	slots;
+		for (size_t pc = 0; pc < _code.size(); ++pc) {
+			instruction		& in = _code[pc];
+			if ((in.op == ePushValue) || (in.op == ePushVariable)) {
+				std::vector<value *>	& list = (in.op == ePushValue ? _consts : _vars);
+				boost::unordered_map<value *, uint32_t>::iterator	it = slots.find(in.arg);
+				if (it == slots.end()) {
+					it = slots.insert(std::make_pair(in.arg, (uint32_t)list.size())).first;
+					list.push_back(in.arg);
+				}
+				in.count = it->second;
+			}
+		}
+		++_generation;
+	}
+	return !error;
+}
+
+
+/**
+ * This method returns 'true' if there's a compiled program
+ * ready to be evaluated.
+ */
+bool program::isCompiled() const
+{
+	spinlock::scoped_lock	lock(_mutex);
+	return !_code.empty();
+}
+
+
+/**
+ * This method clears out the program so that it's empty, and
+ * will return an undefined value when evaluated.
+ */
+void program::clear()
+{
+	spinlock::scoped_lock	lock(_mutex);
+	_code.clear();
+	_consts.clear();
+	_vars.clear();
+	_depth = 0;
+	dropNative_nl();
+	++_generation;
+	_ctx = context();
+}
+
+
+/**
+ * This method returns the actual reference to the list of
+ * instructions for this program. This is really just for
+ * debugging, and care should be taken with it.
+ */
+const std::vector<program::instruction> & program::getCode() const
+{
+	return _code;
+}
+
+
+/**
+ * Each different variable the program uses has a slot, numbered
+ * from zero in the order they are first used, and this is the
+ * number of them - which is the number of slots in a context for
+ * this program.
+ */
+size_t program::getSlotCount() const
+{
+	spinlock::scoped_lock	lock(_mutex);
+	return _vars.size();
+}
+
+
+/**
+ * This method returns the slot of the variable with the provided
+ * name, or -1 if the program doesn't use it. This is done once,
+ * so that each thread can set the variable in it's context with
+ * the slot, and not the name.
+ */
+int program::getSlot( const std::string & aName ) const
+{
+	spinlock::scoped_lock	lock(_mutex);
+	int		slot = -1;
+	for (size_t i = 0; (slot < 0) && (i < _vars.size()); ++i) {
+		if (((variable *)_vars[i])->getName() == aName) {
+			slot = (int)i;
+		}
+	}
+	return slot;
+}
+
+
+/**
+ * When LKit is built with LKIT_JIT defined, a program that's been
+ * run enough times is compiled to native code, and this method
+ * returns 'true' if that's what eval() is running now. Without the
+ * define, this is always 'false'.
+ */
+bool program::isNative() const
+{
+	spinlock::scoped_lock	lock(_mutex);
+	return (_native != NULL);
+}
+
+
+/*******************************************************************
+ *
+ *                       Evaluation Methods
+ *
+ *******************************************************************/
+/**
+ * This method runs the instructions of the program, and returns
+ * the value left on the top of the stack. This will be the same
+ * value that evaluating the original tree would have returned.
+ *
+ * When LKit is built with LKIT_JIT defined, once the program has
+ * been run this way enough times, it's compiled to native code,
+ * if it can be, and that's what's run from then on. If the native
+ * code can't handle a run - a value has changed type, say - the
+ * instructions are run instead, and if that keeps happening, the
+ * native code is dropped, and built again for the new types.
+ */
+value program::eval()
+{
+	spinlock::scoped_lock	lock(_mutex);
+	value		retval;
+	if (!_code.empty()) {
+		bool	done = false;
+#ifdef LKIT_JIT
+		// a program that's hot enough is compiled - if it can't be, it never will be
+		if ((_native == NULL) && (_builds < __jit_builds) && (++_hits >= __jit_threshold)) {
+			_hits = 0;
+			++_builds;
+			if ((_native = jit::build(_code, _consts, _vars)) == NULL) {
+				_builds = __jit_builds;
+			}
+		}
+		if (_native != NULL) {
+			if (_native->run(_consts, _vars, retval)) {
+				_bails = 0;
+				done = true;
+			} else if (++_bails >= __jit_threshold) {
+				// it's not what it was built for any more, so start over
+				delete _native;
+				_native = NULL;
+				_bails = 0;
+			}
+		}
+#endif
+		if (!done) {
+			if (!isReady(_ctx)) {
+				prepare_nl(_ctx, true);
+			}
+			setStride(_ctx, 1);
+			exec(_ctx, 1, 0, NULL);
+			retval = _ctx._stack[0];
+		}
+	}
+	return retval;
+}
+
+
+/**
+ * This method runs the program over 'aRows' rows of data in one
+ * call. Each variable in the map takes it's values from the bound
+ * column, and the result for each row is placed in 'aResults',
+ * which has to have room for all the rows. The instructions are
+ * run a block of rows at a time, so the dispatch is paid once for
+ * the block, and not once for each row.
+ *
+ * If the program uses a variable that's not bound, and is defined
+ * by an expression - or an array with something else - we can't
+ * know if it depends on the columns, so we have to set the bound
+ * variables and run the program one row at a time - which leaves
+ * them with the values of the last row.
+ */
+bool program::eval( size_t aRows, const column_map_t & aColumns, value *aResults )
+{
+	bool		error = false;
+	spinlock::scoped_lock	lock(_mutex);
+	if (_code.empty() || (aResults == NULL)) {
+		error = true;
+	}
+
+	/**
+	 * Find the column for each variable that's pushed - once for the
+	 * whole batch - and see if there's anything that will keep us from
+	 * doing it a block of rows at a time.
+	 */
+	std::vector<const column *>	cols;
+	bool						byRow = false;
+	if (!error) {
+		cols.resize(_code.size(), NULL);
+		for (size_t pc = 0; pc < _code.size(); ++pc) {
+			if (_code[pc].op == ePushVariable) {
+				column_map_t::const_iterator	it = aColumns.find(_code[pc].arg);
+				if (it != aColumns.end()) {
+					cols[pc] = &it->second;
+				} else if (((variable *)_code[pc].arg)->getExpr() != NULL) {
+					byRow = true;
+				}
+			} else if (_code[pc].op == ePushTree) {
+				// if it's not all arrays, it might depend on the columns
+				BOOST_FOREACH( value *v, ((expression *)_code[pc].arg)->getArgs() ) {
+					if ((v != NULL) && (array::getArray(v) == NULL)) {
+						byRow = true;
+					}
+				}
+			}
+		}
+	}
+
+	if (!error && !isReady(_ctx)) {
+		prepare_nl(_ctx, true);
+	}
+	if (!error && !byRow) {
+		setStride(_ctx, __block);
+		for (size_t start = 0; start < aRows; start += __block) {
+			size_t	n = ((aRows - start) < __block ? (aRows - start) : __block);
+			exec(_ctx, n, start, &cols[0]);
+			for (size_t r = 0; r < n; ++r) {
+				aResults[start + r] = _ctx._stack[r];
+			}
+		}
+	} else if (!error) {
+		setStride(_ctx, 1);
+		for (size_t r = 0; r < aRows; ++r) {
+			// set each of the bound variables for this row
+			for (column_map_t::const_iterator it = aColumns.begin(); it != aColumns.end(); ++it) {
+				const void	*data = it->second.data;
+				switch (it->second.type) {
+					case value::eBool:
+						it->first->set(((const bool *)data)[r]);
+						break;
+					case value::eInt:
+						it->first->set(((const int *)data)[r]);
+						break;
+					case value::eDouble:
+						it->first->set(((const double *)data)[r]);
+						break;
+					case value::eTime:
+						it->first->set(((const uint64_t *)data)[r]);
+						break;
+					default:
+						break;
+				}
+			}
+			exec(_ctx, 1, 0, NULL);
+			aResults[r] = _ctx._stack[0];
+		}
+	}
+	return !error;
+}
+
+
+/**
+ * This method runs the program with the provided context, and
+ * returns the value left on the top of it's stack. The program is
+ * not changed, and isn't locked, so any number of threads can run
+ * it at once - each with it's own context. The variables that are
+ * bound in the context use those values, and the constants were
+ * copied into it when it was prepared, so unless a variable is
+ * left unbound, nothing shared is touched. If the context isn't
+ * ready for this program, it's prepared first.
+ *
+ * The program can't be compiled, or cleared, while this is going
+ * on - that's up to the caller.
+ */
+value program::eval( context & aContext ) const
+{
+	value		retval;
+	if (!_code.empty()) {
+		if (!isReady(aContext)) {
+			aContext.prepare(*this);
+		}
+		setStride(aContext, 1);
+		exec(aContext, 1, 0, NULL);
+		retval = aContext._stack[0];
+	}
+	return retval;
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string program::toString() const
+{
+	static const char	*__names[] = { "push", "pushv", "pusht", "max", "min", "sum",
+									   "diff", "prod", "quot", "comp", "bin",
+									   "step", "skip", "select", "call" };
+	spinlock::scoped_lock	lock(_mutex);
+	std::ostringstream	msg;
+	msg << "[program stack=" << _depth << " code=(";
+	for (size_t i = 0; i < _code.size(); ++i) {
+		const instruction	& in = _code[i];
+		if (i > 0) {
+			msg << ", ";
+		}
+		msg << __names[in.op];
+		switch (in.op) {
+			case ePushValue:
+			case ePushVariable:
+			case ePushTree:
+				msg << " " << in.arg->toString();
+				break;
+			case eCall:
+				msg << "/" << in.count << " " << in.fcn->toString();
+				break;
+			case eComp:
+			case eBin:
+				msg << "." << in.kind << "/" << in.count;
+				break;
+			case eStep:
+				msg << "." << in.step.kind << (in.step.last ? "$" : "") << "/" << in.count;
+				break;
+			case eSkip:
+				msg << "." << in.skip.mode << "@" << in.skip.back << "/" << in.count;
+				break;
+			default:
+				msg << "/" << in.count;
+				break;
+		}
+	}
+	msg << ")]";
+	return msg.str();
+}
+
+
+/*******************************************************************
+ *
+ *                   Compiling/Evaluation Methods
+ *
+ *******************************************************************/
+/**
+ * This method adds the instructions for the provided value to the
+ * end of the program. For an expression, that's the instructions
+ * for each of the arguments, and then the one for the function.
+ * The depth is the number of values on the stack before we start,
+ * so that we know how big a stack the program is going to need.
+ * The "_nl" means the caller has to handle the locking.
+ */
+void program::emit_nl( value *aValue, uint32_t aDepth )
+{
+	// make sure the stack is deep enough for what we're pushing
+	if (_depth <= aDepth) {
+		_depth = aDepth + 1;
+	}
+
+	function	*f = NULL;
+	if (aValue->isExpression() &&
+		((f = ((expression *)aValue)->getFunction()) != NULL)) {
+		/**
+		 * Push each of the arguments in order - skipping the NULLs as
+		 * the functions do - and then finish with the function itself.
+		 * The lazy functions only run the arguments they need, so they
+		 * have skips in with the code for their arguments.
+		 */
+		std::vector<value *>	args;
+		bool					arrays = false;
+		bool					later = false;
+		BOOST_FOREACH( value *v, ((expression *)aValue)->getArgs() ) {
+			if (v != NULL) {
+				args.push_back(v);
+				arrays = arrays || (array::getArray(v) != NULL);
+				// a comp only has something to skip if it's past the second
+				later = later || ((args.size() > 2) && v->isExpression());
+			}
+		}
+		const std::type_info	& t = typeid(*f);
+		if (arrays) {
+			/**
+			 * An array can't go on the stack, so anything that works on
+			 * one is left to the tree - and it's answer is pushed.
+			 */
+			instruction		in;
+			in.op = ePushTree;
+			in.count = 0;
+			in.arg = aValue;
+			_code.push_back(in);
+		} else if ((t == typeid(func::bin)) && (((func::bin *)f)->getType() != func::bin::eNot) &&
+			(args.size() > 1)) {
+			emitChain_nl(f, args, aDepth);
+		} else if ((t == typeid(func::cond)) && !args.empty()) {
+			emitCond_nl(args, 0, aDepth);
+		} else if ((t == typeid(func::comp)) && later) {
+			emitCompare_nl(f, args, aDepth);
+		} else {
+			uint32_t	cnt = 0;
+			BOOST_FOREACH( value *v, args ) {
+				emit_nl(v, aDepth + cnt);
+				++cnt;
+			}
+			emitFunction_nl(f, cnt);
+		}
+	} else {
+		/**
+		 * Anything else is just a value. Simple values are copied onto
+		 * the stack, but variables (which might be defined by an
+		 * expression) need to be evaluated.
+		 */
+		instruction		in;
+		in.op = (aValue->isVariable() ? ePushVariable : ePushValue);
+		in.count = 0;
+		in.arg = aValue;
+		_code.push_back(in);
+	}
+}
+
+
+/**
+ * This method adds the instruction for the function of an
+ * expression to the end of the program, and picks out the
+ * built-in functions that have their own op codes. The "_nl"
+ * means the caller has to handle the locking.
+ */
+void program::emitFunction_nl( function *aFunction, uint32_t aCount )
+{
+	instruction		in;
+	in.count = aCount;
+	in.fcn = aFunction;
+	/**
+	 * We only use the op codes for the EXACT built-in classes, as a
+	 * subclass may well be doing something different in it's eval().
+	 */
+	const std::type_info	& t = typeid(*aFunction);
+	if (t == typeid(func::max)) {
+		in.op = eMax;
+	} else if (t == typeid(func::min)) {
+		in.op = eMin;
+	} else if (t == typeid(func::sum)) {
+		in.op = eSum;
+	} else if (t == typeid(func::diff)) {
+		in.op = eDiff;
+	} else if (t == typeid(func::prod)) {
+		in.op = eProd;
+	} else if (t == typeid(func::quot)) {
+		in.op = eQuot;
+	} else if (t == typeid(func::comp)) {
+		in.op = eComp;
+		in.kind = ((func::comp *)aFunction)->getType();
+	} else if (t == typeid(func::bin)) {
+		in.op = eBin;
+		in.kind = ((func::bin *)aFunction)->getType();
+	} else {
+		in.op = eCall;
+	}
+	_code.push_back(in);
+}
+
+
+/**
+ * These methods add the instructions for the lazy functions - an
+ * 'and' or 'or' of two or more arguments, and a 'cond' - where
+ * each argument after the first is behind a skip, so that it's
+ * only run if it's needed to get the answer. The "_nl" means the
+ * caller has to handle the locking.
+ */
+void program::emitChain_nl( function *aFunction, const std::vector<value *> & anArgs, uint32_t aDepth )
+{
+	/**
+	 * The first argument is made a bool (or undefined) on it's own, and
+	 * then each of the rest is folded into it, two at a time - which is
+	 * the same answer as doing them all at once. Once it's false, for an
+	 * 'and', or true, for an 'or', the rest are skipped, and what's folded
+	 * in is undefined, which leaves it alone.
+	 */
+	skip_mode	mode = (((func::bin *)aFunction)->getType() == func::bin::eAnd ?
+							eSkipIfFalse : eSkipIfTrue);
+	emit_nl(anArgs[0], aDepth);
+	emitFunction_nl(aFunction, 1);
+	for (size_t i = 1; i < anArgs.size(); ++i) {
+		size_t	pc = emitSkip_nl(mode, 1);
+		emit_nl(anArgs[i], aDepth + 1);
+		_code[pc].count = (uint32_t)(_code.size() - pc - 1);
+		emitFunction_nl(aFunction, 2);
+	}
+}
+
+
+void program::emitCond_nl( const std::vector<value *> & anArgs, size_t aStart, uint32_t aDepth )
+{
+	if (aStart + 1 == anArgs.size()) {
+		// the odd one at the end is the value if none of the tests are true
+		emit_nl(anArgs[aStart], aDepth);
+	} else {
+		/**
+		 * This is the test, the 'then' - which is skipped if no row has
+		 * the test true, and the 'else' - the rest of the pairs, which is
+		 * skipped if every row does. Then the select picks for each row.
+		 */
+		emit_nl(anArgs[aStart], aDepth);
+		size_t	pc = emitSkip_nl(eSkipUnlessTrue, 1);
+		emit_nl(anArgs[aStart + 1], aDepth + 1);
+		_code[pc].count = (uint32_t)(_code.size() - pc - 1);
+		uint32_t	cnt = 2;
+		if (aStart + 2 < anArgs.size()) {
+			pc = emitSkip_nl(eSkipIfTrue, 2);
+			emitCond_nl(anArgs, aStart + 2, aDepth + 2);
+			_code[pc].count = (uint32_t)(_code.size() - pc - 1);
+			++cnt;
+		}
+		instruction		in;
+		in.op = eSelect;
+		in.count = cnt;
+		in.arg = NULL;
+		_code.push_back(in);
+	}
+}
+
+
+/**
+ * This method adds the instructions for a comparison of three or
+ * more arguments, where one of them past the second needs to be
+ * evaluated. It's a step for each argument after the first, and
+ * once it's false, the rest are skipped, as the comp stops at the
+ * first pair that fails. The "_nl" means the caller has to handle
+ * the locking.
+ */
+void program::emitCompare_nl( function *aFunction, const std::vector<value *> & anArgs, uint32_t aDepth )
+{
+	/**
+	 * The first step compares the first two arguments, and leaves the
+	 * answer under what the next one is compared against - which moves
+	 * along for the ordered comparisons. The answer is undefined until
+	 * a defined argument has been compared, as the comp's is, and the
+	 * skips are there for when it's false.
+	 */
+	instruction		in;
+	in.op = eStep;
+	in.count = 2;
+	in.step.kind = ((func::comp *)aFunction)->getType();
+	in.step.last = 0;
+	emit_nl(anArgs[0], aDepth);
+	emit_nl(anArgs[1], aDepth + 1);
+	_code.push_back(in);
+	in.count = 3;
+	for (size_t i = 2; i < anArgs.size(); ++i) {
+		size_t	pc = emitSkip_nl(eSkipIfFalse, 2);
+		emit_nl(anArgs[i], aDepth + 2);
+		_code[pc].count = (uint32_t)(_code.size() - pc - 1);
+		in.step.last = (i + 1 == anArgs.size() ? 1 : 0);
+		_code.push_back(in);
+	}
+}
+
+
+/**
+ * This method adds a skip to the end of the program, for the code
+ * of the expression that's about to be added, and returns where
+ * it is, so that the number of instructions to skip can be filled
+ * in once that code is done.
+ */
+size_t program::emitSkip_nl( skip_mode aMode, uint32_t aBack )
+{
+	instruction		in;
+	in.op = eSkip;
+	in.count = 0;
+	in.skip.mode = aMode;
+	in.skip.back = aBack;
+	_code.push_back(in);
+	return (_code.size() - 1);
+}
+
+/**
+ * This method gets the context ready to run this program. If
+ * it's 'live', the constants aren't copied, and are read from the
+ * program's values each time - so that it picks up the changes in
+ * them, as the tree would. The "_nl" means the caller has to handle
+ * the locking.
+ */
+void program::prepare_nl( context & aContext, bool aLive ) const
+{
+	aContext._program = this;
+	aContext._generation = _generation;
+	aContext._live = aLive;
+	aContext._consts.clear();
+	if (!aLive) {
+		BOOST_FOREACH( value *v, _consts ) {
+			aContext._consts.push_back(v->getDatum());
+		}
+	}
+	aContext._vars.clear();
+	aContext._vars.resize(_vars.size(), value().getDatum());
+	aContext._bound.assign(_vars.size(), false);
+	// the stack needs to be set up again as well
+	aContext._stride = 0;
+	aContext._stack.clear();
+}
+
+
+/**
+ * This method returns 'true' if the context has been prepared for
+ * this program, as it is now, and can be run with it.
+ */
+bool program::isReady( const context & aContext ) const
+{
+	return ((aContext._program == this) &&
+			(aContext._generation == _generation) &&
+			(aContext._vars.size() == _vars.size()) &&
+			(aContext._live || (aContext._consts.size() == _consts.size())));
+}
+
+
+/**
+ * This method makes sure that the stack of the context is set up
+ * to hold the values for 'aStride' rows in each slot.
+ */
+void program::setStride( context & aContext, size_t aStride ) const
+{
+	if ((aContext._stride != aStride) || (aContext._stack.size() != _depth * aStride)) {
+		aContext._stride = aStride;
+		aContext._stack.clear();
+		aContext._stack.resize(_depth * aContext._stride);
+		// ...and the lanes for the slots start out empty as well
+		aContext._kinds.assign(_depth, value::eUnknown);
+		aContext._dbls.resize(_depth * aContext._stride);
+		aContext._ints.resize(_depth * aContext._stride);
+		aContext._mask.resize(aContext._stride);
+	}
+}
+
+
+/**
+ * This method runs all the instructions of the program on 'aRows'
+ * rows at once with the provided context. If there are columns
+ * for the pushed variables, they will be in 'aCols' - indexed by
+ * the instruction - starting at row 'aStart' in the column. When
+ * it's done, the answers are in the first slot of the stack.
+ */
+void program::exec( context & aContext, size_t aRows, size_t aStart, const column * const *aCols ) const
+{
+	// with columns, the slots that are all one type can be in the lanes
+	bool		typed = (aCols != NULL);
+	size_t		sp = 0;
+	size_t		sz = _code.size();
+	for (size_t pc = 0; pc < sz; ++pc) {
+		const instruction	& in = _code[pc];
+		/**
+		 * The pushes are easy - everything else works on the 'count'
+		 * slots on the top of the stack, and leaves the result in the
+		 * first of them. With no arguments, the answer is undefined.
+		 */
+		if (in.op == ePushValue) {
+			// a live context doesn't have copies of the constants
+			datum	src = (aContext._live ? in.arg->getDatum() : aContext._consts[in.count]);
+			if (!typed || !fill(aContext, sp, src, aRows)) {
+				datum	*top = &aContext._stack[sp * aContext._stride];
+				for (size_t r = 0; r < aRows; ++r) {
+					top[r] = src;
+				}
+			}
+			++sp;
+			continue;
+		} else if (in.op == ePushVariable) {
+			if ((aCols != NULL) && (aCols[pc] != NULL)) {
+				if (!fill(aContext, sp, *aCols[pc], aStart, aRows)) {
+					datum	*top = &aContext._stack[sp * aContext._stride];
+					for (size_t r = 0; r < aRows; ++r) {
+						load(top[r], *aCols[pc], aStart + r);
+					}
+				}
+			} else {
+				// it's the same for every row, so get it once
+				datum	v = (aContext._bound[in.count] ? aContext._vars[in.count] : in.arg->eval().getDatum());
+				if (!typed || !fill(aContext, sp, v, aRows)) {
+					datum	*top = &aContext._stack[sp * aContext._stride];
+					for (size_t r = 0; r < aRows; ++r) {
+						top[r] = v;
+					}
+				}
+			}
+			++sp;
+			continue;
+		} else if (in.op == ePushTree) {
+			// it's the same for every row, so get it once
+			datum	v = in.arg->eval().getDatum();
+			if (!typed || !fill(aContext, sp, v, aRows)) {
+				datum	*top = &aContext._stack[sp * aContext._stride];
+				for (size_t r = 0; r < aRows; ++r) {
+					top[r] = v;
+				}
+			}
+			++sp;
+			continue;
+		} else if (in.op == eStep) {
+			/**
+			 * The answer so far is false once a pair fails, and undefined
+			 * until a defined argument has been compared. The argument on
+			 * the top is folded into it, and takes the place of what it was
+			 * compared against, for the ordered comparisons.
+			 */
+			sp -= in.count;
+			if (typed) {
+				for (uint32_t i = 0; i < in.count; ++i) {
+					spill(aContext, sp + i, aRows);
+				}
+			}
+			bool	first = (in.count == 2);
+			bool	ordered = ((in.step.kind != func::comp::eEquals) &&
+							   (in.step.kind != func::comp::eNotEquals));
+			datum	*ans = &aContext._stack[sp * aContext._stride];
+			datum	*opd = &aContext._stack[(sp + 1) * aContext._stride];
+			const datum	*from = (first ? ans : opd);
+			const datum	*v = &aContext._stack[(sp + in.count - 1) * aContext._stride];
+			value	& acc = aContext._scratch;
+			for (size_t r = 0; r < aRows; ++r) {
+				datum	test = ans[r];
+				datum	next = from[r];
+				if (first) {
+					test.type = value::eUnknown;
+				}
+				bool	failed = ((test.type == value::eBool) && !test.boolValue);
+				if (!failed && (v[r].type != value::eUnknown)) {
+					acc = from[r];
+					bool	comp = true;
+					switch (in.step.kind) {
+						case func::comp::eEquals :
+							comp = (acc == v[r]);
+							break;
+						case func::comp::eNotEquals :
+							comp = (acc != v[r]);
+							break;
+						case func::comp::eLessThan :
+							comp = (acc < v[r]);
+							break;
+						case func::comp::eGreaterThan :
+							comp = (acc > v[r]);
+							break;
+						case func::comp::eLessOrEqual :
+							comp = (acc <= v[r]);
+							break;
+						case func::comp::eGreaterOrEqual :
+							comp = (acc >= v[r]);
+							break;
+					}
+					test.type = value::eBool;
+					test.boolValue = comp;
+					if (ordered) {
+						next = v[r];
+					}
+				}
+				ans[r] = test;
+				opd[r] = next;
+			}
+			sp += (in.step.last ? 1 : 2);
+			continue;
+		} else if (in.op == eSkip) {
+			// the expression isn't needed if the test holds for every row
+			size_t	slot = sp - in.skip.back;
+			if (typed) {
+				spill(aContext, slot, aRows);
+				aContext._kinds[slot] = value::eUnknown;
+			}
+			const datum	*test = &aContext._stack[slot * aContext._stride];
+			bool	skip = true;
+			for (size_t r = 0; skip && (r < aRows); ++r) {
+				bool	defined = (test[r].type != value::eUnknown);
+				switch (in.skip.mode) {
+					case eSkipIfFalse:
+						skip = (defined && !isTrue(test[r]));
+						break;
+					case eSkipIfTrue:
+						skip = (defined && isTrue(test[r]));
+						break;
+					case eSkipUnlessTrue:
+						skip = (!defined || !isTrue(test[r]));
+						break;
+				}
+			}
+			if (skip) {
+				// ...so put an undefined value in it's place, and jump over it
+				datum	*top = &aContext._stack[sp * aContext._stride];
+				for (size_t r = 0; r < aRows; ++r) {
+					top[r].type = value::eUnknown;
+				}
+				if (typed) {
+					aContext._kinds[sp] = value::eUnknown;
+				}
+				++sp;
+				pc += in.count;
+			}
+			continue;
+		}
+		sp -= in.count;
+		/**
+		 * If the arguments are all in lanes, see if the kernels can do
+		 * this instruction. If not, everything has to be on the stack as
+		 * datums for the code below, and so does the answer.
+		 */
+		if (typed) {
+			if (vector(aContext, in, sp, aRows)) {
+				++sp;
+				continue;
+			}
+			for (uint32_t i = 0; i < in.count; ++i) {
+				spill(aContext, sp + i, aRows);
+			}
+			aContext._kinds[sp] = value::eUnknown;
+		}
+		datum	*ans = &aContext._stack[sp * aContext._stride];
+		if ((in.count == 0) && (in.op != eCall)) {
+			for (size_t r = 0; r < aRows; ++r) {
+				ans[r].type = value::eUnknown;
+			}
+			++sp;
+			continue;
+		}
+		// the operators work on the scratch value, so they act as on values
+		value	& acc = aContext._scratch;
+		switch (in.op) {
+			case eMax:
+				for (uint32_t i = 1; i < in.count; ++i) {
+					const datum	*v = &aContext._stack[(sp + i) * aContext._stride];
+					for (size_t r = 0; r < aRows; ++r) {
+						if (v[r].type != value::eUnknown) {
+							acc = v[r];
+							if (acc > ans[r]) {
+								ans[r] = v[r];
+							}
+						}
+					}
+				}
+				break;
+			case eMin:
+				for (uint32_t i = 1; i < in.count; ++i) {
+					const datum	*v = &aContext._stack[(sp + i) * aContext._stride];
+					for (size_t r = 0; r < aRows; ++r) {
+						if (v[r].type != value::eUnknown) {
+							acc = v[r];
+							if (acc < ans[r]) {
+								ans[r] = v[r];
+							}
+						}
+					}
+				}
+				break;
+			case eSum:
+			case eDiff:
+			case eProd:
+			case eQuot:
+				for (size_t r = 0; r < aRows; ++r) {
+					acc = ans[r];
+					if ((in.op == eDiff) && (in.count == 1)) {
+						// unary minus - just negate what we have
+						acc *= -1;
+					}
+					for (uint32_t i = 1; i < in.count; ++i) {
+						const datum	& v = aContext._stack[(sp + i) * aContext._stride + r];
+						if (v.type == value::eUnknown) {
+							continue;
+						}
+						switch (in.op) {
+							case eSum:
+								acc += v;
+								break;
+							case eDiff:
+								acc -= v;
+								break;
+							case eProd:
+								acc *= v;
+								break;
+							default:
+								acc /= v;
+								break;
+						}
+					}
+					ans[r] = acc.getDatum();
+				}
+				break;
+			case eComp:
+				for (size_t r = 0; r < aRows; ++r) {
+					// the first value is what we compare against
+					acc = ans[r];
+					bool	comp = true;
+					size_t	cnt = 0;
+					for (uint32_t i = 1; comp && (i < in.count); ++i) {
+						const datum	& v = aContext._stack[(sp + i) * aContext._stride + r];
+						if (v.type == value::eUnknown) {
+							continue;
+						}
+						++cnt;
+						switch (in.kind) {
+							case func::comp::eEquals :
+								comp = (acc == v);
+								break;
+							case func::comp::eNotEquals :
+								comp = (acc != v);
+								break;
+							case func::comp::eLessThan :
+								comp = (acc < v);
+								break;
+							case func::comp::eGreaterThan :
+								comp = (acc > v);
+								break;
+							case func::comp::eLessOrEqual :
+								comp = (acc <= v);
+								break;
+							case func::comp::eGreaterOrEqual :
+								comp = (acc >= v);
+								break;
+						}
+						// the ordered comparisons move along the list
+						if (comp && (in.kind != func::comp::eEquals) &&
+							(in.kind != func::comp::eNotEquals)) {
+							acc = v;
+						}
+					}
+					if (cnt > 0) {
+						ans[r].type = value::eBool;
+						ans[r].boolValue = comp;
+					} else {
+						ans[r].type = value::eUnknown;
+					}
+				}
+				break;
+			case eBin:
+				for (size_t r = 0; r < aRows; ++r) {
+					// 'and' is true until we find a false, and 'or' false until a true
+					bool	test = (in.kind != func::bin::eOr);
+					size_t	cnt = 0;
+					bool	keepGoing = true;
+					for (uint32_t i = 0; keepGoing && (i < in.count); ++i) {
+						const datum	& v = aContext._stack[(sp + i) * aContext._stride + r];
+						if (v.type == value::eUnknown) {
+							continue;
+						}
+						++cnt;
+						switch (in.kind) {
+							case func::bin::eAnd :
+								if (!isTrue(v)) {
+									test = false;
+									keepGoing = false;
+								}
+								break;
+							case func::bin::eOr :
+								if (isTrue(v)) {
+									test = true;
+									keepGoing = false;
+								}
+								break;
+							case func::bin::eNot :
+								// this is a unary operator
+								test = !isTrue(v);
+								keepGoing = false;
+								break;
+						}
+					}
+					if (cnt > 0) {
+						ans[r].type = value::eBool;
+						ans[r].boolValue = test;
+					} else {
+						ans[r].type = value::eUnknown;
+					}
+				}
+				break;
+			case eSelect:
+				// an undefined test isn't true, and with no 'else', it's undefined
+				for (size_t r = 0; r < aRows; ++r) {
+					if (isTrue(ans[r])) {
+						ans[r] = aContext._stack[(sp + 1) * aContext._stride + r];
+					} else if (in.count > 2) {
+						ans[r] = aContext._stack[(sp + 2) * aContext._stride + r];
+					} else {
+						ans[r].type = value::eUnknown;
+					}
+				}
+				break;
+			case eCall:
+				// the function needs values, so the arguments are copied into them
+				aContext._call_vals.resize(in.count);
+				aContext._call_args.resize(in.count);
+				for (uint32_t i = 0; i < in.count; ++i) {
+					aContext._call_args[i] = &aContext._call_vals[i];
+				}
+				for (size_t r = 0; r < aRows; ++r) {
+					for (uint32_t i = 0; i < in.count; ++i) {
+						aContext._call_vals[i] = aContext._stack[(sp + i) * aContext._stride + r];
+					}
+					ans[r] = in.fcn->eval(aContext._call_args, aContext._call_scratch).getDatum();
+				}
+				break;
+			default:
+				throw std::runtime_error("[program::exec] unknown op code in the program!");
+				break;
+		}
+		++sp;
+	}
+	// the answers have to be on the stack for the caller
+	if (typed && (sz > 0)) {
+		spill(aContext, 0, aRows);
+	}
+}
+
+
+/**
+ * This method loads the value at the given row of the column
+ * into the provided datum on the stack.
+ */
+void program::load( datum & aDatum, const column & aColumn, size_t aRow )
+{
+	aDatum.type = aColumn.type;
+	switch (aColumn.type) {
+		case value::eBool:
+			aDatum.boolValue = ((const bool *)aColumn.data)[aRow];
+			break;
+		case value::eInt:
+			aDatum.intValue = ((const int *)aColumn.data)[aRow];
+			break;
+		case value::eDouble:
+			aDatum.doubleValue = ((const double *)aColumn.data)[aRow];
+			break;
+		case value::eTime:
+			aDatum.timeValue = ((const uint64_t *)aColumn.data)[aRow];
+			break;
+		default:
+			aDatum.type = value::eUnknown;
+			break;
+	}
+}
+
+
+/**
+ * This method returns what evalAsBool() would for a value that
+ * holds the datum - so an undefined one isn't true.
+ */
+bool program::isTrue( const datum & aDatum )
+{
+	bool		retval = false;
+	switch (aDatum.type) {
+		case value::eUnknown:
+			break;
+		case value::eBool:
+			retval = aDatum.boolValue;
+			break;
+		case value::eInt:
+			retval = (aDatum.intValue != 0);
+			break;
+		case value::eDouble:
+			retval = (aDatum.doubleValue != 0.0);
+			break;
+		case value::eTime:
+			retval = (aDatum.timeValue != 0);
+			break;
+	}
+	return retval;
+}
+
+
+/**
+ * When we're running a batch, a slot on the stack that's all
+ * doubles, or all ints, is kept in a simple array - a lane - so
+ * that the vector kernels can work on it. These methods fill the
+ * lane for a slot from a datum or a column, and return 'false'
+ * if that can't be done, and the slot has to hold the datums.
+ */
+bool program::fill( context & aContext, size_t aSlot, const datum & aValue, size_t aRows )
+{
+	bool		filled = true;
+	size_t		base = aSlot * aContext._stride;
+	if (aValue.type == value::eDouble) {
+		std::fill(aContext._dbls.begin() + base, aContext._dbls.begin() + base + aRows, aValue.doubleValue);
+		aContext._kinds[aSlot] = value::eDouble;
+	} else if (aValue.type == value::eInt) {
+		std::fill(aContext._ints.begin() + base, aContext._ints.begin() + base + aRows, aValue.intValue);
+		aContext._kinds[aSlot] = value::eInt;
+	} else {
+		filled = false;
+		aContext._kinds[aSlot] = value::eUnknown;
+	}
+	return filled;
+}
+
+
+bool program::fill( context & aContext, size_t aSlot, const column & aColumn, size_t aStart, size_t aRows )
+{
+	bool		filled = true;
+	size_t		base = aSlot * aContext._stride;
+	if (aColumn.type == value::eDouble) {
+		const double	*src = (const double *)aColumn.data + aStart;
+		std::copy(src, src + aRows, aContext._dbls.begin() + base);
+		aContext._kinds[aSlot] = value::eDouble;
+	} else if (aColumn.type == value::eInt) {
+		const int		*src = (const int *)aColumn.data + aStart;
+		std::copy(src, src + aRows, aContext._ints.begin() + base);
+		aContext._kinds[aSlot] = value::eInt;
+	} else {
+		filled = false;
+		aContext._kinds[aSlot] = value::eUnknown;
+	}
+	return filled;
+}
+
+
+/**
+ * This method takes whatever is in the lane for the slot and puts
+ * it on the stack as datums - which is what everything other than
+ * the vector kernels needs.
+ */
+void program::spill( context & aContext, size_t aSlot, size_t aRows )
+{
+	size_t		base = aSlot * aContext._stride;
+	datum		*top = &aContext._stack[base];
+	switch (aContext._kinds[aSlot]) {
+		case value::eDouble:
+			for (size_t r = 0; r < aRows; ++r) {
+				top[r].type = value::eDouble;
+				top[r].doubleValue = aContext._dbls[base + r];
+			}
+			break;
+		case value::eInt:
+			for (size_t r = 0; r < aRows; ++r) {
+				top[r].type = value::eInt;
+				top[r].intValue = aContext._ints[base + r];
+			}
+			break;
+		case value::eBool:
+			for (size_t r = 0; r < aRows; ++r) {
+				top[r].type = value::eBool;
+				top[r].boolValue = (aContext._ints[base + r] != 0);
+			}
+			break;
+		default:
+			break;
+	}
+	aContext._kinds[aSlot] = value::eUnknown;
+}
+
+
+/**
+ * This method tries to run the instruction on the lanes of the
+ * arguments with the vector kernels. The types in the slots are
+ * checked once for the block, and if they, and the instruction,
+ * work for the kernels, the answer is left in the lane of the
+ * first slot, and 'true' is returned. Otherwise, nothing is done,
+ * and 'false' is returned.
+ */
+bool program::vector( context & aContext, const instruction & anInst, size_t aSlot, size_t aRows )
+{
+	uint32_t	cnt = anInst.count;
+	bool		done = ((cnt > 0) && (anInst.op != eCall));
+	/**
+	 * Every argument has to be in a lane, and we need to know if they
+	 * are all the same type, and if any are bools - as the arithmetic
+	 * kernels don't do bools.
+	 */
+	value::value_type	first = (done ? aContext._kinds[aSlot] : value::eUnknown);
+	bool				same = true;
+	bool				bools = false;
+	for (uint32_t i = 0; done && (i < cnt); ++i) {
+		value::value_type	k = aContext._kinds[aSlot + i];
+		if (k == value::eUnknown) {
+			done = false;
+		}
+		same = same && (k == first);
+		bools = bools || (k == value::eBool);
+	}
+	if (done) {
+		double		*ad = &aContext._dbls[aSlot * aContext._stride];
+		int			*ai = &aContext._ints[aSlot * aContext._stride];
+		switch (anInst.op) {
+			case eSum:
+			case eDiff:
+			case eProd:
+			case eQuot:
+				if (bools) {
+					done = false;
+					break;
+				}
+				/**
+				 * A zero divisor makes that row undefined, and the kernels
+				 * can't do that, so look for them before we change anything.
+				 */
+				if (anInst.op == eQuot) {
+					for (uint32_t i = 1; done && (i < cnt); ++i) {
+						size_t	b = (aSlot + i) * aContext._stride;
+						if (aContext._kinds[aSlot + i] == value::eDouble) {
+							done = !kernels::anyZero(&aContext._dbls[b], aRows);
+						} else {
+							done = !kernels::anyZero(&aContext._ints[b], aRows);
+						}
+					}
+					if (!done) {
+						break;
+					}
+				}
+				// unary minus is just a negation of the one argument
+				if ((anInst.op == eDiff) && (cnt == 1)) {
+					if (first == value::eDouble) {
+						kernels::neg(ad, aRows);
+					} else {
+						kernels::neg(ai, aRows);
+					}
+					break;
+				}
+				// the first argument's type is the type of the answer
+				for (uint32_t i = 1; i < cnt; ++i) {
+					size_t	b = (aSlot + i) * aContext._stride;
+					bool	dbl = (aContext._kinds[aSlot + i] == value::eDouble);
+					if (first == value::eDouble) {
+						if (dbl) {
+							arith(anInst.op, ad, &aContext._dbls[b], aRows);
+						} else {
+							arith(anInst.op, ad, &aContext._ints[b], aRows);
+						}
+					} else {
+						if (dbl) {
+							arith(anInst.op, ai, &aContext._dbls[b], aRows);
+						} else {
+							arith(anInst.op, ai, &aContext._ints[b], aRows);
+						}
+					}
+				}
+				break;
+			case eMax:
+			case eMin:
+				/**
+				 * With mixed types, the answer takes the type of whichever
+				 * argument wins for each row - so that's not for a kernel.
+				 */
+				if (!same || bools) {
+					done = false;
+					break;
+				}
+				for (uint32_t i = 1; i < cnt; ++i) {
+					size_t	b = (aSlot + i) * aContext._stride;
+					if (first == value::eDouble) {
+						arith(anInst.op, ad, &aContext._dbls[b], aRows);
+					} else {
+						arith(anInst.op, ai, &aContext._ints[b], aRows);
+					}
+				}
+				break;
+			case eComp:
+				if (!same || bools || (cnt < 2)) {
+					done = false;
+					break;
+				}
+				{
+					kernels::comp_type	op = kernels::eEquals;
+					switch (anInst.kind) {
+						case func::comp::eEquals :
+							op = kernels::eEquals;
+							break;
+						case func::comp::eNotEquals :
+							op = kernels::eNotEquals;
+							break;
+						case func::comp::eLessThan :
+							op = kernels::eLessThan;
+							break;
+						case func::comp::eGreaterThan :
+							op = kernels::eGreaterThan;
+							break;
+						case func::comp::eLessOrEqual :
+							op = kernels::eLessOrEqual;
+							break;
+						case func::comp::eGreaterOrEqual :
+							op = kernels::eGreaterOrEqual;
+							break;
+					}
+					// equalities are against the first - the rest are pairwise
+					bool	chain = ((op != kernels::eEquals) && (op != kernels::eNotEquals));
+					std::fill(aContext._mask.begin(), aContext._mask.begin() + aRows, 1);
+					for (uint32_t i = 1; i < cnt; ++i) {
+						size_t	a = (chain ? aSlot + i - 1 : aSlot) * aContext._stride;
+						size_t	b = (aSlot + i) * aContext._stride;
+						if (first == value::eDouble) {
+							kernels::comp(op, &aContext._dbls[a], &aContext._dbls[b], &aContext._mask[0], aRows);
+						} else {
+							kernels::comp(op, &aContext._ints[a], &aContext._ints[b], &aContext._mask[0], aRows);
+						}
+					}
+					std::copy(aContext._mask.begin(), aContext._mask.begin() + aRows, ai);
+					first = value::eBool;
+				}
+				break;
+			case eBin:
+				/**
+				 * The kernels only 'and' the truths of the lanes together,
+				 * so an 'or' stays with the values on the stack.
+				 */
+				if (anInst.kind == func::bin::eOr) {
+					done = false;
+					break;
+				}
+				std::fill(aContext._mask.begin(), aContext._mask.begin() + aRows, 1);
+				// 'not' only looks at the first argument
+				for (uint32_t i = 0; i < (anInst.kind == func::bin::eNot ? 1 : cnt); ++i) {
+					size_t	b = (aSlot + i) * aContext._stride;
+					if (aContext._kinds[aSlot + i] == value::eDouble) {
+						kernels::truth(&aContext._dbls[b], &aContext._mask[0], aRows);
+					} else {
+						kernels::truth(&aContext._ints[b], &aContext._mask[0], aRows);
+					}
+				}
+				if (anInst.kind == func::bin::eNot) {
+					for (size_t r = 0; r < aRows; ++r) {
+						aContext._mask[r] ^= 1;
+					}
+				}
+				std::copy(aContext._mask.begin(), aContext._mask.begin() + aRows, ai);
+				first = value::eBool;
+				break;
+			default:
+				done = false;
+				break;
+		}
+		if (done) {
+			aContext._kinds[aSlot] = first;
+		}
+	}
+	return done;
+}
+
+
+/**
+ * This method drops the native code for the program, if there is
+ * any, and starts the counts over - as it's done whenever the
+ * instructions change. The "_nl" means the caller has to handle
+ * the locking.
+ */
+void program::dropNative_nl()
+{
+	if (_native != NULL) {
+		delete _native;
+		_native = NULL;
+	}
+	_hits = 0;
+	_bails = 0;
+	_builds = 0;
+}
+}		// end of namespace lkit
+
+
+/**
+ * For debugging purposes, let's make it easy for the user to stream
+ * out this value. It basically is just the toString() method of the
+ * program streamed out.
+ */
+std::ostream & operator<<( std::ostream & aStream, const lkit::program & aValue )
+{
+	aStream << aValue.toString();
+	return aStream;
+}
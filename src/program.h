@@ -0,0 +1,469 @@
+/**
+ * program.h - this file defines a compiled, flattened, form of a language
+ *             tree. The tree of expressions is walked once, and turned
+ *             into a simple list of instructions that are then run by a
+ *             tight loop over a stack of values. The built-in functions
+ *             have their own instructions, and everything else is just a
+ *             call to the function on the values on the stack.
+ */
+#ifndef __LKIT_PROGRAM_H
+#define __LKIT_PROGRAM_H
+
+//	System Headers
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+#include <boost/unordered_map.hpp>
+
+//	Other Headers
+#include "value.h"
+#include "context.h"
+#include "util/spinlock.h"
+
+//	Forward Declarations
+/**
+ * We are going to build up programs from expressions, their functions and
+ * arguments (values) so we need to have forward references on these so we
+ * can use them in the signatures.
+ */
+namespace lkit {
+class function;
+class expression;
+class jit;
+}	// end of namespace lkit
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+/**
+ * Main class definition
+ */
+namespace lkit {
+class program
+{
+	friend class context;
+
+	public:
+		/**
+		 * These are the different instructions that a program is made
+		 * up of. The pushes put a value on the top of the stack, and all
+		 * the others take the 'count' values on the top of the stack and
+		 * replace them with the result of the operation on those values.
+		 */
+		enum op_code {
+			// copy a simple value onto the stack
+			ePushValue = 0,
+			// evaluate a variable (or other value) onto the stack
+			ePushVariable,
+			// evaluate what can't be flattened - like a reduction of arrays
+			ePushTree,
+			// the built-in functions
+			eMax,
+			eMin,
+			eSum,
+			eDiff,
+			eProd,
+			eQuot,
+			eComp,
+			eBin,
+			// fold the next argument of a chain of comparisons into it
+			eStep,
+			// stand in for the next expression if it's not needed
+			eSkip,
+			// pick the 'then' or 'else' of an 'if' by it's test
+			eSelect,
+			// any other function - called on the values on the stack
+			eCall
+		};
+
+		/**
+		 * These are the tests a skip can make on a slot of the stack -
+		 * and if it holds for every row, the expression after the skip
+		 * isn't needed, and isn't run. The first two stop an 'and' and
+		 * an 'or', and the last two pick the branch of an 'if'.
+		 */
+		enum skip_mode {
+			eSkipIfFalse = 0,
+			eSkipIfTrue,
+			eSkipUnlessTrue
+		};
+
+		/**
+		 * This is a single instruction in the program. It's kept small
+		 * so that the entire program fits in as few cache lines as we
+		 * can manage. What's in the union depends on the op code.
+		 *
+		 * The only jumps are the skips - each one is just before the code
+		 * for an expression, and if that expression isn't needed, the skip
+		 * puts an undefined value on the stack in it's place, and jumps
+		 * over it. So the stack is the same either way. The steps of a
+		 * comparison are the only instructions that leave two slots - the
+		 * answer so far, and what the next argument is compared against -
+		 * until the last of them, which leaves just the answer.
+		 */
+		struct instruction {
+			op_code			op;
+			// number of values on the stack this instruction works on
+			uint32_t		count;
+			union {
+				// ePushValue, ePushVariable - 'count' is the slot - and ePushTree
+				value		*arg;
+				// eCall
+				function	*fcn;
+				// eComp, eBin - the function's type
+				int			kind;
+				// eSkip - 'count' is the number of instructions to skip
+				struct {
+					// the skip_mode for the test
+					int32_t		mode;
+					// how far down the stack the slot to test is
+					uint32_t	back;
+				}			skip;
+				// eStep - 'count' is 2 for the first step, and 3 for the rest
+				struct {
+					// the comp's type
+					int32_t		kind;
+					// if it's the last step, and leaves just the answer
+					uint32_t	last;
+				}			step;
+			};
+		};
+
+		/**
+		 * This is a column of data for batch evaluation - a contiguous
+		 * array of one of the value types, owned by the caller, where
+		 * each element is the value of a variable for that row.
+		 */
+		struct column {
+			value::value_type	type;
+			const void			*data;
+		};
+		/**
+		 * The columns are bound to the variables they supply, and this
+		 * makes it easy to look them up as we prepare for a batch.
+		 */
+		typedef boost::unordered_map<value *, column> column_map_t;
+
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This is the default constructor that assumes NOTHING - it just
+		 * makes an empty program ready to have an expression compiled
+		 * into it.
+		 */
+		program();
+		/**
+		 * This constructor takes the root of a language tree and compiles
+		 * it into this program. If that can't be done, then an exception
+		 * will be thrown.
+		 */
+		program( value *aRoot );
+		/**
+		 * This is the standard copy constructor that needs to be in every
+		 * class to make sure that we control how many copies we have
+		 * floating around in the system.
+		 */
+		program( const program & anOther );
+		/**
+		 * This is the standard destructor and needs to be virtual to make
+		 * sure that if we subclass off this, the right destructor will be
+		 * called.
+		 */
+		virtual ~program();
+
+		/**
+		 * When we process the result of an equality we need to make sure
+		 * that we do this right by always having an equals operator on
+		 * all classes.
+		 */
+		program & operator=( const program & anOther );
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method takes the root of a language tree and walks it,
+		 * building up the list of instructions that will calculate the
+		 * same value as evaluating the tree. This replaces anything that
+		 * was in the program. The values and functions in the tree are
+		 * only referenced, so they have to outlive this program.
+		 */
+		virtual bool compile( value *aRoot );
+		/**
+		 * This method returns 'true' if there's a compiled program
+		 * ready to be evaluated.
+		 */
+		virtual bool isCompiled() const;
+		/**
+		 * This method clears out the program so that it's empty, and
+		 * will return an undefined value when evaluated.
+		 */
+		virtual void clear();
+		/**
+		 * This method returns the actual reference to the list of
+		 * instructions for this program. This is really just for
+		 * debugging, and care should be taken with it.
+		 */
+		virtual const std::vector<instruction> & getCode() const;
+		/**
+		 * Each different variable the program uses has a slot, numbered
+		 * from zero in the order they are first used, and this is the
+		 * number of them - which is the number of slots in a context for
+		 * this program.
+		 */
+		virtual size_t getSlotCount() const;
+		/**
+		 * This method returns the slot of the variable with the provided
+		 * name, or -1 if the program doesn't use it. This is done once,
+		 * so that each thread can set the variable in it's context with
+		 * the slot, and not the name.
+		 */
+		virtual int getSlot( const std::string & aName ) const;
+		/**
+		 * When LKit is built with LKIT_JIT defined, a program that's been
+		 * run enough times is compiled to native code, and this method
+		 * returns 'true' if that's what eval() is running now. Without the
+		 * define, this is always 'false'.
+		 */
+		virtual bool isNative() const;
+
+		/*******************************************************************
+		 *
+		 *                       Evaluation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method runs the instructions of the program, and returns
+		 * the value left on the top of the stack. This will be the same
+		 * value that evaluating the original tree would have returned.
+		 *
+		 * When LKit is built with LKIT_JIT defined, once the program has
+		 * been run this way enough times, it's compiled to native code,
+		 * if it can be, and that's what's run from then on. If the native
+		 * code can't handle a run - a value has changed type, say - the
+		 * instructions are run instead, and if that keeps happening, the
+		 * native code is dropped, and built again for the new types.
+		 */
+		virtual value eval();
+		/**
+		 * This method runs the program over 'aRows' rows of data in one
+		 * call. Each variable in the map takes it's values from the bound
+		 * column, and the result for each row is placed in 'aResults',
+		 * which has to have room for all the rows. The instructions are
+		 * run a block of rows at a time, so the dispatch is paid once for
+		 * the block, and not once for each row.
+		 *
+		 * If the program uses a variable that's not bound, and is defined
+		 * by an expression - or an array with something else - we can't
+		 * know if it depends on the columns, so we have to set the bound
+		 * variables and run the program one row at a time - which leaves
+		 * them with the values of the last row.
+		 */
+		virtual bool eval( size_t aRows, const column_map_t & aColumns, value *aResults );
+		/**
+		 * This method runs the program with the provided context, and
+		 * returns the value left on the top of it's stack. The program is
+		 * not changed, and isn't locked, so any number of threads can run
+		 * it at once - each with it's own context. The variables that are
+		 * bound in the context use those values, and the constants were
+		 * copied into it when it was prepared, so unless a variable is
+		 * left unbound, nothing shared is touched. If the context isn't
+		 * ready for this program, it's prepared first.
+		 *
+		 * The program can't be compiled, or cleared, while this is going
+		 * on - that's up to the caller.
+		 */
+		virtual value eval( context & aContext ) const;
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+
+	protected:
+		/*******************************************************************
+		 *
+		 *                   Compiling/Evaluation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method adds the instructions for the provided value to the
+		 * end of the program. For an expression, that's the instructions
+		 * for each of the arguments, and then the one for the function.
+		 * The depth is the number of values on the stack before we start,
+		 * so that we know how big a stack the program is going to need.
+		 * The "_nl" means the caller has to handle the locking.
+		 */
+		virtual void emit_nl( value *aValue, uint32_t aDepth );
+		/**
+		 * This method adds the instruction for the function of an
+		 * expression to the end of the program, and picks out the
+		 * built-in functions that have their own op codes. The "_nl"
+		 * means the caller has to handle the locking.
+		 */
+		virtual void emitFunction_nl( function *aFunction, uint32_t aCount );
+		/**
+		 * These methods add the instructions for the lazy functions - an
+		 * 'and' or 'or' of two or more arguments, and a 'cond' - where
+		 * each argument after the first is behind a skip, so that it's
+		 * only run if it's needed to get the answer. The "_nl" means the
+		 * caller has to handle the locking.
+		 */
+		virtual void emitChain_nl( function *aFunction, const std::vector<value *> & anArgs, uint32_t aDepth );
+		virtual void emitCond_nl( const std::vector<value *> & anArgs, size_t aStart, uint32_t aDepth );
+		/**
+		 * This method adds the instructions for a comparison of three or
+		 * more arguments, where one of them past the second needs to be
+		 * evaluated. It's a step for each argument after the first, and
+		 * once it's false, the rest are skipped, as the comp stops at the
+		 * first pair that fails. The "_nl" means the caller has to handle
+		 * the locking.
+		 */
+		virtual void emitCompare_nl( function *aFunction, const std::vector<value *> & anArgs, uint32_t aDepth );
+		/**
+		 * This method adds a skip to the end of the program, for the code
+		 * of the expression that's about to be added, and returns where
+		 * it is, so that the number of instructions to skip can be filled
+		 * in once that code is done.
+		 */
+		size_t emitSkip_nl( skip_mode aMode, uint32_t aBack );
+
+		/**
+		 * This method gets the context ready to run this program. If
+		 * it's 'live', the constants aren't copied, and are read from the
+		 * program's values each time - so that it picks up the changes in
+		 * them, as the tree would. The "_nl" means the caller has to handle
+		 * the locking.
+		 */
+		void prepare_nl( context & aContext, bool aLive ) const;
+		/**
+		 * This method returns 'true' if the context has been prepared for
+		 * this program, as it is now, and can be run with it.
+		 */
+		bool isReady( const context & aContext ) const;
+		/**
+		 * This method makes sure that the stack of the context is set up
+		 * to hold the values for 'aStride' rows in each slot.
+		 */
+		void setStride( context & aContext, size_t aStride ) const;
+		/**
+		 * This method runs all the instructions of the program on 'aRows'
+		 * rows at once with the provided context. If there are columns
+		 * for the pushed variables, they will be in 'aCols' - indexed by
+		 * the instruction - starting at row 'aStart' in the column. When
+		 * it's done, the answers are in the first slot of the stack.
+		 */
+		void exec( context & aContext, size_t aRows, size_t aStart, const column * const *aCols ) const;
+		/**
+		 * This method loads the value at the given row of the column
+		 * into the provided datum on the stack.
+		 */
+		static void load( datum & aDatum, const column & aColumn, size_t aRow );
+		/**
+		 * This method returns what evalAsBool() would for a value that
+		 * holds the datum - so an undefined one isn't true.
+		 */
+		static bool isTrue( const datum & aDatum );
+
+		/**
+		 * When we're running a batch, a slot on the stack that's all
+		 * doubles, or all ints, is kept in a simple array - a lane - so
+		 * that the vector kernels can work on it. These methods fill the
+		 * lane for a slot from a datum or a column, and return 'false'
+		 * if that can't be done, and the slot has to hold the datums.
+		 */
+		static bool fill( context & aContext, size_t aSlot, const datum & aValue, size_t aRows );
+		static bool fill( context & aContext, size_t aSlot, const column & aColumn, size_t aStart, size_t aRows );
+		/**
+		 * This method takes whatever is in the lane for the slot and puts
+		 * it on the stack as datums - which is what everything other than
+		 * the vector kernels needs.
+		 */
+		static void spill( context & aContext, size_t aSlot, size_t aRows );
+		/**
+		 * This method tries to run the instruction on the lanes of the
+		 * arguments with the vector kernels. The types in the slots are
+		 * checked once for the block, and if they, and the instruction,
+		 * work for the kernels, the answer is left in the lane of the
+		 * first slot, and 'true' is returned. Otherwise, nothing is done,
+		 * and 'false' is returned.
+		 */
+		static bool vector( context & aContext, const instruction & anInst, size_t aSlot, size_t aRows );
+
+		/**
+		 * This method drops the native code for the program, if there is
+		 * any, and starts the counts over - as it's done whenever the
+		 * instructions change. The "_nl" means the caller has to handle
+		 * the locking.
+		 */
+		void dropNative_nl();
+
+	private:
+		/**
+		 * This is the list of instructions for the program, and they are
+		 * run in order from first to last - the only jumps are the skips
+		 * over the expressions that aren't needed.
+		 */
+		std::vector<instruction>	_code;
+		/**
+		 * These are the constants and the variables that the program
+		 * pushes, by slot, and the depth is the number of slots of the
+		 * stack that the program needs, as found when it was compiled.
+		 * The generation is bumped each time the program is changed, so
+		 * that a context knows when it needs to be prepared again.
+		 */
+		std::vector<value *>		_consts;
+		std::vector<value *>		_vars;
+		uint32_t					_depth;
+		uint32_t					_generation;
+		/**
+		 * This is the context that's used by the locked evaluations -
+		 * it's live, so that they pick up the changes in the constants
+		 * as well as the variables.
+		 */
+		context						_ctx;
+		/**
+		 * This is the native code for the program, if it's been built,
+		 * and the counts of the runs with the instructions, of the runs
+		 * the native code gave up on in a row, and of the times it's been
+		 * built - so that a program that can't be helped stops trying.
+		 * They are here, even without LKIT_JIT, so the layout is the same.
+		 */
+		jit							*_native;
+		uint32_t					_hits;
+		uint32_t					_bails;
+		uint32_t					_builds;
+		// ...and a simple spinlock to control access to it all
+		mutable util::spinlock		_mutex;
+};
+}		// end of namespace lkit
+
+/**
+ * For debugging purposes, let's make it easy for the user to stream
+ * out this value. It basically is just the toString() method of the
+ * program streamed out.
+ */
+std::ostream & operator<<( std::ostream & aStream, const lkit::program & aValue );
+
+#endif		// __LKIT_PROGRAM_H
@@ -0,0 +1,229 @@
+/**
+ * registry.cpp - this file implements the registry of functions that
+ *                parsers look up the functions of their source in. A
+ *                registry is never changed once it's made, so it can be
+ *                shared by any number of parsers - and threads - with no
+ *                locking, and it's held by a reference-counted pointer, so
+ *                it's gone when the last parser using it is. The default
+ *                functions are in one registry for the whole process, and
+ *                every parser uses it unless told otherwise - the functions
+ *                a parser adds of it's own are put over it, in that parser,
+ *                and no other.
+ */
+
+//	System Headers
+#include <sstream>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "registry.h"
+#include "array_functions.h"
+#include "base_functions.h"
+#include "util/footprint.h"
+
+//	Forward Declarations
+
+//	Private Constants
+
+//	Private Datatypes
+
+//	Private Data Constants
+
+
+namespace lkit {
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This is the default constructor that makes an empty registry
+ * with no functions in it at all.
+ */
+registry::registry() :
+	_fcns(),
+	_table()
+{
+}
+
+
+/**
+ * This constructor makes a registry of the functions in the map,
+ * by the names they have there. The registry owns the functions
+ * from then on, and deletes them when it's gone, so the caller
+ * has to be willing to relinquish control.
+ */
+registry::registry( const fcn_map_t & aFunctions ) :
+	_fcns(),
+	_table()
+{
+	for (fcn_map_t::const_iterator it = aFunctions.begin(); it != aFunctions.end(); ++it) {
+		if (it->second != NULL) {
+			_fcns[it->first] = it->second;
+			_table.add(it->first, it->second);
+		}
+	}
+}
+
+
+/**
+ * This is the standard destructor and needs to be virtual to make
+ * sure that if we subclass off this, the right destructor will be
+ * called. It deletes all the functions of the registry.
+ */
+registry::~registry()
+{
+	for (fcn_map_t::iterator it = _fcns.begin(); it != _fcns.end(); ++it) {
+		delete it->second;
+	}
+	_fcns.clear();
+}
+
+
+/**
+ * This method returns the registry of the default functions for
+ * the language - the same one for everyone in the process. It's
+ * made the first time it's asked for, and it's what all parsers
+ * use unless they're told to use another.
+ */
+registry::ptr_t registry::getDefaults()
+{
+	/**
+	 * The compiler makes sure that only one thread builds this, and
+	 * the rest wait for it - and being local, it's there even for the
+	 * parsers made while the statics of the process are.
+	 */
+	static const ptr_t	__defaults = makeDefaults();
+	return __defaults;
+}
+
+
+/*******************************************************************
+ *
+ *                        Accessor Methods
+ *
+ *******************************************************************/
+/**
+ * This method returns the function registered under the name, or
+ * NULL if there isn't one. Nothing is locked, as nothing changes.
+ */
+function *registry::lookUp( const boost::string_ref & aName ) const
+{
+	return _table.get(aName);
+}
+
+
+/**
+ * This method returns the map of all the functions in the registry
+ * by their names - it's never changed, and the functions belong to
+ * the registry, so none of them are to be deleted.
+ */
+const fcn_map_t & registry::getFunctions() const
+{
+	return _fcns;
+}
+
+
+/**
+ * This method returns the number of functions in the registry.
+ */
+size_t registry::size() const
+{
+	return _fcns.size();
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * This method adds the registry - the functions, as the size of
+ * the base class, and the map and table they're in - to the tally.
+ */
+void registry::addFootprint( util::footprint & aTally ) const
+{
+	for (fcn_map_t::const_iterator it = _fcns.begin(); it != _fcns.end(); ++it) {
+		aTally.addObject(sizeof(function), util::footprint::heapBlock(sizeof(function)) - sizeof(function));
+		aTally.addString(it->first);
+	}
+	aTally.addMap(_fcns);
+	// the names in the table are a part of the functions already counted
+	util::footprint		names;
+	_table.addFootprint(names);
+	aTally.addParts(names);
+}
+
+
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string registry::toString() const
+{
+	std::ostringstream	msg;
+	msg << "[registry fcns=(";
+	bool	first = true;
+	for (fcn_map_t::const_iterator it = _fcns.begin(); it != _fcns.end(); ++it) {
+		if (!first) {
+			msg << ", ";
+		}
+		msg << it->first;
+		first = false;
+	}
+	msg << ")]";
+	return msg.str();
+}
+
+
+/**
+ * This method makes the registry of the DEFAULT functions for
+ * the language. This does not include any user-supplied
+ * functions, but does include the basic functionality of the
+ * language.
+ */
+registry::ptr_t registry::makeDefaults()
+{
+	fcn_map_t	fcns;
+	fcns["max"] = new func::max();
+	fcns["min"] = new func::min();
+	fcns["+"] = new func::sum();
+	fcns["-"] = new func::diff();
+	fcns["*"] = new func::prod();
+	fcns["/"] = new func::quot();
+	fcns["=="] = new func::comp(func::comp::eEquals);
+	fcns["!="] = new func::comp(func::comp::eNotEquals);
+	fcns["<"] = new func::comp(func::comp::eLessThan);
+	fcns[">"] = new func::comp(func::comp::eGreaterThan);
+	fcns["<="] = new func::comp(func::comp::eLessOrEqual);
+	fcns[">="] = new func::comp(func::comp::eGreaterOrEqual);
+	fcns["and"] = new func::bin(func::bin::eAnd);
+	fcns["or"] = new func::bin(func::bin::eOr);
+	fcns["not"] = new func::bin(func::bin::eNot);
+	fcns["if"] = new func::cond();
+	fcns["cond"] = new func::cond();
+	fcns["vsum"] = new func::reduce(func::reduce::eSum);
+	fcns["vmean"] = new func::reduce(func::reduce::eMean);
+	fcns["vmin"] = new func::reduce(func::reduce::eMin);
+	fcns["vmax"] = new func::reduce(func::reduce::eMax);
+	fcns["dot"] = new func::reduce(func::reduce::eDot);
+	return ptr_t(new registry(fcns));
+}
+}		// end of namespace lkit
+
+
+/**
+ * For debugging purposes, let's make it easy for the user to stream
+ * out this value. It basically is just the toString() method of the
+ * registry streamed out.
+ */
+std::ostream & operator<<( std::ostream & aStream, const lkit::registry & aValue )
+{
+	aStream << aValue.toString();
+	return aStream;
+}
@@ -0,0 +1,163 @@
+/**
+ * registry.h - this file defines the registry of functions that parsers
+ *              look up the functions of their source in. A registry is
+ *              never changed once it's made, so it can be shared by any
+ *              number of parsers - and threads - with no locking, and it's
+ *              held by a reference-counted pointer, so it's gone when the
+ *              last parser using it is. The default functions are in one
+ *              registry for the whole process, and every parser uses it
+ *              unless told otherwise - the functions a parser adds of it's
+ *              own are put over it, in that parser, and no other.
+ */
+#ifndef __LKIT_REGISTRY_H
+#define __LKIT_REGISTRY_H
+
+//	System Headers
+#include <ostream>
+#include <string>
+
+//	Third-Party Headers
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility/string_ref.hpp>
+
+//	Other Headers
+#include "util/table.h"
+
+//	Forward Declarations
+/**
+ * The registry only holds onto the functions, so we just need to know
+ * about them in the signatures here.
+ */
+namespace lkit {
+class function;
+}	// end of namespace lkit
+
+//	Public Constants
+
+//	Public Datatypes
+/**
+ * We are going to have a map of the function names to the actual pointers
+ * to the lkit::function instances, and rather than clutter up the code
+ * with all the syntax, it makes sense to create a nice, simple typedef
+ * here so that we can use it in the code and keep things cleaner.
+ */
+typedef boost::unordered_map<std::string, lkit::function *> fcn_map_t;
+
+//	Public Data Constants
+
+
+/**
+ * Main class definition
+ */
+namespace lkit {
+class registry
+{
+	public:
+		/**
+		 * A registry is only ever shared by this pointer - so that it's
+		 * freed, with all it's functions, when the last one using it
+		 * lets it go - and it's const, as it's never changed.
+		 */
+		typedef boost::shared_ptr<const registry> ptr_t;
+
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This is the default constructor that makes an empty registry
+		 * with no functions in it at all.
+		 */
+		registry();
+		/**
+		 * This constructor makes a registry of the functions in the map,
+		 * by the names they have there. The registry owns the functions
+		 * from then on, and deletes them when it's gone, so the caller
+		 * has to be willing to relinquish control.
+		 */
+		registry( const fcn_map_t & aFunctions );
+		/**
+		 * This is the standard destructor and needs to be virtual to make
+		 * sure that if we subclass off this, the right destructor will be
+		 * called. It deletes all the functions of the registry.
+		 */
+		virtual ~registry();
+
+		/**
+		 * This method returns the registry of the default functions for
+		 * the language - the same one for everyone in the process. It's
+		 * made the first time it's asked for, and it's what all parsers
+		 * use unless they're told to use another.
+		 */
+		static ptr_t getDefaults();
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method returns the function registered under the name, or
+		 * NULL if there isn't one. Nothing is locked, as nothing changes.
+		 */
+		function *lookUp( const boost::string_ref & aName ) const;
+		/**
+		 * This method returns the map of all the functions in the registry
+		 * by their names - it's never changed, and the functions belong to
+		 * the registry, so none of them are to be deleted.
+		 */
+		const fcn_map_t & getFunctions() const;
+		/**
+		 * This method returns the number of functions in the registry.
+		 */
+		size_t size() const;
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method adds the registry - the functions, as the size of
+		 * the base class, and the map and table they're in - to the tally.
+		 */
+		void addFootprint( util::footprint & aTally ) const;
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+
+	private:
+		// there's no copying a registry - it owns the functions
+		registry( const registry & anOther );
+		registry & operator=( const registry & anOther );
+		/**
+		 * This method makes the registry of the default functions - it's
+		 * only done once, by getDefaults().
+		 */
+		static ptr_t makeDefaults();
+
+		/**
+		 * These are the functions of the registry, by name - the map, to
+		 * be able to list them, and the table, to find them without any
+		 * locking. Both are filled in the constructor, and never changed.
+		 */
+		fcn_map_t					_fcns;
+		util::table<function>		_table;
+};
+}		// end of namespace lkit
+
+/**
+ * For debugging purposes, let's make it easy for the user to stream
+ * out this value. It basically is just the toString() method of the
+ * registry streamed out.
+ */
+std::ostream & operator<<( std::ostream & aStream, const lkit::registry & aValue );
+
+#endif		// __LKIT_REGISTRY_H
@@ -0,0 +1,948 @@
+/**
+ * stream.cpp - this file implements a streaming evaluator for a parser. Records
+ *              are read from a file, or a pipe, as CSV or a simple binary
+ *              format, and the columns of the input that have the names of
+ *              the variables of the source are bound to them, so that each
+ *              batch of rows is evaluated with one evalBatch(). The records
+ *              are read, and their fields parsed, on a thread of their own,
+ *              into one batch while the last one is being evaluated, and the
+ *              value of the final expression for each row is written out in
+ *              the same format as the input.
+ */
+
+//	System Headers
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <limits>
+
+//	Third-Party Headers
+#include <boost/foreach.hpp>
+#ifndef LKIT_SINGLE_THREADED
+#include <boost/bind/bind.hpp>
+#endif
+
+//	Other Headers
+#include "stream.h"
+#include "parser.h"
+#include "util/timer.h"
+
+//	Forward Declarations
+
+//	Private Constants
+/**
+ * These are the four bytes that start the binary format, the size of the
+ * reads from a descriptor, and how much output we hold on to before it's
+ * written out.
+ */
+static const char	__magic[] = "LKB1";
+static const size_t	__chunk = 256 * 1024;
+static const size_t	__flush = 64 * 1024;
+
+//	Private Datatypes
+
+//	Private Data Constants
+
+
+
+namespace lkit {
+/**
+ * This function returns the width of a field of the type in a binary
+ * record - or 0 if it's not a type that can be in one.
+ */
+static size_t widthOf( value::value_type aType )
+{
+	size_t		w = 0;
+	switch (aType) {
+		case value::eInt:
+			w = sizeof(int32_t);
+			break;
+		case value::eDouble:
+			w = sizeof(double);
+			break;
+		case value::eTime:
+			w = sizeof(uint64_t);
+			break;
+		default:
+			break;
+	}
+	return w;
+}
+
+
+/**
+ * This function trims the spaces from both ends of the field, and then
+ * the quotes, if it's quoted, so that what's left is just the text of
+ * the value in it.
+ */
+static void trim( const char * & aBegin, const char * & anEnd )
+{
+	while ((aBegin < anEnd) && isspace((unsigned char)*aBegin)) {
+		++aBegin;
+	}
+	while ((anEnd > aBegin) && isspace((unsigned char)anEnd[-1])) {
+		--anEnd;
+	}
+	if ((anEnd - aBegin >= 2) && (*aBegin == '"') && (anEnd[-1] == '"')) {
+		++aBegin;
+		--anEnd;
+	}
+}
+
+
+/**
+ * These functions parse the text of a field as a double - which is a NaN
+ * if there's no number there at all - and an int, which is 0.
+ */
+static double parseDouble( const char *aBegin, const char *anEnd )
+{
+	double		d = std::numeric_limits<double>::quiet_NaN();
+	char		buff[64];
+	size_t		len = std::min((size_t)(anEnd - aBegin), sizeof(buff) - 1);
+	if (len > 0) {
+		memcpy(buff, aBegin, len);
+		buff[len] = '\0';
+		char	*stop = NULL;
+		double	v = strtod(buff, &stop);
+		if (stop != buff) {
+			d = v;
+		}
+	}
+	return d;
+}
+
+
+static int parseInt( const char *aBegin, const char *anEnd )
+{
+	int			i = 0;
+	bool		neg = false;
+	if ((aBegin < anEnd) && ((*aBegin == '-') || (*aBegin == '+'))) {
+		neg = (*aBegin++ == '-');
+	}
+	for (; (aBegin < anEnd) && isdigit((unsigned char)*aBegin); ++aBegin) {
+		i = i * 10 + (*aBegin - '0');
+	}
+	return (neg ? -i : i);
+}
+
+
+/**
+ * This function adds the text of the value to the output - in the shortest
+ * form that reads back as the same double, for the doubles - and nothing
+ * at all if it's undefined.
+ */
+static void formatValue( std::string & anOut, value & aValue )
+{
+	datum	d = aValue.getDatum();
+	char	buff[64];
+	switch (d.type) {
+		case value::eBool:
+			anOut.append(d.boolValue ? "true" : "false");
+			break;
+		case value::eInt:
+			snprintf(buff, sizeof(buff), "%d", d.intValue);
+			anOut.append(buff);
+			break;
+		case value::eDouble:
+			snprintf(buff, sizeof(buff), "%.15g", d.doubleValue);
+			if (strtod(buff, NULL) != d.doubleValue) {
+				snprintf(buff, sizeof(buff), "%.17g", d.doubleValue);
+			}
+			anOut.append(buff);
+			break;
+		case value::eTime:
+			anOut.append(util::timer::formatTimestamp(d.timeValue, true));
+			break;
+		default:
+			break;
+	}
+}
+
+
+/**
+ * This function adds the uint32_t to the output in the machine's byte
+ * order - as all the binary format is.
+ */
+static void append( std::string & anOut, uint32_t aValue )
+{
+	anOut.append((const char *)&aValue, sizeof(aValue));
+}
+
+
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This constructor takes the parser - with it's source - that's
+ * going to be evaluated for each record. The parser isn't owned,
+ * and has to outlive this stream, and no one else should be using
+ * it while run() is going on.
+ */
+stream::stream( parser & aParser, format aFormat ) :
+	_parser(aParser),
+	_format(aFormat),
+	_types(),
+	_keep(),
+	_batch_size(4096),
+	_rows(0),
+	_in(-1),
+	_data(NULL),
+	_size(0),
+	_pos(0),
+	_eof(true),
+	_read_failed(false),
+	_buf(),
+	_cols(),
+	_width(0),
+	_out(-1),
+	_pending(),
+	_write_failed(false),
+	_stop(false)
+{
+	_full[0] = false;
+	_full[1] = false;
+}
+
+
+/**
+ * This is the standard destructor and needs to be virtual to make
+ * sure that if we subclass off this, the right destructor will be
+ * called.
+ */
+stream::~stream()
+{
+	// the parser isn't ours, and the run cleaned up after itself
+}
+
+
+/*******************************************************************
+ *
+ *                        Accessor Methods
+ *
+ *******************************************************************/
+/**
+ * These methods set, and get, the format of the records that are
+ * read - the results are written in the same format.
+ */
+void stream::setFormat( format aFormat )
+{
+	_format = aFormat;
+}
+
+
+stream::format stream::getFormat() const
+{
+	return _format;
+}
+
+
+/**
+ * The fields of a CSV file are all just text, so each column that's
+ * bound to a variable is read as a double - unless it's set here to
+ * be an int, or a time, which is read with timer::parseTimestamp().
+ * The binary format has the types in it's header, so this is only
+ * for CSV. Anything other than an int, double or time is refused.
+ */
+bool stream::setType( const std::string & aColumn, value::value_type aType )
+{
+	bool		error = false;
+	if (widthOf(aType) == 0) {
+		error = true;
+	} else {
+		_types[aColumn] = aType;
+	}
+	return !error;
+}
+
+
+/**
+ * This method says that the named column of the input is to be
+ * written out with each result - as it was read - so that the
+ * results can be matched up with their records. The kept columns
+ * are written in the order they are in the input, and then the
+ * result, which has the name 'result'.
+ */
+void stream::keepColumn( const std::string & aColumn )
+{
+	if (std::find(_keep.begin(), _keep.end(), aColumn) == _keep.end()) {
+		_keep.push_back(aColumn);
+	}
+}
+
+
+/**
+ * These methods set, and get, the number of records that are in
+ * each batch - read together, and evaluated with one evalBatch().
+ * The default is 4096.
+ */
+void stream::setBatchSize( size_t aRows )
+{
+	_batch_size = std::max(aRows, (size_t)1);
+}
+
+
+size_t stream::getBatchSize() const
+{
+	return _batch_size;
+}
+
+
+/**
+ * This method returns the number of records that were evaluated
+ * by the last run().
+ */
+uint64_t stream::getRowCount() const
+{
+	return _rows;
+}
+
+
+/*******************************************************************
+ *
+ *                       Evaluation Methods
+ *
+ *******************************************************************/
+/**
+ * This method reads all the records of the file 'anInput' - it's
+ * mapped into memory, and read right out of the map - evaluates the
+ * source for each, and writes the results to the file 'anOutput',
+ * replacing whatever was in it. If the input can't be read, or is
+ * malformed, or the source can't be compiled, 'false' is returned.
+ */
+bool stream::run( const std::string & anInput, const std::string & anOutput )
+{
+	bool		error = false;
+	int			fd = open(anInput.c_str(), O_RDONLY);
+	struct stat	st;
+	void		*map = MAP_FAILED;
+	if ((fd < 0) || (fstat(fd, &st) != 0)) {
+		error = true;
+	} else if ((st.st_size > 0) &&
+			   ((map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)) {
+		error = true;
+	} else {
+		// it's all read once, front to back, so tell the kernel to read ahead
+		if (map != MAP_FAILED) {
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+		}
+		_out = open(anOutput.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (_out < 0) {
+			error = true;
+		} else {
+			_in = -1;
+			_data = (map == MAP_FAILED ? NULL : (const char *)map);
+			_size = (size_t)st.st_size;
+			_pos = 0;
+			_eof = true;
+			error = !process();
+			if (close(_out) != 0) {
+				error = true;
+			}
+		}
+	}
+	if (map != MAP_FAILED) {
+		munmap(map, st.st_size);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	_data = NULL;
+	_out = -1;
+	return !error;
+}
+
+
+/**
+ * This method reads all the records from the file descriptor
+ * 'anInput' - a pipe, a socket or a file - until the end of it,
+ * evaluates the source for each, and writes the results to the
+ * file descriptor 'anOutput'. Neither is closed when it's done. If
+ * the input is malformed, or the source can't be compiled, 'false'
+ * is returned.
+ *
+ * The columns bound to the parser for the batches are all cleared
+ * when a run is done - as the data they point to is gone.
+ */
+bool stream::run( int anInput, int anOutput )
+{
+	bool		error = false;
+	if ((anInput < 0) || (anOutput < 0)) {
+		error = true;
+	} else {
+		_in = anInput;
+		_out = anOutput;
+		_buf.resize(__chunk);
+		_data = &_buf[0];
+		_size = 0;
+		_pos = 0;
+		_eof = false;
+		error = !process();
+	}
+	_in = -1;
+	_out = -1;
+	_data = NULL;
+	std::vector<char>().swap(_buf);
+	return !error;
+}
+
+
+/*******************************************************************
+ *
+ *                         Reading Methods
+ *
+ *******************************************************************/
+/**
+ * This method makes sure that there are at least 'aBytes' bytes
+ * of the input from the current position on, reading more if the
+ * input is a descriptor, and returns 'false' if the input ends
+ * before that.
+ */
+bool stream::need( size_t aBytes )
+{
+	while ((_size - _pos < aBytes) && !_eof) {
+		// move what's left to the front, and make room for what's needed
+		size_t	left = _size - _pos;
+		if (_pos > 0) {
+			memmove(&_buf[0], &_buf[_pos], left);
+			_pos = 0;
+			_size = left;
+		}
+		if (_buf.size() < aBytes + __chunk / 2) {
+			_buf.resize(std::max(_buf.size() * 2, aBytes + __chunk));
+		}
+		_data = &_buf[0];
+		ssize_t	got = read(_in, &_buf[_size], _buf.size() - _size);
+		if (got > 0) {
+			_size += got;
+		} else if ((got < 0) && (errno == EINTR)) {
+			continue;
+		} else {
+			_eof = true;
+			_read_failed = (got < 0);
+		}
+	}
+	return (_size - _pos >= aBytes);
+}
+
+
+/**
+ * This method finds the next line of the input, and returns it's
+ * start and end - without the end of line - or 'false' if there
+ * are no more.
+ */
+bool stream::nextLine( const char * & aBegin, const char * & anEnd )
+{
+	bool		found = false;
+	size_t		seen = 0;
+	while (!found) {
+		const char	*nl = NULL;
+		if (_size - _pos > seen) {
+			nl = (const char *)memchr(_data + _pos + seen, '\n', _size - _pos - seen);
+		}
+		if (nl != NULL) {
+			aBegin = _data + _pos;
+			anEnd = nl;
+			_pos = (nl - _data) + 1;
+			found = true;
+		} else if (_eof) {
+			// the last line doesn't need to have an end
+			if (_pos < _size) {
+				aBegin = _data + _pos;
+				anEnd = _data + _size;
+				_pos = _size;
+				found = true;
+			}
+			break;
+		} else {
+			seen = _size - _pos;
+			need(seen + 1);
+		}
+	}
+	if (found && (anEnd > aBegin) && (anEnd[-1] == '\r')) {
+		--anEnd;
+	}
+	return found;
+}
+
+
+/**
+ * This method reads the header of the input - the names of the
+ * columns, and their types - and works out which are bound to the
+ * variables of the parser, and which are kept.
+ */
+bool stream::readHeader()
+{
+	bool		error = false;
+	_cols.clear();
+	_width = 0;
+	if (_format == eCSV) {
+		const char	*pos = NULL;
+		const char	*end = NULL;
+		if (!nextLine(pos, end)) {
+			error = true;
+		} else {
+			while (true) {
+				const char	*f = pos;
+				const char	*c = (const char *)memchr(pos, ',', end - pos);
+				pos = (c == NULL ? end : c);
+				const char	*fe = pos;
+				trim(f, fe);
+				column	col;
+				col.name.assign(f, fe - f);
+				boost::unordered_map<std::string, value::value_type>::iterator	it = _types.find(col.name);
+				col.type = (it == _types.end() ? value::eDouble : it->second);
+				col.offset = 0;
+				col.width = 0;
+				col.bound = false;
+				col.kept = false;
+				_cols.push_back(col);
+				if (pos == end) {
+					break;
+				}
+				++pos;
+			}
+		}
+	} else {
+		uint32_t	cnt = 0;
+		if (!need(8) || (memcmp(_data + _pos, __magic, 4) != 0)) {
+			error = true;
+		} else {
+			memcpy(&cnt, _data + _pos + 4, sizeof(cnt));
+			_pos += 8;
+		}
+		for (uint32_t i = 0; !error && (i < cnt); ++i) {
+			uint32_t	type = 0;
+			uint32_t	len = 0;
+			if (!need(8)) {
+				error = true;
+				break;
+			}
+			memcpy(&type, _data + _pos, sizeof(type));
+			memcpy(&len, _data + _pos + 4, sizeof(len));
+			_pos += 8;
+			column	col;
+			col.type = (value::value_type)type;
+			col.width = widthOf(col.type);
+			col.bound = false;
+			col.kept = false;
+			if ((col.width == 0) || !need(len)) {
+				error = true;
+			} else {
+				col.name.assign(_data + _pos, len);
+				col.offset = _width;
+				_width += col.width;
+				_pos += len;
+				_cols.push_back(col);
+			}
+		}
+		if (_width == 0) {
+			error = true;
+		}
+	}
+	/**
+	 * The columns that have the names of the variables are the ones we
+	 * bind - the rest are never even parsed, unless they are kept.
+	 */
+	BOOST_FOREACH( column & c, _cols ) {
+		c.bound = (_parser.getVariableSlot(c.name) >= 0);
+		c.kept = (std::find(_keep.begin(), _keep.end(), c.name) != _keep.end());
+	}
+	return !error;
+}
+
+
+/**
+ * This method reads the next batch of records from the input into
+ * the batch, parsing all the fields that are needed - a line at a
+ * time for CSV, and a record at a time for the binary format.
+ */
+void stream::fill( batch & aBatch )
+{
+	aBatch.rows = 0;
+	aBatch.kept.clear();
+	aBatch.ends.clear();
+	aBatch.last = false;
+	aBatch.failed = false;
+	while (aBatch.rows < _batch_size) {
+		if (_format == eCSV) {
+			const char	*pos = NULL;
+			const char	*end = NULL;
+			if (!nextLine(pos, end)) {
+				aBatch.last = true;
+				break;
+			}
+			// blank lines are just skipped
+			if (pos == end) {
+				continue;
+			}
+			parseLine(aBatch, pos, end);
+		} else {
+			if (!need(_width)) {
+				// anything left over is part of a record
+				aBatch.failed = (_pos < _size);
+				aBatch.last = true;
+				break;
+			}
+			parseRecord(aBatch, _data + _pos);
+			_pos += _width;
+		}
+		aBatch.ends.push_back(aBatch.kept.size());
+		++aBatch.rows;
+	}
+	if (_read_failed) {
+		aBatch.failed = true;
+	}
+}
+
+
+/**
+ * This method parses one line of CSV into the next row of the batch.
+ * A quoted field can have commas in it, and a field that's not in the
+ * line at all is empty - a NaN for a double, and zero for the rest.
+ */
+void stream::parseLine( batch & aBatch, const char *aBegin, const char *anEnd )
+{
+	const char	*pos = aBegin;
+	size_t		row = aBatch.rows;
+	for (size_t i = 0; i < _cols.size(); ++i) {
+		const column	& col = _cols[i];
+		const char		*f = pos;
+		if ((pos < anEnd) && (*pos == '"')) {
+			// a quote ends with the next one that's not doubled
+			for (++pos; pos < anEnd; ++pos) {
+				if (*pos == '"') {
+					if ((pos + 1 < anEnd) && (pos[1] == '"')) {
+						++pos;
+					} else {
+						++pos;
+						break;
+					}
+				}
+			}
+		}
+		const char	*c = (pos < anEnd ? (const char *)memchr(pos, ',', anEnd - pos) : NULL);
+		pos = (c == NULL ? anEnd : c);
+		const char	*fe = pos;
+		if (pos < anEnd) {
+			++pos;
+		}
+		// each kept field has it's comma, as the result comes after them
+		if (col.kept) {
+			aBatch.kept.append(f, fe - f);
+			aBatch.kept.push_back(',');
+		}
+		if (col.bound) {
+			trim(f, fe);
+			switch (col.type) {
+				case value::eInt:
+					aBatch.ints[i][row] = parseInt(f, fe);
+					break;
+				case value::eTime:
+					aBatch.times[i][row] = util::timer::parseTimestamp(f, fe - f);
+					break;
+				default:
+					aBatch.dbls[i][row] = parseDouble(f, fe);
+					break;
+			}
+		}
+	}
+}
+
+
+/**
+ * This method copies the fields of one binary record into the next
+ * row of the batch - there's nothing to parse, just the bytes.
+ */
+void stream::parseRecord( batch & aBatch, const char *aRecord )
+{
+	size_t		row = aBatch.rows;
+	for (size_t i = 0; i < _cols.size(); ++i) {
+		const column	& col = _cols[i];
+		const char		*f = aRecord + col.offset;
+		if (col.kept) {
+			aBatch.kept.append(f, col.width);
+		}
+		if (col.bound) {
+			switch (col.type) {
+				case value::eInt:
+					{
+						int32_t		v = 0;
+						memcpy(&v, f, sizeof(v));
+						aBatch.ints[i][row] = v;
+					}
+					break;
+				case value::eTime:
+					memcpy(&aBatch.times[i][row], f, sizeof(uint64_t));
+					break;
+				default:
+					memcpy(&aBatch.dbls[i][row], f, sizeof(double));
+					break;
+			}
+		}
+	}
+}
+
+
+/**
+ * This method evaluates the source on the batch of records, and
+ * adds the results to what's to be written out.
+ */
+bool stream::evaluate( batch & aBatch )
+{
+	bool		error = false;
+	if (aBatch.rows > 0) {
+		// the columns are in this batch's arrays
+		for (size_t i = 0; i < _cols.size(); ++i) {
+			const column	& col = _cols[i];
+			if (!col.bound) {
+				continue;
+			}
+			switch (col.type) {
+				case value::eInt:
+					_parser.bindColumn(col.name, &aBatch.ints[i][0]);
+					break;
+				case value::eTime:
+					_parser.bindColumn(col.name, &aBatch.times[i][0]);
+					break;
+				default:
+					_parser.bindColumn(col.name, &aBatch.dbls[i][0]);
+					break;
+			}
+		}
+		std::vector<value>	ans;
+		if (!_parser.evalBatch(aBatch.rows, ans)) {
+			error = true;
+		} else {
+			for (size_t r = 0; r < aBatch.rows; ++r) {
+				writeRow(aBatch, r, ans[r]);
+			}
+			_rows += aBatch.rows;
+			error = !flush(false);
+		}
+	}
+	return !error;
+}
+
+
+/**
+ * This method does the work of a run once the input is ready - it
+ * reads the header, and then the loader fills the batches while
+ * the caller evaluates them, one after the other, until the input
+ * is done, or something fails.
+ */
+bool stream::process()
+{
+	bool		error = false;
+	_rows = 0;
+	_pending.clear();
+	_write_failed = false;
+	_read_failed = false;
+	_stop = false;
+	// the source has to be compiled to know what variables it has
+	if ((_parser.getProgram() == NULL) || !readHeader()) {
+		error = true;
+	} else {
+		for (int k = 0; k < 2; ++k) {
+			batch	& b = _batches[k];
+			b.dbls.assign(_cols.size(), std::vector<double>());
+			b.ints.assign(_cols.size(), std::vector<int>());
+			b.times.assign(_cols.size(), std::vector<uint64_t>());
+			for (size_t i = 0; i < _cols.size(); ++i) {
+				if (!_cols[i].bound) {
+					continue;
+				}
+				switch (_cols[i].type) {
+					case value::eInt:
+						b.ints[i].resize(_batch_size);
+						break;
+					case value::eTime:
+						b.times[i].resize(_batch_size);
+						break;
+					default:
+						b.dbls[i].resize(_batch_size);
+						break;
+				}
+			}
+			b.rows = 0;
+			b.last = false;
+			b.failed = false;
+			_full[k] = false;
+		}
+		writeHeader();
+#ifndef LKIT_SINGLE_THREADED
+		/**
+		 * The loader fills one batch while we evaluate the other, and
+		 * each waits for the other to be done with the next one.
+		 */
+		boost::thread	loader(boost::bind(&stream::load, this));
+		for (int k = 0; ; k ^= 1) {
+			{
+				boost::mutex::scoped_lock	lock(_mutex);
+				while (!_full[k]) {
+					_change.wait(lock);
+				}
+			}
+			batch	& b = _batches[k];
+			bool	done = b.last;
+			if (b.failed || !evaluate(b)) {
+				error = true;
+			}
+			{
+				boost::mutex::scoped_lock	lock(_mutex);
+				_full[k] = false;
+				_stop = error;
+			}
+			_change.notify_all();
+			if (done || error) {
+				break;
+			}
+		}
+		loader.join();
+#else
+		// with no threads, it's just read a batch, and then evaluate it
+		for (bool done = false; !done && !error; ) {
+			batch	& b = _batches[0];
+			fill(b);
+			done = b.last;
+			if (b.failed || !evaluate(b)) {
+				error = true;
+			}
+		}
+#endif
+		if (!flush(true)) {
+			error = true;
+		}
+	}
+	// the columns point into the batches, so they can't stay bound
+	_parser.clearColumns();
+	return !error;
+}
+
+
+/**
+ * This method is the loader - it fills one batch after the other,
+ * as each one is free, until the input is done. It's run on a
+ * thread of it's own, so the reading and parsing of one batch is
+ * done while the last one is being evaluated.
+ */
+void stream::load()
+{
+#ifndef LKIT_SINGLE_THREADED
+	for (int k = 0; ; k ^= 1) {
+		{
+			boost::mutex::scoped_lock	lock(_mutex);
+			while (_full[k] && !_stop) {
+				_change.wait(lock);
+			}
+			if (_stop) {
+				break;
+			}
+		}
+		batch	& b = _batches[k];
+		try {
+			fill(b);
+		} catch (...) {
+			b.failed = true;
+			b.last = true;
+		}
+		bool	done = b.last;
+		{
+			boost::mutex::scoped_lock	lock(_mutex);
+			_full[k] = true;
+		}
+		_change.notify_all();
+		if (done) {
+			break;
+		}
+	}
+#endif
+}
+
+
+/*******************************************************************
+ *
+ *                         Writing Methods
+ *
+ *******************************************************************/
+/**
+ * These methods add the header, and the kept fields and result of
+ * one row, to what's to be written out, and write it all to the
+ * output when there's enough of it - or it's all done.
+ */
+void stream::writeHeader()
+{
+	if (_format == eCSV) {
+		BOOST_FOREACH( const column & c, _cols ) {
+			if (c.kept) {
+				_pending.append(c.name);
+				_pending.push_back(',');
+			}
+		}
+		_pending.append("result\n");
+	} else {
+		uint32_t	cnt = 1;
+		BOOST_FOREACH( const column & c, _cols ) {
+			cnt += (c.kept ? 1 : 0);
+		}
+		_pending.append(__magic, 4);
+		append(_pending, cnt);
+		BOOST_FOREACH( const column & c, _cols ) {
+			if (c.kept) {
+				append(_pending, (uint32_t)c.type);
+				append(_pending, (uint32_t)c.name.size());
+				_pending.append(c.name);
+			}
+		}
+		append(_pending, (uint32_t)value::eDouble);
+		append(_pending, (uint32_t)6);
+		_pending.append("result");
+	}
+}
+
+
+void stream::writeRow( const batch & aBatch, size_t aRow, value & aResult )
+{
+	size_t		start = (aRow == 0 ? 0 : aBatch.ends[aRow - 1]);
+	_pending.append(aBatch.kept, start, aBatch.ends[aRow] - start);
+	if (_format == eCSV) {
+		formatValue(_pending, aResult);
+		_pending.push_back('\n');
+	} else {
+		// the result is always a double - and a NaN if it's undefined
+		double	d = (aResult.isUndefined() ? std::numeric_limits<double>::quiet_NaN() :
+											 aResult.evalAsDouble());
+		_pending.append((const char *)&d, sizeof(d));
+	}
+}
+
+
+bool stream::flush( bool aForce )
+{
+	if (!_write_failed && (aForce || (_pending.size() >= __flush))) {
+		size_t	done = 0;
+		while (done < _pending.size()) {
+			ssize_t	cnt = write(_out, _pending.data() + done, _pending.size() - done);
+			if (cnt > 0) {
+				done += cnt;
+			} else if ((cnt < 0) && (errno == EINTR)) {
+				continue;
+			} else {
+				_write_failed = true;
+				break;
+			}
+		}
+		_pending.clear();
+	}
+	return !_write_failed;
+}
+}		// end of namespace lkit
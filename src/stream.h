@@ -0,0 +1,306 @@
+/**
+ * stream.h - this file defines a streaming evaluator for a parser. Records
+ *            are read from a file, or a pipe, as CSV or a simple binary
+ *            format, and the columns of the input that have the names of
+ *            the variables of the source are bound to them, so that each
+ *            batch of rows is evaluated with one evalBatch(). The records
+ *            are read, and their fields parsed, on a thread of their own,
+ *            into one batch while the last one is being evaluated, and the
+ *            value of the final expression for each row is written out in
+ *            the same format as the input - after any of the input columns
+ *            that are to be kept. If LKit is built with LKIT_SINGLE_THREADED
+ *            defined, there's no thread, and each batch is read and then
+ *            evaluated by the caller.
+ *
+ *            The binary format is a header - the four bytes 'LKB1', the
+ *            number of columns as a uint32_t, and for each, it's type as
+ *            a uint32_t (the value_type of an int, double or time) and the
+ *            length of it's name as a uint32_t followed by the name - and
+ *            then the records, each the fields, in that order, as their
+ *            int32_t, double or uint64_t in the machine's byte order.
+ */
+#ifndef __LKIT_STREAM_H
+#define __LKIT_STREAM_H
+
+//	System Headers
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+#include <boost/unordered_map.hpp>
+#ifndef LKIT_SINGLE_THREADED
+#include <boost/thread.hpp>
+#endif
+
+//	Other Headers
+#include "value.h"
+
+//	Forward Declarations
+namespace lkit {
+class parser;
+}	// end of namespace lkit
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+/**
+ * Main class definition
+ */
+namespace lkit {
+class stream
+{
+	public:
+		/**
+		 * These are the formats of the records that can be read - and
+		 * the results are written in the same one.
+		 */
+		enum format {
+			// a header line of the names, and then a line for each record
+			eCSV = 0,
+			// the header of names and types, and then fixed-size records
+			eBinary
+		};
+
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This constructor takes the parser - with it's source - that's
+		 * going to be evaluated for each record. The parser isn't owned,
+		 * and has to outlive this stream, and no one else should be using
+		 * it while run() is going on.
+		 */
+		explicit stream( parser & aParser, format aFormat = eCSV );
+		/**
+		 * This is the standard destructor and needs to be virtual to make
+		 * sure that if we subclass off this, the right destructor will be
+		 * called.
+		 */
+		virtual ~stream();
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * These methods set, and get, the format of the records that are
+		 * read - the results are written in the same format.
+		 */
+		virtual void setFormat( format aFormat );
+		virtual format getFormat() const;
+		/**
+		 * The fields of a CSV file are all just text, so each column that's
+		 * bound to a variable is read as a double - unless it's set here to
+		 * be an int, or a time, which is read with timer::parseTimestamp().
+		 * The binary format has the types in it's header, so this is only
+		 * for CSV. Anything other than an int, double or time is refused.
+		 */
+		virtual bool setType( const std::string & aColumn, value::value_type aType );
+		/**
+		 * This method says that the named column of the input is to be
+		 * written out with each result - as it was read - so that the
+		 * results can be matched up with their records. The kept columns
+		 * are written in the order they are in the input, and then the
+		 * result, which has the name 'result'.
+		 */
+		virtual void keepColumn( const std::string & aColumn );
+		/**
+		 * These methods set, and get, the number of records that are in
+		 * each batch - read together, and evaluated with one evalBatch().
+		 * The default is 4096.
+		 */
+		virtual void setBatchSize( size_t aRows );
+		virtual size_t getBatchSize() const;
+		/**
+		 * This method returns the number of records that were evaluated
+		 * by the last run().
+		 */
+		virtual uint64_t getRowCount() const;
+
+		/*******************************************************************
+		 *
+		 *                       Evaluation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method reads all the records of the file 'anInput' - it's
+		 * mapped into memory, and read right out of the map - evaluates the
+		 * source for each, and writes the results to the file 'anOutput',
+		 * replacing whatever was in it. If the input can't be read, or is
+		 * malformed, or the source can't be compiled, 'false' is returned.
+		 */
+		virtual bool run( const std::string & anInput, const std::string & anOutput );
+		/**
+		 * This method reads all the records from the file descriptor
+		 * 'anInput' - a pipe, a socket or a file - until the end of it,
+		 * evaluates the source for each, and writes the results to the
+		 * file descriptor 'anOutput'. Neither is closed when it's done. If
+		 * the input is malformed, or the source can't be compiled, 'false'
+		 * is returned.
+		 *
+		 * The columns bound to the parser for the batches are all cleared
+		 * when a run is done - as the data they point to is gone.
+		 */
+		virtual bool run( int anInput, int anOutput );
+
+	private:
+		/**
+		 * This is each column of the input - it's name and type, where
+		 * it's fields are in a binary record, and if it's bound to a
+		 * variable, or kept for the output, or both.
+		 */
+		struct column {
+			std::string			name;
+			value::value_type	type;
+			size_t				offset;
+			size_t				width;
+			bool				bound;
+			bool				kept;
+		};
+
+		/**
+		 * This is a batch of records - the values of each of the bound
+		 * columns, in the array for it's type, and the kept fields of
+		 * each row, as they were read, one row after the other, with the
+		 * end of each row's in 'ends'. The 'last' batch is the end of the
+		 * input, and 'failed' says if it ended with a bad record.
+		 */
+		struct batch {
+			size_t									rows;
+			std::vector< std::vector<double> >		dbls;
+			std::vector< std::vector<int> >			ints;
+			std::vector< std::vector<uint64_t> >	times;
+			std::string								kept;
+			std::vector<size_t>						ends;
+			bool									last;
+			bool									failed;
+		};
+
+		/*******************************************************************
+		 *
+		 *                         Reading Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method makes sure that there are at least 'aBytes' bytes
+		 * of the input from the current position on, reading more if the
+		 * input is a descriptor, and returns 'false' if the input ends
+		 * before that.
+		 */
+		bool need( size_t aBytes );
+		/**
+		 * This method finds the next line of the input, and returns it's
+		 * start and end - without the end of line - or 'false' if there
+		 * are no more.
+		 */
+		bool nextLine( const char * & aBegin, const char * & anEnd );
+		/**
+		 * This method reads the header of the input - the names of the
+		 * columns, and their types - and works out which are bound to the
+		 * variables of the parser, and which are kept.
+		 */
+		bool readHeader();
+		/**
+		 * This method reads the next batch of records from the input into
+		 * the batch, parsing all the fields that are needed - a line at a
+		 * time for CSV, and a record at a time for the binary format.
+		 */
+		void fill( batch & aBatch );
+		void parseLine( batch & aBatch, const char *aBegin, const char *anEnd );
+		void parseRecord( batch & aBatch, const char *aRecord );
+		/**
+		 * This method evaluates the source on the batch of records, and
+		 * adds the results to what's to be written out.
+		 */
+		bool evaluate( batch & aBatch );
+		/**
+		 * This method does the work of a run once the input is ready - it
+		 * reads the header, and then the loader fills the batches while
+		 * the caller evaluates them, one after the other, until the input
+		 * is done, or something fails.
+		 */
+		bool process();
+		/**
+		 * This method is the loader - it fills one batch after the other,
+		 * as each one is free, until the input is done. It's run on a
+		 * thread of it's own, so the reading and parsing of one batch is
+		 * done while the last one is being evaluated.
+		 */
+		void load();
+
+		/*******************************************************************
+		 *
+		 *                         Writing Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * These methods add the header, and the kept fields and result of
+		 * one row, to what's to be written out, and write it all to the
+		 * output when there's enough of it - or it's all done.
+		 */
+		void writeHeader();
+		void writeRow( const batch & aBatch, size_t aRow, value & aResult );
+		bool flush( bool aForce );
+
+		// there's no copying a stream - it's all about the one run
+		stream( const stream & anOther );
+		stream & operator=( const stream & anOther );
+
+		/**
+		 * This is the parser we evaluate, how the records are formatted,
+		 * the types of the CSV columns that aren't doubles, the columns to
+		 * keep, and how many records are in a batch.
+		 */
+		parser												& _parser;
+		format												_format;
+		boost::unordered_map<std::string, value::value_type>	_types;
+		std::vector<std::string>							_keep;
+		size_t												_batch_size;
+		uint64_t											_rows;
+		/**
+		 * This is the input - the bytes we have, from the map of the file
+		 * or in the buffer for the descriptor, where we are in them, and
+		 * if there's no more to read, or reading it failed - and it's
+		 * columns, and the size of a binary record.
+		 */
+		int													_in;
+		const char											*_data;
+		size_t												_size;
+		size_t												_pos;
+		bool												_eof;
+		bool												_read_failed;
+		std::vector<char>									_buf;
+		std::vector<column>									_cols;
+		size_t												_width;
+		/**
+		 * This is the output - the descriptor, and what's waiting to be
+		 * written to it - and whether it's failed.
+		 */
+		int													_out;
+		std::string											_pending;
+		bool												_write_failed;
+		/**
+		 * These are the two batches, and their states - a batch is full
+		 * when the loader is done with it, and free when it's evaluated.
+		 * The loader stops when it's told to, as the evaluation failed.
+		 */
+		batch												_batches[2];
+		bool												_full[2];
+		bool												_stop;
+#ifndef LKIT_SINGLE_THREADED
+		boost::mutex										_mutex;
+		boost::condition_variable							_change;
+#endif
+};
+}		// end of namespace lkit
+
+#endif		// __LKIT_STREAM_H
@@ -0,0 +1,263 @@
+/**
+ * arena.h - this file defines a simple arena allocator for LKit. It hands
+ *           out memory from chunks, one after the other, so that the
+ *           things allocated together end up next to each other in
+ *           memory, and when we're all done, all the chunks are released
+ *           at once. The chunks start out small, and double in size up
+ *           to a limit, so a small arena doesn't hold a lot it never uses. Blocks that are given back before then are kept on
+ *           a free list for their size, so that an arena that sees a lot
+ *           of the same things come and go doesn't keep growing.
+ */
+#ifndef __LKIT_UTIL_ARENA_H
+#define __LKIT_UTIL_ARENA_H
+
+//	System Headers
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "spinlock.h"
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+namespace lkit {
+namespace util {
+/**
+ * This is the main class definition.
+ */
+class arena
+{
+	public:
+		/**
+		 * All the blocks are multiples of this size, so that anything
+		 * we hand out is aligned for anything that might be put in it.
+		 */
+		static const size_t		ALIGNMENT = 16;
+		/**
+		 * These are the sizes of the first, and the largest, chunks that
+		 * we get from the heap, and the largest block that will be kept
+		 * on a free list for re-use.
+		 */
+		static const size_t		FIRST_CHUNK_SIZE = 2 * 1024;
+		static const size_t		CHUNK_SIZE = 64 * 1024;
+		static const size_t		MAX_FREE_SIZE = 512;
+
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This is the default constructor that assumes NOTHING - it just
+		 * makes an empty arena that will get it's first chunk when the
+		 * first block is allocated.
+		 */
+		arena() :
+			_chunks(),
+			_next(NULL),
+			_end(NULL),
+			_grow(FIRST_CHUNK_SIZE),
+			_bytes(0),
+			_reserved(0),
+			_mutex()
+		{
+			for (size_t i = 0; i <= MAX_FREE_SIZE / ALIGNMENT; ++i) {
+				_free[i] = NULL;
+			}
+		}
+
+		/**
+		 * This is the standard destructor and it releases all the chunks
+		 * back to the heap. Nothing is destructed - that's the job of the
+		 * code that put things in the arena.
+		 */
+		~arena()
+		{
+			release();
+		}
+
+		/*******************************************************************
+		 *
+		 *                        Allocation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method returns a block of at least 'aSize' bytes from the
+		 * arena. If there's one of the same size on the free list, we
+		 * use that, otherwise it comes from the end of the current chunk,
+		 * and if that's not big enough, from a new chunk - twice the size
+		 * of the last one. A block that's bigger than that new chunk would
+		 * be gets a chunk all it's own, and the current one is kept for
+		 * the blocks that come after it.
+		 */
+		void *allocate( size_t aSize )
+		{
+			spinlock::scoped_lock	lock(_mutex);
+			size_t		sz = round(aSize);
+			void		*retval = NULL;
+			// see if we have one of these ready to go
+			if ((sz <= MAX_FREE_SIZE) && (_free[sz / ALIGNMENT] != NULL)) {
+				retval = _free[sz / ALIGNMENT];
+				_free[sz / ALIGNMENT] = *(void **)retval;
+			} else {
+				// ...if not, then we need to carve it out of a chunk
+				if ((_next != NULL) && ((size_t)(_end - _next) >= sz)) {
+					retval = _next;
+					_next += sz;
+				} else if (sz > _grow) {
+					// it's too big for a chunk - so it gets one of it's own
+					retval = ::operator new(sz);
+					_chunks.push_back((char *)retval);
+					_reserved += sz;
+				} else {
+					_next = (char *)::operator new(_grow);
+					_end = _next + _grow;
+					_chunks.push_back(_next);
+					_reserved += _grow;
+					if (_grow < CHUNK_SIZE) {
+						_grow *= 2;
+					}
+					retval = _next;
+					_next += sz;
+				}
+			}
+			_bytes += sz;
+			return retval;
+		}
+
+		/**
+		 * This method gives back a block of 'aSize' bytes to the arena
+		 * so that it can be re-used the next time a block of that size
+		 * is needed. The memory isn't returned to the heap until the
+		 * arena is released.
+		 */
+		void deallocate( void *aBlock, size_t aSize )
+		{
+			if (aBlock != NULL) {
+				spinlock::scoped_lock	lock(_mutex);
+				size_t		sz = round(aSize);
+				if (sz <= MAX_FREE_SIZE) {
+					*(void **)aBlock = _free[sz / ALIGNMENT];
+					_free[sz / ALIGNMENT] = aBlock;
+				}
+				_bytes -= sz;
+			}
+		}
+
+		/**
+		 * This method returns ALL the memory of the arena to the heap in
+		 * one go. Anything allocated from the arena has to have been
+		 * destructed by now, as it's all gone after this.
+		 */
+		void release()
+		{
+			spinlock::scoped_lock	lock(_mutex);
+			for (size_t i = 0; i < _chunks.size(); ++i) {
+				::operator delete(_chunks[i]);
+			}
+			_chunks.clear();
+			_next = NULL;
+			_end = NULL;
+			_grow = FIRST_CHUNK_SIZE;
+			_bytes = 0;
+			_reserved = 0;
+			for (size_t i = 0; i <= MAX_FREE_SIZE / ALIGNMENT; ++i) {
+				_free[i] = NULL;
+			}
+		}
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method returns the number of chunks that the arena has
+		 * gotten from the heap.
+		 */
+		size_t getChunkCount() const
+		{
+			spinlock::scoped_lock	lock(_mutex);
+			return _chunks.size();
+		}
+
+		/**
+		 * This method returns the number of bytes that are in use by
+		 * the blocks that have been allocated, and not given back.
+		 */
+		size_t getBytesInUse() const
+		{
+			spinlock::scoped_lock	lock(_mutex);
+			return _bytes;
+		}
+
+		/**
+		 * This method returns the number of bytes in all the chunks that
+		 * the arena has gotten from the heap - what's in use, what's on
+		 * the free lists, and what hasn't been handed out yet.
+		 */
+		size_t getBytesReserved() const
+		{
+			spinlock::scoped_lock	lock(_mutex);
+			return _reserved;
+		}
+
+		/**
+		 * This method returns the size of the block the arena really
+		 * hands out when asked for 'aSize' bytes.
+		 */
+		static size_t getBlockSize( size_t aSize )
+		{
+			return round(aSize);
+		}
+
+	private:
+		/**
+		 * This rounds up the size of a block to the alignment, and makes
+		 * sure it's big enough to hold the link it'll need when it's on
+		 * the free list.
+		 */
+		static size_t round( size_t aSize )
+		{
+			size_t	sz = (aSize + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+			return (sz == 0 ? ALIGNMENT : sz);
+		}
+
+		// there's no copying an arena - it's the owner of all it's memory
+		arena( const arena & anOther );
+		arena & operator=( const arena & anOther );
+
+		/**
+		 * These are all the chunks we've gotten from the heap, the part
+		 * of the current one that hasn't been handed out yet, and the
+		 * size of the next one we'll get.
+		 */
+		std::vector<char *>		_chunks;
+		char					*_next;
+		char					*_end;
+		size_t					_grow;
+		/**
+		 * These are the free lists for each of the sizes of blocks - the
+		 * first bytes of each free block is the link to the next one.
+		 */
+		void					*_free[MAX_FREE_SIZE / ALIGNMENT + 1];
+		// these are the number of bytes currently in use, and in the chunks
+		size_t					_bytes;
+		size_t					_reserved;
+		// ...and a simple spinlock to control access to it all
+		mutable spinlock		_mutex;
+};
+}		// end of namespace util
+}		// end of namespace lkit
+
+#endif		// __LKIT_UTIL_ARENA_H
@@ -0,0 +1,200 @@
+/**
+ * footprint.h - this file defines a simple tally of the memory that some
+ *               set of things in LKit is using - how many of them there
+ *               are, the bytes they asked for, and the overhead of the
+ *               allocators on top of that - the headers, the rounding, and
+ *               the buckets of the hashes - so that the cost of a language
+ *               tree, or a whole parser, can be seen, and compared with
+ *               other ways of laying it all out.
+ *
+ *               The heap doesn't say what it's using for a block, so this
+ *               uses what glibc does on 64-bit machines - a word in front
+ *               of each block, rounded up to 16 bytes, and never less than
+ *               32. It's an estimate, but a good one, and it's the same for
+ *               every layout being compared.
+ */
+#ifndef __LKIT_UTIL_FOOTPRINT_H
+#define __LKIT_UTIL_FOOTPRINT_H
+
+//	System Headers
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+#include <boost/unordered_map.hpp>
+
+//	Other Headers
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+namespace lkit {
+namespace util {
+/**
+ * This is the main class definition.
+ */
+class footprint
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This is the default constructor that starts the tally at zero.
+		 */
+		footprint() :
+			_count(0),
+			_bytes(0),
+			_overhead(0)
+		{
+		}
+
+		/*******************************************************************
+		 *
+		 *                        Tally Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method counts one more thing in the tally - that's 'aSize'
+		 * bytes itself, plus the 'anOverhead' the allocator used for it.
+		 */
+		void addObject( size_t aSize, size_t anOverhead )
+		{
+			++_count;
+			_bytes += aSize;
+			_overhead += anOverhead;
+		}
+
+		/**
+		 * This method adds a block of 'aSize' bytes from the heap that's
+		 * held by one of the things in the tally - it's not counted as a
+		 * thing of it's own.
+		 */
+		void addBlock( size_t aSize )
+		{
+			if (aSize > 0) {
+				_bytes += aSize;
+				_overhead += heapBlock(aSize) - aSize;
+			}
+		}
+
+		/**
+		 * This method adds the bytes that the allocator uses and that
+		 * aren't part of anything - like the unused part of an arena.
+		 */
+		void addOverhead( size_t aSize )
+		{
+			_overhead += aSize;
+		}
+
+		/**
+		 * These methods add what the list, or string, has on the heap -
+		 * all it has room for, not just what's in it - and for a string
+		 * that fits in itself, that's nothing at all.
+		 */
+		template <class T> void addList( const std::vector<T> & aList )
+		{
+			addBlock(aList.capacity() * sizeof(T));
+		}
+
+		void addString( const std::string & aString )
+		{
+			const char	*self = (const char *)&aString;
+			if ((aString.data() < self) || (aString.data() >= self + sizeof(aString))) {
+				addBlock(aString.capacity() + 1);
+			}
+		}
+
+		/**
+		 * This method adds the buckets, and the nodes, of the hash - the
+		 * pairs in the nodes are what's asked for, and the links, and the
+		 * buckets, are the overhead. What the keys, or values, point to
+		 * is up to the caller.
+		 */
+		template <class K, class V> void addMap( const boost::unordered_map<K, V> & aMap )
+		{
+			size_t	pair = sizeof(typename boost::unordered_map<K, V>::value_type);
+			size_t	node = pair + 2 * sizeof(void *);
+			_bytes += aMap.size() * pair;
+			_overhead += aMap.size() * (heapBlock(node) - pair);
+			if (aMap.bucket_count() > 0) {
+				_overhead += heapBlock((aMap.bucket_count() + 1) * sizeof(void *));
+			}
+		}
+
+		/**
+		 * This adds the bytes, and overhead, of another tally to this
+		 * one - but not it's count, as what it's counted is a part of
+		 * the things already counted in this one.
+		 */
+		void addParts( const footprint & anOther )
+		{
+			_bytes += anOther._bytes;
+			_overhead += anOther._overhead;
+		}
+
+		/**
+		 * This adds all that's in another tally to this one.
+		 */
+		footprint & operator+=( const footprint & anOther )
+		{
+			_count += anOther._count;
+			_bytes += anOther._bytes;
+			_overhead += anOther._overhead;
+			return *this;
+		}
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * These methods return the number of things in the tally, the
+		 * bytes they asked for, and what the allocators used on top of
+		 * that - so all they're using is the last two added up.
+		 */
+		size_t getCount() const
+		{
+			return _count;
+		}
+
+		size_t getBytes() const
+		{
+			return _bytes;
+		}
+
+		size_t getOverhead() const
+		{
+			return _overhead;
+		}
+
+		/**
+		 * This method returns what the heap is using for a block of
+		 * 'aSize' bytes - a word in front of it, rounded up to 16 bytes,
+		 * and never less than 32.
+		 */
+		static size_t heapBlock( size_t aSize )
+		{
+			size_t	sz = (aSize + sizeof(size_t) + 15) & ~((size_t)15);
+			return (sz < 32 ? 32 : sz);
+		}
+
+	private:
+		size_t		_count;
+		size_t		_bytes;
+		size_t		_overhead;
+};
+}		// end of namespace util
+}		// end of namespace lkit
+
+#endif		// __LKIT_UTIL_FOOTPRINT_H
@@ -0,0 +1,154 @@
+/**
+ * lexer.h - this file defines the lexer for the parser. It makes one pass
+ *           over the source, handing back each token as a view into the
+ *           source itself - so there's no copying, and no allocation, for
+ *           any of them. The parser then decides what each one means: a
+ *           function, a constant, or a variable.
+ */
+#ifndef __LKIT_UTIL_LEXER_H
+#define __LKIT_UTIL_LEXER_H
+
+//	System Headers
+#include <stddef.h>
+#include <stdint.h>
+
+//	Third-Party Headers
+#include <boost/utility/string_ref.hpp>
+
+//	Other Headers
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+namespace lkit {
+namespace util {
+/**
+ * This is the main class definition.
+ */
+class lexer
+{
+	public:
+		/**
+		 * These are the kinds of tokens in the source - the start and
+		 * end of an expression, everything else between the whitespace
+		 * and parens, and the end of the source.
+		 */
+		enum token_type {
+			eEnd = 0,
+			eOpen,
+			eClose,
+			eAtom,
+		};
+
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This constructor takes the range of the source to scan - it's
+		 * not copied, so it has to be there for as long as the lexer, and
+		 * the tokens it hands out, are in use.
+		 */
+		lexer( const char *aBegin, const char *anEnd ) :
+			_begin(aBegin),
+			_pos(aBegin),
+			_end(anEnd),
+			_start(aBegin)
+		{
+		}
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method skips any whitespace and returns the next token in
+		 * the source, putting the text of it in 'aToken'. An atom is any
+		 * run of characters up to the next whitespace or paren - except
+		 * that one starting with a quote runs to the closing quote, so
+		 * a timestamp like '2012-03-21 11:45:16' is one atom.
+		 */
+		token_type next( boost::string_ref & aToken )
+		{
+			token_type	retval = eEnd;
+			// skip all white space - it's unimportant
+			while ((_pos < _end) && isSpace(*_pos)) {
+				++_pos;
+			}
+			_start = _pos;
+			if (_pos < _end) {
+				if (*_pos == '(') {
+					retval = eOpen;
+					++_pos;
+				} else if (*_pos == ')') {
+					retval = eClose;
+					++_pos;
+				} else {
+					retval = eAtom;
+					if (*_pos == '\'') {
+						// a quoted atom runs to - and includes - the closing quote
+						++_pos;
+						while ((_pos < _end) && (*_pos != '\'')) {
+							++_pos;
+						}
+						if (_pos < _end) {
+							++_pos;
+						}
+					} else {
+						while ((_pos < _end) && !isSpace(*_pos) &&
+							   (*_pos != '(') && (*_pos != ')')) {
+							++_pos;
+						}
+					}
+				}
+			}
+			aToken = boost::string_ref(_start, _pos - _start);
+			return retval;
+		}
+
+		/**
+		 * These methods return the offsets in the source of the start of
+		 * the last token, and of where the next one will be looked for -
+		 * just past the end of the last one.
+		 */
+		uint32_t getTokenOffset() const
+		{
+			return (uint32_t)(_start - _begin);
+		}
+
+		uint32_t getOffset() const
+		{
+			return (uint32_t)(_pos - _begin);
+		}
+
+	private:
+		/**
+		 * This is the same as isspace() in the "C" locale - but without
+		 * the call, or looking at the locale, for every character.
+		 */
+		static bool isSpace( char aChar )
+		{
+			return ((aChar == ' ') || ((aChar >= '\t') && (aChar <= '\r')));
+		}
+
+		/**
+		 * These are the range of the source, where we are in it, and the
+		 * start of the last token we handed out.
+		 */
+		const char		*_begin;
+		const char		*_pos;
+		const char		*_end;
+		const char		*_start;
+};
+}		// end of namespace util
+}		// end of namespace lkit
+
+#endif		// __LKIT_UTIL_LEXER_H
@@ -0,0 +1,305 @@
+/**
+ * pool.h - this file defines a simple work-stealing pool of threads for
+ *          LKit. A batch of tasks is dealt out to a queue for each of the
+ *          threads - and one for the caller, who helps out - and each one
+ *          works from the front of it's own queue, and when that's empty,
+ *          steals from the back of the others, so that a few long tasks
+ *          don't leave the rest of the threads idle. If LKit is built with
+ *          LKIT_SINGLE_THREADED defined, there are no threads at all, and
+ *          the caller just runs the tasks, one after the other.
+ */
+#ifndef __LKIT_UTIL_POOL_H
+#define __LKIT_UTIL_POOL_H
+
+//	System Headers
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+//	Third-Party Headers
+#include <boost/function.hpp>
+#ifndef LKIT_SINGLE_THREADED
+#include <boost/bind/bind.hpp>
+#include <boost/thread.hpp>
+#endif
+
+//	Other Headers
+#include "spinlock.h"
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+namespace lkit {
+namespace util {
+/**
+ * This is the main class definition.
+ */
+class pool
+{
+	public:
+		/**
+		 * This is what the pool runs - anything that can be called with
+		 * no arguments, and returns nothing.
+		 */
+		typedef boost::function<void ()> task_t;
+
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This constructor starts 'aThreads' threads that will wait for
+		 * the batches of tasks to run. The caller of run() is one more,
+		 * so a pool of 3 threads runs a batch 4 at a time.
+		 */
+		explicit pool( size_t aThreads ) :
+			_queues(),
+			_threads(),
+			_batch(0),
+			_pending(0),
+			_failed(false),
+			_stop(false)
+		{
+#ifndef LKIT_SINGLE_THREADED
+			for (size_t i = 0; i <= aThreads; ++i) {
+				_queues.push_back(new queue());
+			}
+			for (size_t i = 1; i <= aThreads; ++i) {
+				_threads.push_back(new boost::thread(boost::bind(&pool::work, this, i)));
+			}
+#endif
+		}
+
+		/**
+		 * This is the standard destructor and it tells all the threads
+		 * to stop, and waits for them to do it. The caller has to make
+		 * sure that no batch is running at the time.
+		 */
+		~pool()
+		{
+#ifndef LKIT_SINGLE_THREADED
+			{
+				boost::mutex::scoped_lock	lock(_mutex);
+				_stop = true;
+			}
+			_wake.notify_all();
+			for (size_t i = 0; i < _threads.size(); ++i) {
+				_threads[i]->join();
+				delete _threads[i];
+			}
+			_threads.clear();
+			for (size_t i = 0; i < _queues.size(); ++i) {
+				delete _queues[i];
+			}
+			_queues.clear();
+#endif
+		}
+
+		/*******************************************************************
+		 *
+		 *                        Execution Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method runs all the tasks in the batch, and doesn't return
+		 * until they are all done. The calling thread works on the batch
+		 * as well, and there's no telling what thread runs what task, or
+		 * in what order. If any of the tasks throws an exception, the
+		 * rest of them are still run, and then this returns 'false'.
+		 */
+		bool run( const std::vector<task_t> & aTasks )
+		{
+			bool		error = false;
+			bool		shared = false;
+#ifndef LKIT_SINGLE_THREADED
+			if (!_threads.empty() && (aTasks.size() > 1)) {
+				shared = true;
+				/**
+				 * The count has to be set before the first task is in a
+				 * queue, as a thread that's still looking for work from
+				 * the last batch might pick it up right away.
+				 */
+				{
+					boost::mutex::scoped_lock	lock(_mutex);
+					_pending = aTasks.size();
+					_failed = false;
+				}
+				for (size_t i = 0; i < aTasks.size(); ++i) {
+					queue	& q = *_queues[i % _queues.size()];
+					spinlock::scoped_lock	lock(q.mutex);
+					q.tasks.push_back(&aTasks[i]);
+				}
+				{
+					boost::mutex::scoped_lock	lock(_mutex);
+					++_batch;
+				}
+				_wake.notify_all();
+				// help out with the batch, and then wait for the rest
+				drain(0);
+				boost::mutex::scoped_lock	lock(_mutex);
+				while (_pending > 0) {
+					_done.wait(lock);
+				}
+				error = _failed;
+			}
+#endif
+			// with no one to help, it's just a simple loop
+			for (size_t i = 0; !shared && (i < aTasks.size()); ++i) {
+				if (!call(aTasks[i])) {
+					error = true;
+				}
+			}
+			return !error;
+		}
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method returns the number of threads that work on a batch
+		 * - the ones in the pool, and the caller.
+		 */
+		size_t getThreadCount() const
+		{
+			return _threads.size() + 1;
+		}
+
+	private:
+		/**
+		 * This calls the task, and returns 'false' if it threw anything
+		 * at all - as there's no one on the thread to catch it.
+		 */
+		static bool call( const task_t & aTask )
+		{
+			bool	error = false;
+			try {
+				aTask();
+			} catch (...) {
+				error = true;
+			}
+			return !error;
+		}
+
+#ifndef LKIT_SINGLE_THREADED
+		/**
+		 * These are the queues of the tasks - one for each thread, and
+		 * the caller is the first - each with it's own lock, so that a
+		 * thread working on it's own queue doesn't get in the way of
+		 * the others.
+		 */
+		struct queue {
+			std::deque<const task_t *>	tasks;
+			spinlock					mutex;
+		};
+
+		/**
+		 * This method returns the next task for the thread working on the
+		 * queue 'aQueue' - from the front of it's own queue, or else from
+		 * the back of one of the others - or NULL if there are none left.
+		 */
+		const task_t *next( size_t aQueue )
+		{
+			const task_t	*retval = NULL;
+			for (size_t i = 0; (retval == NULL) && (i < _queues.size()); ++i) {
+				queue	& q = *_queues[(aQueue + i) % _queues.size()];
+				spinlock::scoped_lock	lock(q.mutex);
+				if (!q.tasks.empty()) {
+					if (i == 0) {
+						retval = q.tasks.front();
+						q.tasks.pop_front();
+					} else {
+						retval = q.tasks.back();
+						q.tasks.pop_back();
+					}
+				}
+			}
+			return retval;
+		}
+
+		/**
+		 * This method runs the tasks for the thread working on the queue
+		 * 'aQueue' until there are none left in any of the queues - and
+		 * counts each one as done as it goes.
+		 */
+		void drain( size_t aQueue )
+		{
+			const task_t	*t = NULL;
+			while ((t = next(aQueue)) != NULL) {
+				bool	ok = call(*t);
+				boost::mutex::scoped_lock	lock(_mutex);
+				if (!ok) {
+					_failed = true;
+				}
+				if (--_pending == 0) {
+					_done.notify_all();
+				}
+			}
+		}
+
+		/**
+		 * This is the loop for each of the threads in the pool - wait for
+		 * a new batch, work on it until it's all been taken, and then do
+		 * it all again until we're told to stop.
+		 */
+		void work( size_t aQueue )
+		{
+			uint64_t	seen = 0;
+			while (true) {
+				{
+					boost::mutex::scoped_lock	lock(_mutex);
+					while (!_stop && (_batch == seen)) {
+						_wake.wait(lock);
+					}
+					if (_stop) {
+						break;
+					}
+					seen = _batch;
+				}
+				drain(aQueue);
+			}
+		}
+#endif
+
+		// there's no copying a pool - it's the owner of all it's threads
+		pool( const pool & anOther );
+		pool & operator=( const pool & anOther );
+
+#ifndef LKIT_SINGLE_THREADED
+		/**
+		 * These are the queues of tasks, and the threads working on them,
+		 * and the lock and conditions they wait on for a new batch, and
+		 * for the batch to be done.
+		 */
+		std::vector<queue *>			_queues;
+		std::vector<boost::thread *>	_threads;
+		boost::mutex					_mutex;
+		boost::condition_variable		_wake;
+		boost::condition_variable		_done;
+#else
+		std::vector<void *>				_queues;
+		std::vector<void *>				_threads;
+#endif
+		/**
+		 * This is the count of the batches - so a thread knows when there's
+		 * a new one - and the tasks in the current one that aren't done,
+		 * and if any of them failed. All are protected by the mutex.
+		 */
+		uint64_t						_batch;
+		size_t							_pending;
+		bool							_failed;
+		bool							_stop;
+};
+}		// end of namespace util
+}		// end of namespace lkit
+
+#endif		// __LKIT_UTIL_POOL_H
@@ -0,0 +1,77 @@
+/**
+ * spinlock.h - this file defines the spinlock that all of LKit uses to
+ *              protect it's data. Normally, this is just the boost
+ *              spinlock, but if LKit is built with LKIT_SINGLE_THREADED
+ *              defined, then it's a lock that does nothing, so that
+ *              when a single thread owns all the values and parsers, it
+ *              doesn't pay for locking at all. It's empty, but as a member
+ *              it still takes a byte - and the padding after it - so the
+ *              value, that there are the most of, leaves it's locks out
+ *              of that build altogether.
+ */
+#ifndef __LKIT_UTIL_SPINLOCK_H
+#define __LKIT_UTIL_SPINLOCK_H
+
+//	System Headers
+
+//	Third-Party Headers
+#ifndef LKIT_SINGLE_THREADED
+#include <boost/smart_ptr/detail/spinlock.hpp>
+#endif
+
+//	Other Headers
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+namespace lkit {
+namespace util {
+#ifndef LKIT_SINGLE_THREADED
+/**
+ * By default, we're going to use the boost spinlock as it's small and
+ * very fast when there's little contention - and that's what we have.
+ */
+typedef boost::detail::spinlock spinlock;
+#else
+/**
+ * This is the single-threaded version of the spinlock. It has the same
+ * interface as the boost spinlock, but does nothing at all, and so the
+ * compiler removes it all. The caller is then responsible for making
+ * sure that only one thread is using the values at any one time.
+ *
+ * NOTE: everything that includes the LKit headers - the library AND the
+ *       code using it - has to agree on LKIT_SINGLE_THREADED as it
+ *       changes the size of all the classes.
+ */
+class spinlock
+{
+	public:
+		bool try_lock() { return true; }
+		void lock() { }
+		void unlock() { }
+
+		/**
+		 * This is the scoped lock that the code uses to lock a spinlock
+		 * for the life of the scope - and here, it does nothing as well.
+		 */
+		class scoped_lock
+		{
+			public:
+				explicit scoped_lock( spinlock & aLock ) { }
+				~scoped_lock() { }
+			private:
+				scoped_lock( const scoped_lock & anOther );
+				scoped_lock & operator=( const scoped_lock & anOther );
+		};
+};
+#endif
+}		// end of namespace util
+}		// end of namespace lkit
+
+#endif		// __LKIT_UTIL_SPINLOCK_H
@@ -0,0 +1,415 @@
+/**
+ * table.h - this file defines the table the parser uses to find it's
+ *           variables and functions by name, or by slot, without taking
+ *           any locks. A name is given a slot the first time it's added,
+ *           and keeps it until the table is cleared, so an entry for a
+ *           name is never changed or removed - it's just published - and
+ *           the slot holds the pointer to what has that name right now.
+ *           When the hash of the names, or the array of slots, is full,
+ *           a copy twice the size is published in it's place, and the old
+ *           one is kept until the table is cleared, so that a reader that
+ *           was still looking at it is never left with a dangling pointer.
+ *
+ *           Readers never lock, but the writers - add(), set() and clear()
+ *           - have to be run one at a time, and the caller does that with
+ *           a lock of it's own. clear() frees everything, so nothing can
+ *           be reading the table when it's called. If LKit is built with
+ *           LKIT_SINGLE_THREADED defined, the pointers are just pointers.
+ */
+#ifndef __LKIT_UTIL_TABLE_H
+#define __LKIT_UTIL_TABLE_H
+
+//	System Headers
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+#include <boost/functional/hash.hpp>
+#include <boost/utility/string_ref.hpp>
+#ifndef LKIT_SINGLE_THREADED
+#include <boost/atomic.hpp>
+#endif
+
+//	Other Headers
+#include "footprint.h"
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+namespace lkit {
+namespace util {
+/**
+ * This is the main class definition.
+ */
+template <class T> class table
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This is the default constructor that makes an empty table with
+		 * room for a few names before it has to grow.
+		 */
+		table() :
+			_index(),
+			_slots(),
+			_count(),
+			_entries(),
+			_old_index(),
+			_old_slots()
+		{
+			_index.store(makeIndex(__initial * 2));
+			_slots.store(makeSlots(__initial));
+		}
+
+
+		/**
+		 * This is the standard destructor - it frees all the names and
+		 * arrays of the table, but not what the slots point to, as that
+		 * belongs to the caller.
+		 */
+		~table()
+		{
+			release();
+		}
+
+
+		/*******************************************************************
+		 *
+		 *                         Reader Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method returns the slot for the name, or -1 if the name
+		 * has never been added to the table - it doesn't matter if the
+		 * slot has anything in it now.
+		 */
+		int find( const boost::string_ref & aName ) const
+		{
+			int			slot = -1;
+			size_t		h = boost::hash_range(aName.begin(), aName.end());
+			index		*idx = _index.load();
+			for (size_t i = h & idx->mask; ; i = (i + 1) & idx->mask) {
+				entry	*e = idx->buckets[i].load();
+				if (e == NULL) {
+					break;
+				}
+				if ((e->hash == h) && (aName.compare(boost::string_ref(e->name)) == 0)) {
+					slot = e->slot;
+					break;
+				}
+			}
+			return slot;
+		}
+
+
+		/**
+		 * These methods return what's in the slot - or the slot for the
+		 * name - right now, which is NULL if there's nothing there, or
+		 * the slot, or name, isn't in the table.
+		 */
+		T *get( int aSlot ) const
+		{
+			T			*ans = NULL;
+			slots		*s = _slots.load();
+			if ((aSlot >= 0) && ((size_t)aSlot < s->capacity)) {
+				ans = s->cells[aSlot].load();
+			}
+			return ans;
+		}
+
+
+		T *get( const boost::string_ref & aName ) const
+		{
+			// the slot has to be read after the name, or it might be too new
+			return get(find(aName));
+		}
+
+
+		/**
+		 * This method returns the number of slots that have been handed
+		 * out - which is one more than the largest slot - and the names
+		 * of all of them can be found.
+		 */
+		size_t size() const
+		{
+			return _count.load();
+		}
+
+
+		/**
+		 * This method adds the names, and the arrays - the current ones,
+		 * and those that have been replaced - to the tally. It looks at
+		 * what only the writers use, so the caller has to be the writer.
+		 */
+		void addFootprint( footprint & aTally ) const
+		{
+			for (size_t i = 0; i < _entries.size(); ++i) {
+				aTally.addObject(sizeof(entry), footprint::heapBlock(sizeof(entry)) - sizeof(entry));
+				aTally.addString(_entries[i]->name);
+			}
+			std::vector<const index *>	idx(_old_index.begin(), _old_index.end());
+			std::vector<const slots *>	sl(_old_slots.begin(), _old_slots.end());
+			idx.push_back(_index.load());
+			sl.push_back(_slots.load());
+			for (size_t i = 0; i < idx.size(); ++i) {
+				aTally.addBlock(sizeof(index));
+				aTally.addBlock((idx[i]->mask + 1) * sizeof(cell<entry *>));
+			}
+			for (size_t i = 0; i < sl.size(); ++i) {
+				aTally.addBlock(sizeof(slots));
+				aTally.addBlock(sl[i]->capacity * sizeof(cell<T *>));
+			}
+			aTally.addList(_entries);
+			aTally.addList(_old_index);
+			aTally.addList(_old_slots);
+		}
+
+
+		/*******************************************************************
+		 *
+		 *                         Writer Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This method puts the pointer in the slot for the name - giving
+		 * the name a new slot if it's never been seen - and returns the
+		 * slot. The caller has to make sure that it's the only writer.
+		 */
+		int add( const std::string & aName, T *aPtr )
+		{
+			int			slot = find(aName);
+			if (slot >= 0) {
+				set(slot, aPtr);
+			} else {
+				// the new slot has to be there before anyone can find it
+				slot = (int)_count.load();
+				slots	*s = _slots.load();
+				if ((size_t)slot >= s->capacity) {
+					slots	*bigger = makeSlots(s->capacity * 2);
+					for (size_t i = 0; i < s->capacity; ++i) {
+						bigger->cells[i].store(s->cells[i].load());
+					}
+					_slots.store(bigger);
+					_old_slots.push_back(s);
+					s = bigger;
+				}
+				s->cells[slot].store(aPtr);
+				// ...and then the name is published, in a bigger hash if need be
+				entry	*e = new entry();
+				e->name = aName;
+				e->hash = boost::hash_range(aName.begin(), aName.end());
+				e->slot = slot;
+				_entries.push_back(e);
+				index	*idx = _index.load();
+				if (_entries.size() * 2 > idx->mask + 1) {
+					index	*bigger = makeIndex((idx->mask + 1) * 2);
+					for (size_t i = 0; i < _entries.size(); ++i) {
+						insert(bigger, _entries[i]);
+					}
+					_index.store(bigger);
+					_old_index.push_back(idx);
+				} else {
+					insert(idx, e);
+				}
+				// ...so that every slot counted has a name that can be found
+				_count.store((size_t)slot + 1);
+			}
+			return slot;
+		}
+
+
+		/**
+		 * This method replaces the pointer in the slot - NULL when what
+		 * was there is gone. The caller has to make sure that it's the
+		 * only writer, and that the slot has been handed out.
+		 */
+		void set( int aSlot, T *aPtr )
+		{
+			slots		*s = _slots.load();
+			if ((aSlot >= 0) && ((size_t)aSlot < s->capacity)) {
+				s->cells[aSlot].store(aPtr);
+			}
+		}
+
+
+		/**
+		 * This method drops all the names, and their slots, so that the
+		 * table is empty again. Everything is freed, so there can't be
+		 * anyone reading the table while this is done.
+		 */
+		void clear()
+		{
+			release();
+			_index.store(makeIndex(__initial * 2));
+			_slots.store(makeSlots(__initial));
+			_count.store(0);
+		}
+
+	private:
+		/**
+		 * This is a pointer, or a count, that's read by any thread at all
+		 * while it's written by one - so the reader has to see everything
+		 * the writer did before it was stored.
+		 */
+		template <class V> class cell
+		{
+			public:
+				cell() :
+					_val(V())
+				{
+				}
+				V load() const
+				{
+#ifndef LKIT_SINGLE_THREADED
+					return _val.load(boost::memory_order_acquire);
+#else
+					return _val;
+#endif
+				}
+				void store( V aValue )
+				{
+#ifndef LKIT_SINGLE_THREADED
+					_val.store(aValue, boost::memory_order_release);
+#else
+					_val = aValue;
+#endif
+				}
+			private:
+				// there's no copying of a cell - it's where it is
+				cell( const cell & anOther );
+				cell & operator=( const cell & anOther );
+#ifndef LKIT_SINGLE_THREADED
+				boost::atomic<V>	_val;
+#else
+				V					_val;
+#endif
+		};
+
+		/**
+		 * This is a name in the table - it's hash, so that the probes
+		 * rarely have to compare the strings, and it's slot.
+		 */
+		struct entry {
+			std::string		name;
+			size_t			hash;
+			int				slot;
+		};
+
+		/**
+		 * This is the open-addressed hash of the names - always a power
+		 * of two in size, and never more than half full - and the array
+		 * of slots. Once either is published, it only ever has pointers
+		 * stored in it, and it's only freed when the table is cleared.
+		 */
+		struct index {
+			size_t			mask;
+			cell<entry *>	*buckets;
+		};
+		struct slots {
+			size_t			capacity;
+			cell<T *>		*cells;
+		};
+
+		/**
+		 * These make the hash, and the array of slots, of the size given,
+		 * with nothing in them.
+		 */
+		static index *makeIndex( size_t aSize )
+		{
+			index	*idx = new index();
+			idx->mask = aSize - 1;
+			idx->buckets = new cell<entry *>[aSize];
+			return idx;
+		}
+
+
+		static slots *makeSlots( size_t aSize )
+		{
+			slots	*s = new slots();
+			s->capacity = aSize;
+			s->cells = new cell<T *>[aSize];
+			return s;
+		}
+
+
+		/**
+		 * This puts the entry in the first empty bucket from where it's
+		 * hash says it belongs - there's always one, as it's half empty.
+		 */
+		static void insert( index *anIndex, entry *anEntry )
+		{
+			size_t	i = anEntry->hash & anIndex->mask;
+			while (anIndex->buckets[i].load() != NULL) {
+				i = (i + 1) & anIndex->mask;
+			}
+			anIndex->buckets[i].store(anEntry);
+		}
+
+
+		/**
+		 * This frees the names, and all the arrays - the current ones and
+		 * those that were replaced as the table grew.
+		 */
+		void release()
+		{
+			_old_index.push_back(_index.load());
+			_old_slots.push_back(_slots.load());
+			for (size_t i = 0; i < _old_index.size(); ++i) {
+				delete [] _old_index[i]->buckets;
+				delete _old_index[i];
+			}
+			for (size_t i = 0; i < _old_slots.size(); ++i) {
+				delete [] _old_slots[i]->cells;
+				delete _old_slots[i];
+			}
+			for (size_t i = 0; i < _entries.size(); ++i) {
+				delete _entries[i];
+			}
+			_old_index.clear();
+			_old_slots.clear();
+			_entries.clear();
+			_index.store(NULL);
+			_slots.store(NULL);
+		}
+
+		// there's no copying a table - it's all about the pointers
+		table( const table & anOther );
+		table & operator=( const table & anOther );
+
+		/**
+		 * This is the number of slots the table starts with - the hash
+		 * starts out twice as big, so it's never more than half full.
+		 */
+		static const size_t		__initial = 16;
+
+		/**
+		 * These are what the readers see - the current hash of the names,
+		 * and the array of slots, and how many of the slots are in use.
+		 */
+		cell<index *>			_index;
+		cell<slots *>			_slots;
+		cell<size_t>			_count;
+		/**
+		 * These are only for the writers - all the names, so the hash can
+		 * be built again when it grows, and the arrays that were replaced,
+		 * as someone might still be looking at them.
+		 */
+		std::vector<entry *>	_entries;
+		std::vector<index *>	_old_index;
+		std::vector<slots *>	_old_slots;
+};
+}		// end of namespace util
+}		// end of namespace lkit
+
+#endif		// __LKIT_UTIL_TABLE_H
@@ -18,10 +18,14 @@
 #endif
 #include <string>
 #include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <ctype.h>
 
 //	Third-Party Headers
 
 //	Other Headers
+#include "spinlock.h"
 
 //	Forward Declarations
 
@@ -110,6 +114,30 @@ class timer
 		}
 
 
+		/**
+		 * When we're timing things that take a lot less than a usec - like
+		 * the evaluation of a single expression - we need a finer clock.
+		 * This is the same idea as usecStamp(), but in nsec, and it's from
+		 * a monotonic clock, so it's only good for intervals.
+		 */
+		static inline uint64_t nsecStamp()
+		{
+			uint64_t	now = 0;
+			#ifdef __MACH__
+				static mach_timebase_info_data_t	__timebase;
+				if (__timebase.denom == 0) {
+					(void) mach_timebase_info(&__timebase);
+				}
+				now = (mach_absolute_time() * __timebase.numer)/__timebase.denom;
+			#else
+				timespec	ts;
+				clock_gettime(CLOCK_MONOTONIC, &ts);
+				now = ((uint64_t)ts.tv_sec * 1000000000LL + (uint64_t)ts.tv_nsec);
+			#endif
+			return now;
+		}
+
+
 		/**
 		 * This method takes a timestamp as usec since Epoch and formats
 		 * it into a nice, human-readable timestamp: '2012-02-12 11:34:15'
@@ -203,43 +231,159 @@ class timer
 		 * completely reversable.
 		 */
 		static inline uint64_t parseTimestamp( const std::string & aTimestamp )
+		{
+			return parseTimestamp(aTimestamp.data(), aTimestamp.length());
+		}
+
+
+		/**
+		 * This method takes the 'aLen' characters at 'aTimestamp' - they
+		 * don't have to be NUL-terminated, so they can be right in the
+		 * middle of some source - as one of:
+		 *
+		 *   YYYY-MM-DD HH:MM:SS.ssssss
+		 *   YYYY-MM-DD
+		 *   HH:MM:SS.ssssss
+		 *
+		 * and converts it into a uint64_t number of usec since epoch - or
+		 * since midnight, for a time alone. The date and time are in the
+		 * local standard time, just as mktime() would have it with no DST.
+		 * Leading blanks are skipped, but anything else that isn't one of
+		 * these - even a date with a bad time after it - is a zero, plus
+		 * any fractional part we could find.
+		 *
+		 * The fields are parsed by hand, and the offset from UTC is just
+		 * looked up once for each day we see - as mktime() is a lot of
+		 * work for what's usually the same day, over and over.
+		 */
+		static inline uint64_t parseTimestamp( const char *aTimestamp, size_t aLen )
 		{
 			// this will get us to usec from seconds - just 1e6
 			static uint64_t	__mult = 1000000;
 
-			uint64_t	stamp = 0;
-			// start with an empty time structure and then fill it as we can
-			struct tm	when;
-			bzero(&when, sizeof(when));
-			// let's determine what we likely have for the format
-			size_t	len = aTimestamp.length();
-			bool	gotDate = ((aTimestamp.find('-') != std::string::npos) &&
-							   (len >= 10));
-			bool	gotTime = ((aTimestamp.find(':') != std::string::npos) &&
-							   (len >= 8));
-			if (gotDate && gotTime) {
-				if (strptime(aTimestamp.c_str(), "%Y-%m-%d %H:%M:%S", &when) != NULL) {
-					stamp = mktime(&when) * __mult;
+			uint64_t		stamp = 0;
+			const char		*pos = aTimestamp;
+			const char		*end = aTimestamp + aLen;
+			int				year = 0;
+			int				mon = 0;
+			int				day = 0;
+			int				hrs = 0;
+			int				mins = 0;
+			int				secs = 0;
+			// skip any leading blanks, as strptime() always did
+			while ((pos < end) && isspace(*pos)) {
+				++pos;
+			}
+			if ((end - pos >= 8) && (pos[2] == ':')) {
+				// it's just a time of day
+				if (parseTime(pos, end, hrs, mins, secs)) {
+					stamp = ((((hrs * 60) + mins) * 60) + secs) * __mult;
+				}
+			} else if (parseField(pos, end, 4, year) && (pos < end) && (*pos == '-') &&
+					   parseField(++pos, end, 2, mon) && (pos < end) && (*pos == '-') &&
+					   parseField(++pos, end, 2, day) &&
+					   (mon >= 1) && (mon <= 12) && (day >= 1) && (day <= 31)) {
+				// it's got a date - see if there's a time after it as well
+				const char	*date = pos;
+				while ((pos < end) && ((*pos == ' ') || (*pos == 'T'))) {
+					++pos;
 				}
-			} else if (gotDate) {
-				if (strptime(aTimestamp.c_str(), "%Y-%m-%d", &when) != NULL) {
-					stamp = mktime(&when) * __mult;
+				// ...it's midnight with nothing after it, but a bad time is a zero
+				if ((pos == date) || (pos == end) || parseTime(pos, end, hrs, mins, secs)) {
+					int64_t		when = localMidnight(year, mon, day) +
+									   (((hrs * 60) + mins) * 60) + secs;
+					stamp = (when > 0 ? when * __mult : 0);
 				}
-			} else if (gotTime) {
-				uint64_t	hrs = (aTimestamp[0] - '0') * 10 + (aTimestamp[1] - '0');
-				uint64_t	mins = (aTimestamp[3] - '0') * 10 + (aTimestamp[4] - '0');
-				uint64_t	secs = (aTimestamp[6] - '0') * 10 + (aTimestamp[7] - '0');
-				stamp = ((((hrs * 60) + mins) * 60) + secs) * __mult;
 			}
 			// now look for any fractional seconds on the time
-			size_t		pos = aTimestamp.rfind('.');
-			if (pos < aTimestamp.length() - 1) {
-				std::string		frac = aTimestamp.substr(pos+1);
-				frac.append("0000000");
-				stamp += atoi(frac.substr(0,6).c_str());
+			while ((end > aTimestamp) && (end[-1] != '.')) {
+				--end;
+			}
+			if (end > aTimestamp) {
+				uint64_t	usec = 0;
+				int			cnt = 0;
+				for (pos = end; (cnt < 6) && (pos < aTimestamp + aLen) &&
+								(*pos >= '0') && (*pos <= '9'); ++pos, ++cnt) {
+					usec = usec * 10 + (*pos - '0');
+				}
+				for (; cnt < 6; ++cnt) {
+					usec *= 10;
+				}
+				stamp += usec;
 			}
 			return stamp;
 		}
+
+	private:
+		/**
+		 * This method parses up to 'aMaxDigits' digits at 'aPos' into
+		 * 'aField', moving 'aPos' past them, and returns 'true' if there
+		 * was at least one.
+		 */
+		static inline bool parseField( const char * & aPos, const char *anEnd,
+									   int aMaxDigits, int & aField )
+		{
+			int		cnt = 0;
+			aField = 0;
+			for (; (cnt < aMaxDigits) && (aPos < anEnd) &&
+				   (*aPos >= '0') && (*aPos <= '9'); ++aPos, ++cnt) {
+				aField = aField * 10 + (*aPos - '0');
+			}
+			return (cnt > 0);
+		}
+
+
+		/**
+		 * This method parses the 'HH:MM:SS' at 'aPos' into it's fields,
+		 * and returns 'true' if it's all there, and they make sense.
+		 */
+		static inline bool parseTime( const char * & aPos, const char *anEnd,
+									  int & aHrs, int & aMins, int & aSecs )
+		{
+			return (parseField(aPos, anEnd, 2, aHrs) && (aPos < anEnd) && (*aPos == ':') &&
+					parseField(++aPos, anEnd, 2, aMins) && (aPos < anEnd) && (*aPos == ':') &&
+					parseField(++aPos, anEnd, 2, aSecs) &&
+					(aHrs <= 23) && (aMins <= 59) && (aSecs <= 61));
+		}
+
+
+		/**
+		 * This method returns the seconds since epoch of the midnight -
+		 * in local standard time - that starts the given day. That's best
+		 * left to mktime(), because of the time zone, but the last day we
+		 * looked up is kept, as most timestamps will be on the same day
+		 * as the one before it.
+		 */
+		static inline int64_t localMidnight( int aYear, int aMon, int aDay )
+		{
+			static spinlock	__mutex;
+			static int		__day = 0;
+			static int64_t	__midnight = 0;
+
+			int		day = (aYear * 100 + aMon) * 100 + aDay;
+			int64_t	midnight = 0;
+			bool	known = false;
+			{
+				spinlock::scoped_lock	lock(__mutex);
+				if (__day == day) {
+					midnight = __midnight;
+					known = true;
+				}
+			}
+			if (!known) {
+				struct tm	when;
+				bzero(&when, sizeof(when));
+				when.tm_year = aYear - 1900;
+				when.tm_mon = aMon - 1;
+				when.tm_mday = aDay;
+				midnight = mktime(&when);
+				// save it for the next time we see this day
+				spinlock::scoped_lock	lock(__mutex);
+				__day = day;
+				__midnight = midnight;
+			}
+			return midnight;
+		}
 };
 }		// end of namespace util
 }		// end of namespace lkit
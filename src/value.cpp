@@ -8,24 +8,64 @@
 
 //	System Headers
 #include <sstream>
+#include <typeinfo>
 
 //	Third-Party Headers
 #include <boost/functional/hash.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/is_pod.hpp>
 
 //	Other Headers
 #include "value.h"
+#include "util/arena.h"
+#include "util/footprint.h"
 
 //	Forward Declarations
 
 //	Private Constants
+/**
+ * The locks of a value are only members in the threaded build, so it's
+ * only there that the constructors have them to set up.
+ */
+#ifndef LKIT_SINGLE_THREADED
+#define LKIT_VALUE_LOCKS	_mutex(), _deps_mutex(),
+#else
+#define LKIT_VALUE_LOCKS
+#endif
 
 //	Private Datatypes
+/**
+ * Every value that's allocated has this header in front of it, so that
+ * when it's deleted we know if it goes back to an arena - and which one,
+ * or to the heap. It's padded out so the value stays aligned.
+ */
+struct alloc_header {
+	lkit::util::arena	*pool;
+	size_t				size;
+} __attribute__((aligned(16)));
+
+/**
+ * The whole point of the datum is that it's small and plain, so make
+ * sure it stays that way.
+ */
+BOOST_STATIC_ASSERT(sizeof(lkit::datum) == 16);
+BOOST_STATIC_ASSERT(boost::is_pod<lkit::datum>::value);
 
 //	Private Data Constants
 
 
 
 namespace lkit {
+#ifdef LKIT_SINGLE_THREADED
+/**
+ * With only one thread, the locks do nothing, so all the values can
+ * share the same two, and not carry them around.
+ */
+util::spinlock	value::_mutex;
+util::spinlock	value::_deps_mutex;
+#endif
+
+
 /*******************************************************************
  *
  *                     Constructors/Destructor
@@ -37,8 +77,9 @@ namespace lkit {
  */
 value::value() :
 	_type(eUnknown),
+	LKIT_VALUE_LOCKS
 	_intValue(0),
-	_mutex()
+	_dependents(NULL)
 {
 }
 
@@ -50,36 +91,55 @@ value::value() :
  */
 value::value( bool aValue ) :
 	_type(eBool),
+	LKIT_VALUE_LOCKS
 	_boolValue(aValue),
-	_mutex()
+	_dependents(NULL)
 {
 }
 
 
 value::value( int aValue ) :
 	_type(eInt),
+	LKIT_VALUE_LOCKS
 	_intValue(aValue),
-	_mutex()
+	_dependents(NULL)
 {
 }
 
 
 value::value( double aValue ) :
 	_type(eDouble),
+	LKIT_VALUE_LOCKS
 	_doubleValue(aValue),
-	_mutex()
+	_dependents(NULL)
 {
 }
 
 
 value::value( uint64_t aValue ) :
 	_type(eTime),
+	LKIT_VALUE_LOCKS
 	_timeValue(aValue),
-	_mutex()
+	_dependents(NULL)
 {
 }
 
 
+/**
+ * This constructor takes the plain data of a value - it's type
+ * and contents - and makes a value of it. This is how the data
+ * the evaluator works with gets back out to the caller.
+ */
+value::value( const datum & aDatum ) :
+	_type(eUnknown),
+	LKIT_VALUE_LOCKS
+	_intValue(0),
+	_dependents(NULL)
+{
+	assign_nl(aDatum);
+}
+
+
 /**
  * This is the standard copy constructor that needs to be in every
  * class to make sure that we control how many copies we have
@@ -87,14 +147,34 @@ value::value( uint64_t aValue ) :
  */
 value::value( const value & anOther ) :
 	_type(eUnknown),
+	LKIT_VALUE_LOCKS
 	_intValue(0),
-	_mutex()
+	_dependents(NULL)
 {
-	// let the '=' operator do the heavy lifting...
-	*this = anOther;
+	// nothing can depend on us yet, so there's no one to tell
+	assign_nl(anOther);
 }
 
 
+#if __cplusplus >= 201103L
+/**
+ * This is the move constructor - for all the temporaries that
+ * come out of the evaluations and the math operators. There's
+ * nothing on the heap to steal, so it's just the type and the
+ * contents, but it's never told to anyone, and the dependents
+ * of the original stay with it, as they know it by it's address.
+ */
+value::value( value && anOther ) :
+	_type(eUnknown),
+	LKIT_VALUE_LOCKS
+	_intValue(0),
+	_dependents(NULL)
+{
+	assign_nl(anOther);
+}
+#endif
+
+
 /**
  * This is the standard clone method that we'll have for all
  * classes so that it's possible to clone the value without
@@ -113,6 +193,110 @@ value *value::clone() const
  */
 value::~value()
 {
+	// let everyone that depends on us know that we're going away
+	std::vector<value *>	*deps = NULL;
+	{
+		util::spinlock::scoped_lock	lock(_deps_mutex);
+		deps = _dependents;
+		_dependents = NULL;
+	}
+	if (deps != NULL) {
+		for (std::vector<value *>::iterator it = deps->begin(); it != deps->end(); ++it) {
+			(*it)->dropDependency(this);
+		}
+		delete deps;
+	}
+}
+
+
+/*******************************************************************
+ *
+ *                        Memory Management
+ *
+ *******************************************************************/
+/**
+ * These are the allocators for values - and everything built on
+ * them. The plain version comes from the heap, and the other puts
+ * the value in the provided arena. Either way, it's just deleted
+ * like any other value, and the memory goes back where it came
+ * from, so whoever ends up owning the value doesn't need to know
+ * where it was allocated.
+ */
+void *value::operator new( size_t aSize )
+{
+	alloc_header	*h = (alloc_header *)::operator new(sizeof(alloc_header) + aSize);
+	h->pool = NULL;
+	h->size = aSize;
+	return (h + 1);
+}
+
+
+void *value::operator new( size_t aSize, util::arena & anArena )
+{
+	alloc_header	*h = (alloc_header *)anArena.allocate(sizeof(alloc_header) + aSize);
+	h->pool = &anArena;
+	h->size = aSize;
+	return (h + 1);
+}
+
+
+void value::operator delete( void *aBlock )
+{
+	if (aBlock != NULL) {
+		alloc_header	*h = (alloc_header *)aBlock - 1;
+		if (h->pool != NULL) {
+			h->pool->deallocate(h, sizeof(alloc_header) + h->size);
+		} else {
+			::operator delete(h);
+		}
+	}
+}
+
+
+void value::operator delete( void *aBlock, util::arena & anArena )
+{
+	// this is only called if the constructor throws - same as above
+	value::operator delete(aBlock);
+}
+
+
+/**
+ * This method adds the value to the tally of memory - the block
+ * it was allocated in, and what the allocator used on top of it,
+ * which is the header and the rounding of the arena, or the heap -
+ * and then all that it holds on the heap. The value has to have
+ * been made with 'new' - either kind - as that's where the size,
+ * and the allocator, are kept.
+ */
+void value::addAllocation( const value *aValue, util::footprint & aTally )
+{
+	if (aValue != NULL) {
+		const alloc_header	*h = (const alloc_header *)aValue - 1;
+		size_t				blk = sizeof(alloc_header) + h->size;
+		if (h->pool != NULL) {
+			aTally.addObject(h->size, util::arena::getBlockSize(blk) - h->size);
+		} else {
+			aTally.addObject(h->size, util::footprint::heapBlock(blk) - h->size);
+		}
+		aValue->addFootprint(aTally);
+	}
+}
+
+
+/**
+ * This method adds all that this value holds on the heap - the
+ * list of it's dependents, and for the subclasses, their names and
+ * lists and the like - to the tally, but not the value itself, as
+ * it might not be on the heap at all. Subclasses that hold more
+ * need to add it, and then call their super's version.
+ */
+void value::addFootprint( util::footprint & aTally ) const
+{
+	util::spinlock::scoped_lock	lock(_deps_mutex);
+	if (_dependents != NULL) {
+		aTally.addBlock(sizeof(std::vector<value *>));
+		aTally.addList(*_dependents);
+	}
 }
 
 
@@ -124,17 +308,28 @@ value::~value()
 value & value::operator=( const value & anOther )
 {
 	if (this != & anOther) {
-		_type = anOther._type;
-		switch (_type) {
-			case eUnknown:	_intValue = 0;							break;
-			case eBool:		_boolValue = anOther._boolValue;		break;
-			case eInt:		_intValue = anOther._intValue;			break;
-			case eDouble:	_doubleValue = anOther._doubleValue;	break;
-			case eTime:		_timeValue = anOther._timeValue;		break;
-		}
+		assign_nl(anOther);
+		markDependentsDirty();
+	}
+	return *this;
+}
+
+
+#if __cplusplus >= 201103L
+/**
+ * This is the move assignment operator, and it's just like the
+ * one above - the contents are taken, and our dependents are
+ * told - but the temporary it's taking them from isn't copied.
+ */
+value & value::operator=( value && anOther )
+{
+	if (this != & anOther) {
+		assign_nl(anOther);
+		markDependentsDirty();
 	}
 	return *this;
 }
+#endif
 
 
 /**
@@ -170,6 +365,19 @@ value & value::operator=( uint64_t aValue )
 }
 
 
+/**
+ * This version of the assignment operator takes the plain data
+ * of a value and saves it's type and contents into this instance,
+ * just like assigning another value would.
+ */
+value & value::operator=( const datum & aDatum )
+{
+	assign_nl(aDatum);
+	markDependentsDirty();
+	return *this;
+}
+
+
 /*******************************************************************
  *
  *                        Accessor Methods
@@ -183,29 +391,37 @@ value & value::operator=( uint64_t aValue )
  */
 bool value::set( bool aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
-	return set_nl(aValue);
+	util::spinlock::scoped_lock	lock(_mutex);
+	bool	ok = set_nl(aValue);
+	markDependentsDirty();
+	return ok;
 }
 
 
 bool value::set( int aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
-	return set_nl(aValue);
+	util::spinlock::scoped_lock	lock(_mutex);
+	bool	ok = set_nl(aValue);
+	markDependentsDirty();
+	return ok;
 }
 
 
 bool value::set( double aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
-	return set_nl(aValue);
+	util::spinlock::scoped_lock	lock(_mutex);
+	bool	ok = set_nl(aValue);
+	markDependentsDirty();
+	return ok;
 }
 
 
 bool value::set( uint64_t aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
-	return set_nl(aValue);
+	util::spinlock::scoped_lock	lock(_mutex);
+	bool	ok = set_nl(aValue);
+	markDependentsDirty();
+	return ok;
 }
 
 
@@ -216,35 +432,53 @@ bool value::set( uint64_t aValue )
  */
 value value::eval()
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	return eval_nl();
 }
 
 
+/**
+ * This is the same evaluation, but the result is written right
+ * into 'aResult' - which is returned - so there's no temporary
+ * to construct, and copy, at every level of a tree. It's written
+ * the way the evaluations cache their results, without telling
+ * anything that depends on 'aResult', so it's meant for the
+ * caller's own values - the scratch a function works in. The
+ * functions evaluate their arguments this way, so a subclass that
+ * overrides eval() needs to override this as well.
+ */
+value & value::eval( value & aResult )
+{
+	util::spinlock::scoped_lock	lock(_mutex);
+	eval_nl(aResult);
+	return aResult;
+}
+
+
 bool value::evalAsBool()
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	return evalAsBool_nl();
 }
 
 
 int value::evalAsInt()
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	return evalAsInt_nl();
 }
 
 
 double value::evalAsDouble()
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	return evalAsDouble_nl();
 }
 
 
 uint64_t value::evalAsTime()
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	return evalAsTime_nl();
 }
 
@@ -287,32 +521,56 @@ value::operator uint64_t()
  */
 bool value::isUndefined() const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	return (_type == eUnknown);
 }
 
 
 bool value::isInteger() const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	return (_type == eInt);
 }
 
 
 bool value::isDouble() const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	return (_type == eDouble);
 }
 
 
 bool value::isTime() const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	return (_type == eTime);
 }
 
 
+/**
+ * This method returns the plain data of this instance - it's type
+ * and contents - as they are right now. For an expression, this
+ * is the cached result, and it's not evaluated, so if that's what
+ * is needed, it's eval().getDatum().
+ */
+datum value::getDatum() const
+{
+	datum		retval;
+	util::spinlock::scoped_lock	lock(_mutex);
+	retval.type = _type;
+	// the time is the widest, so it carries all the others
+	retval.timeValue = 0;
+	switch (_type) {
+		case eUnknown:	break;
+		case eBool:		retval.boolValue = _boolValue;			break;
+		case eInt:		retval.intValue = _intValue;			break;
+		case eDouble:	retval.doubleValue = _doubleValue;		break;
+		case eTime:		retval.timeValue = _timeValue;			break;
+	}
+	return retval;
+}
+
+
 /**
  * This method simply resets the value to it's "undefined"
  * state - clearing out any value that might be currently
@@ -320,8 +578,68 @@ bool value::isTime() const
  */
 void value::clear()
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	clear_nl();
+	markDependentsDirty();
+}
+
+
+/**
+ * These methods allow an expression, or any other value that is
+ * calculated from this one, to register (and unregister) itself
+ * as a dependent of this value. When this value changes, each
+ * dependent is told that it's cached result is stale, and it
+ * will be recalculated on the next evaluation. A dependent that
+ * uses this value more than once registers once for each use.
+ */
+void value::addDependent( value *aDependent )
+{
+	if (aDependent != NULL) {
+		util::spinlock::scoped_lock	lock(_deps_mutex);
+		if (_dependents == NULL) {
+			_dependents = new std::vector<value *>();
+		}
+		_dependents->push_back(aDependent);
+	}
+}
+
+
+void value::removeDependent( value *aDependent )
+{
+	util::spinlock::scoped_lock	lock(_deps_mutex);
+	if (_dependents != NULL) {
+		for (std::vector<value *>::iterator it = _dependents->begin(); it != _dependents->end(); ++it) {
+			if (*it == aDependent) {
+				_dependents->erase(it);
+				break;
+			}
+		}
+	}
+}
+
+
+/**
+ * This method returns 'true' if the cached contents of this
+ * instance are out of date with respect to the values it's
+ * calculated from. A simple value is never dirty, but an
+ * expression will be until it's evaluated.
+ */
+bool value::isDirty() const
+{
+	return false;
+}
+
+
+/**
+ * This method returns 'true' if the contents of this instance
+ * can't be cached at all - because somewhere in the chain of
+ * values it's calculated from is a function that isn't pure,
+ * and so has to be called on every evaluation. Simple values
+ * are never volatile.
+ */
+bool value::isVolatile() const
+{
+	return false;
 }
 
 
@@ -349,6 +667,12 @@ bool value::isExpression() const
 }
 
 
+bool value::isArray() const
+{
+	return false;
+}
+
+
 /**
  * There are a lot of times that a human-readable version of
  * this instance will come in handy. This is that method. It's
@@ -358,7 +682,7 @@ bool value::isExpression() const
  */
 std::string value::toString() const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	return toString_nl();
 }
 
@@ -373,7 +697,7 @@ std::string value::toString() const
 size_t value::hash() const
 {
 	size_t	ans = 0;
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:											break;
 		case eBool:		ans = boost::hash_value(_boolValue);	break;
@@ -392,7 +716,7 @@ size_t value::hash() const
  */
 bool value::operator==( const value & anOther ) const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	bool		equals = (this == & anOther);
 	if (!equals && (_type == anOther._type)) {
 		switch (_type) {
@@ -554,7 +878,7 @@ bool value::operator>=( const value & anOther ) const
  */
 bool value::operator<( bool aValue ) const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	bool		test = false;
 	switch (_type) {
 		case eUnknown:
@@ -578,7 +902,7 @@ bool value::operator<( bool aValue ) const
 
 bool value::operator<( int aValue ) const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	bool		test = false;
 	switch (_type) {
 		case eUnknown:
@@ -602,7 +926,7 @@ bool value::operator<( int aValue ) const
 
 bool value::operator<( double aValue ) const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	bool		test = false;
 	switch (_type) {
 		case eUnknown:
@@ -626,7 +950,7 @@ bool value::operator<( double aValue ) const
 
 bool value::operator<( uint64_t aValue ) const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	bool		test = false;
 	switch (_type) {
 		case eUnknown:
@@ -674,7 +998,7 @@ bool value::operator<=( uint64_t aValue ) const
 
 bool value::operator>( bool aValue ) const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	bool		test = false;
 	switch (_type) {
 		case eUnknown:
@@ -698,7 +1022,7 @@ bool value::operator>( bool aValue ) const
 
 bool value::operator>( int aValue ) const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	bool		test = false;
 	switch (_type) {
 		case eUnknown:
@@ -722,7 +1046,7 @@ bool value::operator>( int aValue ) const
 
 bool value::operator>( double aValue ) const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	bool		test = false;
 	switch (_type) {
 		case eUnknown:
@@ -746,7 +1070,7 @@ bool value::operator>( double aValue ) const
 
 bool value::operator>( uint64_t aValue ) const
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	bool		test = false;
 	switch (_type) {
 		case eUnknown:
@@ -792,6 +1116,102 @@ bool value::operator>=( uint64_t aValue ) const
 }
 
 
+/**
+ * These versions of the tests take the plain data of a value, and
+ * are just the same as testing against a value that holds it. It's
+ * how a program compares the data on it's stack.
+ */
+bool value::operator==( const datum & aDatum ) const
+{
+	util::spinlock::scoped_lock	lock(_mutex);
+	bool		equals = false;
+	if (_type == aDatum.type) {
+		switch (_type) {
+			case eUnknown:
+				equals = true;
+				break;
+			case eBool:
+				equals = (_boolValue == aDatum.boolValue);
+				break;
+			case eInt:
+				equals = (_intValue == aDatum.intValue);
+				break;
+			case eDouble:
+				equals = (_doubleValue == aDatum.doubleValue);
+				break;
+			case eTime:
+				equals = (_timeValue == aDatum.timeValue);
+				break;
+		}
+	}
+	return equals;
+}
+
+
+bool value::operator!=( const datum & aDatum ) const
+{
+	return !operator==(aDatum);
+}
+
+
+bool value::operator<( const datum & aDatum ) const
+{
+	bool	test = false;
+	switch (aDatum.type) {
+		case eUnknown:
+			break;
+		case eBool:
+			test = operator<(aDatum.boolValue);
+			break;
+		case eInt:
+			test = operator<(aDatum.intValue);
+			break;
+		case eDouble:
+			test = operator<(aDatum.doubleValue);
+			break;
+		case eTime:
+			test = operator<(aDatum.timeValue);
+			break;
+	}
+	return test;
+}
+
+
+bool value::operator<=( const datum & aDatum ) const
+{
+	return !operator>(aDatum);
+}
+
+
+bool value::operator>( const datum & aDatum ) const
+{
+	bool	test = false;
+	switch (aDatum.type) {
+		case eUnknown:
+			break;
+		case eBool:
+			test = operator>(aDatum.boolValue);
+			break;
+		case eInt:
+			test = operator>(aDatum.intValue);
+			break;
+		case eDouble:
+			test = operator>(aDatum.doubleValue);
+			break;
+		case eTime:
+			test = operator>(aDatum.timeValue);
+			break;
+	}
+	return test;
+}
+
+
+bool value::operator>=( const datum & aDatum ) const
+{
+	return !operator<(aDatum);
+}
+
+
 /*
  * These operators are the convenience assignment operators for
  * the value and are meant to make it easy to use these guys in
@@ -822,7 +1242,7 @@ value & value::operator+=( const value & anOther )
 
 value & value::operator+=( bool aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			set_nl(aValue);
@@ -840,13 +1260,14 @@ value & value::operator+=( bool aValue )
 			_timeValue += (aValue ? 1 : 0);
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator+=( int aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			set_nl(aValue);
@@ -864,13 +1285,14 @@ value & value::operator+=( int aValue )
 			_timeValue += aValue;
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator+=( double aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			set_nl(aValue);
@@ -888,13 +1310,14 @@ value & value::operator+=( double aValue )
 			_timeValue += aValue;
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator+=( uint64_t aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			set_nl(aValue);
@@ -912,6 +1335,7 @@ value & value::operator+=( uint64_t aValue )
 			_timeValue += aValue;
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
@@ -940,7 +1364,7 @@ value & value::operator-=( const value & anOther )
 
 value & value::operator-=( bool aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			set_nl(!aValue);
@@ -958,13 +1382,14 @@ value & value::operator-=( bool aValue )
 			_timeValue -= (aValue ? 1 : 0);
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator-=( int aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			set_nl(-1 * aValue);
@@ -982,13 +1407,14 @@ value & value::operator-=( int aValue )
 			_timeValue -= aValue;
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator-=( double aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			set_nl(-1.0 * aValue);
@@ -1006,13 +1432,14 @@ value & value::operator-=( double aValue )
 			_timeValue -= aValue;
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator-=( uint64_t aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			set_nl(-1 * aValue);
@@ -1030,6 +1457,7 @@ value & value::operator-=( uint64_t aValue )
 			_timeValue -= aValue;
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
@@ -1058,7 +1486,7 @@ value & value::operator*=( const value & anOther )
 
 value & value::operator*=( bool aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			break;
@@ -1075,13 +1503,14 @@ value & value::operator*=( bool aValue )
 			_timeValue *= (aValue ? 1 : 0);
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator*=( int aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			break;
@@ -1098,13 +1527,14 @@ value & value::operator*=( int aValue )
 			_timeValue *= aValue;
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator*=( double aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			break;
@@ -1121,13 +1551,14 @@ value & value::operator*=( double aValue )
 			_timeValue *= aValue;
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator*=( uint64_t aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			break;
@@ -1144,6 +1575,7 @@ value & value::operator*=( uint64_t aValue )
 			_timeValue *= aValue;
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
@@ -1173,7 +1605,7 @@ value & value::operator/=( const value & anOther )
 
 value & value::operator/=( bool aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			break;
@@ -1188,13 +1620,14 @@ value & value::operator/=( bool aValue )
 			}
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator/=( int aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			break;
@@ -1227,13 +1660,14 @@ value & value::operator/=( int aValue )
 			}
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator/=( double aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			break;
@@ -1266,13 +1700,14 @@ value & value::operator/=( double aValue )
 			}
 			break;
 	}
+	markDependentsDirty();
 	return *this;
 }
 
 
 value & value::operator/=( uint64_t aValue )
 {
-	boost::detail::spinlock::scoped_lock	lock(_mutex);
+	util::spinlock::scoped_lock	lock(_mutex);
 	switch (_type) {
 		case eUnknown:
 			break;
@@ -1305,6 +1740,100 @@ value & value::operator/=( uint64_t aValue )
 			}
 			break;
 	}
+	markDependentsDirty();
+	return *this;
+}
+
+
+/**
+ * These versions take the plain data of a value, and do just what
+ * the same operator would with a value that holds it.
+ */
+value & value::operator+=( const datum & aDatum )
+{
+	switch (aDatum.type) {
+		case eUnknown:
+			break;
+		case eBool:
+			operator+=(aDatum.boolValue);
+			break;
+		case eInt:
+			operator+=(aDatum.intValue);
+			break;
+		case eDouble:
+			operator+=(aDatum.doubleValue);
+			break;
+		case eTime:
+			operator+=(aDatum.timeValue);
+			break;
+	}
+	return *this;
+}
+
+
+value & value::operator-=( const datum & aDatum )
+{
+	switch (aDatum.type) {
+		case eUnknown:
+			break;
+		case eBool:
+			operator-=(aDatum.boolValue);
+			break;
+		case eInt:
+			operator-=(aDatum.intValue);
+			break;
+		case eDouble:
+			operator-=(aDatum.doubleValue);
+			break;
+		case eTime:
+			operator-=(aDatum.timeValue);
+			break;
+	}
+	return *this;
+}
+
+
+value & value::operator*=( const datum & aDatum )
+{
+	switch (aDatum.type) {
+		case eUnknown:
+			break;
+		case eBool:
+			operator*=(aDatum.boolValue);
+			break;
+		case eInt:
+			operator*=(aDatum.intValue);
+			break;
+		case eDouble:
+			operator*=(aDatum.doubleValue);
+			break;
+		case eTime:
+			operator*=(aDatum.timeValue);
+			break;
+	}
+	return *this;
+}
+
+
+value & value::operator/=( const datum & aDatum )
+{
+	switch (aDatum.type) {
+		case eUnknown:
+			clear();
+			break;
+		case eBool:
+			operator/=(aDatum.boolValue);
+			break;
+		case eInt:
+			operator/=(aDatum.intValue);
+			break;
+		case eDouble:
+			operator/=(aDatum.doubleValue);
+			break;
+		case eTime:
+			operator/=(aDatum.timeValue);
+			break;
+	}
 	return *this;
 }
 
@@ -1347,7 +1876,9 @@ bool value::operator||( const value & anOther ) const
  */
 bool value::set_nl( const value & aValue )
 {
-	*this = aValue;
+	if (this != & aValue) {
+		assign_nl(aValue);
+	}
 	return true;
 }
 
@@ -1399,6 +1930,51 @@ void value::clear_nl()
 }
 
 
+/**
+ * This method copies the type and contents of the provided value
+ * into this instance without notifying any of the dependents of the
+ * change. This is what the evaluation methods use to cache their
+ * results. The "_nl" means "no lock" - the caller has to do it.
+ */
+void value::assign_nl( const value & aValue )
+{
+	_type = aValue._type;
+	switch (_type) {
+		case eUnknown:	_intValue = 0;							break;
+		case eBool:		_boolValue = aValue._boolValue;			break;
+		case eInt:		_intValue = aValue._intValue;			break;
+		case eDouble:	_doubleValue = aValue._doubleValue;		break;
+		case eTime:		_timeValue = aValue._timeValue;			break;
+	}
+}
+
+
+void value::assign_nl( const datum & aDatum )
+{
+	_type = aDatum.type;
+	switch (_type) {
+		case eUnknown:	_intValue = 0;							break;
+		case eBool:		_boolValue = aDatum.boolValue;			break;
+		case eInt:		_intValue = aDatum.intValue;			break;
+		case eDouble:	_doubleValue = aDatum.doubleValue;		break;
+		case eTime:		_timeValue = aDatum.timeValue;			break;
+	}
+}
+
+
+/**
+ * This method copies this instance into 'aResult' the same way -
+ * it's what the plain eval_nl() does, and what a subclass does once
+ * it's brought itself up to date.
+ */
+void value::copyTo_nl( value & aResult ) const
+{
+	if (&aResult != this) {
+		aResult.assign_nl(*this);
+	}
+}
+
+
 /**
  * This method gets the value for this instance, and it may be quite
  * involved in getting the value. This will be the way to get
@@ -1415,6 +1991,20 @@ value value::eval_nl()
 }
 
 
+void value::eval_nl( value & aResult )
+{
+	/**
+	 * A plain value is just copied into theirs, but a subclass may have
+	 * only overridden the other one, so that has to be what's used.
+	 */
+	if (typeid(*this) != typeid(value)) {
+		aResult.assign_nl(eval_nl());
+	} else {
+		copyTo_nl(aResult);
+	}
+}
+
+
 bool value::evalAsBool_nl()
 {
 	bool		retval = false;
@@ -1512,12 +2102,65 @@ uint64_t value::evalAsTime_nl()
  * and is quite useful for those times the subclasses need to be able
  * to lock something up while they do their thing.
  */
-boost::detail::spinlock & value::mutex() const
+util::spinlock & value::mutex() const
 {
 	return _mutex;
 }
 
 
+/**
+ * This method is called on a dependent of a value when that value
+ * has changed. The default is to simply pass the news along to
+ * all of our dependents, but an expression will mark it's cached
+ * result as stale as well.
+ */
+void value::markDirty()
+{
+	markDependentsDirty();
+}
+
+
+/**
+ * This is the same as the above, but it's told which value it is
+ * that has changed - so that an expression that can update it's
+ * result for just that argument knows where to look. Anything that
+ * doesn't care where the change came from can ignore it.
+ */
+void value::markDirty( const value *aSource )
+{
+	markDirty();
+}
+
+
+/**
+ * This method tells all the registered dependents of this value
+ * that this value has changed, and they need to mark themselves
+ * as dirty. It's called by all the public mutating methods, but
+ * NOT by the "_nl" setters, as they are used by the evaluation
+ * methods to cache the results of a calculation.
+ */
+void value::markDependentsDirty()
+{
+	util::spinlock::scoped_lock	lock(_deps_mutex);
+	if (_dependents != NULL) {
+		for (std::vector<value *>::iterator it = _dependents->begin(); it != _dependents->end(); ++it) {
+			(*it)->markDirty(this);
+		}
+	}
+}
+
+
+/**
+ * This method is called on each dependent of a value as that value
+ * is being destroyed, so that the dependent can drop any reference
+ * it might have to it. The default is to do nothing, as a simple
+ * value doesn't depend on anything.
+ */
+void value::dropDependency( const value *aValue )
+{
+}
+
+
 /*******************************************************************
  *
  *                         Utility Methods
@@ -11,13 +11,25 @@
 //	System Headers
 #include <stdint.h>
 #include <ostream>
+#include <vector>
 
 //	Third-Party Headers
-#include <boost/smart_ptr/detail/spinlock.hpp>
 
 //	Other Headers
+#include "util/spinlock.h"
 
 //	Forward Declarations
+/**
+ * Values can be allocated from an arena, and tally up the memory they
+ * use, and we only need to know about them in the signatures here.
+ */
+namespace lkit {
+namespace util {
+class arena;
+class footprint;
+}		// end of namespace util
+struct datum;
+}		// end of namespace lkit
 
 //	Public Constants
 
@@ -52,12 +64,28 @@ class value
 		value( int aValue );
 		value( double aValue );
 		value( uint64_t aValue );
+		/**
+		 * This constructor takes the plain data of a value - it's type
+		 * and contents - and makes a value of it. This is how the data
+		 * the evaluator works with gets back out to the caller.
+		 */
+		value( const datum & aDatum );
 		/**
 		 * This is the standard copy constructor that needs to be in every
 		 * class to make sure that we control how many copies we have
 		 * floating around in the system.
 		 */
 		value( const value & anOther );
+#if __cplusplus >= 201103L
+		/**
+		 * This is the move constructor - for all the temporaries that
+		 * come out of the evaluations and the math operators. There's
+		 * nothing on the heap to steal, so it's just the type and the
+		 * contents, but it's never told to anyone, and the dependents
+		 * of the original stay with it, as they know it by it's address.
+		 */
+		value( value && anOther );
+#endif
 		/**
 		 * This is the standard clone method that we'll have for all
 		 * classes so that it's possible to clone the value without
@@ -77,6 +105,14 @@ class value
 		 * all classes.
 		 */
 		value & operator=( const value & anOther );
+#if __cplusplus >= 201103L
+		/**
+		 * This is the move assignment operator, and it's just like the
+		 * one above - the contents are taken, and our dependents are
+		 * told - but the temporary it's taking them from isn't copied.
+		 */
+		value & operator=( value && anOther );
+#endif
 		/**
 		 * These versions of the assignment operator will take the value
 		 * and the implied type and save this information into this
@@ -86,6 +122,50 @@ class value
 		value & operator=( int aValue );
 		value & operator=( double aValue );
 		value & operator=( uint64_t aValue );
+		/**
+		 * This version of the assignment operator takes the plain data
+		 * of a value and saves it's type and contents into this instance,
+		 * just like assigning another value would.
+		 */
+		value & operator=( const datum & aDatum );
+
+		/*******************************************************************
+		 *
+		 *                        Memory Management
+		 *
+		 *******************************************************************/
+		/**
+		 * These are the allocators for values - and everything built on
+		 * them. The plain version comes from the heap, and the other puts
+		 * the value in the provided arena:
+		 *
+		 *   value  *v = new (myArena) value(10);
+		 *
+		 * Either way, it's just deleted like any other value, and the
+		 * memory goes back where it came from, so whoever ends up owning
+		 * the value doesn't need to know where it was allocated.
+		 */
+		static void *operator new( size_t aSize );
+		static void *operator new( size_t aSize, util::arena & anArena );
+		static void operator delete( void *aBlock );
+		static void operator delete( void *aBlock, util::arena & anArena );
+		/**
+		 * This method adds the value to the tally of memory - the block
+		 * it was allocated in, and what the allocator used on top of it,
+		 * which is the header and the rounding of the arena, or the heap -
+		 * and then all that it holds on the heap. The value has to have
+		 * been made with 'new' - either kind - as that's where the size,
+		 * and the allocator, are kept.
+		 */
+		static void addAllocation( const value *aValue, util::footprint & aTally );
+		/**
+		 * This method adds all that this value holds on the heap - the
+		 * list of it's dependents, and for the subclasses, their names and
+		 * lists and the like - to the tally, but not the value itself, as
+		 * it might not be on the heap at all. Subclasses that hold more
+		 * need to add it, and then call their super's version.
+		 */
+		virtual void addFootprint( util::footprint & aTally ) const;
 
 		/*******************************************************************
 		 *
@@ -122,6 +202,17 @@ class value
 		 * constants as well as evaluate functions and expressions.
 		 */
 		virtual value eval();
+		/**
+		 * This is the same evaluation, but the result is written right
+		 * into 'aResult' - which is returned - so there's no temporary
+		 * to construct, and copy, at every level of a tree. It's written
+		 * the way the evaluations cache their results, without telling
+		 * anything that depends on 'aResult', so it's meant for the
+		 * caller's own values - the scratch a function works in. The
+		 * functions evaluate their arguments this way, so a subclass that
+		 * overrides eval() needs to override this as well.
+		 */
+		virtual value & eval( value & aResult );
 		virtual bool evalAsBool();
 		virtual int evalAsInt();
 		virtual double evalAsDouble();
@@ -149,6 +240,14 @@ class value
 		bool isDouble() const;
 		bool isTime() const;
 
+		/**
+		 * This method returns the plain data of this instance - it's type
+		 * and contents - as they are right now. For an expression, this
+		 * is the cached result, and it's not evaluated, so if that's what
+		 * is needed, it's eval().getDatum().
+		 */
+		datum getDatum() const;
+
 		/**
 		 * This method simply resets the value to it's "undefined"
 		 * state - clearing out any value that might be currently
@@ -156,6 +255,32 @@ class value
 		 */
 		void clear();
 
+		/**
+		 * These methods allow an expression, or any other value that is
+		 * calculated from this one, to register (and unregister) itself
+		 * as a dependent of this value. When this value changes, each
+		 * dependent is told that it's cached result is stale, and it
+		 * will be recalculated on the next evaluation. A dependent that
+		 * uses this value more than once registers once for each use.
+		 */
+		void addDependent( value *aDependent );
+		void removeDependent( value *aDependent );
+		/**
+		 * This method returns 'true' if the cached contents of this
+		 * instance are out of date with respect to the values it's
+		 * calculated from. A simple value is never dirty, but an
+		 * expression will be until it's evaluated.
+		 */
+		virtual bool isDirty() const;
+		/**
+		 * This method returns 'true' if the contents of this instance
+		 * can't be cached at all - because somewhere in the chain of
+		 * values it's calculated from is a function that isn't pure,
+		 * and so has to be called on every evaluation. Simple values
+		 * are never volatile.
+		 */
+		virtual bool isVolatile() const;
+
 		/*******************************************************************
 		 *
 		 *                         Utility Methods
@@ -170,6 +295,7 @@ class value
 		 */
 		virtual bool isVariable() const;
 		virtual bool isExpression() const;
+		virtual bool isArray() const;
 
 		/**
 		 * There are a lot of times that a human-readable version of
@@ -249,6 +375,17 @@ class value
 		bool operator>=( int aValue ) const;
 		bool operator>=( double aValue ) const;
 		bool operator>=( uint64_t aValue ) const;
+		/**
+		 * These versions of the tests take the plain data of a value, and
+		 * are just the same as testing against a value that holds it. It's
+		 * how a program compares the data on it's stack.
+		 */
+		bool operator==( const datum & aDatum ) const;
+		bool operator!=( const datum & aDatum ) const;
+		bool operator<( const datum & aDatum ) const;
+		bool operator<=( const datum & aDatum ) const;
+		bool operator>( const datum & aDatum ) const;
+		bool operator>=( const datum & aDatum ) const;
 
 		/*
 		 * These operators are the convenience assignment operators for
@@ -279,6 +416,14 @@ class value
 		value & operator/=( int aValue );
 		value & operator/=( double aValue );
 		value & operator/=( uint64_t aValue );
+		/**
+		 * These versions take the plain data of a value, and do just what
+		 * the same operator would with a value that holds it.
+		 */
+		value & operator+=( const datum & aDatum );
+		value & operator-=( const datum & aDatum );
+		value & operator*=( const datum & aDatum );
+		value & operator/=( const datum & aDatum );
 
 		/**
 		 * These are the binary operators for the values. They will
@@ -372,6 +517,21 @@ class value
 		 */
 		virtual void clear_nl();
 
+		/**
+		 * This method copies the type and contents of the provided value
+		 * into this instance without notifying any of the dependents of the
+		 * change. This is what the evaluation methods use to cache their
+		 * results. The "_nl" means "no lock" - the caller has to do it.
+		 */
+		void assign_nl( const value & aValue );
+		void assign_nl( const datum & aDatum );
+		/**
+		 * This method copies this instance into 'aResult' the same way -
+		 * it's what the plain eval_nl() does, and what a subclass does once
+		 * it's brought itself up to date.
+		 */
+		void copyTo_nl( value & aResult ) const;
+
 		/**
 		 * This method gets the value for this instance, and it may be quite
 		 * involved in getting the value. This will be the way to get
@@ -382,6 +542,7 @@ class value
 		 * these values. That means the caller has to do it.
 		 */
 		virtual value eval_nl();
+		virtual void eval_nl( value & aResult );
 		virtual bool evalAsBool_nl();
 		virtual int evalAsInt_nl();
 		virtual double evalAsDouble_nl();
@@ -392,7 +553,37 @@ class value
 		 * and is quite useful for those times the subclasses need to be able
 		 * to lock something up while they do their thing.
 		 */
-		boost::detail::spinlock & mutex() const;
+		util::spinlock & mutex() const;
+
+		/**
+		 * This method is called on a dependent of a value when that value
+		 * has changed. The default is to simply pass the news along to
+		 * all of our dependents, but an expression will mark it's cached
+		 * result as stale as well.
+		 */
+		virtual void markDirty();
+		/**
+		 * This is the same as the above, but it's told which value it is
+		 * that has changed - so that an expression that can update it's
+		 * result for just that argument knows where to look. Anything that
+		 * doesn't care where the change came from can ignore it.
+		 */
+		virtual void markDirty( const value *aSource );
+		/**
+		 * This method tells all the registered dependents of this value
+		 * that this value has changed, and they need to mark themselves
+		 * as dirty. It's called by all the public mutating methods, but
+		 * NOT by the "_nl" setters, as they are used by the evaluation
+		 * methods to cache the results of a calculation.
+		 */
+		void markDependentsDirty();
+		/**
+		 * This method is called on each dependent of a value as that value
+		 * is being destroyed, so that the dependent can drop any reference
+		 * it might have to it. The default is to do nothing, as a simple
+		 * value doesn't depend on anything.
+		 */
+		virtual void dropDependency( const value *aValue );
 
 		/*******************************************************************
 		 *
@@ -419,14 +610,56 @@ class value
 		 * is that we are really storing.
 		 */
 		value_type		_type;
+		/**
+		 * This is the spinlock to protect the access to the value, and
+		 * the one for the list of dependents. The list has it's own lock
+		 * as the notification runs up the tree while evaluations run down
+		 * it, and we can't have the two fighting over the same locks.
+		 *
+		 * These are packed in with the type so that they fill what would
+		 * otherwise be padding before the union. If we're built single-
+		 * threaded, they're not in the value at all - even an empty lock
+		 * takes a byte, and the padding after it - they're shared statics
+		 * that do nothing.
+		 */
+#ifndef LKIT_SINGLE_THREADED
+		mutable util::spinlock		_mutex;
+		mutable util::spinlock		_deps_mutex;
+#else
+		static util::spinlock		_mutex;
+		static util::spinlock		_deps_mutex;
+#endif
 		union {
 			bool		_boolValue;
 			int			_intValue;
 			double		_doubleValue;
 			uint64_t	_timeValue;
 		};
-		// ...and a spinlock to protect the access to the value
-		mutable boost::detail::spinlock		_mutex;
+		/**
+		 * These are all the values that are calculated from this value,
+		 * and need to be told when it changes. Most values - constants,
+		 * scratch and the temporaries - never have any, so the list is
+		 * only made when the first one is added, and is NULL until then.
+		 */
+		std::vector<value *>		*_dependents;
+};
+
+
+/**
+ * This is the plain data of a value - just the type and the contents,
+ * with none of the locking, dependents, or virtual methods. It's sixteen
+ * bytes, it can be copied with a memcpy(), and it never allocates, so
+ * it's what the evaluator keeps for the constants and variables it
+ * pushes, and what a value hands out with getDatum().
+ */
+struct datum {
+	value::value_type	type;
+	union {
+		bool		boolValue;
+		int			intValue;
+		double		doubleValue;
+		uint64_t	timeValue;
+	};
 };
 }		// end of namespace lkit
 
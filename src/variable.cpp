@@ -14,6 +14,7 @@
 
 //	Other Headers
 #include "variable.h"
+#include "util/footprint.h"
 
 //	Forward Declarations
 
@@ -27,10 +28,10 @@
 
 /**
  * Make it easy to reference the spinlock and it's scoped lock. They
- * are both in the boost::detail namespace, and it's just going to make
+ * are both in the lkit::util namespace, and it's just going to make
  * the code a little cleaner.
  */
-using namespace boost::detail;
+using lkit::util::spinlock;
 
 namespace lkit {
 /*******************************************************************
@@ -121,8 +122,9 @@ variable::variable( const std::string & aName, uint64_t aValue ) :
 variable::variable( const std::string & aName, value *aValue ) :
 	value(),
 	_name(aName),
-	_expr(aValue)
+	_expr(NULL)
 {
+	setExpr_nl(aValue);
 }
 
 
@@ -160,10 +162,7 @@ value *variable::clone() const
 variable::~variable()
 {
 	// if I have an expression, then delete it
-	if (_expr != NULL) {
-		delete _expr;
-		_expr = NULL;
-	}
+	dropExpr_nl();
 }
 
 
@@ -179,21 +178,11 @@ variable & variable::operator=( const variable & anOther )
 		value::operator=(anOther);
 		// ...then we'll do our ivars
 		_name = anOther._name;
-		// clone the other's expression - if he has one
+		// drop anything I might have at this time
+		dropExpr_nl();
+		// ...and clone the other's expression - if he has one
 		if (anOther._expr != NULL) {
-			// drop anything I might have at this time
-			if (_expr != NULL) {
-				delete _expr;
-				_expr = NULL;
-			}
-			// ...and clone in his expression
-			_expr = anOther._expr->clone();
-		} else {
-			// he has no expression, so neither should I
-			if (_expr != NULL) {
-				delete _expr;
-				_expr = NULL;
-			}
+			setExpr_nl(anOther._expr->clone());
 		}
 	}
 	return *this;
@@ -209,13 +198,10 @@ variable & variable::operator=( const variable & anOther )
 variable & variable::operator=( const value & anOther )
 {
 	if (this != & anOther) {
-		// let the super class do all it's stuff...
+		// if I have an expression, drop it
+		dropExpr_nl();
+		// ...and let the super class do all it's stuff
 		value::operator=(anOther);
-		// and if I have an expression, drop it
-		if (_expr != NULL) {
-			delete _expr;
-			_expr = NULL;
-		}
 	}
 	return *this;
 }
@@ -259,7 +245,9 @@ bool variable::set( uint64_t aValue )
 bool variable::set( value *aValue )
 {
 	spinlock::scoped_lock	lock(mutex());
-	return set_nl(aValue);
+	bool	ok = set_nl(aValue);
+	markDependentsDirty();
+	return ok;
 }
 
 
@@ -275,6 +263,7 @@ bool variable::set( const std::string & aName, bool aValue )
 	spinlock::scoped_lock	lock(mutex());
 	if ((error = !value::set_nl(aValue)) == false) {
 		_name = aName;
+		markDependentsDirty();
 	}
 	return !error;
 }
@@ -286,6 +275,7 @@ bool variable::set( const std::string & aName, int aValue )
 	spinlock::scoped_lock	lock(mutex());
 	if ((error = !value::set_nl(aValue)) == false) {
 		_name = aName;
+		markDependentsDirty();
 	}
 	return !error;
 }
@@ -297,6 +287,7 @@ bool variable::set( const std::string & aName, double aValue )
 	spinlock::scoped_lock	lock(mutex());
 	if ((error = !value::set_nl(aValue)) == false) {
 		_name = aName;
+		markDependentsDirty();
 	}
 	return !error;
 }
@@ -308,6 +299,7 @@ bool variable::set( const std::string & aName, uint64_t aValue )
 	spinlock::scoped_lock	lock(mutex());
 	if ((error = !value::set_nl(aValue)) == false) {
 		_name = aName;
+		markDependentsDirty();
 	}
 	return !error;
 }
@@ -316,15 +308,20 @@ bool variable::set( const std::string & aName, uint64_t aValue )
 bool variable::set( const std::string & aName, value *aValue )
 {
 	bool	error = false;
-	if (aValue != NULL) {
+	if (aValue == NULL) {
+		error = true;
+	} else if (aValue == _expr) {
+		// same definition, just a new name
+		spinlock::scoped_lock	lock(mutex());
+		_name = aName;
+	} else {
 		spinlock::scoped_lock	lock(mutex());
 		// clear out everything that might be in the super class
 		clear_nl();
 		// ...and then set the things we know we need
 		_name = aName;
-		_expr = aValue;
-	} else {
-		error = true;
+		setExpr_nl(aValue);
+		markDependentsDirty();
 	}
 	return !error;
 }
@@ -344,6 +341,19 @@ std::string variable::getName() const
 }
 
 
+/**
+ * This method returns the expression (or other value) that is
+ * defining this variable, or NULL if it's a simple value. This
+ * is still owned by the variable, so don't delete it, and be
+ * careful with it, as it's the ACTUAL definition.
+ */
+value *variable::getExpr() const
+{
+	spinlock::scoped_lock	lock((spinlock &)mutex());
+	return _expr;
+}
+
+
 /*******************************************************************
  *
  *                         Utility Methods
@@ -362,6 +372,44 @@ bool variable::isVariable() const
 }
 
 
+/**
+ * This method returns 'true' if this variable is defined by an
+ * expression, and that expression's cached result is out of date.
+ * A simple valued variable is never dirty.
+ */
+bool variable::isDirty() const
+{
+	return ((_expr != NULL) && _expr->isDirty());
+}
+
+
+/**
+ * This method returns 'true' if this variable is defined by an
+ * expression that has to be recalculated on every evaluation
+ * because it uses a function that isn't pure.
+ */
+bool variable::isVolatile() const
+{
+	return ((_expr != NULL) && _expr->isVolatile());
+}
+
+
+/**
+ * This method adds the name of the variable - if it's on the heap -
+ * to the tally, along with what the value does. The expression that
+ * defines it, if there is one, is the variable's, so it's added too.
+ */
+void variable::addFootprint( util::footprint & aTally ) const
+{
+	{
+		spinlock::scoped_lock	lock(mutex());
+		aTally.addString(_name);
+		value::addAllocation(_expr, aTally);
+	}
+	value::addFootprint(aTally);
+}
+
+
 /**
  * There are a lot of times that a human-readable version of
  * this instance will come in handy. This is that method. It's
@@ -496,11 +544,11 @@ bool variable::set_nl( value *aValue )
 	bool		error = false;
 	if (aValue == NULL) {
 		error = true;
-	} else {
+	} else if (aValue != _expr) {
 		// first, clear out everything we might have
 		clear_nl();
 		// ...now set AND SAVE the pointer for our new value
-		_expr = aValue;
+		setExpr_nl(aValue);
 	}
 	return !error;
 }
@@ -517,10 +565,7 @@ bool variable::set_nl( value *aValue )
 void variable::clear_nl()
 {
 	// first, clear out my stuff...
-	if (_expr == NULL) {
-		delete _expr;
-		_expr = NULL;
-	}
+	dropExpr_nl();
 	// ...now let the super do it's thing...
 	value::clear_nl();
 }
@@ -538,16 +583,26 @@ void variable::clear_nl()
 value variable::eval_nl()
 {
 	if (_expr != NULL) {
-		set_nl(_expr->eval());
+		_expr->eval(*this);
 	}
 	return value(*this);
 }
 
 
+void variable::eval_nl( value & aResult )
+{
+	if (_expr != NULL) {
+		_expr->eval(*this);
+	}
+	// the base would call eval_nl() again, so just copy it into theirs
+	copyTo_nl(aResult);
+}
+
+
 bool variable::evalAsBool_nl()
 {
 	if (_expr != NULL) {
-		set_nl(_expr->eval());
+		_expr->eval(*this);
 	}
 	return value::evalAsBool_nl();
 }
@@ -556,7 +611,7 @@ bool variable::evalAsBool_nl()
 int variable::evalAsInt_nl()
 {
 	if (_expr != NULL) {
-		set_nl(_expr->eval());
+		_expr->eval(*this);
 	}
 	return value::evalAsInt_nl();
 }
@@ -565,7 +620,7 @@ int variable::evalAsInt_nl()
 double variable::evalAsDouble_nl()
 {
 	if (_expr != NULL) {
-		set_nl(_expr->eval());
+		_expr->eval(*this);
 	}
 	return value::evalAsDouble_nl();
 }
@@ -574,12 +629,54 @@ double variable::evalAsDouble_nl()
 uint64_t variable::evalAsTime_nl()
 {
 	if (_expr != NULL) {
-		set_nl(_expr->eval());
+		_expr->eval(*this);
 	}
 	return value::evalAsTime_nl();
 }
 
 
+/**
+ * These methods take care of the expression that might be defining
+ * this variable. We need to register as a dependent of it so that
+ * when it changes, we can tell everyone that depends on us, and we
+ * need to unregister before we delete it. The "_nl" means the
+ * caller has to handle the locking.
+ */
+void variable::setExpr_nl( value *anExpr )
+{
+	if (anExpr != _expr) {
+		dropExpr_nl();
+		if ((_expr = anExpr) != NULL) {
+			_expr->addDependent(this);
+		}
+	}
+}
+
+
+void variable::dropExpr_nl()
+{
+	if (_expr != NULL) {
+		_expr->removeDependent(this);
+		delete _expr;
+		_expr = NULL;
+	}
+}
+
+
+/**
+ * This method is called when the expression defining this
+ * variable is being destroyed, and we need to make sure that
+ * we don't hold onto it any longer.
+ */
+void variable::dropDependency( const value *aValue )
+{
+	spinlock::scoped_lock	lock(mutex());
+	if (_expr == aValue) {
+		_expr = NULL;
+	}
+}
+
+
 /*******************************************************************
  *
  *                      Subcalss Utility Methods
@@ -137,6 +137,13 @@ class variable :
 		 * care should be taken in processing it's value.
 		 */
 		virtual std::string getName() const;
+		/**
+		 * This method returns the expression (or other value) that is
+		 * defining this variable, or NULL if it's a simple value. This
+		 * is still owned by the variable, so don't delete it, and be
+		 * careful with it, as it's the ACTUAL definition.
+		 */
+		virtual value *getExpr() const;
 
 		/*******************************************************************
 		 *
@@ -152,6 +159,26 @@ class variable :
 		 */
 		virtual bool isVariable() const;
 
+		/**
+		 * This method returns 'true' if this variable is defined by an
+		 * expression, and that expression's cached result is out of date.
+		 * A simple valued variable is never dirty.
+		 */
+		virtual bool isDirty() const;
+		/**
+		 * This method returns 'true' if this variable is defined by an
+		 * expression that has to be recalculated on every evaluation
+		 * because it uses a function that isn't pure.
+		 */
+		virtual bool isVolatile() const;
+
+		/**
+		 * This method adds the name of the variable - if it's on the heap -
+		 * to the tally, along with what the value does. The expression that
+		 * defines it, if there is one, is the variable's, so it's added too.
+		 */
+		virtual void addFootprint( util::footprint & aTally ) const;
+
 		/**
 		 * There are a lot of times that a human-readable version of
 		 * this instance will come in handy. This is that method. It's
@@ -239,11 +266,28 @@ class variable :
 		 * these values. That means the caller has to do it.
 		 */
 		virtual value eval_nl();
+		virtual void eval_nl( value & aResult );
 		virtual bool evalAsBool_nl();
 		virtual int evalAsInt_nl();
 		virtual double evalAsDouble_nl();
 		virtual uint64_t evalAsTime_nl();
 
+		/**
+		 * These methods take care of the expression that might be defining
+		 * this variable. We need to register as a dependent of it so that
+		 * when it changes, we can tell everyone that depends on us, and we
+		 * need to unregister before we delete it. The "_nl" means the
+		 * caller has to handle the locking.
+		 */
+		void setExpr_nl( value *anExpr );
+		void dropExpr_nl();
+		/**
+		 * This method is called when the expression defining this
+		 * variable is being destroyed, and we need to make sure that
+		 * we don't hold onto it any longer.
+		 */
+		virtual void dropDependency( const value *aValue );
+
 		/*******************************************************************
 		 *
 		 *                     Subcalss Utility Methods
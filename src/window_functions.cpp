@@ -0,0 +1,1024 @@
+/**
+ * window_functions.cpp - this file implements the time-series functions for
+ *                        the function table. Unlike the base functions, these
+ *                        each hold a window of the last samples they've been
+ *                        given - the last N of them, or all those in the last
+ *                        span of time - and return the sum, mean, etc. of that
+ *                        window. Each sample is added in constant time, so
+ *                        they are a good deal cheaper than keeping the series
+ *                        outside LKit, and putting the results back in.
+ */
+
+//	System Headers
+#include <math.h>
+#include <sstream>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "window_functions.h"
+#include "util/timer.h"
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+/**
+ * Make it easy to reference the spinlock and it's scoped lock. They
+ * are both in the lkit::util namespace, and it's just going to make
+ * the code a little cleaner.
+ */
+using lkit::util::spinlock;
+
+namespace lkit {
+namespace func {
+/**
+ * Every one of the windows writes out the same things about itself, so
+ * let's put that in one place.
+ */
+static std::string describe( const char *aName, size_t aCapacity, uint64_t aSpan )
+{
+	std::ostringstream	msg;
+	msg << "<" << aName << " " << aCapacity;
+	if (aSpan > 0) {
+		msg << " " << aSpan << "us";
+	}
+	msg << ">";
+	return msg.str();
+}
+
+
+/**
+ * window() - this is the base of all the time-series functions. It holds
+ *            the last samples in a fixed-size ring buffer, and each time
+ *            it's called, the first argument is added as the newest of
+ *            them. The window holds at most 'capacity' samples, and if it
+ *            has a span, only those in the last 'span' usec as well. The
+ *            second argument - if there is one - is the time of the sample,
+ *            and if it's not there, the time is 'now'. A sample with the
+ *            same time as the newest one replaces it, so evaluating the
+ *            same tree twice for the same time doesn't count it twice.
+ *            Undefined samples are skipped.
+ */
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This constructor takes the number of samples the window can
+ * hold, and the span of time - in usec - that they can cover. If
+ * the span is 0, then it's just the last 'aCapacity' samples.
+ */
+window::window( size_t aCapacity, uint64_t aSpan ) :
+	function(),
+	_mutex(),
+	_samples(aCapacity > 0 ? aCapacity : 1),
+	_times(aCapacity > 0 ? aCapacity : 1, 0),
+	_span(aSpan),
+	_first(0),
+	_next(0)
+{
+}
+
+
+/**
+ * This is the standard copy constructor that needs to be in every
+ * class to make sure that we control how many copies we have
+ * floating around in the system.
+ */
+window::window( const window & anOther ) :
+	function(),
+	_mutex(),
+	_samples(),
+	_times(),
+	_span(0),
+	_first(0),
+	_next(0)
+{
+	// let the '=' operator do the heavy lifting...
+	*this = anOther;
+}
+
+
+/**
+ * This is the standard destructor and needs to be virtual to make
+ * sure that if we subclass off this, the right destructor will be
+ * called.
+ */
+window::~window()
+{
+	// the ring is just values, so there's nothing to do
+}
+
+
+/**
+ * When we process the result of an equality we need to make sure
+ * that we do this right by always having an equals operator on
+ * all classes.
+ */
+window & window::operator=( const window & anOther )
+{
+	if (this != & anOther) {
+		function::operator=(anOther);
+		_samples = anOther._samples;
+		_times = anOther._times;
+		_span = anOther._span;
+		_first = anOther._first;
+		_next = anOther._next;
+	}
+	return *this;
+}
+
+
+/*******************************************************************
+ *
+ *                        Accessor Methods
+ *
+ *******************************************************************/
+/**
+ * These methods return the most samples the window will hold,
+ * the span of time they can cover - 0 if it's only a count - and
+ * the number of samples that are in it right now.
+ */
+size_t window::getCapacity() const
+{
+	return _samples.size();
+}
+
+
+uint64_t window::getSpan() const
+{
+	return _span;
+}
+
+
+size_t window::getCount() const
+{
+	spinlock::scoped_lock	lock(_mutex);
+	return (size_t)(_next - _first);
+}
+
+
+/**
+ * This method empties the window so that it starts again with
+ * the next sample it's given.
+ */
+void window::reset()
+{
+	spinlock::scoped_lock	lock(_mutex);
+	reset_nl();
+}
+
+
+/*******************************************************************
+ *
+ *                       Evaluation Methods
+ *
+ *******************************************************************/
+/**
+ * This is the main evaluation point for the function. The sample
+ * and it's time are each evaluated ONCE, the sample is added to
+ * the window, and the answer for the window is returned.
+ */
+value window::eval( std::vector<value *> & anArg )
+{
+	// get the sample - and it's time - before we lock anything up
+	value		sample;
+	value		when;
+	if ((anArg.size() > 0) && (anArg[0] != NULL)) {
+		anArg[0]->eval(sample);
+	}
+	if ((anArg.size() > 1) && (anArg[1] != NULL)) {
+		anArg[1]->eval(when);
+	}
+	// ...and now we can add it to the window
+	return (when.isUndefined() ? add(sample) : add(sample, when.evalAsTime()));
+}
+
+
+/**
+ * This is the evaluation point used by the expressions. There isn't
+ * any need for the scratch buffer, so it's just the eval() above -
+ * or a subclass's own, if it has one.
+ */
+value window::eval( std::vector<value *> & anArg, std::vector<value> & aScratch )
+{
+	return eval(anArg);
+}
+
+
+/**
+ * These methods add the sample - at the time, if there is one -
+ * to the window, and return the answer for the window, just as if
+ * it were called with them as arguments. This is for those times
+ * we're feeding it from code.
+ */
+value window::add( const value & aSample )
+{
+	// a window with a span needs a time, so we'll use 'now'
+	uint64_t	now = (_span > 0 ? util::timer::usecSinceEpoch() : 0);
+	spinlock::scoped_lock	lock(_mutex);
+	add_nl(aSample, now, false);
+	return answer_nl();
+}
+
+
+value window::add( const value & aSample, uint64_t aTime )
+{
+	spinlock::scoped_lock	lock(_mutex);
+	add_nl(aSample, aTime, true);
+	return answer_nl();
+}
+
+
+/**
+ * This method does the work of adding the sample to the window. If
+ * it's 'stamped' with the same time as the newest sample, it takes
+ * the place of that one.
+ */
+void window::add_nl( const value & aSample, uint64_t aTime, bool aStamped )
+{
+	size_t		cap = _samples.size();
+	uint64_t	when = aTime;
+	bool		replace = false;
+	if (_next > _first) {
+		uint64_t	newest = _times[(_next - 1) % cap];
+		// the same time as the newest sample means it's that sample again
+		replace = (aStamped && (when == newest));
+		// ...and the times can't go backwards - a late sample is the newest
+		if (when < newest) {
+			when = newest;
+		}
+	}
+	if (replace) {
+		if (!aSample.isUndefined()) {
+			value	old = _samples[(_next - 1) % cap];
+			_samples[(_next - 1) % cap] = aSample;
+			replaced_nl(_next - 1, old);
+		}
+	} else {
+		// drop all the samples that have fallen out of the span of time
+		if (_span > 0) {
+			while ((_next > _first) && (_times[_first % cap] + _span <= when)) {
+				removed_nl(_first);
+				++_first;
+			}
+		}
+		// ...and if we have a sample, make room for it, and add it
+		if (!aSample.isUndefined()) {
+			if (_next - _first >= cap) {
+				removed_nl(_first);
+				++_first;
+			}
+			_samples[_next % cap] = aSample;
+			_times[_next % cap] = when;
+			++_next;
+			added_nl(_next - 1);
+		}
+	}
+}
+
+
+/**
+ * This method is called with the lock held, and simply empties the
+ * ring - the subclasses clear out what they keep, and then call this.
+ */
+void window::reset_nl()
+{
+	for (uint64_t s = _first; s < _next; ++s) {
+		_samples[s % _samples.size()].clear();
+	}
+	_first = 0;
+	_next = 0;
+}
+
+
+
+
+
+
+/**
+ * moving_sum() - this function returns the sum of the samples in the
+ *                window. The total is kept as the samples come and go, so
+ *                it's constant time no matter how big the window is, and
+ *                a running double total is re-summed from the samples
+ *                each time the window turns over, so it can't drift.
+ */
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This constructor takes the number of samples the window can
+ * hold, and the span of time - in usec - that they can cover. If
+ * the span is 0, then it's just the last 'aCapacity' samples.
+ */
+moving_sum::moving_sum( size_t aCapacity, uint64_t aSpan ) :
+	window(aCapacity, aSpan),
+	_total(),
+	_removed(0)
+{
+}
+
+
+moving_sum::moving_sum( const moving_sum & anOther ) :
+	window(anOther),
+	_total(anOther._total),
+	_removed(anOther._removed)
+{
+}
+
+
+moving_sum::~moving_sum()
+{
+}
+
+
+moving_sum & moving_sum::operator=( const moving_sum & anOther )
+{
+	if (this != & anOther) {
+		window::operator=(anOther);
+		_total = anOther._total;
+		_removed = anOther._removed;
+	}
+	return *this;
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string moving_sum::toString() const
+{
+	return describe("moving_sum", getCapacity(), getSpan());
+}
+
+
+/**
+ * These keep the total of the samples as they come and go, and
+ * return it as the answer for the window.
+ */
+void moving_sum::added_nl( uint64_t aSeq )
+{
+	// the first sample into an empty window sets the type of the total
+	_total += sample_nl(aSeq);
+}
+
+
+void moving_sum::removed_nl( uint64_t aSeq )
+{
+	if (next_nl() - first_nl() <= 1) {
+		// this is the last one, so the window will be empty
+		_total.clear();
+		_removed = 0;
+	} else {
+		_total -= sample_nl(aSeq);
+		++_removed;
+	}
+}
+
+
+void moving_sum::replaced_nl( uint64_t aSeq, const value & anOld )
+{
+	if (next_nl() - first_nl() <= 1) {
+		// it's the only sample, so it's the total - type and all
+		_total = sample_nl(aSeq);
+	} else {
+		_total -= anOld;
+		_total += sample_nl(aSeq);
+	}
+}
+
+
+value moving_sum::answer_nl()
+{
+	// once the window has turned over, clear out any rounding in a double
+	if (_total.isDouble() && (_removed >= getCapacity())) {
+		resum_nl();
+	}
+	return _total;
+}
+
+
+void moving_sum::reset_nl()
+{
+	window::reset_nl();
+	_total.clear();
+	_removed = 0;
+}
+
+
+/**
+ * This method sums up the samples in the window from scratch,
+ * and is used to clear out any rounding in the running total.
+ */
+void moving_sum::resum_nl()
+{
+	_total.clear();
+	for (uint64_t s = first_nl(); s < next_nl(); ++s) {
+		_total += sample_nl(s);
+	}
+	_removed = 0;
+}
+
+
+
+
+
+
+/**
+ * moving_mean() - this function returns the mean of the samples in the
+ *                 window as a double. It's the moving sum divided by the
+ *                 number of samples, so it's constant time as well.
+ */
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This constructor takes the number of samples the window can
+ * hold, and the span of time - in usec - that they can cover. If
+ * the span is 0, then it's just the last 'aCapacity' samples.
+ */
+moving_mean::moving_mean( size_t aCapacity, uint64_t aSpan ) :
+	moving_sum(aCapacity, aSpan)
+{
+}
+
+
+moving_mean::moving_mean( const moving_mean & anOther ) :
+	moving_sum(anOther)
+{
+}
+
+
+moving_mean::~moving_mean()
+{
+}
+
+
+moving_mean & moving_mean::operator=( const moving_mean & anOther )
+{
+	if (this != & anOther) {
+		moving_sum::operator=(anOther);
+	}
+	return *this;
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string moving_mean::toString() const
+{
+	return describe("moving_mean", getCapacity(), getSpan());
+}
+
+
+/**
+ * The answer is the total over the number of samples - and
+ * undefined if there aren't any.
+ */
+value moving_mean::answer_nl()
+{
+	value		retval;
+	uint64_t	cnt = next_nl() - first_nl();
+	if (cnt > 0) {
+		value	total = moving_sum::answer_nl();
+		retval = total.evalAsDouble() / (double)cnt;
+	}
+	return retval;
+}
+
+
+
+
+
+
+/**
+ * moving_count() - this function returns the number of samples in the
+ *                  window as an int. For a window with a span, this is
+ *                  the number of samples in the last span of time.
+ */
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This constructor takes the number of samples the window can
+ * hold, and the span of time - in usec - that they can cover. If
+ * the span is 0, then it's just the last 'aCapacity' samples.
+ */
+moving_count::moving_count( size_t aCapacity, uint64_t aSpan ) :
+	window(aCapacity, aSpan)
+{
+}
+
+
+moving_count::moving_count( const moving_count & anOther ) :
+	window(anOther)
+{
+}
+
+
+moving_count::~moving_count()
+{
+}
+
+
+moving_count & moving_count::operator=( const moving_count & anOther )
+{
+	if (this != & anOther) {
+		window::operator=(anOther);
+	}
+	return *this;
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string moving_count::toString() const
+{
+	return describe("moving_count", getCapacity(), getSpan());
+}
+
+
+/**
+ * The answer is just the number of samples in the window.
+ */
+value moving_count::answer_nl()
+{
+	return value((int)(next_nl() - first_nl()));
+}
+
+
+
+
+
+
+/**
+ * moving_extreme() - this is the base of the moving max and min. It holds
+ *                    a monotonic deque of the samples that could still be
+ *                    the answer - every sample that's older, and not as
+ *                    good, as another in the window never can be - so the
+ *                    answer is always at the front, and each sample goes
+ *                    on and off the deque once, for constant time on
+ *                    average.
+ */
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This constructor takes the number of samples the window can
+ * hold, and the span of time - in usec - that they can cover. If
+ * the span is 0, then it's just the last 'aCapacity' samples.
+ */
+moving_extreme::moving_extreme( size_t aCapacity, uint64_t aSpan ) :
+	window(aCapacity, aSpan),
+	_deque(aCapacity > 0 ? aCapacity : 1, 0),
+	_head(0),
+	_size(0)
+{
+}
+
+
+moving_extreme::moving_extreme( const moving_extreme & anOther ) :
+	window(anOther),
+	_deque(anOther._deque),
+	_head(anOther._head),
+	_size(anOther._size)
+{
+}
+
+
+moving_extreme::~moving_extreme()
+{
+}
+
+
+moving_extreme & moving_extreme::operator=( const moving_extreme & anOther )
+{
+	if (this != & anOther) {
+		window::operator=(anOther);
+		_deque = anOther._deque;
+		_head = anOther._head;
+		_size = anOther._size;
+	}
+	return *this;
+}
+
+
+/**
+ * These keep the deque of the samples as they come and go, and
+ * return the front of it as the answer for the window.
+ */
+void moving_extreme::added_nl( uint64_t aSeq )
+{
+	size_t		cap = _deque.size();
+	const value	& v = sample_nl(aSeq);
+	// anything older that this one covers can never be the answer
+	while ((_size > 0) && covers(v, sample_nl(_deque[(_head + _size - 1) % cap]))) {
+		--_size;
+	}
+	_deque[(_head + _size) % cap] = aSeq;
+	++_size;
+}
+
+
+void moving_extreme::removed_nl( uint64_t aSeq )
+{
+	// the oldest is only on the deque if it's still the answer
+	if ((_size > 0) && (_deque[_head] == aSeq)) {
+		_head = (_head + 1) % _deque.size();
+		--_size;
+	}
+}
+
+
+void moving_extreme::replaced_nl( uint64_t aSeq, const value & anOld )
+{
+	if (covers(sample_nl(aSeq), anOld)) {
+		/**
+		 * The newest is always at the back, and if the new value is
+		 * at least as good, everything the old one covered, it does
+		 * too - so it's just like adding it again.
+		 */
+		--_size;
+		added_nl(aSeq);
+	} else {
+		/**
+		 * Some of the samples the old one covered might be back in the
+		 * running, and we don't know which - so we have to build the
+		 * deque again from the window.
+		 */
+		_head = 0;
+		_size = 0;
+		for (uint64_t s = first_nl(); s < next_nl(); ++s) {
+			added_nl(s);
+		}
+	}
+}
+
+
+value moving_extreme::answer_nl()
+{
+	value		retval;
+	if (_size > 0) {
+		retval = sample_nl(_deque[_head]);
+	}
+	return retval;
+}
+
+
+void moving_extreme::reset_nl()
+{
+	window::reset_nl();
+	_head = 0;
+	_size = 0;
+}
+
+
+
+
+
+
+/**
+ * moving_max() - this function returns the largest of the samples in
+ *                the window. The comparisons are all done on the values
+ *                themselves.
+ */
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This constructor takes the number of samples the window can
+ * hold, and the span of time - in usec - that they can cover. If
+ * the span is 0, then it's just the last 'aCapacity' samples.
+ */
+moving_max::moving_max( size_t aCapacity, uint64_t aSpan ) :
+	moving_extreme(aCapacity, aSpan)
+{
+}
+
+
+moving_max::moving_max( const moving_max & anOther ) :
+	moving_extreme(anOther)
+{
+}
+
+
+moving_max::~moving_max()
+{
+}
+
+
+moving_max & moving_max::operator=( const moving_max & anOther )
+{
+	if (this != & anOther) {
+		moving_extreme::operator=(anOther);
+	}
+	return *this;
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string moving_max::toString() const
+{
+	return describe("moving_max", getCapacity(), getSpan());
+}
+
+
+/**
+ * A newer sample covers an older one if it's not smaller.
+ */
+bool moving_max::covers( const value & aNew, const value & anOld ) const
+{
+	return !(aNew < anOld);
+}
+
+
+
+
+
+
+/**
+ * moving_min() - this function returns the smallest of the samples in
+ *                the window. The comparisons are all done on the values
+ *                themselves.
+ */
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This constructor takes the number of samples the window can
+ * hold, and the span of time - in usec - that they can cover. If
+ * the span is 0, then it's just the last 'aCapacity' samples.
+ */
+moving_min::moving_min( size_t aCapacity, uint64_t aSpan ) :
+	moving_extreme(aCapacity, aSpan)
+{
+}
+
+
+moving_min::moving_min( const moving_min & anOther ) :
+	moving_extreme(anOther)
+{
+}
+
+
+moving_min::~moving_min()
+{
+}
+
+
+moving_min & moving_min::operator=( const moving_min & anOther )
+{
+	if (this != & anOther) {
+		moving_extreme::operator=(anOther);
+	}
+	return *this;
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string moving_min::toString() const
+{
+	return describe("moving_min", getCapacity(), getSpan());
+}
+
+
+/**
+ * A newer sample covers an older one if it's not larger.
+ */
+bool moving_min::covers( const value & aNew, const value & anOld ) const
+{
+	return !(aNew > anOld);
+}
+
+
+
+
+
+
+/**
+ * ema() - this function returns the exponential moving average of the
+ *         samples as a double. With a span of 0, each new sample has a
+ *         weight of 2/(N+1) for N samples - the usual 'N-period' EMA. With
+ *         a span, the weight of the old average decays by 'e' every span
+ *         usec, so samples that come at uneven times are weighted by how
+ *         long it's been since the last one, and N isn't used.
+ */
+/*******************************************************************
+ *
+ *                     Constructors/Destructor
+ *
+ *******************************************************************/
+/**
+ * This constructor takes the number of samples for the weight of
+ * a new sample, or the span of time - in usec - that the weight
+ * of the average decays over.
+ */
+ema::ema( size_t aSamples, uint64_t aSpan ) :
+	window(1, aSpan),
+	_count(aSamples > 0 ? aSamples : 1),
+	_alpha(2.0 / ((aSamples > 0 ? aSamples : 1) + 1.0)),
+	_tau(aSpan),
+	_prev(0.0),
+	_prev_time(0),
+	_prev_primed(false),
+	_avg(0.0),
+	_primed(false),
+	_last_time(0)
+{
+}
+
+
+ema::ema( const ema & anOther ) :
+	window(anOther),
+	_count(anOther._count),
+	_alpha(anOther._alpha),
+	_tau(anOther._tau),
+	_prev(anOther._prev),
+	_prev_time(anOther._prev_time),
+	_prev_primed(anOther._prev_primed),
+	_avg(anOther._avg),
+	_primed(anOther._primed),
+	_last_time(anOther._last_time)
+{
+}
+
+
+ema::~ema()
+{
+}
+
+
+ema & ema::operator=( const ema & anOther )
+{
+	if (this != & anOther) {
+		window::operator=(anOther);
+		_count = anOther._count;
+		_alpha = anOther._alpha;
+		_tau = anOther._tau;
+		_prev = anOther._prev;
+		_prev_time = anOther._prev_time;
+		_prev_primed = anOther._prev_primed;
+		_avg = anOther._avg;
+		_primed = anOther._primed;
+		_last_time = anOther._last_time;
+	}
+	return *this;
+}
+
+
+/*******************************************************************
+ *
+ *                         Utility Methods
+ *
+ *******************************************************************/
+/**
+ * There are a lot of times that a human-readable version of
+ * this instance will come in handy. This is that method. It's
+ * not necessarily meant to be something to process, but most
+ * likely what a debugging system would want to write out for
+ * this guy.
+ */
+std::string ema::toString() const
+{
+	return describe("ema", (_tau > 0 ? 1 : _count), _tau);
+}
+
+
+/**
+ * The window only ever holds the newest sample, and these fold
+ * each one into the average - or take it back out again, and put
+ * in the new one, when it's replaced.
+ */
+void ema::added_nl( uint64_t aSeq )
+{
+	_prev = _avg;
+	_prev_time = _last_time;
+	_prev_primed = _primed;
+	_avg = fold_nl(aSeq);
+	_primed = true;
+	_last_time = time_nl(aSeq);
+}
+
+
+void ema::removed_nl( uint64_t aSeq )
+{
+	// the sample is already in the average - so there's nothing to do
+}
+
+
+void ema::replaced_nl( uint64_t aSeq, const value & anOld )
+{
+	_avg = fold_nl(aSeq);
+}
+
+
+value ema::answer_nl()
+{
+	return (_primed ? value(_avg) : value());
+}
+
+
+void ema::reset_nl()
+{
+	window::reset_nl();
+	_prev = 0.0;
+	_prev_time = 0;
+	_prev_primed = false;
+	_avg = 0.0;
+	_primed = false;
+	_last_time = 0;
+}
+
+
+/**
+ * This method returns the average with the sample folded in -
+ * starting from the average before it, and the time since the
+ * sample before it.
+ */
+double ema::fold_nl( uint64_t aSeq ) const
+{
+	value		s = sample_nl(aSeq);
+	double		x = s.evalAsDouble();
+	double		retval = x;
+	if (_prev_primed) {
+		double	a = _alpha;
+		if (_tau > 0) {
+			a = 1.0 - exp(-(double)(time_nl(aSeq) - _prev_time) / (double)_tau);
+		}
+		retval = _prev + a * (x - _prev);
+	}
+	return retval;
+}
+
+}		// end of namespace func
+}		// end of namespace lkit
@@ -0,0 +1,582 @@
+/**
+ * window_functions.h - this file defines the time-series functions for the
+ *                      function table. Unlike the base functions, these
+ *                      each hold a window of the last samples they've been
+ *                      given - the last N of them, or all those in the last
+ *                      span of time - and return the sum, mean, etc. of that
+ *                      window. Each sample is added in constant time, so
+ *                      they are a good deal cheaper than keeping the series
+ *                      outside LKit, and putting the results back in.
+ */
+#ifndef __LKIT_WINDOW_FUNCTIONS_H
+#define __LKIT_WINDOW_FUNCTIONS_H
+
+//	System Headers
+#include <stdint.h>
+#include <vector>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "function.h"
+#include "util/spinlock.h"
+
+//	Forward Declarations
+
+//	Public Constants
+
+//	Public Datatypes
+
+//	Public Data Constants
+
+
+namespace lkit {
+namespace func {
+
+/**
+ * window() - this is the base of all the time-series functions. It holds
+ *            the last samples in a fixed-size ring buffer, and each time
+ *            it's called, the first argument is added as the newest of
+ *            them. The window holds at most 'capacity' samples, and if it
+ *            has a span, only those in the last 'span' usec as well. The
+ *            second argument - if there is one - is the time of the sample,
+ *            and if it's not there, the time is 'now'. A sample with the
+ *            same time as the newest one replaces it, so evaluating the
+ *            same tree twice for the same time doesn't count it twice.
+ *            Undefined samples are skipped.
+ *
+ *            Each instance is one window on one series, so use a different
+ *            instance - and name in the parser - for each series.
+ */
+class window :
+	public function
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This constructor takes the number of samples the window can
+		 * hold, and the span of time - in usec - that they can cover. If
+		 * the span is 0, then it's just the last 'aCapacity' samples.
+		 */
+		window( size_t aCapacity, uint64_t aSpan = 0 );
+		/**
+		 * This is the standard copy constructor that needs to be in every
+		 * class to make sure that we control how many copies we have
+		 * floating around in the system.
+		 */
+		window( const window & anOther );
+		/**
+		 * This is the standard destructor and needs to be virtual to make
+		 * sure that if we subclass off this, the right destructor will be
+		 * called.
+		 */
+		virtual ~window();
+
+		/**
+		 * When we process the result of an equality we need to make sure
+		 * that we do this right by always having an equals operator on
+		 * all classes.
+		 */
+		window & operator=( const window & anOther );
+
+		/*******************************************************************
+		 *
+		 *                        Accessor Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * These methods return the most samples the window will hold,
+		 * the span of time they can cover - 0 if it's only a count - and
+		 * the number of samples that are in it right now.
+		 */
+		size_t getCapacity() const;
+		uint64_t getSpan() const;
+		size_t getCount() const;
+		/**
+		 * This method empties the window so that it starts again with
+		 * the next sample it's given.
+		 */
+		virtual void reset();
+
+		/*******************************************************************
+		 *
+		 *                       Evaluation Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * This is the main evaluation point for the function. The sample
+		 * and it's time are each evaluated ONCE, the sample is added to
+		 * the window, and the answer for the window is returned.
+		 */
+		virtual value eval( std::vector<value *> & anArg );
+		/**
+		 * This is the evaluation point used by the expressions. There isn't
+		 * any need for the scratch buffer, so it's just the eval() above -
+		 * or a subclass's own, if it has one.
+		 */
+		virtual value eval( std::vector<value *> & anArg, std::vector<value> & aScratch );
+		/**
+		 * These methods add the sample - at the time, if there is one -
+		 * to the window, and return the answer for the window, just as if
+		 * it were called with them as arguments. This is for those times
+		 * we're feeding it from code.
+		 */
+		virtual value add( const value & aSample );
+		virtual value add( const value & aSample, uint64_t aTime );
+
+	protected:
+		/**
+		 * These are the things a window function has to do as the samples
+		 * come and go. The sample 'aSeq' has just been added, or is just
+		 * about to be removed - and it's always the oldest that goes. When
+		 * the newest sample is replaced, we're told what it used to be.
+		 * The answer is then what the function returns for the window.
+		 * The lock is held for all of them.
+		 */
+		virtual void added_nl( uint64_t aSeq ) = 0;
+		virtual void removed_nl( uint64_t aSeq ) = 0;
+		virtual void replaced_nl( uint64_t aSeq, const value & anOld ) = 0;
+		virtual value answer_nl() = 0;
+		virtual void reset_nl();
+		/**
+		 * This method does the work of adding the sample to the window. If
+		 * it's 'stamped' with the same time as the newest sample, it takes
+		 * the place of that one.
+		 */
+		void add_nl( const value & aSample, uint64_t aTime, bool aStamped );
+		/**
+		 * These are the sequence numbers of the oldest sample, and the one
+		 * that will be the next added - so the window has the samples from
+		 * 'first' up to, but not including, 'next' - and the methods to get
+		 * the sample and time for any one of them.
+		 */
+		uint64_t first_nl() const { return _first; }
+		uint64_t next_nl() const { return _next; }
+		const value & sample_nl( uint64_t aSeq ) const { return _samples[aSeq % _samples.size()]; }
+		uint64_t time_nl( uint64_t aSeq ) const { return _times[aSeq % _times.size()]; }
+		/**
+		 * This is the simple spinlock that protects the window - as the
+		 * same function can be called by several threads at once.
+		 */
+		mutable lkit::util::spinlock	_mutex;
+
+	private:
+		/**
+		 * These are the samples, and their times, by sequence number - the
+		 * ring is exactly the capacity of the window, so it never grows.
+		 */
+		std::vector<value>		_samples;
+		std::vector<uint64_t>	_times;
+		uint64_t				_span;
+		uint64_t				_first;
+		uint64_t				_next;
+};
+
+
+
+/**
+ * moving_sum() - this function returns the sum of the samples in the
+ *                window. The total is kept as the samples come and go, so
+ *                it's constant time no matter how big the window is, and
+ *                a running double total is re-summed from the samples
+ *                each time the window turns over, so it can't drift.
+ */
+class moving_sum :
+	public window
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This constructor takes the number of samples the window can
+		 * hold, and the span of time - in usec - that they can cover. If
+		 * the span is 0, then it's just the last 'aCapacity' samples.
+		 */
+		moving_sum( size_t aCapacity, uint64_t aSpan = 0 );
+		moving_sum( const moving_sum & anOther );
+		virtual function *clone() const { return new moving_sum(*this); }
+		virtual ~moving_sum();
+		moving_sum & operator=( const moving_sum & anOther );
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * These keep the total of the samples as they come and go, and
+		 * return it as the answer for the window.
+		 */
+		virtual void added_nl( uint64_t aSeq );
+		virtual void removed_nl( uint64_t aSeq );
+		virtual void replaced_nl( uint64_t aSeq, const value & anOld );
+		virtual value answer_nl();
+		virtual void reset_nl();
+		/**
+		 * This method sums up the samples in the window from scratch,
+		 * and is used to clear out any rounding in the running total.
+		 */
+		void resum_nl();
+
+		/**
+		 * This is the running total of the samples in the window, and the
+		 * number of samples removed since it was last re-summed.
+		 */
+		value			_total;
+		size_t			_removed;
+};
+
+
+
+/**
+ * moving_mean() - this function returns the mean of the samples in the
+ *                 window as a double. It's the moving sum divided by the
+ *                 number of samples, so it's constant time as well.
+ */
+class moving_mean :
+	public moving_sum
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This constructor takes the number of samples the window can
+		 * hold, and the span of time - in usec - that they can cover. If
+		 * the span is 0, then it's just the last 'aCapacity' samples.
+		 */
+		moving_mean( size_t aCapacity, uint64_t aSpan = 0 );
+		moving_mean( const moving_mean & anOther );
+		virtual function *clone() const { return new moving_mean(*this); }
+		virtual ~moving_mean();
+		moving_mean & operator=( const moving_mean & anOther );
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * The answer is the total over the number of samples - and
+		 * undefined if there aren't any.
+		 */
+		virtual value answer_nl();
+};
+
+
+
+/**
+ * moving_count() - this function returns the number of samples in the
+ *                  window as an int. For a window with a span, this is
+ *                  the number of samples in the last span of time.
+ */
+class moving_count :
+	public window
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This constructor takes the number of samples the window can
+		 * hold, and the span of time - in usec - that they can cover. If
+		 * the span is 0, then it's just the last 'aCapacity' samples.
+		 */
+		moving_count( size_t aCapacity, uint64_t aSpan = 0 );
+		moving_count( const moving_count & anOther );
+		virtual function *clone() const { return new moving_count(*this); }
+		virtual ~moving_count();
+		moving_count & operator=( const moving_count & anOther );
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * There's nothing to keep for the count - the window has it.
+		 */
+		virtual void added_nl( uint64_t aSeq ) { };
+		virtual void removed_nl( uint64_t aSeq ) { };
+		virtual void replaced_nl( uint64_t aSeq, const value & anOld ) { };
+		virtual value answer_nl();
+};
+
+
+
+/**
+ * moving_extreme() - this is the base of the moving max and min. It holds
+ *                    a monotonic deque of the samples that could still be
+ *                    the answer - every sample that's older, and not as
+ *                    good, as another in the window never can be - so the
+ *                    answer is always at the front, and each sample goes
+ *                    on and off the deque once, for constant time on
+ *                    average.
+ */
+class moving_extreme :
+	public window
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This constructor takes the number of samples the window can
+		 * hold, and the span of time - in usec - that they can cover. If
+		 * the span is 0, then it's just the last 'aCapacity' samples.
+		 */
+		moving_extreme( size_t aCapacity, uint64_t aSpan = 0 );
+		moving_extreme( const moving_extreme & anOther );
+		virtual ~moving_extreme();
+		moving_extreme & operator=( const moving_extreme & anOther );
+
+	protected:
+		/**
+		 * This method returns 'true' if the sample 'aNew' is at least as
+		 * good as 'anOld' - so that 'anOld' can be dropped from the deque
+		 * now that 'aNew' is in the window.
+		 */
+		virtual bool covers( const value & aNew, const value & anOld ) const = 0;
+		/**
+		 * These keep the deque of the samples as they come and go, and
+		 * return the front of it as the answer for the window.
+		 */
+		virtual void added_nl( uint64_t aSeq );
+		virtual void removed_nl( uint64_t aSeq );
+		virtual void replaced_nl( uint64_t aSeq, const value & anOld );
+		virtual value answer_nl();
+		virtual void reset_nl();
+
+	private:
+		/**
+		 * This is the deque of the sequence numbers of the samples, in
+		 * a ring the size of the window, so that it never grows.
+		 */
+		std::vector<uint64_t>	_deque;
+		size_t					_head;
+		size_t					_size;
+};
+
+
+
+/**
+ * moving_max() - this function returns the largest of the samples in
+ *                the window. The comparisons are all done on the values
+ *                themselves.
+ */
+class moving_max :
+	public moving_extreme
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This constructor takes the number of samples the window can
+		 * hold, and the span of time - in usec - that they can cover. If
+		 * the span is 0, then it's just the last 'aCapacity' samples.
+		 */
+		moving_max( size_t aCapacity, uint64_t aSpan = 0 );
+		moving_max( const moving_max & anOther );
+		virtual function *clone() const { return new moving_max(*this); }
+		virtual ~moving_max();
+		moving_max & operator=( const moving_max & anOther );
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * A newer sample covers an older one if it's not smaller.
+		 */
+		virtual bool covers( const value & aNew, const value & anOld ) const;
+};
+
+
+
+/**
+ * moving_min() - this function returns the smallest of the samples in
+ *                the window. The comparisons are all done on the values
+ *                themselves.
+ */
+class moving_min :
+	public moving_extreme
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This constructor takes the number of samples the window can
+		 * hold, and the span of time - in usec - that they can cover. If
+		 * the span is 0, then it's just the last 'aCapacity' samples.
+		 */
+		moving_min( size_t aCapacity, uint64_t aSpan = 0 );
+		moving_min( const moving_min & anOther );
+		virtual function *clone() const { return new moving_min(*this); }
+		virtual ~moving_min();
+		moving_min & operator=( const moving_min & anOther );
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * A newer sample covers an older one if it's not larger.
+		 */
+		virtual bool covers( const value & aNew, const value & anOld ) const;
+};
+
+
+
+/**
+ * ema() - this function returns the exponential moving average of the
+ *         samples as a double. With a span of 0, each new sample has a
+ *         weight of 2/(N+1) for N samples - the usual 'N-period' EMA. With
+ *         a span, the weight of the old average decays by 'e' every span
+ *         usec, so samples that come at uneven times are weighted by how
+ *         long it's been since the last one, and N isn't used.
+ */
+class ema :
+	public window
+{
+	public:
+		/*******************************************************************
+		 *
+		 *                     Constructors/Destructor
+		 *
+		 *******************************************************************/
+		/**
+		 * This constructor takes the number of samples for the weight of
+		 * a new sample, or the span of time - in usec - that the weight
+		 * of the average decays over.
+		 */
+		ema( size_t aSamples, uint64_t aSpan = 0 );
+		ema( const ema & anOther );
+		virtual function *clone() const { return new ema(*this); }
+		virtual ~ema();
+		ema & operator=( const ema & anOther );
+
+		/*******************************************************************
+		 *
+		 *                         Utility Methods
+		 *
+		 *******************************************************************/
+		/**
+		 * There are a lot of times that a human-readable version of
+		 * this instance will come in handy. This is that method. It's
+		 * not necessarily meant to be something to process, but most
+		 * likely what a debugging system would want to write out for
+		 * this guy.
+		 */
+		virtual std::string toString() const;
+
+	protected:
+		/**
+		 * The window only ever holds the newest sample, and these fold
+		 * each one into the average - or take it back out again, and put
+		 * in the new one, when it's replaced.
+		 */
+		virtual void added_nl( uint64_t aSeq );
+		virtual void removed_nl( uint64_t aSeq );
+		virtual void replaced_nl( uint64_t aSeq, const value & anOld );
+		virtual value answer_nl();
+		virtual void reset_nl();
+		/**
+		 * This method returns the average with the sample folded in -
+		 * starting from the average before it, and the time since the
+		 * sample before it.
+		 */
+		double fold_nl( uint64_t aSeq ) const;
+
+	private:
+		/**
+		 * This is the number of samples, and the weight of a new sample
+		 * that comes from it. The average is kept both before and after
+		 * the newest sample, so that it can be replaced, and if there's
+		 * no average yet, 'primed' is 'false'.
+		 */
+		size_t			_count;
+		double			_alpha;
+		uint64_t		_tau;
+		double			_prev;
+		uint64_t		_prev_time;
+		bool			_prev_primed;
+		double			_avg;
+		bool			_primed;
+		uint64_t		_last_time;
+};
+
+}		// end of namespace func
+}		// end of namespace lkit
+
+#endif		// __LKIT_WINDOW_FUNCTIONS_H
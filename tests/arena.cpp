@@ -0,0 +1,130 @@
+/**
+ * This is the test of the arena allocator, and the values in it
+ */
+//	System Headers
+#include <iostream>
+#include <string>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "value.h"
+#include "variable.h"
+#include "base_functions.h"
+#include "expression.h"
+#include "util/arena.h"
+
+int main(int argc, char *argv[]) {
+	bool	error = false;
+
+	using namespace lkit::util;
+	/**
+	 * Blocks come from the same chunk, one after the other, and when
+	 * they are given back, they get re-used for the next one that size.
+	 */
+	if (!error) {
+		arena	pool;
+		char	*a = (char *)pool.allocate(40);
+		char	*b = (char *)pool.allocate(40);
+		if ((pool.getChunkCount() == 1) && (b - a == 48) &&
+			(pool.getBytesInUse() == 96)) {
+			std::cout << "Success, allocated blocks next to each other in one chunk" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, blocks were " << (b - a) << " bytes apart in " << pool.getChunkCount() << " chunks" << std::endl;
+		}
+		pool.deallocate(a, 40);
+		char	*c = (char *)pool.allocate(33);
+		if ((c == a) && (pool.getBytesInUse() == 96)) {
+			std::cout << "Success, re-used the block that was given back" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, did not re-use the block that was given back" << std::endl;
+		}
+		pool.release();
+		if ((pool.getChunkCount() == 0) && (pool.getBytesInUse() == 0)) {
+			std::cout << "Success, released all the chunks at once" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, there are still " << pool.getChunkCount() << " chunks after the release" << std::endl;
+		}
+	}
+
+	/**
+	 * The chunks start small, and double in size, and a block that's too
+	 * big for one gets it's own, without giving up the rest of the one
+	 * we're using.
+	 */
+	if (!error) {
+		arena	pool;
+		char	*a = (char *)pool.allocate(40);
+		char	*big = (char *)pool.allocate(arena::FIRST_CHUNK_SIZE * 4);
+		char	*b = (char *)pool.allocate(40);
+		if ((big != NULL) && (b - a == 48) && (pool.getChunkCount() == 2) &&
+			(pool.getBytesReserved() == arena::FIRST_CHUNK_SIZE * 5)) {
+			std::cout << "Success, the big block got it's own chunk, and the rest of the first was used" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, blocks were " << (b - a) << " bytes apart in " << pool.getChunkCount()
+					  << " chunks of " << pool.getBytesReserved() << " bytes" << std::endl;
+		}
+		// ...and each new one is twice the last, up to the largest size
+		size_t	expect = arena::FIRST_CHUNK_SIZE * 2;
+		size_t	chunks = pool.getChunkCount();
+		size_t	last = pool.getBytesReserved();
+		bool	grew = true;
+		for (int i = 0; grew && (i < 10); ) {
+			pool.allocate(40);
+			if (pool.getChunkCount() != chunks) {
+				grew = (pool.getBytesReserved() - last == expect);
+				chunks = pool.getChunkCount();
+				last = pool.getBytesReserved();
+				if (expect < arena::CHUNK_SIZE) {
+					expect *= 2;
+				}
+				++i;
+			}
+		}
+		if (grew) {
+			std::cout << "Success, the chunks doubled in size up to " << arena::CHUNK_SIZE << " bytes" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, the chunks did not double up to " << arena::CHUNK_SIZE << " bytes" << std::endl;
+		}
+	}
+
+	/**
+	 * Values in an arena are deleted like any other value - even when
+	 * it's a variable deleting the expression that defines it - and the
+	 * memory goes back to the arena.
+	 */
+	if (!error) {
+		arena				pool;
+		lkit::func::sum		sum;
+		lkit::value			*a = new (pool) lkit::value(2);
+		lkit::value			*b = new (pool) lkit::value(3.5);
+		lkit::expression	*e = new (pool) lkit::expression(&sum, a, b);
+		lkit::variable		*x = new (pool) lkit::variable("x", e);
+		if ((x->eval() == lkit::value(5)) && (pool.getBytesInUse() > 0)) {
+			std::cout << "Success, built " << *x << " in the arena" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, the arena values evaluated to " << x->eval() << std::endl;
+		}
+		delete x;
+		delete b;
+		delete a;
+		if (pool.getBytesInUse() == 0) {
+			std::cout << "Success, all the values went back to the arena" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, there are " << pool.getBytesInUse() << " bytes still in use in the arena" << std::endl;
+		}
+		// ...and the plain ones still come from the heap
+		lkit::value		*h = new lkit::value(1);
+		delete h;
+	}
+
+	std::cout << (error ? "FAILED!" : "SUCCESS") << std::endl;
+	return (error ? 1 : 0);
+}
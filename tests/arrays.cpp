@@ -0,0 +1,165 @@
+/**
+ * This is the test of the arrays, and the reductions on them
+ */
+//	System Headers
+#include <math.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "value.h"
+#include "variable.h"
+#include "expression.h"
+#include "array.h"
+#include "array_functions.h"
+#include "base_functions.h"
+#include "program.h"
+#include "parser.h"
+
+int main(int argc, char *argv[]) {
+	bool	error = false;
+
+	/**
+	 * The array is just bound to the buffer - it's not copied - and as
+	 * a single value, it's undefined.
+	 */
+	const size_t	n = 10001;
+	std::vector<double>		px(n);
+	std::vector<int>		qty(n);
+	double			sum = 0.0, dot = 0.0, lo = 1.0e9, hi = -1.0e9;
+	int				qsum = 0;
+	for (size_t i = 0; i < n; ++i) {
+		px[i] = 100.0 + 0.25 * ((i * 37) % 101) - 0.5 * (i % 7);
+		qty[i] = (int)(i % 13) - 2;
+		sum += px[i];
+		dot += px[i] * qty[i];
+		qsum += qty[i];
+		lo = (px[i] < lo ? px[i] : lo);
+		hi = (px[i] > hi ? px[i] : hi);
+	}
+	if (!error) {
+		lkit::array			a(&px[0], n);
+		lkit::array::view	v = a.getView();
+		if ((v.type == lkit::value::eDouble) && (v.data == &px[0]) && (v.size == n) &&
+			a.isArray() && a.isUndefined() && (a.toString() == "(double[10001])")) {
+			std::cout << "Success - the array " << a << " is bound to the buffer" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - the array " << a << " isn't bound to the buffer" << std::endl;
+		}
+	}
+
+	/**
+	 * Each of the reductions has to match the simple loop - the sums of
+	 * doubles aren't done left to right, so they are only close.
+	 */
+	if (!error) {
+		lkit::array				a(&px[0], n), q(&qty[0], n), none;
+		lkit::func::reduce		vsum(lkit::func::reduce::eSum);
+		lkit::func::reduce		vmean(lkit::func::reduce::eMean);
+		lkit::func::reduce		vmin(lkit::func::reduce::eMin);
+		lkit::func::reduce		vmax(lkit::func::reduce::eMax);
+		lkit::func::reduce		vdot(lkit::func::reduce::eDot);
+		lkit::expression		s(&vsum, &a);
+		lkit::expression		qs(&vsum, &q);
+		lkit::expression		both(&vsum, &q, &a);
+		lkit::expression		m(&vmean, &a);
+		lkit::expression		mn(&vmin, &a);
+		lkit::expression		mx(&vmax, &q, &a);
+		lkit::expression		d(&vdot, &a, &q);
+		lkit::expression		empty(&vmin, &none);
+		if (s.eval().isDouble() && (fabs(s.evalAsDouble() - sum) < 1.0e-6) &&
+			(qs.eval() == lkit::value(qsum)) &&
+			both.eval().isInteger() && (both.eval() == lkit::value(qsum + (int)sum)) &&
+			(fabs(m.evalAsDouble() - sum / n) < 1.0e-9) &&
+			(mn.eval() == lkit::value(lo)) && (mx.eval() == lkit::value(hi)) &&
+			(fabs(d.evalAsDouble() - dot) < 1.0e-6) && empty.eval().isUndefined()) {
+			std::cout << "Success - the reductions of " << n << " elements match the loops" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - the reductions are off: sum=" << s.eval() << " (" << sum << ") ints="
+					  << qs.eval() << " both=" << both.eval() << " mean=" << m.eval() << " min="
+					  << mn.eval() << " max=" << mx.eval() << " dot=" << d.eval() << " (" << dot
+					  << ") empty=" << empty.eval() << std::endl;
+		}
+	}
+
+	/**
+	 * In the parser, the arrays are the values of the variables, and the
+	 * cached answers have to change when the buffer does - and is touched -
+	 * or is bound to another, whether we walk the tree or run the bytecode.
+	 */
+	for (int mode = 0; !error && (mode < 2); ++mode) {
+		lkit::parser	p;
+		lkit::array		*a = new lkit::array(&px[0], n);
+		lkit::value		*av = a;
+		lkit::value		*qv = new lkit::array(&qty[0], n);
+		p.addVariable("px", av);
+		p.addVariable("qty", qv);
+		p.addVariable("x", lkit::value(2.0));
+		p.useBytecode(mode == 1);
+		p.setSource("(+ x (/ (dot px qty) (vsum qty)))");
+		double		ref = 2.0 + dot / qsum;
+		double		got = p.eval().evalAsDouble();
+		px[0] += 1000.0;
+		a->touch();
+		double		ref2 = 2.0 + (dot + 1000.0 * qty[0]) / qsum;
+		double		got2 = p.eval().evalAsDouble();
+		px[0] -= 1000.0;
+		std::vector<int>	ones(n, 1);
+		lkit::value	*ov = new lkit::array(&ones[0], n);
+		p.addVariable("qty", ov);
+		lkit::value	ref3 = lkit::value(2.0 + sum / n);
+		double		got3 = p.eval().evalAsDouble();
+		if ((fabs(got - ref) < 1.0e-9) && (fabs(got2 - ref2) < 1.0e-9) &&
+			(fabs(got3 - ref3.evalAsDouble()) < 1.0e-9)) {
+			std::cout << "Success - " << p.getSource() << " follows the arrays" << (mode == 1 ? " in bytecode" : "") << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << p.getSource() << " got " << got << ", " << got2 << ", " << got3
+					  << " but should be " << ref << ", " << ref2 << ", " << ref3 << std::endl;
+		}
+	}
+
+	/**
+	 * A batch can still be done a block of rows at a time, as the array
+	 * doesn't depend on the columns.
+	 */
+	if (!error) {
+		const size_t	rows = 300;
+		double			xs[rows];
+		for (size_t r = 0; r < rows; ++r) {
+			xs[r] = 0.5 * r;
+		}
+		lkit::variable			x("x");
+		lkit::array				a(&px[0], n);
+		lkit::func::reduce		vmax(lkit::func::reduce::eMax);
+		lkit::func::sum			plus;
+		lkit::expression		most(&vmax, &a);
+		lkit::expression		root(&plus, &x, &most);
+		lkit::program			p(&root);
+		lkit::program::column_map_t	cols;
+		lkit::program::column	xc = { lkit::value::eDouble, xs };
+		cols[&x] = xc;
+		lkit::value				ans[rows];
+		if (!p.eval(rows, cols, ans)) {
+			error = true;
+			std::cout << "ERROR - " << p << " could not be run on the batch" << std::endl;
+		}
+		for (size_t r = 0; !error && (r < rows); ++r) {
+			if (ans[r] != lkit::value(xs[r] + hi)) {
+				error = true;
+				std::cout << "ERROR - " << p << " got " << ans[r] << " for row " << r << " but should be " << (xs[r] + hi) << std::endl;
+			}
+		}
+		if (!error) {
+			std::cout << "Success - " << p << " matches row by row for " << rows << " rows" << std::endl;
+		}
+	}
+
+	std::cout << (error ? "FAILED!" : "SUCCESS") << std::endl;
+	return (error ? 1 : 0);
+}
@@ -0,0 +1,464 @@
+/**
+ * These are the microbenchmarks for the hot paths of LKit - the value
+ * arithmetic, the evaluation of the trees, the compile of the source and
+ * the evaluation of one parser by many threads. Each one writes a line of
+ * comma-separated values to stdout:
+ *
+ *   name,threads,iterations,usec,ns_per_op
+ *
+ * so that the results can be kept, and compared from release to release.
+ * If a name is given on the command line, only those benchmarks that start
+ * with it are run.
+ */
+//	System Headers
+#include <stdint.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+#include <boost/thread.hpp>
+
+//	Other Headers
+#include "value.h"
+#include "variable.h"
+#include "array.h"
+#include "array_functions.h"
+#include "base_functions.h"
+#include "expression.h"
+#include "parser.h"
+#include "util/timer.h"
+
+using lkit::util::timer;
+
+/**
+ * This is where each benchmark puts the results it computes, so that the
+ * compiler can't decide that the work isn't needed.
+ */
+static double	__sink = 0.0;
+
+/**
+ * This is the prefix of the benchmarks to run - empty for all of them.
+ */
+static std::string	__only;
+
+/**
+ * This returns 'true' if the benchmark with this name is to be run.
+ */
+static bool wanted( const std::string & aName )
+{
+	return (aName.compare(0, __only.size(), __only) == 0);
+}
+
+/**
+ * This writes out the results of one benchmark in the machine-readable
+ * form that we promised.
+ */
+static void report( const std::string & aName, int aThreads, uint64_t anIters, uint64_t aUSec )
+{
+	double	ns = (anIters > 0 ? (aUSec * 1000.0) / anIters : 0.0);
+	std::cout << aName << "," << aThreads << "," << anIters << "," << aUSec << "," << ns << std::endl;
+}
+
+/**
+ * The compile needs to be timed on it's own - without the eval that
+ * normally comes right after it - and that's protected in the parser,
+ * so we need to open it up.
+ */
+class bench_parser :
+	public lkit::parser
+{
+	public:
+		bool build() { return compile(); }
+};
+
+/**
+ * This is a worker that evaluates a shared parser over and over, for the
+ * benchmark of many threads hitting the same parser.
+ */
+struct worker
+{
+	worker( lkit::parser *aParser, uint64_t anIters ) :
+		prsr(aParser), iters(anIters), total(0.0) { };
+	void operator()()
+	{
+		for (uint64_t i = 0; i < iters; ++i) {
+			total += prsr->eval().evalAsDouble();
+		}
+	}
+	lkit::parser	*prsr;
+	uint64_t		iters;
+	double			total;
+};
+
+
+/**
+ * value::operator+= for each pair of types - the left side sets the type
+ * of the answer, and the right side is cast to it.
+ */
+static void benchValueAdd()
+{
+	const uint64_t	iters = 10000000;
+	lkit::value		rhs[] = { lkit::value(1), lkit::value(1.5), lkit::value((uint64_t)1) };
+	const char		*names[] = { "int", "double", "time" };
+	for (int l = 0; l < 3; ++l) {
+		for (int r = 0; r < 3; ++r) {
+			std::string		name = std::string("value_add_") + names[l] + "_" + names[r];
+			if (!wanted(name)) {
+				continue;
+			}
+			lkit::value		ans = rhs[l];
+			lkit::value		&v = rhs[r];
+			uint64_t		start = timer::usecStamp();
+			for (uint64_t i = 0; i < iters; ++i) {
+				ans += v;
+			}
+			uint64_t		usec = timer::usecStamp() - start;
+			__sink += ans.evalAsDouble();
+			report(name, 1, iters, usec);
+		}
+	}
+}
+
+
+/**
+ * The evaluation of a deep tree - a chain of sums, each on the one below
+ * it and a variable - when the variable at the bottom changes, so the
+ * whole chain is recalculated, and when nothing's changed, so it's just
+ * the cached answer at the top.
+ */
+static void benchExprDeep()
+{
+	const int		depth = 1000;
+	const uint64_t	iters = 5000;
+	lkit::variable	x("x", 1.0);
+	lkit::value		one(1.0);
+	lkit::func::sum	sum;
+	std::vector<lkit::expression *>	chain;
+	lkit::value		*below = &x;
+	for (int d = 0; d < depth; ++d) {
+		chain.push_back(new lkit::expression(&sum, below, &one));
+		below = chain.back();
+	}
+	lkit::expression	*top = chain.back();
+	if (wanted("expr_deep_dirty")) {
+		uint64_t	start = timer::usecStamp();
+		for (uint64_t i = 0; i < iters; ++i) {
+			x = (double)i;
+			__sink += top->evalAsDouble();
+		}
+		report("expr_deep_dirty", 1, iters, timer::usecStamp() - start);
+	}
+	if (wanted("expr_deep_cached")) {
+		uint64_t	start = timer::usecStamp();
+		for (uint64_t i = 0; i < iters * 400; ++i) {
+			__sink += top->evalAsDouble();
+		}
+		report("expr_deep_cached", 1, iters * 400, timer::usecStamp() - start);
+	}
+	for (int d = depth - 1; d >= 0; --d) {
+		delete chain[d];
+	}
+}
+
+
+/**
+ * The evaluation of a wide tree - one sum of a lot of variables - when
+ * just one of them changes, and when they all do.
+ */
+static void benchExprWide()
+{
+	const int		width = 1000;
+	const uint64_t	iters = 20000;
+	std::vector<lkit::variable *>	vars;
+	std::vector<lkit::value *>		args;
+	for (int w = 0; w < width; ++w) {
+		std::ostringstream	name;
+		name << "x" << w;
+		vars.push_back(new lkit::variable(name.str(), (double)w));
+		args.push_back(vars.back());
+	}
+	lkit::func::sum		sum;
+	lkit::expression	top(&sum, args);
+	if (wanted("expr_wide_one")) {
+		uint64_t	start = timer::usecStamp();
+		for (uint64_t i = 0; i < iters; ++i) {
+			*vars[i % width] = (double)i;
+			__sink += top.evalAsDouble();
+		}
+		report("expr_wide_one", 1, iters, timer::usecStamp() - start);
+	}
+	if (wanted("expr_wide_all")) {
+		uint64_t	start = timer::usecStamp();
+		for (uint64_t i = 0; i < iters / 10; ++i) {
+			for (int w = 0; w < width; ++w) {
+				*vars[w] = (double)(i + w);
+			}
+			__sink += top.evalAsDouble();
+		}
+		report("expr_wide_all", 1, iters / 10, timer::usecStamp() - start);
+	}
+	for (int w = 0; w < width; ++w) {
+		delete vars[w];
+	}
+}
+
+
+/**
+ * The same wide sum as above, when they all change, but as one array
+ * bound to the buffer, and reduced by the kernel.
+ */
+static void benchArrayWide()
+{
+	const int		width = 1000;
+	const uint64_t	iters = 2000;
+	std::vector<double>		buff(width);
+	lkit::array				data(&buff[0], width);
+	lkit::func::reduce		vsum(lkit::func::reduce::eSum);
+	lkit::expression		top(&vsum, &data);
+	if (wanted("array_wide_all")) {
+		uint64_t	start = timer::usecStamp();
+		for (uint64_t i = 0; i < iters; ++i) {
+			for (int w = 0; w < width; ++w) {
+				buff[w] = (double)(i + w);
+			}
+			data.touch();
+			__sink += top.evalAsDouble();
+		}
+		report("array_wide_all", 1, iters, timer::usecStamp() - start);
+	}
+}
+
+
+/**
+ * The compile of a large source - a lot of nested expressions on a few
+ * variables, so that none of it can be folded away - into the tree, and
+ * the load of the image of that tree.
+ */
+static void benchCompile()
+{
+	if (!wanted("parser_compile")) {
+		return;
+	}
+	const int		terms = 2000;
+	const uint64_t	iters = 20;
+	std::ostringstream	src;
+	src << "(+";
+	for (int t = 0; t < terms; ++t) {
+		src << " (* x " << t << ".5 (- y " << t << "))";
+	}
+	src << ")";
+	bench_parser	p;
+	p.addVariable("x", lkit::value(1.5));
+	p.addVariable("y", lkit::value(2));
+	uint64_t		usec = 0;
+	for (uint64_t i = 0; i < iters; ++i) {
+		// setting the source drops the last tree, so we have to compile again
+		p.setSource(src.str());
+		uint64_t	start = timer::usecStamp();
+		p.build();
+		usec += timer::usecStamp() - start;
+	}
+	__sink += p.eval().evalAsDouble();
+	report("parser_compile", 1, iters, usec);
+	report("parser_compile_bytes", 1, iters * src.str().size(), usec);
+	// ...and the same trees from the image of them, with no compile at all
+	std::string		image = p.getImage();
+	usec = 0;
+	for (uint64_t i = 0; i < iters; ++i) {
+		uint64_t	start = timer::usecStamp();
+		p.setImage(image);
+		usec += timer::usecStamp() - start;
+	}
+	__sink += p.eval().evalAsDouble();
+	report("parser_image", 1, iters, usec);
+}
+
+
+/**
+ * The evaluation of one parser by a lot of threads at once - where all
+ * they're really doing is fighting over the locks.
+ */
+static void benchContention()
+{
+	const uint64_t	iters = 200000;
+	lkit::parser	p;
+	p.addVariable("x", lkit::value(1.5));
+	p.addVariable("y", lkit::value(2));
+	p.setSource("(+ (* x 2) (- y 1) (max x y 3))");
+	p.eval();
+	for (int cnt = 1; cnt <= 8; cnt *= 2) {
+		std::string		name = "parser_eval_threads";
+		if (!wanted(name)) {
+			break;
+		}
+		std::vector<worker *>			w;
+		std::vector<boost::thread *>	t;
+		uint64_t		start = timer::usecStamp();
+		for (int i = 0; i < cnt; ++i) {
+			w.push_back(new worker(&p, iters));
+			t.push_back(new boost::thread(boost::ref(*w.back())));
+		}
+		for (int i = 0; i < cnt; ++i) {
+			t[i]->join();
+			__sink += w[i]->total;
+			delete t[i];
+			delete w[i];
+		}
+		report(name, cnt, iters * cnt, timer::usecStamp() - start);
+	}
+}
+
+
+/**
+ * The evaluation of a source of a lot of independent rules, where x
+ * changes every time, so they all have to be done again - on one
+ * thread, and then on a pool of them.
+ */
+static void benchParallel()
+{
+	const int		rules = 200;
+	const int		terms = 50;
+	const uint64_t	iters = 200;
+	std::ostringstream	src;
+	for (int r = 0; r < rules; ++r) {
+		src << "(+";
+		for (int t = 0; t < terms; ++t) {
+			src << " (* x " << (r + t) << ".5 (- y " << t << "))";
+		}
+		src << ")";
+	}
+	lkit::parser	p;
+	p.addVariable("y", lkit::value(2));
+	p.setSource(src.str());
+	for (int cnt = 1; cnt <= 8; cnt *= 2) {
+		std::string		name = "parser_eval_parallel";
+		if (!wanted(name)) {
+			break;
+		}
+		p.useThreads(cnt);
+		std::vector<lkit::value>	ans;
+		uint64_t		start = timer::usecStamp();
+		for (uint64_t i = 0; i < iters; ++i) {
+			p.addVariable("x", lkit::value(1.5 + i));
+			p.evalAll(ans);
+			__sink += ans.back().evalAsDouble();
+		}
+		report(name, cnt, iters, timer::usecStamp() - start);
+	}
+}
+
+
+/**
+ * The evaluation of a source of a lot of small rules - each one a sum,
+ * or a comparison, of just two values - when x changes, so they all
+ * have to be done again, with the fixed functions the parser puts in
+ * for them, and with the general ones.
+ */
+static void benchFastPaths()
+{
+	const int		rules = 500;
+	const uint64_t	iters = 2000;
+	std::ostringstream	src;
+	for (int r = 0; r < rules; ++r) {
+		src << " (and (> (+ x " << r << ".5) (* y 2.5)) (< (- x y) " << r << ".0))";
+	}
+	for (int mode = 0; mode < 2; ++mode) {
+		std::string		name = (mode == 0 ? "parser_eval_fixed" : "parser_eval_general");
+		if (!wanted(name)) {
+			continue;
+		}
+		lkit::parser	p;
+		p.useFastPaths(mode == 0);
+		p.addVariable("y", lkit::value(2.0));
+		p.setSource(src.str());
+		std::vector<lkit::value>	ans;
+		uint64_t		start = timer::usecStamp();
+		for (uint64_t i = 0; i < iters; ++i) {
+			p.addVariable("x", lkit::value(1.5 + i));
+			p.evalAll(ans);
+			__sink += ans.back().evalAsInt();
+		}
+		report(name, 1, iters * rules, timer::usecStamp() - start);
+	}
+}
+
+
+/**
+ * The evaluation of one bigger rule - all arithmetic and comparisons on
+ * ints and doubles - compiled to a program, as x changes. When LKit is
+ * built with 'make JIT=1', this is the native code for the program, and
+ * otherwise it's the instructions, so the two builds can be compared.
+ */
+static void benchBytecode()
+{
+	const uint64_t	iters = 1000000;
+	std::string		name = "parser_eval_bytecode";
+	if (wanted(name)) {
+		lkit::parser	p;
+		p.useBytecode();
+		p.addVariable("y", lkit::value(2.0));
+		p.setSource("(if (and (> (+ x 0.5) (* y 2.5)) (< (- x y) 1000000.0))"
+					" (- (* x y) (/ x 4.0) (max x y 3.0))"
+					" (+ (* x x) (* y y) (/ (- x y) 2.0)))");
+		uint64_t		start = timer::usecStamp();
+		for (uint64_t i = 0; i < iters; ++i) {
+			p.addVariable("x", lkit::value(1.5 + (i % 1000)));
+			__sink += p.eval().evalAsDouble();
+		}
+		report(name, 1, iters, timer::usecStamp() - start);
+	}
+}
+
+
+/**
+ * The making of a lot of parsers - each with the default functions - and
+ * the copying of them, as a server with a parser for each of it's rules,
+ * or each of it's clients, would do.
+ */
+static void benchConstruct()
+{
+	const uint64_t	iters = 100000;
+	std::string		name = "parser_construct";
+	if (wanted(name)) {
+		uint64_t		start = timer::usecStamp();
+		for (uint64_t i = 0; i < iters; ++i) {
+			lkit::parser	p;
+			__sink += (p.getSource().size() > 0 ? 1.0 : 0.0);
+		}
+		report(name, 1, iters, timer::usecStamp() - start);
+	}
+	name = "parser_copy";
+	if (wanted(name)) {
+		lkit::parser	orig;
+		orig.setSource("(+ x 1)");
+		uint64_t		start = timer::usecStamp();
+		for (uint64_t i = 0; i < iters; ++i) {
+			lkit::parser	p(orig);
+			__sink += (p.getSource().size() > 0 ? 1.0 : 0.0);
+		}
+		report(name, 1, iters, timer::usecStamp() - start);
+	}
+}
+
+
+int main(int argc, char *argv[]) {
+	if (argc > 1) {
+		__only = argv[1];
+	}
+	std::cout << "name,threads,iterations,usec,ns_per_op" << std::endl;
+	benchValueAdd();
+	benchExprDeep();
+	benchExprWide();
+	benchArrayWide();
+	benchCompile();
+	benchContention();
+	benchParallel();
+	benchFastPaths();
+	benchBytecode();
+	benchConstruct();
+	// this keeps all the work from being optimized away
+	std::cerr << "sink: " << __sink << std::endl;
+	return 0;
+}
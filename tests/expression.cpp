@@ -13,6 +13,75 @@
 #include "expression.h"
 #include "util/timer.h"
 
+/**
+ * This is a simple function that sums its arguments, but counts the
+ * number of times it's been called so that we can see that the
+ * expressions only re-evaluate when their arguments have changed.
+ */
+class counted_sum :
+	public lkit::func::sum
+{
+	public:
+		counted_sum() : calls(0) { };
+		virtual lkit::value eval( std::vector<lkit::value *> & anArg )
+		{
+			++calls;
+			return lkit::func::sum::eval(anArg);
+		}
+		int		calls;
+};
+
+/**
+ * This is the same thing, but it claims to have state, so it can't
+ * be cached, and has to be called on every evaluation.
+ */
+class counted_impure_sum :
+	public counted_sum
+{
+	public:
+		virtual bool isPure() const { return false; }
+};
+
+/**
+ * This is a simple value that counts the number of times it's been
+ * evaluated, so that we can see that an expression that's updating
+ * it's answer only looks at the arguments that have changed.
+ */
+class counted_value :
+	public lkit::value
+{
+	public:
+		counted_value() : evals(0) { };
+		virtual lkit::value eval()
+		{
+			++evals;
+			return lkit::value::eval();
+		}
+		virtual lkit::value & eval( lkit::value & aResult )
+		{
+			++evals;
+			return lkit::value::eval(aResult);
+		}
+		int		evals;
+};
+
+/**
+ * This is a value that's twice what it holds - and it only overrides
+ * the one eval_nl(), so the base has to use it for the other.
+ */
+class doubled_value :
+	public lkit::value
+{
+	public:
+		doubled_value( int aValue ) : lkit::value(aValue) { };
+	protected:
+		virtual lkit::value eval_nl()
+		{
+			return lkit::value(2 * evalAsInt_nl());
+		}
+};
+
+
 int main(int argc, char *argv[]) {
 	bool	error = false;
 
@@ -81,6 +150,283 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	/**
+	 * The expressions cache their results, and should only call the
+	 * function again when one of the arguments - or something they
+	 * depend on - has actually changed.
+	 */
+	if (!error) {
+		lkit::value	a, b, c;
+		a = 1;
+		b = 2;
+		c = 3;
+		counted_sum			f;
+		lkit::expression	inner(&f, &a, &b);
+		lkit::expression	outer(&f, &inner, &c);
+		outer.eval();
+		outer.eval();
+		if ((outer.evalAsInt() == 6) && (f.calls == 2)) {
+			std::cout << "Success - " << outer << " is cached when nothing changes!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << outer << " was re-evaluated " << f.calls << " times for: " << outer.evalAsInt() << std::endl;
+		}
+		// changing a leaf needs to run all the way up the tree
+		f.calls = 0;
+		a = 10;
+		if ((outer.evalAsInt() == 15) && (f.calls == 2)) {
+			std::cout << "Success - " << outer << " picks up the change in a leaf!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << outer << " missed the change in a leaf: " << outer.evalAsInt() << " after " << f.calls << " calls" << std::endl;
+		}
+		// ...but changing the top-level argument leaves the inner alone
+		f.calls = 0;
+		c += 5;
+		if ((outer.evalAsInt() == 20) && (f.calls == 1) && !inner.isDirty()) {
+			std::cout << "Success - " << outer << " only re-evaluates what changed!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << outer << " re-evaluated too much: " << outer.evalAsInt() << " after " << f.calls << " calls" << std::endl;
+		}
+		// a temporary moved into a leaf is a change, and the answer can go right into ours
+		f.calls = 0;
+		b = lkit::value(4);
+		lkit::value		ans;
+		if ((outer.eval(ans) == 22) && ans.isInteger() && (f.calls == 2)) {
+			std::cout << "Success - " << outer << " picks up a moved value, and evaluates into " << ans << "!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << outer << " evaluated into " << ans << " after " << f.calls << " calls" << std::endl;
+		}
+	}
+
+	/**
+	 * A function that isn't pure can't be cached, and neither can any
+	 * expression that uses it as an argument - even a pure one.
+	 */
+	if (!error) {
+		lkit::value		a, b, c;
+		a = 1;
+		b = 2;
+		c = 3;
+		counted_impure_sum	g;
+		counted_sum			f;
+		lkit::expression	inner(&g, &a, &b);
+		lkit::expression	outer(&f, &inner, &c);
+		outer.eval();
+		outer.eval();
+		if ((outer.evalAsInt() == 6) && (g.calls == 3) && (f.calls == 3) &&
+			outer.isVolatile()) {
+			std::cout << "Success - " << outer << " is re-evaluated for an impure function!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << outer << " was cached with an impure function: " << g.calls << " and " << f.calls << " calls" << std::endl;
+		}
+	}
+
+	/**
+	 * Each argument should be evaluated exactly once per call of the
+	 * function - no matter what the function is doing with it.
+	 */
+	if (!error) {
+		lkit::value		a, b, c;
+		a = 1;
+		b = 2;
+		c = 3;
+		counted_impure_sum	g;
+		lkit::func::max		f;
+		lkit::expression	inner(&g, &a, &b);
+		lkit::expression	outer(&f, &c, &inner, &inner);
+		if ((outer.evalAsInt() == 3) && (g.calls == 2)) {
+			std::cout << "Success - " << outer << " evaluates each argument once!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << outer << " evaluated " << g.calls << " arguments for: " << outer.evalAsInt() << std::endl;
+		}
+	}
+
+	/**
+	 * The sums, products, and the max and min of a lot of arguments are
+	 * updated for just the ones that have changed - and they have to get
+	 * the same answers as doing them all.
+	 */
+	if (!error) {
+		const int			cnt = 100;
+		counted_value		v[cnt];
+		counted_value		d[cnt];
+		std::vector<lkit::value *>	ints;
+		std::vector<lkit::value *>	dbls;
+		for (int i = 0; i < cnt; ++i) {
+			v[i].set(i * 7 % 31);
+			d[i].set(1.0 + 0.001 * i);
+			ints.push_back(&v[i]);
+			dbls.push_back(&d[i]);
+		}
+		lkit::func::sum		sum;
+		lkit::func::prod	prod;
+		lkit::func::max		max;
+		lkit::func::min		min;
+		lkit::expression	s(&sum, ints);
+		lkit::expression	p(&prod, dbls);
+		lkit::expression	hi(&max, ints);
+		lkit::expression	lo(&min, ints);
+		s.eval();
+		p.eval();
+		hi.eval();
+		lo.eval();
+		// changing one argument only looks at that one
+		for (int i = 0; i < cnt; ++i) {
+			v[i].evals = 0;
+		}
+		v[5].set(1000);
+		lkit::value		ans = s.eval();
+		int				looked = 0;
+		for (int i = 0; i < cnt; ++i) {
+			looked += v[i].evals;
+		}
+		if ((v[5].evals == 1) && (looked == 1) && (ans == sum.eval(ints))) {
+			std::cout << "Success - a sum of " << cnt << " arguments was updated for the one that changed" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - a sum of " << cnt << " arguments looked at " << looked << " of them and got " << ans << std::endl;
+		}
+		// ...and lots of changes have to match doing them all
+		for (int n = 0; !error && (n < 2000); ++n) {
+			int		i = (n * 37) % cnt;
+			switch (n % 5) {
+				case 0:
+					// make this one the largest
+					v[i].set(2000 + n);
+					break;
+				case 1:
+					// take the largest down to the smallest
+					v[i].set(-2000 - n);
+					break;
+				case 2:
+					// ...and an undefined one is skipped
+					v[i].clear();
+					break;
+				default:
+					v[i].set(n % 19);
+					break;
+			}
+			d[i].set(1.0 + 0.0001 * (n % 13));
+			lkit::value		ps = p.eval();
+			lkit::value		pa = prod.eval(dbls);
+			double			err = (ps.evalAsDouble() - pa.evalAsDouble()) / pa.evalAsDouble();
+			if ((s.eval() != sum.eval(ints)) || (hi.eval() != max.eval(ints)) ||
+				(lo.eval() != min.eval(ints)) || (err > 1e-12) || (err < -1e-12)) {
+				error = true;
+				std::cout << "ERROR - after change " << n << " the updates got " << s.eval() << ", " << ps
+						  << ", " << hi.eval() << ", " << lo.eval() << " but should be " << sum.eval(ints)
+						  << ", " << pa << ", " << max.eval(ints) << ", " << min.eval(ints) << std::endl;
+			}
+		}
+		if (!error) {
+			std::cout << "Success - sum, prod, max and min of " << cnt << " arguments matched after 2000 updates" << std::endl;
+		}
+		// a function that can't update stops the tracking, and one that can starts it again
+		if (!error) {
+			counted_sum		cs;
+			s.setFunction(&cs);
+			v[3].set(77);
+			bool	off = ((s.eval() == sum.eval(ints)) && (cs.calls == 1));
+			s.setFunction(&sum);
+			s.eval();
+			for (int i = 0; i < cnt; ++i) {
+				v[i].evals = 0;
+			}
+			v[3].set(78);
+			ans = s.eval();
+			looked = 0;
+			for (int i = 0; i < cnt; ++i) {
+				looked += v[i].evals;
+			}
+			if (off && (looked == 1) && (ans == sum.eval(ints))) {
+				std::cout << "Success - the tracking of the arguments stopped, and started again, with the function" << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR - after the function changed, the sum looked at " << looked << " arguments and got " << ans << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * The first defined argument sets the type of a sum, so an undefined
+	 * one ahead of it becoming defined, or it becoming undefined, has to
+	 * give the same type as doing them all - as does the product.
+	 */
+	if (!error) {
+		const int			cnt = 9;
+		lkit::value			v[cnt];
+		std::vector<lkit::value *>	args;
+		for (int i = 0; i < cnt; ++i) {
+			if (i > 0) {
+				v[i].set(2);
+			}
+			args.push_back(&v[i]);
+		}
+		lkit::func::sum		sum;
+		lkit::func::prod	prod;
+		lkit::expression	s(&sum, args);
+		lkit::expression	p(&prod, args);
+		s.eval();
+		p.eval();
+		bool	ok = true;
+		for (int n = 0; ok && (n < 4); ++n) {
+			switch (n) {
+				case 0:
+					// the type comes from the first one that's defined
+					v[1].set(3.5);
+					break;
+				case 1:
+					// ...and when that goes away, it's from the next one
+					v[1].clear();
+					break;
+				case 2:
+					// an undefined one ahead of the first takes over
+					v[0].set(1.5);
+					break;
+				default:
+					// ...and when it goes away, it's from the next one again
+					v[0].clear();
+					break;
+			}
+			lkit::value		sa = sum.eval(args);
+			lkit::value		pa = prod.eval(args);
+			ok = ((s.eval() == sa) && (s.eval().isDouble() == sa.isDouble()) &&
+				  (p.eval() == pa) && (p.eval().isDouble() == pa.isDouble()));
+			if (!ok) {
+				error = true;
+				std::cout << "ERROR - after change " << n << " the updates got " << s.eval() << ", " << p.eval()
+						  << " but should be " << sa << ", " << pa << std::endl;
+			}
+		}
+		if (ok) {
+			std::cout << "Success - sum and prod of " << cnt << " arguments got their type from the first defined one" << std::endl;
+		}
+	}
+
+	/**
+	 * A value that only overrides eval_nl() has to be evaluated with it
+	 * when a function evaluates it's arguments into it's scratch.
+	 */
+	if (!error) {
+		doubled_value		d(5);
+		lkit::value			one(1);
+		lkit::func::sum		sum;
+		lkit::expression	e(&sum, &d, &one);
+		lkit::value			v;
+		if ((d.eval() == lkit::value(10)) && (d.eval(v) == lkit::value(10)) &&
+			(e.eval() == lkit::value(11))) {
+			std::cout << "Success - " << e << " used the eval_nl() of the subclass" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << e << " got " << e.eval() << " but should be 11" << std::endl;
+		}
+	}
+
 	std::cout << (error ? "FAILED!" : "SUCCESS") << std::endl;
 	return (error ? 1 : 0);
 }
@@ -2,15 +2,134 @@
  * This is the test of the parser class
  */
 //	System Headers
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <iostream>
+#include <stdexcept>
+#include <sstream>
 #include <string>
+#include <vector>
 
 //	Third-Party Headers
 
 //	Other Headers
 #include "parser.h"
+#include "base_functions.h"
+#include "context.h"
+#include "registry.h"
 #include "util/timer.h"
 
+/**
+ * This is division, but it counts how many times it's been done - so
+ * that we can see the same sub-expression is only done once.
+ */
+class counted_quot :
+	public lkit::func::quot
+{
+	public:
+		counted_quot() : calls(0) { };
+		virtual lkit::value eval( std::vector<lkit::value *> & anArg, std::vector<lkit::value> & aScratch )
+		{
+			++calls;
+			return lkit::func::quot::eval(anArg, aScratch);
+		}
+		int		calls;
+};
+
+
+/**
+ * This pulls the count, bytes, or overhead - the column - out of the
+ * line for the kind in the parser's memory usage, or -1 if it's not
+ * there.
+ */
+static long usageOf( const std::string & aUsage, const std::string & aKind, int aColumn )
+{
+	long				ans = -1;
+	std::istringstream	in(aUsage);
+	std::string			line;
+	while (std::getline(in, line)) {
+		if (line.compare(0, aKind.size() + 1, aKind + ",") == 0) {
+			std::istringstream	cols(line.substr(aKind.size() + 1));
+			std::string			col;
+			for (int i = 0; (i <= aColumn) && std::getline(cols, col, ','); ++i) {
+				ans = atol(col.c_str());
+			}
+			break;
+		}
+	}
+	return ans;
+}
+
+
+/**
+ * This returns where the count of the nodes is in an image - after the
+ * header, the source, the names, the roots and the definitions - so the
+ * test can make it wrong. Each of them starts with it's count.
+ */
+static size_t nodeCountAt( const std::string & anImage )
+{
+	uint32_t	cnt = 0;
+	uint32_t	len = 0;
+	size_t		pos = 3 * sizeof(uint32_t);
+	memcpy(&len, anImage.data() + pos, sizeof(len));
+	pos += sizeof(len) + len;
+	memcpy(&cnt, anImage.data() + pos, sizeof(cnt));
+	pos += sizeof(cnt);
+	for (uint32_t i = 0; i < cnt; ++i) {
+		memcpy(&len, anImage.data() + pos, sizeof(len));
+		pos += sizeof(len) + len;
+	}
+	memcpy(&cnt, anImage.data() + pos, sizeof(cnt));
+	pos += sizeof(cnt) + cnt * sizeof(uint32_t);
+	memcpy(&cnt, anImage.data() + pos, sizeof(cnt));
+	pos += sizeof(cnt) + cnt * 2 * sizeof(uint32_t);
+	return pos;
+}
+
+
+/**
+ * This returns 'true' if the parser's source can be compiled - it
+ * throws when a function isn't there, and that's a 'false'.
+ */
+static bool compiles( lkit::parser & aParser )
+{
+	bool						ans = false;
+	std::vector<lkit::value>	all;
+	try {
+		ans = aParser.evalAll(all);
+	} catch (std::exception & e) {
+		ans = false;
+	}
+	return ans;
+}
+
+
+/**
+ * This keeps all the changes that a subscription's callback is told
+ * about - as one line for each, so they are easy to check.
+ */
+class change_log
+{
+	public:
+		void operator()( int anID, const lkit::value & anOld, const lkit::value & aNew )
+		{
+			std::ostringstream	msg;
+			msg << anID << ":" << anOld << "->" << aNew;
+			changes.push_back(msg.str());
+		}
+		std::string str() const
+		{
+			std::string		retval;
+			for (size_t i = 0; i < changes.size(); ++i) {
+				retval += (i == 0 ? "" : " ") + changes[i];
+			}
+			return retval;
+		}
+		std::vector<std::string>	changes;
+};
+
+
 int main(int argc, char *argv[]) {
 	bool	error = false;
 
@@ -75,6 +194,18 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	if (!error) {
+		std::string		src = "(or 0 false 0.0)";
+		lkit::value		ref = false;
+		p.setSource(src);
+		if (p.eval() == ref) {
+			std::cout << "Success, parsed " << src << " into: " << ref << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, unable to parse " << src << " into: " << ref << " ... got: " << p.eval() << std::endl;
+		}
+	}
+
 	if (!error) {
 		std::string		src = "(+ (+ 1 2) (+ 3 4 5) 6))";
 		lkit::value		ref = 21;
@@ -135,6 +266,765 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	if (!error) {
+		std::string		src = "(+ (* y 2) 1)";
+		lkit::value		ref = 21;
+		p.addVariable("y", lkit::value(3));
+		p.setSource(src);
+		p.eval();
+		p.addVariable("y", lkit::value(10));
+		if (p.eval() == ref) {
+			std::cout << "Success, re-evaluated " << src << " with new 'y' into: " << ref << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, unable to re-evaluate " << src << " with new 'y' into: " << ref << " ... got: " << p.eval() << std::endl;
+		}
+	}
+
+	if (!error) {
+		std::string		src = "(set x (* 2 (+ 1 2))) (+ (* 2 3) x y)";
+		lkit::value		ref = 22;
+		p.setSource(src);
+		const lkit::variable	*x = (const lkit::variable *)p.getVariable("x");
+		if ((x == NULL) || (x->getExpr() != NULL)) {
+			error = true;
+			std::cout << "ERROR, the constant definition of 'x' in " << src << " was not folded into a simple value!" << std::endl;
+		} else if (p.eval() == ref) {
+			std::cout << "Success, folded the constants in " << src << " and got: " << ref << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, unable to parse " << src << " into: " << ref << " ... got: " << p.eval() << std::endl;
+		}
+	}
+
+	/**
+	 * Compiling the expressions into programs has to give us the same
+	 * answers as walking the language tree.
+	 */
+	if (!error) {
+		const char	*srcs[] = {
+			"(+ (/ 10.0 2.5) (* (+ 1.5 2 6) 2.0))",
+			"(* (set x (+ 1 2 3)) 3 (* x 2))",
+			"(set z 4) (- (max z 2 9) (min 3 z) (- z))",
+			"(and (< 1 2 z) (>= z 4 4) (not false))",
+			"(or (> z 5) (< z 0) (== z 4.0))",
+			"(if (> z 3) (* z 2) (- z))",
+			"(cond (< z 1) 1 (< z 3) 2 (== z 3) 3)",
+			"(+ (* w 2.5) 1)"
+		};
+		p.addVariable("w", lkit::value(2.0));
+		for (int i = 0; !error && (i < 8); ++i) {
+			std::string		src = srcs[i];
+			p.useBytecode(false);
+			p.setSource(src);
+			lkit::value		ref = p.eval();
+			p.useBytecode(true);
+			if (p.usingBytecode() && (p.eval() == ref)) {
+				std::cout << "Success, compiled " << src << " to bytecode and got: " << ref << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR, unable to compile " << src << " to bytecode for: " << ref << " ... got: " << p.eval() << std::endl;
+			}
+		}
+		// ...and it has to see the changes in the variables
+		p.addVariable("w", lkit::value(4.0));
+		if (p.eval() == lkit::value(11.0)) {
+			std::cout << "Success, bytecode picked up the new value for 'w'" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, bytecode missed the new value for 'w' ... got: " << p.eval() << std::endl;
+		}
+		p.useBytecode(false);
+	}
+
+	/**
+	 * Evaluating a batch of rows from bound columns has to give the same
+	 * answers as setting the variables for each row - even when one of
+	 * the variables is defined by an expression on the others.
+	 */
+	if (!error) {
+		const size_t	rows = 300;
+		double			as[rows];
+		int				bs[rows];
+		for (size_t r = 0; r < rows; ++r) {
+			as[r] = 1.5 * r;
+			bs[r] = (int)r - 100;
+		}
+		const char	*srcs[] = {
+			"(+ (* a 2) (max b 0) w)",
+			"(set d (* a 2)) (- d b)"
+		};
+		for (int i = 0; !error && (i < 2); ++i) {
+			std::string		src = srcs[i];
+			p.setSource(src);
+			p.bindColumn("a", as);
+			p.bindColumn("b", bs);
+			double			ans[rows];
+			if (!p.evalBatch(rows, ans)) {
+				error = true;
+				std::cout << "ERROR, unable to evaluate " << src << " over a batch of " << rows << " rows" << std::endl;
+				break;
+			}
+			p.clearColumns();
+			for (size_t r = 0; r < rows; ++r) {
+				p.addVariable("a", lkit::value(as[r]));
+				p.addVariable("b", lkit::value(bs[r]));
+				lkit::value		ref = p.eval();
+				if (ref != lkit::value(ans[r])) {
+					error = true;
+					std::cout << "ERROR, batch of " << src << " got " << ans[r] << " for row " << r << " but should be " << ref << std::endl;
+					break;
+				}
+			}
+			if (!error) {
+				std::cout << "Success, evaluated " << src << " over a batch of " << rows << " rows" << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * The variables get slots as they are compiled, and setting them
+	 * by slot has to be the same as setting them by name - with the
+	 * tree, and the programs.
+	 */
+	if (!error) {
+		lkit::parser	q;
+		q.setSource("(+ a (* b 2) c)");
+		q.addVariable("c", lkit::value(0.5));
+		// evaluating it compiles it, and that gives the new variables slots
+		q.eval();
+		int			a = q.getVariableSlot("a");
+		int			b = q.getVariableSlot("b");
+		int			c = q.getVariableSlot("c");
+		// the default variables have the first slots
+		if ((c >= 0) && (a == c + 1) && (b == c + 2) && (q.getVariableSlot("d") == -1) &&
+			(q.getVariableSlotCount() == (size_t)b + 1)) {
+			std::cout << "Success, got slots " << a << ", " << b << " and " << c << " for " << q.getSource() << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, got slots " << a << ", " << b << " and " << c << " for " << q.getSource() << std::endl;
+		}
+		for (int mode = 0; !error && (mode < 2); ++mode) {
+			q.useBytecode(mode == 1);
+			bool		ok = q.setVariable(a, 1.5) && q.setVariable(b, 3) &&
+						  q.setVariable(c, lkit::value(0.5));
+			lkit::value	one = q.eval();
+			int			slots[] = { a, b, c };
+			double		vals[] = { 2.0, 4.0, 1.0 };
+			ok = ok && q.setVariables(slots, vals, 3);
+			lkit::value	two = q.eval();
+			if (ok && (one == lkit::value(8.0)) && (two == lkit::value(11.0)) &&
+				!q.setVariable(7, 1.0) && !q.setVariable(-1, 1.0)) {
+				std::cout << "Success, set the variables by slot for " << q.getSource() << (mode == 1 ? " as bytecode" : "") << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR, setting the variables by slot for " << q.getSource() << " got " << one << " and " << two << std::endl;
+			}
+		}
+		if (!error) {
+			// the slot stays with the name, even when it's removed
+			std::string		name = "b";
+			q.removeVariable(name);
+			bool	gone = ((q.getVariableSlot("b") == -1) && !q.setVariable(b, 1.0));
+			q.addVariable("b", lkit::value(1));
+			if (gone && (q.getVariableSlot("b") == b) && q.setVariable(b, 5.0)) {
+				std::cout << "Success, slot " << b << " stayed with 'b' after it was removed" << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR, slot " << b << " didn't stay with 'b' - it's now " << q.getVariableSlot("b") << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * The program of the final expression can be run with a context,
+	 * and the context's values for the variables don't touch the ones
+	 * in the parser.
+	 */
+	if (!error) {
+		lkit::parser	q;
+		q.setSource("(+ a 1) (* a b)");
+		q.addVariable("a", lkit::value(2));
+		q.addVariable("b", lkit::value(3));
+		const lkit::program	*prog = q.getProgram();
+		if (prog == NULL) {
+			error = true;
+			std::cout << "ERROR, unable to get the program for " << q.getSource() << std::endl;
+		} else {
+			lkit::context	ctx(*prog);
+			ctx.set(prog->getSlot("a"), 5);
+			lkit::value		ans = prog->eval(ctx);
+			if ((ans == lkit::value(15)) && (q.eval() == lkit::value(6))) {
+				std::cout << "Success, ran " << *prog << " with " << ctx << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR, " << *prog << " got " << ans << " with " << ctx << " and the parser got " << q.eval() << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * With the compile cache, setting a source we've seen before has to
+	 * skip the compile, but still give the same answers - including the
+	 * variables that the source sets.
+	 */
+	if (!error) {
+		lkit::parser	q;
+		q.useCompileCache(3);
+		const char	*srcs[] = { "(+ x 1)", "(set x 5) (* x 2)", "(+ x 1)",
+								"(* x 2)", "(set x 5) (* x 2)", "(+ x 1)" };
+		int			refs[] = { 1, 10, 6, 10, 10, 6 };
+		q.addVariable("x", lkit::value(0));
+		for (int i = 0; !error && (i < 6); ++i) {
+			// change 'x' so we know the 'set' is done on a hit as well
+			if (i == 3) {
+				q.addVariable("x", lkit::value(5));
+			} else if (i == 4) {
+				q.addVariable("x", lkit::value(-1));
+			}
+			std::string		src = srcs[i];
+			q.setSource(src);
+			if (q.eval() != lkit::value(refs[i])) {
+				error = true;
+				std::cout << "ERROR, the compile cache got " << q.eval() << " for " << src << " but should be " << refs[i] << std::endl;
+			}
+		}
+		// the last three sources were all still in the cache
+		if (!error && (q.getCacheHits() == 3) && (q.getCacheMisses() == 3)) {
+			std::cout << "Success, the compile cache got " << q.getCacheHits() << " hits and " << q.getCacheMisses() << " misses" << std::endl;
+		} else if (!error) {
+			error = true;
+			std::cout << "ERROR, the compile cache got " << q.getCacheHits() << " hits and " << q.getCacheMisses() << " misses - not 3 and 3" << std::endl;
+		}
+		// ...and with room for just one, the oldest has to go
+		q.useCompileCache(1);
+		q.setSource("(* x 2)");
+		q.setSource("(+ x 1)");
+		if (!error && (q.getCacheHits() == 4) && (q.getCacheMisses() == 4) &&
+			(q.eval() == lkit::value(6))) {
+			std::cout << "Success, the compile cache dropped the oldest source" << std::endl;
+		} else if (!error) {
+			error = true;
+			std::cout << "ERROR, the compile cache got " << q.getCacheHits() << " hits and " << q.getCacheMisses() << " misses - not 4 and 4" << std::endl;
+		}
+	}
+
+	/**
+	 * The lexer has to split the tokens on the parens as well as the
+	 * whitespace, keep a quoted timestamp - spaces and all - as one
+	 * constant, and get the numbers just as atoi() and atof() would.
+	 */
+	if (!error) {
+		const char		*srcs[] = {
+			"(+(* 2 3)\n\t(- 5 1))",
+			"(- '2012-03-21 11:45:16.25' '2012-03-21')",
+			"(+ -3 +4 12)",
+			"(+ 1.5e1 -2.5 .25)",
+		};
+		lkit::value		refs[] = {
+			lkit::value(10),
+			lkit::value((uint64_t)(42316LL * 1000000LL + 250000LL)),
+			lkit::value(13),
+			lkit::value(12.75),
+		};
+		lkit::parser	q;
+		for (int i = 0; !error && (i < 4); ++i) {
+			q.setSource(srcs[i]);
+			if (q.eval() == refs[i]) {
+				std::cout << "Success, parsed " << srcs[i] << " into: " << refs[i] << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR, unable to parse " << srcs[i] << " into: " << refs[i] << " ... got: " << q.eval() << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * The same sub-expression - in one expression, or another - has to
+	 * be done just once for each evaluation, but the same function on
+	 * constants of different types is not the same.
+	 */
+	if (!error) {
+		std::string		src = "(* (div x y) 2) (+ (div x y) (div x 2) (div x 2.0) (- (div x y) 1))";
+		lkit::parser	q;
+		counted_quot	*div = new counted_quot();
+		q.addFunction("div", div);
+		q.addVariable("x", lkit::value(6.0));
+		q.addVariable("y", lkit::value(3.0));
+		q.setSource(src);
+		lkit::value		a = q.eval();
+		int				first = div->calls;
+		q.addVariable("x", lkit::value(9.0));
+		lkit::value		b = q.eval();
+		if ((a == lkit::value(9.0)) && (b == lkit::value(14.0)) && (first == 3) && (div->calls == 6)) {
+			std::cout << "Success, " << src << " did " << first << " divisions for each evaluation" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, " << src << " got " << a << " and " << b << " with " << first << " and " << div->calls << " divisions" << std::endl;
+		}
+	}
+
+	/**
+	 * The 'and', 'or' and 'if' only do the arguments they need - walking
+	 * the tree, or running the bytecode - so with 'x' zero, none of the
+	 * divisions are needed, and with it two, each different one is done
+	 * once - as the two '(div 10 x)' are shared in the tree, but the
+	 * bytecode doesn't cache, so it does that one for each use.
+	 */
+	if (!error) {
+		std::string		src = "(and (!= x 0) (> (div 10 x) 1)) (or (== x 0) (< (div 10 x) 5)) "
+							  "(if (== x 0) 0 (div 10.0 x)) (cond (< x 0) (div -1 x) (== x 0) 0 (div 1 x))";
+		lkit::parser	q;
+		counted_quot	*div = new counted_quot();
+		q.addFunction("div", div);
+		for (int mode = 0; !error && (mode < 2); ++mode) {
+			q.useBytecode(mode == 1);
+			q.addVariable("x", lkit::value(0));
+			q.setSource(src);
+			div->calls = 0;
+			lkit::value		a = q.eval();
+			int				none = div->calls;
+			q.addVariable("x", lkit::value(2));
+			lkit::value		b = q.eval();
+			if ((a == lkit::value(0)) && (b == lkit::value(0)) && (none == 0) && (div->calls == (mode == 1 ? 4 : 3))) {
+				std::cout << "Success, " << src << " did only the " << div->calls << " divisions it needed" << (mode == 1 ? " in bytecode" : "") << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR, " << src << " got " << a << " and " << b << " with " << none << " and " << div->calls << " divisions" << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * On a pool of threads, the top-level expressions - and the variable
+	 * the source sets, and the two big arguments of the '-' - are all done
+	 * at once, but the answers have to be the same as when they are done
+	 * one after the other, and the variable that they all use has to be
+	 * done just once - walking the tree, or running the bytecode.
+	 */
+	if (!error) {
+		std::ostringstream	src;
+		src << "(set big (+";
+		for (int i = 1; i <= 12; ++i) {
+			src << " (* x " << i << ")";
+		}
+		src << " (div x 4)))";
+		for (int i = 0; i < 40; ++i) {
+			src << " (+ big (* x " << i << "))";
+		}
+		src << " (- (+";
+		for (int i = 1; i <= 12; ++i) {
+			src << " (* y " << i << " x)";
+		}
+		src << ") (+";
+		for (int i = 1; i <= 12; ++i) {
+			src << " (* x " << i << " y)";
+		}
+		src << " big))";
+		for (int mode = 0; !error && (mode < 2); ++mode) {
+			lkit::parser	q, ref;
+			counted_quot	*div = new counted_quot();
+			q.addFunction("div", div);
+			ref.addFunction("div", new counted_quot());
+			q.useBytecode(mode == 1);
+			q.useThreads(4);
+			q.setSource(src.str());
+			ref.setSource(src.str());
+			for (int pass = 0; !error && (pass < 3); ++pass) {
+				q.addVariable("x", lkit::value(3.0 + pass));
+				q.addVariable("y", lkit::value(2 * pass));
+				ref.addVariable("x", lkit::value(3.0 + pass));
+				ref.addVariable("y", lkit::value(2 * pass));
+				div->calls = 0;
+				std::vector<lkit::value>	got, want;
+				bool	ok = q.evalAll(got);
+				int		calls = div->calls;
+				ref.evalAll(want);
+				if (ok && (got.size() == 41) && (got == want) && (calls == 1) &&
+					(q.eval() == want.back())) {
+					std::cout << "Success, " << got.size() << " expressions on " << q.getThreadCount()
+							  << " threads match the serial answers for pass " << pass
+							  << (mode == 1 ? " in bytecode" : "") << std::endl;
+				} else {
+					error = true;
+					std::cout << "ERROR, " << got.size() << " expressions on " << q.getThreadCount()
+							  << " threads got " << (got.empty() ? lkit::value() : got.back()) << " but should be "
+							  << (want.empty() ? lkit::value() : want.back()) << " with " << calls
+							  << " divisions for pass " << pass << (mode == 1 ? " in bytecode" : "") << std::endl;
+				}
+			}
+#ifndef LKIT_SINGLE_THREADED
+			if (!error && (q.getThreadCount() != 4)) {
+				error = true;
+				std::cout << "ERROR, the parser has " << q.getThreadCount() << " threads, and not 4" << std::endl;
+			}
+#endif
+		}
+	}
+
+	/**
+	 * The fixed functions the parser puts in for the sums, comparisons and
+	 * logic of two values - and the 'not' of one - have to give exactly
+	 * the answers the general ones do, for ints, doubles, the mix of the
+	 * two, bools and undefined values alike - and as the variables change
+	 * what kind of values they are.
+	 */
+	if (!error) {
+		std::string	src = "(+ i j) (- d e) (* i d) (+ d i) (- u i) (* i u)"
+						  " (< i j) (>= d e) (== i 3) (!= d i) (<= e d) (> i d)"
+						  " (< u i) (== u u) (> b i)"
+						  " (and b (< i j)) (or (> i j) b) (and u b) (or u (> i 9))"
+						  " (not b) (not (> i j)) (not u) (not i)";
+		lkit::parser	q, ref;
+		ref.useFastPaths(false);
+		bool	deflt = q.usingFastPaths();
+		q.setSource(src);
+		ref.setSource(src);
+		for (int pass = 0; !error && (pass < 3); ++pass) {
+			lkit::parser	*both[] = { &q, &ref };
+			for (int k = 0; k < 2; ++k) {
+				both[k]->addVariable("i", (pass == 1 ? lkit::value(7.5) : lkit::value(3)));
+				both[k]->addVariable("j", lkit::value(4));
+				both[k]->addVariable("d", lkit::value(2.5));
+				both[k]->addVariable("e", (pass == 2 ? lkit::value(1) : lkit::value(2.5)));
+				both[k]->addVariable("b", lkit::value(pass != 1));
+				both[k]->addVariable("u", (pass == 2 ? lkit::value(9) : lkit::value()));
+			}
+			std::vector<lkit::value>	got, want;
+			q.evalAll(got);
+			ref.evalAll(want);
+			size_t	bad = 0;
+			for (size_t n = 0; n < got.size(); ++n) {
+				if ((n >= want.size()) || (got[n] != want[n])) {
+					std::cout << "ERROR, expression " << n << " got " << got[n] << " but should be "
+							  << (n < want.size() ? want[n] : lkit::value()) << " for pass " << pass << std::endl;
+					++bad;
+				}
+			}
+			if (deflt && !ref.usingFastPaths() && (got.size() == 23) && (want.size() == 23) && (bad == 0)) {
+				std::cout << "Success, the " << got.size() << " expressions with fixed functions match the general ones for pass " << pass << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR, the " << got.size() << " expressions with fixed functions don't match the "
+						  << want.size() << " general ones for pass " << pass << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * The callbacks of the subscriptions have to be called only when the
+	 * value really changes - once for all the changes of setVariables() -
+	 * follow the source to the new expressions, and stop when they are
+	 * dropped.
+	 */
+	if (!error) {
+		lkit::parser	q;
+		change_log		log;
+		q.addVariable("x", lkit::value(5));
+		q.addVariable("y", lkit::value(2));
+		q.setSource("(> x 10) (* y 2)");
+		int		alert = q.subscribeExpr(0, boost::ref(log));
+		int		twice = q.subscribeExpr(1, boost::ref(log));
+		int		xs = q.subscribeVariable("x", boost::ref(log));
+		int		zs = q.subscribeVariable("z", boost::ref(log));
+		q.addVariable("x", lkit::value(7));
+		q.addVariable("x", lkit::value(12));
+		int		slots[] = { q.getVariableSlot("x"), q.getVariableSlot("y") };
+		double	vals[] = { 12.0, 3.0 };
+		q.setVariable(slots[1], 2);
+		q.setVariables(slots, vals, 2);
+		q.setSource("(< x 0) (* y 3) (+ z 1)");
+		size_t	src = q.notify();
+		q.unsubscribe(xs);
+		q.addVariable("x", lkit::value(-1));
+		q.addVariable("z", lkit::value(1));
+		change_log		want;
+		want(xs, lkit::value(5), lkit::value(7));
+		want(alert, lkit::value(false), lkit::value(true));
+		want(xs, lkit::value(7), lkit::value(12));
+		want(twice, lkit::value(4), lkit::value(6.0));
+		want(xs, lkit::value(12), lkit::value(12.0));
+		want(alert, lkit::value(true), lkit::value(false));
+		want(twice, lkit::value(6.0), lkit::value(9.0));
+		want(alert, lkit::value(false), lkit::value(true));
+		want(zs, lkit::value(), lkit::value(1));
+		if ((log.str() == want.str()) && (src == 2) && (q.notify() == 0)) {
+			std::cout << "Success, the subscriptions saw just the changes: " << log.str() << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, the subscriptions saw: " << log.str() << " (" << src << " for the source) but should have seen: " << want.str() << std::endl;
+		}
+	}
+
+	/**
+	 * A source that can't be compiled is the caller's to find, so setting
+	 * a variable mustn't throw for it - the subscriptions to expressions
+	 * just wait until it's fixed, and the caller's notify().
+	 */
+	if (!error) {
+		lkit::parser	q;
+		change_log		log;
+		q.addVariable("x", lkit::value(5));
+		q.setSource("(> x 10)");
+		int		alert = q.subscribeExpr(0, boost::ref(log));
+		q.setSource("(bogus x 10)");
+		bool	set = false;
+		try {
+			set = q.addVariable("x", lkit::value(20)) && q.setVariable(q.getVariableSlot("x"), 30);
+		} catch (std::exception & e) {
+			std::cout << "ERROR, setting the variable threw: " << e.what() << std::endl;
+		}
+		bool	quiet = log.str().empty();
+		q.setSource("(> x 10)");
+		size_t	src = q.notify();
+		change_log		want;
+		want(alert, lkit::value(false), lkit::value(true));
+		if (set && quiet && (src == 1) && (log.str() == want.str())) {
+			std::cout << "Success, the variables can be set with a source that doesn't compile" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, with a source that doesn't compile, the subscriptions saw: " << log.str() << std::endl;
+		}
+	}
+
+	/**
+	 * The image of a compiled source has to rebuild the same trees in
+	 * another parser - the variables it sets, and the ones it uses, by
+	 * name - from a string, or a file, and be refused if it's cut short
+	 * or needs a function that's not there.
+	 */
+	if (!error) {
+		std::string		src = "(set r (* 2 3)) (- (+ (* x r) (plus y '11:45:16')) (max x 2.5))";
+		lkit::parser	q;
+		q.addFunction("plus", new lkit::func::sum());
+		q.setSource(src);
+		std::string		image = q.getImage();
+		lkit::parser	r;
+		r.addFunction("plus", new lkit::func::sum());
+		lkit::parser	s;
+		s.addFunction("plus", new lkit::func::sum());
+		s.useBytecode();
+		if (image.empty() || !r.setImage(image) || !q.saveImage("/tmp/lkit_parser.img") ||
+			!s.loadImage("/tmp/lkit_parser.img") || (r.getSource() != src)) {
+			error = true;
+			std::cout << "ERROR, couldn't set the image of " << src << " (" << image.size() << " bytes)" << std::endl;
+		}
+		for (int i = 0; !error && (i < 4); ++i) {
+			lkit::value		x(i * 1.5);
+			lkit::value		y((uint64_t)(i * 7));
+			q.addVariable("x", x);
+			q.addVariable("y", y);
+			r.addVariable("x", x);
+			r.addVariable("y", y);
+			s.addVariable("x", x);
+			s.addVariable("y", y);
+			lkit::value		ref = q.eval();
+			if ((r.eval() != ref) || (s.eval() != ref) || (*r.getVariable("r") != lkit::value(6))) {
+				error = true;
+				std::cout << "ERROR, the image of " << src << " got " << r.eval() << " and " << s.eval() << " ... not " << ref << std::endl;
+			}
+		}
+		if (!error) {
+			std::cout << "Success, the " << image.size() << " byte image of " << src << " gives the same answers" << std::endl;
+		}
+		lkit::parser	t;
+		if (!error && (t.setImage(image.substr(0, image.size() - 3)) || t.setImage(image))) {
+			error = true;
+			std::cout << "ERROR, took an image that was cut short, or had a missing function" << std::endl;
+		} else if (!error) {
+			t.addFunction("plus", new lkit::func::sum());
+			t.addVariable("x", lkit::value(1.0));
+			t.addVariable("y", lkit::value((uint64_t)0));
+			q.addVariable("x", lkit::value(1.0));
+			q.addVariable("y", lkit::value((uint64_t)0));
+			if (t.eval() == q.eval()) {
+				std::cout << "Success, a bad image is refused, and the source compiled instead" << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR, after a bad image got " << t.eval() << " ... not " << q.eval() << std::endl;
+			}
+		}
+		// a count that's more than the rest of the image could hold is refused before it's used
+		if (!error) {
+			uint32_t		huge = 0x7f000000;
+			std::string		bad = image;
+			memcpy(&bad[nodeCountAt(image)], &huge, sizeof(huge));
+			std::string		names = image;
+			memcpy(&names[4 * sizeof(uint32_t) + src.size()], &huge, sizeof(huge));
+			lkit::parser	u;
+			u.addFunction("plus", new lkit::func::sum());
+			bool			took = true;
+			try {
+				took = (u.setImage(bad) || u.setImage(names));
+			} catch (std::exception & e) {
+				std::cout << "ERROR, a bad count in an image threw: " << e.what() << std::endl;
+			}
+			if (!took) {
+				std::cout << "Success, an image with a count that's too big for it is refused" << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR, took an image with a count that's too big for it" << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * When profiling, each expression has to have the count of it's
+	 * evaluations, and point back to the source it came from - and the
+	 * cached ones have to be counted, but not recalculated. Without it,
+	 * there's no profile at all.
+	 */
+	if (!error) {
+		lkit::parser	q;
+		q.addVariable("x", lkit::value(1));
+		q.addVariable("y", lkit::value(2));
+		std::string		src = "(+ (* x 3) (- y 1))";
+		q.setSource(src);
+		for (int i = 0; i < 10; ++i) {
+			if (i % 2 == 0) {
+				q.addVariable("x", lkit::value(i));
+			}
+			q.eval();
+		}
+		std::string		prof = q.getProfile();
+#ifdef LKIT_PROFILE
+		// x changes every other time, and (- y 1) is only done once
+		std::string		root = ",10,5,0,19,\"" + src + "\"";
+		std::string		once = ",5,1,11,18,\"(- y 1)\"";
+		if ((prof.find("nsec,self_nsec,calls,recalcs,begin,end,source\n") == 0) &&
+			(prof.find(root) != std::string::npos) &&
+			(prof.find(once) != std::string::npos) &&
+			(prof.find("(* x 3)") != std::string::npos)) {
+			std::cout << "Success, the profile of " << src << " is:" << std::endl << prof;
+		} else {
+			error = true;
+			std::cout << "ERROR, the profile of " << src << " is wrong:" << std::endl << prof;
+		}
+		q.resetProfile();
+		if (!error && (q.getProfile().find(",0,0,0,0,") != std::string::npos)) {
+			std::cout << "Success, the profile can be reset" << std::endl;
+		} else if (!error) {
+			error = true;
+			std::cout << "ERROR, the profile wasn't reset:" << std::endl << q.getProfile();
+		}
+#else
+		if (prof.empty()) {
+			std::cout << "Success, there's no profile without LKIT_PROFILE" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, there's a profile without LKIT_PROFILE:" << std::endl << prof;
+		}
+#endif
+	}
+
+	/**
+	 * The memory usage has to count what's in the trees, and what the
+	 * parser holds for them, and it all has to add up - and grow with
+	 * the source, and drop back when it's cleared.
+	 */
+	if (!error) {
+		lkit::parser	q;
+		q.addVariable("x", lkit::value(1));
+		q.addVariable("y", lkit::value(2));
+		q.setSource("(+ (* x 3) (- y 1))");
+		q.eval();
+		std::string		use = q.getMemoryUsage();
+		const char		*kinds[] = { "parser", "expressions", "subexpressions", "constants",
+									 "variables", "functions", "cache", "tables" };
+		long			bytes = 0;
+		long			over = 0;
+		for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); ++i) {
+			bytes += usageOf(use, kinds[i], 1);
+			over += usageOf(use, kinds[i], 2);
+		}
+		if ((use.find("kind,count,bytes,overhead\n") == 0) &&
+			(usageOf(use, "expressions", 0) == 1) && (usageOf(use, "subexpressions", 0) == 2) &&
+			(usageOf(use, "constants", 0) == 2) && (usageOf(use, "variables", 0) == 4) &&
+			(usageOf(use, "functions", 0) == 0) && (usageOf(use, "registry", 0) == 22) &&
+			(usageOf(use, "total", 1) == bytes) &&
+			(usageOf(use, "total", 2) == over + usageOf(use, "arena", 2)) &&
+			(usageOf(use, "subexpressions", 2) > 0)) {
+			std::cout << "Success, the memory usage all adds up:" << std::endl << use;
+		} else {
+			error = true;
+			std::cout << "ERROR, the memory usage is wrong:" << std::endl << use;
+		}
+		long			before = usageOf(use, "subexpressions", 1);
+		q.setSource("(+ (* x 3) (- y 1) (/ x y) (max x y 10))");
+		q.eval();
+		long			after = usageOf(q.getMemoryUsage(), "subexpressions", 1);
+		q.clear();
+		std::string		none = q.getMemoryUsage();
+		if (!error && (after > before) && (usageOf(none, "expressions", 0) == 0) &&
+			(usageOf(none, "subexpressions", 0) == 0) && (usageOf(none, "variables", 0) == 0) &&
+			(usageOf(none, "functions", 0) == 0) && (usageOf(none, "total", 0) == 1)) {
+			std::cout << "Success, the memory usage grows with the source, and drops when it's cleared" << std::endl;
+		} else if (!error) {
+			error = true;
+			std::cout << "ERROR, the memory usage went from " << before << " to " << after << " to:" << std::endl << none;
+		}
+	}
+
+	/**
+	 * The default functions are in one registry that all the parsers
+	 * share, and a parser's own functions - and the ones it removes -
+	 * are put over it, so that no other parser sees them.
+	 */
+	if (!error) {
+		lkit::parser				a;
+		lkit::parser				b;
+		lkit::parser				c(a);
+		std::vector<lkit::value>	ra;
+		std::vector<lkit::value>	rb;
+		a.addFunction("max", new lkit::func::min());
+		bool	removed = a.removeFunction("+") && !a.removeFunction("+") && !a.removeFunction("nope");
+		a.setSource("(max 1 2)");
+		b.setSource("(max 1 2)");
+		bool	ok = a.evalAll(ra) && b.evalAll(rb);
+		a.setSource("(+ 1 2)");
+		b.setSource("(+ 1 2)");
+		bool	gone = !compiles(a);
+		fcn_map_t	fa = a.getFunctions();
+		fcn_map_t	fb = b.getFunctions();
+		if ((a.getRegistry() == lkit::registry::getDefaults()) && (b.getRegistry() == a.getRegistry()) &&
+			(c.getRegistry() == a.getRegistry()) && ok && removed && gone &&
+			(ra[0] == 1) && (rb[0] == 2) && (b.eval() == 3) &&
+			(fa.size() == 21) && (fb.size() == 22) && (fa.find("+") == fa.end()) &&
+			(fa["max"] != fb["max"]) && (fb["max"] == lkit::registry::getDefaults()->lookUp("max"))) {
+			std::cout << "Success, the parsers share the default functions, and have their own over them" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, the parsers didn't keep their own functions to themselves - "
+					  << fa.size() << " and " << fb.size() << " functions" << std::endl;
+		}
+	}
+
+	/**
+	 * A registry of our own can be shared just like the defaults, and
+	 * it's freed when the last parser using it lets it go.
+	 */
+	if (!error) {
+		fcn_map_t				mine;
+		mine["twice"] = new lkit::func::sum();
+		lkit::registry::ptr_t	reg(new lkit::registry(mine));
+		lkit::parser			d;
+		lkit::parser			e;
+		d.useRegistry(reg);
+		e.useRegistry(reg);
+		d.setSource("(twice 2 2)");
+		e.setSource("(+ 2 2)");
+		bool	ok = (d.eval() == 4) && !compiles(e) && (reg.use_count() == 3);
+		d.reset();
+		e.clearFunctions();
+		if (ok && (reg.use_count() == 1) && (d.getRegistry() == lkit::registry::getDefaults()) &&
+			!e.getRegistry() && e.getFunctions().empty() && (reg->size() == 1)) {
+			std::cout << "Success, a registry of our own is shared, and let go of" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, a registry of our own wasn't shared - it has " << reg.use_count() << " users" << std::endl;
+		}
+	}
+
 	std::cout << (error ? "FAILED!" : "SUCCESS") << std::endl;
 	return (error ? 1 : 0);
 }
@@ -0,0 +1,94 @@
+/**
+ * This is the test of the pool of threads that the parser uses
+ */
+//	System Headers
+#include <stdexcept>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+#include <boost/bind/bind.hpp>
+
+//	Other Headers
+#include "util/pool.h"
+
+/**
+ * Each task just counts how many times it's been run in it's own slot,
+ * so that there's no need for any locking - and one that's told to can
+ * throw, as if the evaluation had failed.
+ */
+static void bump( std::vector<int> *aCounts, size_t anIndex, bool aThrow )
+{
+	++(*aCounts)[anIndex];
+	if (aThrow) {
+		throw std::runtime_error("[bump] told to throw");
+	}
+}
+
+
+int main(int argc, char *argv[]) {
+	bool	error = false;
+
+	using namespace lkit::util;
+	/**
+	 * Every task in a batch has to be run exactly once - batch after
+	 * batch on the same threads - and run() can't return until they
+	 * are all done.
+	 */
+	if (!error) {
+		pool	p(3);
+		std::vector<int>				cnt(1000, 0);
+		std::vector<pool::task_t>		tasks;
+		for (size_t i = 0; i < cnt.size(); ++i) {
+			tasks.push_back(boost::bind(&bump, &cnt, i, false));
+		}
+		bool	ok = true;
+		for (int b = 0; b < 50; ++b) {
+			if (!p.run(tasks)) {
+				ok = false;
+			}
+		}
+		size_t	wrong = 0;
+		for (size_t i = 0; i < cnt.size(); ++i) {
+			if (cnt[i] != 50) {
+				++wrong;
+			}
+		}
+		if (ok && (wrong == 0)) {
+			std::cout << "Success, " << p.getThreadCount() << " threads ran 50 batches of " << cnt.size() << " tasks" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, " << wrong << " of the tasks weren't run exactly 50 times" << std::endl;
+		}
+	}
+
+	/**
+	 * A task that throws doesn't stop the rest of the batch, but run()
+	 * has to say that it happened - and an empty batch is just fine.
+	 */
+	if (!error) {
+		pool	p(2);
+		std::vector<int>				cnt(20, 0);
+		std::vector<pool::task_t>		tasks;
+		for (size_t i = 0; i < cnt.size(); ++i) {
+			tasks.push_back(boost::bind(&bump, &cnt, i, (i == 7)));
+		}
+		bool	failed = !p.run(tasks);
+		size_t	done = 0;
+		for (size_t i = 0; i < cnt.size(); ++i) {
+			done += cnt[i];
+		}
+		std::vector<pool::task_t>		none;
+		if (failed && (done == cnt.size()) && p.run(none) && p.run(std::vector<pool::task_t>(1, tasks[0]))) {
+			std::cout << "Success, the failed task was reported, and the rest were still run" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, the batch with a failed task " << (failed ? "was" : "wasn't")
+					  << " reported, and " << done << " of " << cnt.size() << " were run" << std::endl;
+		}
+	}
+
+	std::cout << (error ? "FAILED!" : "SUCCESS") << std::endl;
+	return (error ? 1 : 0);
+}
@@ -0,0 +1,437 @@
+/**
+ * This is the test of the program class
+ */
+//	System Headers
+#include <iostream>
+#include <string>
+
+//	Third-Party Headers
+#include <boost/thread.hpp>
+
+//	Other Headers
+#include "value.h"
+#include "variable.h"
+#include "base_functions.h"
+#include "expression.h"
+#include "program.h"
+#include "context.h"
+#include "kernels.h"
+
+/**
+ * This is a simple function that sums its arguments, but counts the
+ * number of times it's been called. It's not one of the built-ins, so
+ * the program has to call it.
+ */
+class counted_sum :
+	public lkit::func::sum
+{
+	public:
+		counted_sum() : calls(0) { };
+		virtual lkit::value eval( std::vector<lkit::value *> & anArg,
+								  std::vector<lkit::value> & aScratch )
+		{
+			++calls;
+			return lkit::func::sum::eval(anArg, aScratch);
+		}
+		int		calls;
+};
+
+/**
+ * This is a worker that runs a shared program with it's own context,
+ * setting the variable in it's slot to a different value each time,
+ * and checking that it gets the right answer - (+ (* x 2) y 1) - for
+ * every one of them.
+ */
+struct worker
+{
+	worker( const lkit::program *aProgram, int aSlot, int aSeed ) :
+		prog(aProgram), slot(aSlot), seed(aSeed), failed(false) { };
+	void operator()()
+	{
+		lkit::context	ctx(*prog);
+		for (int i = 0; !failed && (i < 20000); ++i) {
+			int		x = seed * 100000 + i;
+			ctx.set(slot, x);
+			if (prog->eval(ctx) != lkit::value(2 * x + 3 + 1)) {
+				failed = true;
+			}
+		}
+	}
+	const lkit::program		*prog;
+	int						slot;
+	int						seed;
+	bool					failed;
+};
+
+
+int main(int argc, char *argv[]) {
+	bool	error = false;
+
+	/**
+	 * A program has to give the same answer as the tree it's compiled
+	 * from - and pick up the changes in the values it references.
+	 */
+	if (!error) {
+		lkit::value		a, b, c, d;
+		a = 10;
+		b = 2.5;
+		c = 3;
+		d = 7;
+		lkit::func::sum		sum;
+		lkit::func::prod	prod;
+		lkit::func::max		max;
+		lkit::func::diff	diff;
+		lkit::expression	inner(&prod, &b, &c);
+		lkit::expression	most(&max, &c, &d);
+		lkit::expression	neg(&diff, &a);
+		lkit::expression	root(&sum, &a, &inner, &most, &neg);
+		lkit::program		p(&root);
+		if (p.eval() == root.eval()) {
+			std::cout << "Success - " << p << " matches " << root << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << p << " got " << p.eval() << " but " << root << " is " << root.eval() << std::endl;
+		}
+		a = 4;
+		d = 1;
+		if (p.eval() == root.eval()) {
+			std::cout << "Success - " << p << " picks up changes in the values" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << p << " got " << p.eval() << " but " << root << " is " << root.eval() << std::endl;
+		}
+	}
+
+	/**
+	 * The comparisons and logical functions have their own instructions
+	 * and they have to work just like the functions do.
+	 */
+	if (!error) {
+		lkit::value		one(1), two(2), three(3);
+		lkit::value		t(true), f(false);
+		lkit::func::comp	lt(lkit::func::comp::eLessThan);
+		lkit::func::comp	eq(lkit::func::comp::eEquals);
+		lkit::func::bin		land(lkit::func::bin::eAnd);
+		lkit::func::bin		lnot(lkit::func::bin::eNot);
+		lkit::expression	inc(&lt, &one, &two, &three);
+		lkit::expression	dec(&lt, &one, &three, &two);
+		lkit::expression	same(&eq, &two, &two);
+		lkit::expression	notf(&lnot, &f);
+		lkit::expression	all(&land, &inc, &same, &notf, &t);
+		lkit::expression	some(&land, &inc, &dec);
+		lkit::expression	*list[] = { &inc, &dec, &same, &notf, &all, &some };
+		for (int i = 0; !error && (i < 6); ++i) {
+			lkit::program	p(list[i]);
+			if (p.eval() == list[i]->eval()) {
+				std::cout << "Success - " << p << " matches " << *list[i] << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR - " << p << " got " << p.eval() << " but " << *list[i] << " is " << list[i]->eval() << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * Any other function - even a subclass of a built-in - has to be
+	 * called by the program on the values on the stack.
+	 */
+	if (!error) {
+		lkit::value		a(1), b(2), c(3);
+		lkit::variable	x("x", 4);
+		counted_sum			f;
+		lkit::func::prod	prod;
+		lkit::expression	inner(&f, &a, &b, &x);
+		lkit::expression	root(&prod, &inner, &c);
+		lkit::program		p(&root);
+		if ((p.eval() == lkit::value(21)) && (f.calls == 1) &&
+			(p.getCode().size() == 6) &&
+			(p.getCode()[3].op == lkit::program::eCall)) {
+			std::cout << "Success - " << p << " calls the user-defined function" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << p << " got " << p.eval() << " after " << f.calls << " calls" << std::endl;
+		}
+		x = 10;
+		if (p.eval() == lkit::value(39)) {
+			std::cout << "Success - " << p << " picks up the change in the variable" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << p << " missed the change in the variable: " << p.eval() << std::endl;
+		}
+	}
+
+	/**
+	 * A comparison stops at the first pair that fails, just as the comp
+	 * does, so what's after it isn't evaluated.
+	 */
+	if (!error) {
+		lkit::value		zero(0), two(2);
+		lkit::variable	x("x", 1), y("y", 1);
+		counted_sum			f;
+		lkit::func::comp	lt(lkit::func::comp::eLessThan);
+		lkit::expression	inner(&f, &y, &two);
+		lkit::expression	root(&lt, &x, &two, &inner, &zero);
+		lkit::program		p(&root);
+		bool	first = ((p.eval() == lkit::value(false)) && (f.calls == 1));
+		x = 5;
+		for (int i = 0; i < 10; ++i) {
+			first = first && (p.eval() == root.eval());
+		}
+		if (first && (f.calls == 1)) {
+			std::cout << "Success - " << p << " stops at the first pair that fails" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << p << " got " << p.eval() << " after " << f.calls << " calls" << std::endl;
+		}
+	}
+
+	/**
+	 * A batch of rows from columns of data has to give the same answers
+	 * as setting the variables and evaluating the program for each row,
+	 * and that has to hold across the blocks of rows as well.
+	 */
+	if (!error) {
+		const size_t	rows = 600;
+		double			xs[rows];
+		int				ys[rows];
+		for (size_t r = 0; r < rows; ++r) {
+			xs[r] = 0.5 * r;
+			ys[r] = (int)(r % 7) - 3;
+		}
+		lkit::variable		x("x"), y("y"), z("z", 10);
+		lkit::value			two(2);
+		lkit::func::prod	prod;
+		lkit::func::sum		sum;
+		lkit::func::max		max;
+		lkit::func::comp	gt(lkit::func::comp::eGreaterThan);
+		lkit::expression	dbl(&prod, &x, &two);
+		lkit::expression	most(&max, &y, &two);
+		lkit::expression	root(&sum, &dbl, &most, &z);
+		lkit::expression	test(&gt, &root, &z);
+		lkit::program::column_map_t		cols;
+		lkit::program::column	xc = { lkit::value::eDouble, xs };
+		lkit::program::column	yc = { lkit::value::eInt, ys };
+		cols[&x] = xc;
+		cols[&y] = yc;
+		/**
+		 * ...and these make sure that each of the vector kernels, and
+		 * the type conversions they do, match the values.
+		 */
+		lkit::value			half(0.5), three(3);
+		lkit::func::diff	diff;
+		lkit::func::quot	quot;
+		lkit::func::min		min;
+		lkit::func::comp	lte(lkit::func::comp::eLessOrEqual);
+		lkit::func::comp	ne(lkit::func::comp::eNotEquals);
+		lkit::func::bin		land(lkit::func::bin::eAnd);
+		lkit::func::bin		lor(lkit::func::bin::eOr);
+		lkit::func::bin		lnot(lkit::func::bin::eNot);
+		lkit::expression	isum(&sum, &y, &x, &half);
+		lkit::expression	iprod(&prod, &y, &x);
+		lkit::expression	idiff(&diff, &y, &x, &three);
+		lkit::expression	neg(&diff, &x);
+		lkit::expression	dquot(&quot, &x, &three, &half);
+		lkit::expression	iquot(&quot, &z, &three);
+		lkit::expression	zquot(&quot, &x, &y);
+		lkit::expression	fewest(&min, &x, &dbl, &half);
+		lkit::expression	mixed(&max, &y, &x);
+		lkit::expression	chain(&lte, &y, &two, &three);
+		lkit::expression	diffs(&ne, &dbl, &x, &half);
+		lkit::expression	both(&land, &chain, &y, &x);
+		lkit::expression	either(&lor, &chain, &y);
+		lkit::expression	none(&lnot, &x);
+		/**
+		 * ...and the lazy ones have to give the same answers whether the
+		 * rows in a block all skip the same argument, or not.
+		 */
+		lkit::func::cond	branch;
+		lkit::expression	guard(&land, &y, &dquot, &chain);
+		lkit::expression	until(&lor, &y, &chain, &x);
+		lkit::expression	pick(&branch, &chain, &isum, &neg);
+		lkit::expression	cascade(&branch, &diffs, &iprod, &chain, &x, &half);
+		lkit::expression	always(&branch, &z, &dquot, &iquot);
+		lkit::expression	steps(&lte, &y, &x, &dbl, &fewest, &half);
+		lkit::expression	*list[] = { &root, &test, &isum, &iprod, &idiff,
+										&neg, &dquot, &iquot, &zquot, &fewest,
+										&mixed, &chain, &diffs, &both, &either,
+										&none, &guard, &until, &pick, &cascade,
+										&always, &steps };
+		std::cout << "Success - running batches with the " << lkit::kernels::isa() << " kernels" << std::endl;
+		for (int i = 0; !error && (i < 22); ++i) {
+			lkit::program		p(list[i]);
+			lkit::value			ans[rows];
+			if (!p.eval(rows, cols, ans)) {
+				error = true;
+				std::cout << "ERROR - " << p << " could not be run on the batch" << std::endl;
+				break;
+			}
+			for (size_t r = 0; r < rows; ++r) {
+				x = xs[r];
+				y = ys[r];
+				if (ans[r] != p.eval()) {
+					error = true;
+					std::cout << "ERROR - " << p << " got " << ans[r] << " for row " << r << " but should be " << p.eval() << std::endl;
+					break;
+				}
+			}
+			if (!error) {
+				std::cout << "Success - " << p << " matches row by row for " << rows << " rows" << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * A program can be shared by many threads, each with it's own
+	 * context holding the values of the variables, and each has to see
+	 * only it's own values - while the shared variables, and anyone
+	 * using the program without a context, don't see any of them.
+	 */
+	if (!error) {
+		lkit::variable		x("x", 1), y("y", 3);
+		lkit::value			one(1), two(2);
+		lkit::func::prod	prod;
+		lkit::func::sum		sum;
+		lkit::expression	dbl(&prod, &x, &two);
+		lkit::expression	root(&sum, &dbl, &y, &one);
+		lkit::program		p(&root);
+		int					slot = p.getSlot("x");
+		if ((p.getSlotCount() == 2) && (slot == 0) && (p.getSlot("y") == 1) &&
+			(p.getSlot("z") == -1)) {
+			std::cout << "Success - " << p << " has slots for it's 2 variables" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << p << " has " << p.getSlotCount() << " slots, and 'x' is in " << slot << std::endl;
+		}
+		if (!error) {
+			const int		cnt = 4;
+			worker			*w[cnt];
+			boost::thread	*t[cnt];
+			for (int i = 0; i < cnt; ++i) {
+				w[i] = new worker(&p, slot, i + 1);
+				t[i] = new boost::thread(boost::ref(*w[i]));
+			}
+			for (int i = 0; i < cnt; ++i) {
+				t[i]->join();
+				if (w[i]->failed) {
+					error = true;
+					std::cout << "ERROR - thread " << i << " got the wrong answer from " << p << std::endl;
+				}
+				delete t[i];
+				delete w[i];
+			}
+			if (!error) {
+				std::cout << "Success - " << cnt << " threads ran " << p << " at once, each with it's own context" << std::endl;
+			}
+		}
+		if (!error) {
+			if ((p.eval() == lkit::value(6)) && (x == lkit::value(1))) {
+				std::cout << "Success - " << p << " still uses the shared variables without a context" << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR - " << p << " got " << p.eval() << " with x=" << x << " after the threads" << std::endl;
+			}
+		}
+		if (!error) {
+			// unbound slots use the shared variables
+			lkit::context	ctx(p);
+			ctx.set(1, 10);
+			lkit::value		a = p.eval(ctx);
+			ctx.unbindAll();
+			y = 20;
+			lkit::value		b = p.eval(ctx);
+			if ((a == lkit::value(13)) && (b == lkit::value(23))) {
+				std::cout << "Success - " << ctx << " falls back to the shared variables when unbound" << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR - " << ctx << " got " << a << " and " << b << " but should be 13 and 23" << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * A program that's run a lot may be compiled to native code, and it
+	 * has to give the same answers as the tree, run after run - when the
+	 * divisor is zero, when the variables change type, and when there's
+	 * something in it that can't be compiled at all.
+	 */
+	if (!error) {
+		lkit::variable		x("x", 0), y("y", 0.5), b("b", true);
+		lkit::value			zero(0), one(1), two(2), three(3), five(5), ten(10), half(0.5), twice(2.0);
+		lkit::func::sum		sum;
+		lkit::func::diff	diff;
+		lkit::func::prod	prod;
+		lkit::func::quot	quot;
+		lkit::func::max		max;
+		lkit::func::comp	lt(lkit::func::comp::eLessThan);
+		lkit::func::comp	gt(lkit::func::comp::eGreaterThan);
+		lkit::func::comp	eq(lkit::func::comp::eEquals);
+		lkit::func::bin		land(lkit::func::bin::eAnd);
+		lkit::func::bin		lnot(lkit::func::bin::eNot);
+		lkit::func::cond	pick;
+		lkit::expression	negx(&diff, &x);
+		lkit::expression	dbly(&prod, &y, &two);
+		lkit::expression	mixed(&sum, &x, &dbly, &negx);
+		lkit::expression	ratio(&quot, &y, &x);
+		lkit::expression	range(&lt, &one, &x, &ten);
+		lkit::expression	big(&gt, &y, &half);
+		lkit::expression	notb(&lnot, &b);
+		lkit::expression	both(&land, &big, &notb);
+		lkit::expression	isx(&eq, &x, &three);
+		lkit::expression	dblr(&prod, &y, &twice);
+		lkit::expression	cond(&pick, &isx, &y, &dblr);
+		lkit::expression	less(&diff, &x, &five);
+		lkit::expression	most(&max, &x, &three, &less);
+		lkit::expression	half_x(&quot, &x, &two);
+		lkit::expression	steps(&lt, &one, &x, &dbly, &ten);
+		lkit::expression	*list[] = { &mixed, &ratio, &range, &both, &cond, &most, &half_x, &steps };
+		const int			cnt = sizeof(list)/sizeof(list[0]);
+		lkit::program		*p[cnt];
+		for (int i = 0; i < cnt; ++i) {
+			p[i] = new lkit::program(list[i]);
+		}
+		int		wrong = 0;
+		for (int pass = 0; pass < 1000; ++pass) {
+			// the second half of the runs has 'x' as a double
+			if (pass < 500) {
+				x = (pass % 7) - 3;
+			} else {
+				x = (pass % 7) * 0.75 - 1.5;
+			}
+			y = pass * 0.25;
+			b = ((pass % 2) == 0);
+			for (int i = 0; i < cnt; ++i) {
+				lkit::value		v = p[i]->eval();
+				if (v != list[i]->eval()) {
+					if (wrong++ == 0) {
+						std::cout << "ERROR - " << *p[i] << " got " << v << " but " << *list[i]
+								  << " is " << list[i]->eval() << " with x=" << x << std::endl;
+					}
+				}
+			}
+		}
+		if (wrong == 0) {
+			std::cout << "Success - " << cnt << " hot programs matched their trees for 1000 runs" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << wrong << " of the runs of the hot programs didn't match their trees" << std::endl;
+		}
+#ifdef LKIT_JIT
+		if (!error) {
+			// the comparisons are all ints and doubles, but the sum has an int on the left of a double
+			if (p[2]->isNative() && p[4]->isNative() && p[7]->isNative() && !p[0]->isNative()) {
+				std::cout << "Success - the hot programs are native code, where they can be" << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR - " << *p[2] << " is " << (p[2]->isNative() ? "" : "not ")
+						  << "native, and " << *p[0] << " is " << (p[0]->isNative() ? "" : "not ") << "native" << std::endl;
+			}
+		}
+#endif
+		for (int i = 0; i < cnt; ++i) {
+			delete p[i];
+		}
+	}
+
+	std::cout << (error ? "FAILED!" : "SUCCESS") << std::endl;
+	return (error ? 1 : 0);
+}
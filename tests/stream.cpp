@@ -0,0 +1,280 @@
+/**
+ * This is the test of the streaming evaluator of records
+ */
+//	System Headers
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+#include <boost/thread.hpp>
+
+//	Other Headers
+#include "parser.h"
+#include "stream.h"
+#include "util/timer.h"
+
+/**
+ * These are the little helpers for the files - write it all, read it all,
+ * and split what's read into it's lines.
+ */
+static void save( const std::string & aFile, const std::string & aData )
+{
+	std::ofstream	out(aFile.c_str(), std::ios::binary | std::ios::trunc);
+	out.write(aData.data(), aData.size());
+}
+
+
+static std::string slurp( const std::string & aFile )
+{
+	std::ifstream		in(aFile.c_str(), std::ios::binary);
+	std::ostringstream	all;
+	all << in.rdbuf();
+	return all.str();
+}
+
+
+static std::vector<std::string> lines( const std::string & aData )
+{
+	std::vector<std::string>	ans;
+	std::istringstream			in(aData);
+	std::string					line;
+	while (std::getline(in, line)) {
+		ans.push_back(line);
+	}
+	return ans;
+}
+
+
+/**
+ * This writes all the data to the pipe, and closes it - on a thread of
+ * it's own, as the pipe only holds so much until it's read.
+ */
+static void feed( int aPipe, const std::string *aData )
+{
+	size_t	done = 0;
+	while (done < aData->size()) {
+		ssize_t	cnt = write(aPipe, aData->data() + done, aData->size() - done);
+		if (cnt <= 0) {
+			break;
+		}
+		done += cnt;
+	}
+	close(aPipe);
+}
+
+
+/**
+ * These add the fields of a binary record, or header, to the data.
+ */
+template <class T> static void put( std::string & aData, T aValue )
+{
+	aData.append((const char *)&aValue, sizeof(aValue));
+}
+
+
+static void column( std::string & aData, lkit::value::value_type aType, const std::string & aName )
+{
+	put(aData, (uint32_t)aType);
+	put(aData, (uint32_t)aName.size());
+	aData.append(aName);
+}
+
+
+int main(int argc, char *argv[]) {
+	bool	error = false;
+	const std::string	in = "/tmp/lkit_stream_in";
+	const std::string	out = "/tmp/lkit_stream_out";
+
+	/**
+	 * A CSV file is mapped, and read in batches, and the results have to
+	 * be the same as the rule on each of the records - with the kept
+	 * columns just as they were, and the unused ones ignored.
+	 */
+	if (!error) {
+		const int			rows = 1000;
+		std::ostringstream	src;
+		src << "name,id,a,b,unused\r\n";
+		for (int i = 0; i < rows; ++i) {
+			src << "\"row " << i << ", of many\"," << i << "," << (i * 0.1) << ", " << (i % 17) * 1.5
+				<< ",junk" << ((i % 100) == 0 ? "\r\n\n" : "\n");
+		}
+		save(in, src.str());
+		lkit::parser	p;
+		p.setSource("(+ (* a 2.0) b id)");
+		lkit::stream	s(p);
+		s.setType("id", lkit::value::eInt);
+		s.keepColumn("name");
+		s.setBatchSize(64);
+		bool						ok = s.run(in, out);
+		std::vector<std::string>	got = lines(slurp(out));
+		int							wrong = 0;
+		for (int i = 0; ok && (i < rows); ++i) {
+			const std::string	& line = got[i + 1];
+			std::ostringstream	name;
+			name << "\"row " << i << ", of many\",";
+			double	want = (i * 0.1 * 2.0 + (i % 17) * 1.5) + i;
+			if ((line.compare(0, name.str().size(), name.str()) != 0) ||
+				(strtod(line.c_str() + name.str().size(), NULL) != want)) {
+				if (wrong++ == 0) {
+					std::cout << "ERROR - row " << i << " was '" << line << "' but should be " << want << std::endl;
+				}
+			}
+		}
+		if (ok && (got.size() == (size_t)rows + 1) && (got[0] == "name,result") &&
+			(s.getRowCount() == (uint64_t)rows) && (wrong == 0)) {
+			std::cout << "Success - the " << rows << " records of the CSV file were evaluated in batches of 64" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - the CSV run " << (ok ? "worked" : "failed") << " with " << s.getRowCount()
+					  << " rows, and " << got.size() << " lines out" << std::endl;
+		}
+	}
+
+	/**
+	 * A pipe is read a chunk at a time, with the lines split across the
+	 * reads, and the time columns are parsed as timestamps.
+	 */
+	if (!error) {
+		const int			rows = 20000;
+		uint64_t			base = lkit::util::timer::parseTimestamp("2012-01-15 09:30:00");
+		std::ostringstream	src;
+		src << "id,when,a\n";
+		for (int i = 0; i < rows; ++i) {
+			src << i << "," << lkit::util::timer::formatTimestamp(base + i * 1000000ULL)
+				<< "," << ((i % 10) * 0.1) << "\n";
+		}
+		std::string		data = src.str();
+		lkit::parser	p;
+		p.setSource("(and (> when cutoff) (> a 0.45))");
+		p.addVariable("cutoff", lkit::value((uint64_t)(base + rows / 2 * 1000000ULL)));
+		lkit::stream	s(p);
+		s.setType("when", lkit::value::eTime);
+		s.keepColumn("id");
+		int				fds[2];
+		bool			ok = false;
+		int				fd = open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if ((fd >= 0) && (pipe(fds) == 0)) {
+			boost::thread	writer(boost::bind(&feed, fds[1], &data));
+			ok = s.run(fds[0], fd);
+			writer.join();
+			close(fds[0]);
+		}
+		if (fd >= 0) {
+			close(fd);
+		}
+		std::vector<std::string>	got = lines(slurp(out));
+		int							wrong = 0;
+		for (int i = 0; ok && (i < rows) && (i + 1 < (int)got.size()); ++i) {
+			bool				want = ((i > rows / 2) && ((i % 10) * 0.1 > 0.45));
+			std::ostringstream	line;
+			line << i << "," << (want ? "true" : "false");
+			if (got[i + 1] != line.str()) {
+				if (wrong++ == 0) {
+					std::cout << "ERROR - row " << i << " was '" << got[i + 1] << "' but should be '" << line.str() << "'" << std::endl;
+				}
+			}
+		}
+		if (ok && (got.size() == (size_t)rows + 1) && (got[0] == "id,result") && (wrong == 0)) {
+			std::cout << "Success - the " << rows << " records from the pipe were evaluated with their timestamps" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - the pipe run " << (ok ? "worked" : "failed") << " with " << s.getRowCount()
+					  << " rows, and " << got.size() << " lines out" << std::endl;
+		}
+	}
+
+	/**
+	 * The binary format has the types in the header, and the results are
+	 * written the same way - doubles, with a NaN for an undefined one.
+	 */
+	if (!error) {
+		const int		rows = 300;
+		std::string		data("LKB1");
+		put(data, (uint32_t)3);
+		column(data, lkit::value::eInt, "id");
+		column(data, lkit::value::eDouble, "a");
+		column(data, lkit::value::eTime, "t");
+		for (int i = 0; i < rows; ++i) {
+			put(data, (int32_t)i);
+			put(data, i * 0.5);
+			put(data, (uint64_t)i * 1000);
+		}
+		save(in, data);
+		lkit::parser	p;
+		p.setSource("(/ a id)");
+		lkit::stream	s(p, lkit::stream::eBinary);
+		s.keepColumn("t");
+		s.setBatchSize(100);
+		bool			ok = s.run(in, out);
+		std::string		got = slurp(out);
+		std::string		head("LKB1");
+		put(head, (uint32_t)2);
+		column(head, lkit::value::eTime, "t");
+		column(head, lkit::value::eDouble, "result");
+		size_t			rec = sizeof(uint64_t) + sizeof(double);
+		int				wrong = 0;
+		if (ok && (got.size() == head.size() + rows * rec) && (got.compare(0, head.size(), head) == 0)) {
+			for (int i = 0; i < rows; ++i) {
+				uint64_t	t = 0;
+				double		d = 0.0;
+				memcpy(&t, got.data() + head.size() + i * rec, sizeof(t));
+				memcpy(&d, got.data() + head.size() + i * rec + sizeof(t), sizeof(d));
+				// the first row is a division by zero
+				if ((t != (uint64_t)i * 1000) || ((i == 0) ? !isnan(d) : (d != (i * 0.5) / i))) {
+					++wrong;
+				}
+			}
+		} else {
+			wrong = rows;
+		}
+		if (ok && (wrong == 0)) {
+			std::cout << "Success - the " << rows << " binary records were evaluated and written as binary" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - the binary run " << (ok ? "worked" : "failed") << " with " << wrong
+					  << " wrong rows in " << got.size() << " bytes out" << std::endl;
+		}
+
+		// a partial record at the end is a malformed file
+		data.append("oops");
+		save(in, data);
+		if (!s.run(in, out)) {
+			std::cout << "Success - a partial binary record is an error" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - a partial binary record wasn't caught" << std::endl;
+		}
+	}
+
+	/**
+	 * There has to be a source, and an input, to run at all.
+	 */
+	if (!error) {
+		lkit::parser	p;
+		p.setSource("(+ a 1)");
+		lkit::stream	s(p);
+		lkit::parser	none;
+		lkit::stream	t(none);
+		if (!s.run("/tmp/lkit_stream_missing", out) && !t.run(in, out) &&
+			!s.setType("a", lkit::value::eBool)) {
+			std::cout << "Success - a missing input, or source, is an error" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - a missing input, or source, wasn't caught" << std::endl;
+		}
+	}
+
+	unlink(in.c_str());
+	unlink(out.c_str());
+	std::cout << (error ? "FAILED!" : "SUCCESS") << std::endl;
+	return (error ? 1 : 0);
+}
@@ -0,0 +1,181 @@
+/**
+ * This is the test of the table the parser finds it's variables in
+ */
+//	System Headers
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+#ifndef LKIT_SINGLE_THREADED
+#include <boost/atomic.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/thread.hpp>
+#endif
+
+//	Other Headers
+#include "parser.h"
+#include "util/table.h"
+
+/**
+ * These are the names, and the things they point to, for the tests -
+ * each name has it's own int, so it's easy to see it's the right one.
+ */
+static std::string nameOf( int anIndex )
+{
+	std::ostringstream	name;
+	name << "var_" << anIndex;
+	return name.str();
+}
+
+
+#ifndef LKIT_SINGLE_THREADED
+/**
+ * This reader looks up all the names that have been published, over and
+ * over, while the writer keeps adding more - every one it finds has to be
+ * the one that was added for that name, and in it's slot.
+ */
+static void reader( const lkit::util::table<int> *aTable, const std::vector<int> *aValues,
+					const boost::atomic<bool> *aDone, int *aWrong )
+{
+	while (!aDone->load()) {
+		size_t	cnt = aTable->size();
+		for (size_t i = 0; i < cnt; ++i) {
+			int		slot = aTable->find(nameOf((int)i));
+			int		*v = aTable->get(slot);
+			if ((slot != (int)i) || (v != &(*aValues)[i])) {
+				++*aWrong;
+			}
+		}
+	}
+}
+
+
+/**
+ * This feeder sets it's own variables in the parser, by name and by
+ * slot, while the other feeders do the same with theirs, and the new
+ * names are being added to the parser.
+ */
+static void feeder( lkit::parser *aParser, int aFirst, int aCount, int *aWrong )
+{
+	for (int pass = 0; pass < 200; ++pass) {
+		for (int i = aFirst; i < aFirst + aCount; ++i) {
+			std::string		name = nameOf(i);
+			aParser->addVariable(name, lkit::value(pass));
+			int				slot = aParser->getVariableSlot(name);
+			if ((slot < 0) || !aParser->setVariable(slot, pass + 1)) {
+				++*aWrong;
+			}
+			const lkit::value	*v = aParser->getVariable(name);
+			if ((v == NULL) || (((lkit::value *)v)->evalAsInt() != pass + 1)) {
+				++*aWrong;
+			}
+		}
+	}
+}
+#endif
+
+
+int main(int argc, char *argv[]) {
+	bool	error = false;
+
+	/**
+	 * A name keeps it's slot - whatever's in it - until the table is
+	 * cleared, and the table grows well past where it starts.
+	 */
+	if (!error) {
+		lkit::util::table<int>	t;
+		std::vector<int>		vals(1000);
+		for (size_t i = 0; i < vals.size(); ++i) {
+			t.add(nameOf((int)i), &vals[i]);
+		}
+		size_t	wrong = 0;
+		for (size_t i = 0; i < vals.size(); ++i) {
+			if ((t.find(nameOf((int)i)) != (int)i) || (t.get(nameOf((int)i)) != &vals[i])) {
+				++wrong;
+			}
+		}
+		t.set(10, NULL);
+		int		again = t.add(nameOf(10), &vals[0]);
+		if ((wrong == 0) && (t.size() == vals.size()) && (t.find("nope") == -1) &&
+			(t.get("nope") == NULL) && (t.get(-1) == NULL) && (t.get(5000) == NULL) &&
+			(again == 10) && (t.get(10) == &vals[0])) {
+			std::cout << "Success - the table found all " << vals.size() << " names in their slots" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - the table had " << wrong << " wrong of " << t.size() << " names" << std::endl;
+		}
+		t.clear();
+		if ((t.size() == 0) && (t.find(nameOf(1)) == -1) && (t.add(nameOf(7), &vals[7]) == 0)) {
+			std::cout << "Success - a cleared table starts the slots over" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - a cleared table still had " << t.size() << " slots" << std::endl;
+		}
+	}
+
+#ifndef LKIT_SINGLE_THREADED
+	/**
+	 * The readers never lock, so they have to see every name that was
+	 * published - even as the hash, and the slots, grow under them.
+	 */
+	if (!error) {
+		lkit::util::table<int>	t;
+		std::vector<int>		vals(20000);
+		boost::atomic<bool>		done(false);
+		int						wrong[4] = { 0, 0, 0, 0 };
+		boost::thread_group		readers;
+		for (int r = 0; r < 4; ++r) {
+			readers.create_thread(boost::bind(&reader, &t, &vals, &done, &wrong[r]));
+		}
+		for (size_t i = 0; i < vals.size(); ++i) {
+			t.add(nameOf((int)i), &vals[i]);
+		}
+		done = true;
+		readers.join_all();
+		if ((wrong[0] + wrong[1] + wrong[2] + wrong[3]) == 0) {
+			std::cout << "Success - 4 readers saw the right slots as " << vals.size() << " names were added" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - the readers saw " << (wrong[0] + wrong[1] + wrong[2] + wrong[3]) << " wrong slots" << std::endl;
+		}
+	}
+
+	/**
+	 * The parser's feeders set their variables without any lock, while
+	 * the source is compiled, adding names of it's own, on this thread.
+	 */
+	if (!error) {
+		lkit::parser			p;
+		int						wrong[4] = { 0, 0, 0, 0 };
+		for (int i = 0; i < 400; ++i) {
+			p.addVariable(nameOf(i), lkit::value(0));
+		}
+		boost::thread_group		feeders;
+		for (int f = 0; f < 4; ++f) {
+			feeders.create_thread(boost::bind(&feeder, &p, f * 100, 100, &wrong[f]));
+		}
+		bool	ok = true;
+		for (int i = 0; ok && (i < 200); ++i) {
+			std::ostringstream	name;
+			name << "new_" << i;
+			p.setSource("(+ " + name.str() + " 1)");
+			p.addVariable(name.str(), lkit::value(i));
+			ok = (p.eval() == i + 1);
+		}
+		feeders.join_all();
+		if (ok && ((wrong[0] + wrong[1] + wrong[2] + wrong[3]) == 0) &&
+			(p.getVariableSlotCount() == 402 + 200)) {
+			std::cout << "Success - 4 feeders set their variables while the source was compiled 200 times" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - the feeders had " << (wrong[0] + wrong[1] + wrong[2] + wrong[3])
+					  << " wrong, and there are " << p.getVariableSlotCount() << " slots" << std::endl;
+		}
+	}
+#endif
+
+	std::cout << (error ? "FAILED!" : "SUCCESS") << std::endl;
+	return (error ? 1 : 0);
+}
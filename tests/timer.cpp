@@ -2,6 +2,7 @@
  * This is the test of the timer (date) parsing
  */
 //	System Headers
+#include <time.h>
 #include <iostream>
 #include <string>
 
@@ -76,6 +77,84 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	/**
+	 * The timestamp can be parsed right out of the middle of some other
+	 * text - by it's length - and every day of a few years has to come
+	 * out just as mktime() would have it.
+	 */
+	if (!error) {
+		const char	*src = "('2012-03-21 11:45:16.5' x)";
+		uint64_t	ref = 1332351916LL * 1000000LL + 500000LL;
+		uint64_t	stamp = timer::parseTimestamp(src + 2, 21);
+		if (stamp == ref) {
+			std::cout << "Success, converted date+time+fraction in the middle of the source to stamp!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, could not convert the middle of " << src << " to stamp! Got: " << stamp << std::endl;
+		}
+	}
+	if (!error) {
+		for (time_t day = 946684800; !error && (day < 1420070400); day += 86400) {
+			struct tm	when;
+			gmtime_r(&day, &when);
+			when.tm_hour = (int)(day / 86400) % 24;
+			when.tm_min = 59;
+			when.tm_sec = 30;
+			when.tm_isdst = 0;
+			char		buff[40];
+			strftime(buff, sizeof(buff), "%Y-%m-%d %H:%M:%S", &when);
+			uint64_t	ref = mktime(&when) * 1000000LL;
+			uint64_t	stamp = timer::parseTimestamp(buff);
+			if (stamp != ref) {
+				error = true;
+				std::cout << "ERROR, could not convert " << buff << " to stamp! Got: " << stamp << " but should be " << ref << std::endl;
+			}
+		}
+		if (!error) {
+			std::cout << "Success, converted every day from 2000 to 2014 just as mktime() does!" << std::endl;
+		}
+	}
+	/**
+	 * Leading blanks are skipped, and a date with nothing after it is
+	 * the midnight that starts it.
+	 */
+	if (!error) {
+		std::string	ts(" 2012-03-21 11:45:16");
+		uint64_t	ref = 1332351916LL * 1000000LL;
+		uint64_t	stamp = timer::parseTimestamp(ts);
+		if (stamp == ref) {
+			std::cout << "Success, converted date+time with a leading blank to stamp!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, could not convert '" << ts << "' to stamp! Got: " << stamp << std::endl;
+		}
+
+		ts = "2012-03-21 ";
+		ref = 1332309600LL * 1000000LL;
+		stamp = timer::parseTimestamp(ts);
+		if (stamp == ref) {
+			std::cout << "Success, converted date with a trailing blank to stamp!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR, could not convert '" << ts << "' to stamp! Got: " << stamp << std::endl;
+		}
+	}
+	if (!error) {
+		const char	*bad[] = { "2012-13-21", "2012-03-00", "junk", "",
+							   "2012-03-21 11:45", "2012-03-21 24:00:00",
+							   "2012-03-21 11:60:61", "2012-03-21 junk" };
+		for (int i = 0; !error && (i < 8); ++i) {
+			uint64_t	stamp = timer::parseTimestamp(bad[i]);
+			if (stamp != 0) {
+				error = true;
+				std::cout << "ERROR, converted '" << bad[i] << "' to stamp: " << stamp << std::endl;
+			}
+		}
+		if (!error) {
+			std::cout << "Success, the malformed timestamps are all zero" << std::endl;
+		}
+	}
+
 	std::cout << (error ? "FAILED!" : "SUCCESS") << std::endl;
 	return (error ? 1 : 0);
 }
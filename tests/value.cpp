@@ -3,7 +3,9 @@
  */
 //	System Headers
 #include <iostream>
+#include <math.h>
 #include <string>
+#include <utility>
 
 //	Third-Party Headers
 
@@ -130,6 +132,71 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	/**
+	 * The plain data of a value has to be small, and it has to carry
+	 * the type and contents back and forth without losing anything.
+	 */
+	if (!error) {
+		if (sizeof(lkit::datum) == 16) {
+			std::cout << "Success - the datum is 16 bytes!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - the datum is " << sizeof(lkit::datum) << " bytes - should be 16" << std::endl;
+		}
+	}
+
+	if (!error) {
+		lkit::value		src[] = { lkit::value(true), lkit::value(42), lkit::value(3.25),
+								  lkit::value((uint64_t)1332348316000LL), lkit::value() };
+		for (size_t i = 0; !error && (i < sizeof(src)/sizeof(src[0])); ++i) {
+			lkit::datum		d = src[i].getDatum();
+			lkit::value		v(d);
+			if ((v == src[i]) && (v.isUndefined() == src[i].isUndefined())) {
+				std::cout << "Success - the datum carries the value: " << v << std::endl;
+			} else {
+				error = true;
+				std::cout << "ERROR - the datum didn't carry the value: " << v << " should be: " << src[i] << std::endl;
+			}
+		}
+	}
+
+	if (!error) {
+		lkit::value		v(10);
+		v = lkit::value(2.5).getDatum();
+		if (v.isDouble() && (v == 2.5)) {
+			std::cout << "Success - a datum can be assigned to a value!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - a datum wasn't assigned to the value: " << v << " should be: (double)2.5" << std::endl;
+		}
+	}
+
+	/**
+	 * Moving a value takes it's contents, and evaluating into a value is
+	 * the same as eval() - it's just not through a temporary.
+	 */
+	if (!error) {
+		lkit::value		a(2.5);
+		lkit::value		b(a.eval());
+		lkit::value		c(true);
+		lkit::value		& r = a.eval(c);
+		lkit::value		d(7);
+#if __cplusplus >= 201103L
+		lkit::value		m(std::move(b));
+		d = std::move(m);
+#else
+		d = b;
+#endif
+		if ((&r == &c) && c.isDouble() && (c == 2.5) && d.isDouble() && (d == 2.5) &&
+			(a.eval(a) == 2.5)) {
+			std::cout << "Success - a value can be moved, and evaluated into another!" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - moving, or evaluating into, a value got: " << c << " and " << d
+					  << " should be: (double)2.5" << std::endl;
+		}
+	}
+
 	std::cout << (error ? "FAILED!" : "SUCCESS") << std::endl;
 	return (error ? 1 : 0);
 }
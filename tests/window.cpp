@@ -0,0 +1,247 @@
+/**
+ * This is the test of the time-series window functions
+ */
+//	System Headers
+#include <math.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//	Third-Party Headers
+
+//	Other Headers
+#include "value.h"
+#include "variable.h"
+#include "expression.h"
+#include "window_functions.h"
+#include "parser.h"
+
+/**
+ * These are the brute-force answers for the samples in a window - the
+ * samples and their times are all there, and we look at every one of
+ * those that are still in the window.
+ */
+struct series
+{
+	series( size_t aCapacity, uint64_t aSpan ) : cap(aCapacity), span(aSpan) { };
+	void add( double aSample, uint64_t aTime )
+	{
+		if (!times.empty() && (times.back() == aTime)) {
+			samples.back() = aSample;
+		} else {
+			samples.push_back(aSample);
+			times.push_back(aTime);
+		}
+	}
+	size_t first() const
+	{
+		size_t	f = (samples.size() > cap ? samples.size() - cap : 0);
+		while ((span > 0) && (f < samples.size()) && (times[f] + span <= times.back())) {
+			++f;
+		}
+		return f;
+	}
+	double sum() const
+	{
+		double	s = 0.0;
+		for (size_t i = first(); i < samples.size(); ++i) {
+			s += samples[i];
+		}
+		return s;
+	}
+	double most() const
+	{
+		double	m = samples[first()];
+		for (size_t i = first(); i < samples.size(); ++i) {
+			m = (samples[i] > m ? samples[i] : m);
+		}
+		return m;
+	}
+	double least() const
+	{
+		double	m = samples[first()];
+		for (size_t i = first(); i < samples.size(); ++i) {
+			m = (samples[i] < m ? samples[i] : m);
+		}
+		return m;
+	}
+	int count() const
+	{
+		return (int)(samples.size() - first());
+	}
+	size_t					cap;
+	uint64_t				span;
+	std::vector<double>		samples;
+	std::vector<uint64_t>	times;
+};
+
+
+/**
+ * Sums and means are close enough if they're within rounding of the
+ * brute-force answer.
+ */
+static bool close( double aValue, double aRef )
+{
+	return (fabs(aValue - aRef) <= 1e-9 * (1.0 + fabs(aRef)));
+}
+
+
+int main(int argc, char *argv[]) {
+	bool	error = false;
+
+	/**
+	 * Each of the windows - by count, and by time - has to give the same
+	 * answers as looking at all the samples in the window, as the samples
+	 * come and go, and when the newest is replaced at the same time.
+	 */
+	for (int mode = 0; !error && (mode < 2); ++mode) {
+		size_t				cap = 50;
+		uint64_t			span = (mode == 0 ? 0 : 1000);
+		series				ref(cap, span);
+		lkit::func::moving_sum		sum(cap, span);
+		lkit::func::moving_mean		mean(cap, span);
+		lkit::func::moving_max		max(cap, span);
+		lkit::func::moving_min		min(cap, span);
+		lkit::func::moving_count	count(cap, span);
+		lkit::func::window			*all[] = { &sum, &mean, &max, &min, &count };
+		srand(42 + mode);
+		uint64_t			when = 1000000;
+		for (int i = 0; !error && (i < 20000); ++i) {
+			// mostly step forward, but now and then, re-do the newest sample
+			if ((rand() % 5) != 0) {
+				when += (rand() % 60);
+			}
+			double		x = (rand() % 2000) / 8.0 - 100.0;
+			lkit::value	v(x);
+			ref.add(x, when);
+			lkit::value	ans[5];
+			for (int f = 0; f < 5; ++f) {
+				ans[f] = all[f]->add(v, when);
+			}
+			if (!close(ans[0].evalAsDouble(), ref.sum()) ||
+				!close(ans[1].evalAsDouble(), ref.sum() / ref.count()) ||
+				(ans[2] != lkit::value(ref.most())) ||
+				(ans[3] != lkit::value(ref.least())) ||
+				(ans[4] != lkit::value(ref.count()))) {
+				error = true;
+				std::cout << "ERROR - sample " << i << " got sum=" << ans[0] << " mean=" << ans[1]
+						  << " max=" << ans[2] << " min=" << ans[3] << " count=" << ans[4]
+						  << " but should be " << ref.sum() << ", " << ref.sum() / ref.count()
+						  << ", " << ref.most() << ", " << ref.least() << ", " << ref.count() << std::endl;
+			}
+		}
+		if (!error) {
+			std::cout << "Success - " << sum << ", " << mean << ", " << max << ", " << min
+					  << " and " << count << " match the brute-force answers for 20000 samples" << std::endl;
+		}
+	}
+
+	/**
+	 * A window of ints has to keep it's sum as an int, and the window
+	 * has to start over when it's reset.
+	 */
+	if (!error) {
+		lkit::func::moving_sum	sum(3);
+		lkit::value		a, b, c, d;
+		a = sum.add(lkit::value(1));
+		b = sum.add(lkit::value(2));
+		c = sum.add(lkit::value(3));
+		d = sum.add(lkit::value(4));
+		sum.reset();
+		lkit::value		e = sum.add(lkit::value(10));
+		if ((a == lkit::value(1)) && (b == lkit::value(3)) && (c == lkit::value(6)) &&
+			(d == lkit::value(9)) && (e == lkit::value(10)) && (sum.getCount() == 1)) {
+			std::cout << "Success - " << sum << " keeps an int sum of the last 3 samples" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << sum << " got " << a << ", " << b << ", " << c << ", " << d << ", " << e << std::endl;
+		}
+	}
+
+	/**
+	 * The EMA by count has to match the usual recurrence, and the EMA by
+	 * time has to weight each sample by how long it's been.
+	 */
+	if (!error) {
+		lkit::func::ema		byCount(9);
+		lkit::func::ema		byTime(1, 1000);
+		double				refCount = 0.0;
+		double				refTime = 0.0;
+		uint64_t			when = 5000;
+		uint64_t			last = 0;
+		for (int i = 0; !error && (i < 1000); ++i) {
+			double		x = (i % 17) * 1.5;
+			when += 10 + (i % 7) * 100;
+			lkit::value	c = byCount.add(lkit::value(x));
+			lkit::value	t = byTime.add(lkit::value(x), when);
+			refCount = (i == 0 ? x : refCount + 0.2 * (x - refCount));
+			refTime = (i == 0 ? x : refTime + (1.0 - exp(-(double)(when - last) / 1000.0)) * (x - refTime));
+			last = when;
+			if (!close(c.evalAsDouble(), refCount) || !close(t.evalAsDouble(), refTime)) {
+				error = true;
+				std::cout << "ERROR - sample " << i << " got " << c << " and " << t << " but should be " << refCount << " and " << refTime << std::endl;
+			}
+		}
+		if (!error) {
+			std::cout << "Success - " << byCount << " and " << byTime << " match the recurrence for 1000 samples" << std::endl;
+		}
+	}
+
+	/**
+	 * In an expression, the window function is called on every evaluation,
+	 * and with the time as the second argument, evaluating it again for the
+	 * same time doesn't add the sample again.
+	 */
+	if (!error) {
+		lkit::variable		x("x", 1.0);
+		lkit::variable		t("t", (uint64_t)100);
+		lkit::func::moving_sum	sum(10, 50);
+		lkit::expression	e(&sum, &x, &t);
+		lkit::value			a = e.eval();
+		lkit::value			b = e.eval();
+		x = 2.0;
+		lkit::value			c = e.eval();
+		t = (uint64_t)120;
+		lkit::value			d = e.eval();
+		t = (uint64_t)160;
+		x = 5.0;
+		lkit::value			f = e.eval();
+		if ((a == lkit::value(1.0)) && (b == lkit::value(1.0)) && (c == lkit::value(2.0)) &&
+			(d == lkit::value(4.0)) && (f == lkit::value(7.0))) {
+			std::cout << "Success - " << e << " holds the samples in the last 50us" << std::endl;
+		} else {
+			error = true;
+			std::cout << "ERROR - " << e << " got " << a << ", " << b << ", " << c << ", " << d << ", " << f << std::endl;
+		}
+	}
+
+	/**
+	 * ...and it has to work the same way in the parser, once it's been
+	 * added as a function, and the variable is set by it's slot.
+	 */
+	if (!error) {
+		lkit::parser	p;
+		p.addFunction("avg4", new lkit::func::moving_mean(4));
+		p.addFunction("hi4", new lkit::func::moving_max(4));
+		p.addVariable("x", lkit::value(0));
+		p.setSource("(- (avg4 x) (hi4 x))");
+		int				slot = p.getVariableSlot("x");
+		int				xs[] = { 4, 8, 2, 6, 10, 0 };
+		double			refs[] = { 0.0, -2.0, -3.3333333333333335, -3.0, -3.5, -5.5 };
+		for (int i = 0; !error && (i < 6); ++i) {
+			p.setVariable(slot, xs[i]);
+			lkit::value		ans = p.eval();
+			if (!close(ans.evalAsDouble(), refs[i])) {
+				error = true;
+				std::cout << "ERROR - " << p.getSource() << " got " << ans << " for x=" << xs[i] << " but should be " << refs[i] << std::endl;
+			}
+		}
+		if (!error) {
+			std::cout << "Success - " << p.getSource() << " runs the windows in the parser" << std::endl;
+		}
+	}
+
+	std::cout << (error ? "FAILED!" : "SUCCESS") << std::endl;
+	return (error ? 1 : 0);
+}